@@ -53,6 +53,7 @@
 *               Load_Names
 *               Load_U16
 *               Pixie_Boot
+*               Boot_Report
 *               Pixie_Boot_ComFPGA
 *               Pixie_Boot_FIPPI
 
@@ -65,6 +66,7 @@
 
 #include "globals.h"
 #include <time.h>
+#include <pthread.h>
 
 // PXI system initialization arrays replacing the pxisys.ini files
 
@@ -81,7 +83,8 @@ U8  PCIDeviceNum_1062_ini [PRESET_MAX_PXI_SLOTS+1]   = {0, 0, 15, 14, 13, 13, 12
 *       Pixie_Init_VarNames:
 *               Initialize DSP I/O parameter names and DSP internal memory
 *               parameter names from files, namely, DSPcode.var and DSPcode.lst
-*               file, by calling function Load_Names.
+*               file, by calling function Load_Names, and builds the hash
+*               indices Find_Xact_Match uses to look up parameter names.
 *
 *               Return Value:
 *                        0 - load successful
@@ -116,6 +119,12 @@ S32 Pixie_Init_VarNames(void)
                 return(-3);
         }
 
+        /* Hash indices of the parameter names for Find_Xact_Match */
+        Pixie_Index_Names(DSP_Parameter_Names,     N_DSP_PAR);
+        Pixie_Index_Names(Channel_Parameter_Names, N_CHANNEL_PAR);
+        Pixie_Index_Names(Module_Parameter_Names,  N_MODULE_PAR);
+        Pixie_Index_Names(System_Parameter_Names,  N_SYSTEM_PAR);
+
         /* DSP internal memory parameter names; currently not being used. */
         /*
         retval = Load_Names(Boot_File_Name_List[6], DSP_MEM_NAM, N_MEM_PAR, MAX_MEM_NAME_LENGTH);
@@ -268,6 +277,9 @@ S32 Load_Names (
 *               Load communication FPGA configuration, FIPPI configuration,
 *               DSP code, and DSP I/O variable values from files in unsigned
 *               16-bit format.
+*               FPGA configurations are kept with their bit-reversed image
+*               for the configuration loader (FPGA_Image_Build) and are not
+*               read again while the file is unchanged.
 *       
 *               Return Value:
 *                        0 - load successful
@@ -286,6 +298,13 @@ S32 Load_U16 ( S8 *filnam,                      // file name
         S32   retval=0;
         U16   k;
         FILE *dataFile = NULL;
+
+        if(FPGA_Image_Current(filnam, ConfigName)) {
+                sprintf(ErrMSG, "*INFO* (Load_U16): file %s is unchanged, using the configuration in memory", filnam);
+                Pixie_Print_MSG(ErrMSG,PrintDebugMsg_Boot);
+                return(0);
+        }
+
         dataFile = fopen(filnam, "rb");
         if(dataFile != NULL) {  
                 switch(ConfigName) {            
@@ -391,7 +410,8 @@ S32 Load_U16 ( S8 *filnam,                      // file name
                         }
                         break;
                 case P32_FPGA_CONFIG:   /* P500E FPGA configuration */
-					P32_FPGA_Configuration = (U8*)malloc(N_P32_BYTES);
+					if(P32_FPGA_Configuration == NULL)
+						P32_FPGA_Configuration = (U8*)malloc(N_P32_BYTES);
 					nWords = fread(P32_FPGA_Configuration, 2, (N_P32_BYTES/2), dataFile);
 					if (nWords < N_P32_BYTES/2) {
 						sprintf(ErrMSG, "*ERROR* (Load_U16): reading P32 FPGA code in Module %d incomplete, %u %d", Chosen_Module, nWords, N_P32_BYTES/2);
@@ -420,6 +440,8 @@ S32 Load_U16 ( S8 *filnam,                      // file name
                 }
 
                 fclose(dataFile);       /* Close file */
+                if(retval == 0)
+                        FPGA_Image_Build(filnam, ConfigName);
                 sprintf(ErrMSG, "*INFO* (Load_U16): finished loading file %s", filnam);
                 Pixie_Print_MSG(ErrMSG,PrintDebugMsg_Boot);
                 return(retval);         
@@ -432,6 +454,194 @@ S32 Load_U16 ( S8 *filnam,                      // file name
 }
 
 
+/* Result of the last Pixie_Boot for each module, see Boot_Report */
+struct Boot_Worker {
+        U8  ModNum;
+        U16 Pattern;            // Boot_Pattern
+        pthread_t Thread;       // 0 if booted without a thread
+        S32 Status;             // 0 or the Pixie_Boot error code
+        U16 Failed;             // Boot_Pattern bit of the phase that failed, 0 if none
+        U32 Time[BOOT_PHASES];  // ms per phase
+};
+
+static struct Boot_Worker BootWorker[PRESET_MAX_MODULES];
+
+static const char *Boot_Phase_Names[BOOT_PHASES] = {"booting FIPPI", "booting DSP", "DSP parameter download", "Program FIPPI"};
+
+static U32 Boot_ms (void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return((U32)(ts.tv_sec*1000 + ts.tv_nsec/1000000));
+}
+
+static U16 Boot_Phase_Index (U16 bit)
+{
+        U16 phase;
+
+        for(phase=0; phase<BOOT_PHASES-1; phase++)
+                if(bit == (0x2 << phase))
+                        break;
+        return(phase);
+}
+
+
+/****************************************************************
+*       Boot_Module_Phase:
+*               One boot phase for one module, as set by bits 1-4 of 
+*               Boot_Pattern:
+*                       0:      Boot FIPPI
+*                       1:      Boot DSP
+*                       2:      Load DSP parameters
+*                       3:      Apply DSP parameters (Set_DACs, Program_FIPPI,
+*                               enable detector input)
+*               Modules only access their own registers and memory here,
+*               so different modules can be booted at the same time.
+*
+*               Return Value:
+*                        0 - success
+*                       -82 - downloading FiPPI configuration failed
+*                       -83 - downloading DSP code failed
+*                       -84 - failed to set DACs
+*                       -85 - failed to program FiPPI
+*                       -86 - failed to enable detector input
+*
+****************************************************************/
+
+static S32 Boot_Module_Phase (
+                U8  i,                  // Pixie module number
+                U16 phase )             // boot phase, 0..BOOT_PHASES-1
+{
+        S32 retval;
+        U16 k;
+        U32 buffer[DSP_IO_BORDER];
+        U16 BoardRevision;
+
+        BoardRevision = (U16)Pixie_Devices[i].Module_Parameter_Values[Find_Xact_Match("BOARD_VERSION", Module_Parameter_Names, N_MODULE_PAR)];
+
+        switch(phase) {
+        case 0:
+                // **************************************************************
+                // Download FIPPI
+                // **************************************************************
+                sprintf(ErrMSG, "*INFO* (Pixie_Boot): Revision 0x%X", BoardRevision);
+                Pixie_Print_MSG(ErrMSG,1);
+                if(Offline == OFFLINE_EMULATOR) {       // emulated module: nothing to configure
+                        sprintf(ErrMSG, "*INFO* (Pixie_Boot): module %d is emulated, no FiPPI configuration", i);
+                        Pixie_Print_MSG(ErrMSG,PrintDebugMsg_Boot);
+                        break;
+                }
+                retval = -2;    // unknown module type
+                if((BoardRevision & 0x0F00) == MODULETYPE_P4 )  
+                        retval=Pixie_Boot_FIPPI(i);  // For Pixie-4: Boot FIPPI 
+#ifdef WINDRIVER_API
+                if((BoardRevision & 0x0F00) == MODULETYPE_P500e) 
+                        retval=PIXIE500E_ProgramFPGA(hDev[i], 3, MODULETYPE_P500e); // For P500e: Boot Virtex 
+                if((BoardRevision & 0x0F00) == MODULETYPE_P4e)
+                        retval = PIXIE4E_ProgramFPGA(hDev[i], 2, (BoardRevision & 0x0FF0)); // P4e: common boot function
+                if((BoardRevision & 0x0F00) == MODULETYPE_P32)  // configuration read by Pixie_Boot
+                        retval = PIXIE4E_ProgramFPGA(hDev[i], 2, (BoardRevision & 0x0FF0)); // P4e+P32: common boot function
+#endif
+                if(retval < 0) {
+                        sprintf(ErrMSG, "*ERROR* (Pixie_Boot): downloading FiPPI configuration to module %d was not successful.", i);
+                        Pixie_Print_MSG(ErrMSG,1);
+                        if (retval==REGIO_ERR) {
+                                sprintf(ErrMSG, "Encountered potentially fatal error communicating to module, PC may lock up.");
+                                Pixie_Print_MSG(ErrMSG,1);
+                                sprintf(ErrMSG, "Save all open files now, then try a PLL reset for a chance to recover");
+                                Pixie_Print_MSG(ErrMSG,1);
+                        }
+                        return(BOOT_FIPPI_ERR);
+                }
+                sprintf(ErrMSG, "*INFO* (Pixie_Boot): FiPPI configuration in module %d was successful.", i);
+                Pixie_Print_MSG(ErrMSG,PrintDebugMsg_Boot);
+                Pixie_Sleep(1);
+                break;
+
+        case 1:
+                // **************************************************************
+                // Download DSP code
+                // **************************************************************
+                retval = 0;     // no DSP code for other module types
+                if(Offline == OFFLINE_EMULATOR)         // emulated module: no DSP code
+                        break;
+                if((BoardRevision & 0x0F00) == MODULETYPE_P4 ) retval=Pixie_Boot_DSP(i, MODULETYPE_P4);                 // Boot DSP for Pixie-4 
+        #ifdef WINDRIVER_API            
+                if((BoardRevision & 0x0F00) == MODULETYPE_P500e ) retval=PIXIE500E_ProgramDSP(hDev[i]);         // Boot DSP for P500e
+                if((BoardRevision & 0x0F00) == MODULETYPE_P4e)    retval=PIXIE500E_ProgramDSP(hDev[i]);     // Boot DSP for P4e (same as P500e) 
+        #endif
+                if(retval < 0) {
+                        sprintf(ErrMSG, "*ERROR* (Pixie_Boot): downloading DSP code to module %d was not successful.", i);
+                        Pixie_Print_MSG(ErrMSG,1);
+                        return(BOOT_DSP_ERR);
+                }
+                break;
+
+        case 2:
+                // **************************************************************
+                // Download DSP parameter values
+                // Pass the 64 Module parameters and 48*4 channel parameters
+                // to DSP (DSP_IO_BORDER)
+                // **************************************************************
+                /* Convert data type */
+                for(k=0; k < DSP_IO_BORDER; k++) buffer[k] = (U32)Pixie_Devices[i].DSP_Parameter_Values[k];
+                /* Download new settings into the module */
+                Pixie_IODM(i, DATA_MEMORY_ADDRESS, MOD_WRITE, DSP_IO_BORDER, buffer);
+                // NOTE: MUST HAVE Sleep below for Sample.c (otherwise DSP parameters are set with errors)
+                Pixie_Sleep(500);
+                break;
+
+        case 3:
+                // **************************************************************
+                // Now start control tasks 0 and 5 to set DACs and program FIPPI
+                // **************************************************************
+                retval=Control_Task_Run(i, SET_DACS, 1000); /* Set DACs */
+                if(retval < 0) {
+                        sprintf(ErrMSG, "*ERROR* (Pixie_Boot): Set DACs in module %d failed.", i);
+                        Pixie_Print_MSG(ErrMSG,1);
+                        return(SET_DAC_ERR);
+                }
+                retval=Control_Task_Run(i, PROGRAM_FIPPI, 1000); /* Program FiPPI */
+                if(retval < 0) {
+                        sprintf(ErrMSG, "*ERROR* (Pixie_Boot): Program FiPPI in module %d failed.", i);
+                        Pixie_Print_MSG(ErrMSG,1);
+                        return(PROG_FIPPI_ERR);
+                }
+                retval=Control_Task_Run(i, ENABLE_INPUT, 1000); /* Connect detector input */
+                if(retval < 0) {
+                        sprintf(ErrMSG, "*ERROR* (Pixie_Boot): Enable detector input in module %d failed.", i);
+                        Pixie_Print_MSG(ErrMSG,1);
+                        return(ENA_INTS_ERR);
+                }
+                break;
+        }
+
+        return(0);
+}
+
+
+static void *Boot_Module_Thread (void *arg)
+{
+        struct Boot_Worker *w = (struct Boot_Worker *)arg;
+        U16 phase;
+        U32 t;
+
+        for(phase=0; phase<BOOT_PHASES; phase++) {
+                if(!(w->Pattern & (0x2 << phase)))
+                        continue;
+                t = Boot_ms();
+                w->Status = Boot_Module_Phase(w->ModNum, phase);
+                w->Time[phase] = Boot_ms() - t;
+                if(w->Status < 0) {
+                        w->Failed = 0x2 << phase;
+                        break;
+                }
+        }
+        return(NULL);
+}
+
+
 /****************************************************************
 *       Pixie_Boot:
 *               Boot the Pixie according the Boot_Pattern.
@@ -442,6 +652,13 @@ S32 Load_U16 ( S8 *filnam,                      // file name
 *                       bit 3:  Load DSP parameters
 *                       bit 4:  Apply DSP parameters (calls Set_DACs
 *                                       and Program_FIPPI)
+*               If BootParallel is set, express modules are booted all at
+*               the same time, each by its own thread going through bits
+*               1-4, so the crate boots about as fast as the slowest 
+*               module. Otherwise each step is done for all modules before
+*               the next, stopping at the first error.
+*               The time of each step and any error are printed for each
+*               module and kept for Boot_Report.
 *
 *               Return Value:
 *                        0 - boot successful
@@ -452,6 +669,7 @@ S32 Load_U16 ( S8 *filnam,                      // file name
 *                       -85 - failed to program FiPPI
 *                       -86 - failed to enable detector input
 *                       -87 - incorrect boot pattern
+*               (in parallel mode, the error of the first module that failed)
 *
 ****************************************************************/
 
@@ -459,10 +677,11 @@ S32 Pixie_Boot (U16 Boot_Pattern)               // boot pattern is a bit mask
 {
 
         S32 retval = -2;
-        U16 k;
+        U16 phase;
         U32 buffer[DATA_MEMORY_LENGTH];
         U8  modulenumber, i;
         U16     BoardRevision;
+        U32 start, t;
 
         U32 dwData,dwStatus;
         U16 Cversion, Cbuild;
@@ -522,146 +741,96 @@ S32 Pixie_Boot (U16 Boot_Pattern)               // boot pattern is a bit mask
         }
 
         // **************************************************************
-        // Download FIPPI
+        // Read the P32 FiPPI configuration once for all P32 modules
         // **************************************************************
         if(Boot_Pattern & 0x2) {
-			sprintf(ErrMSG, "*INFO* (Pixie_Boot): Begin booting FIPPI");
-			Pixie_Print_MSG(ErrMSG,PrintDebugMsg_Boot);
-			for(i=0; i<Number_Modules; i++) {
-				// Get Board Revision 
-				BoardRevision = (U16)Pixie_Devices[i].Module_Parameter_Values[Find_Xact_Match("BOARD_VERSION", Module_Parameter_Names, N_MODULE_PAR)];
-				sprintf(ErrMSG, "*INFO* (Pixie_Boot): Revision 0x%X", BoardRevision);
-				Pixie_Print_MSG(ErrMSG,1);
-				if((BoardRevision & 0x0F00) == MODULETYPE_P4 )  
-					retval=Pixie_Boot_FIPPI(i);  // For Pixie-4: Boot FIPPI 
-#ifdef WINDRIVER_API
-				if((BoardRevision & 0x0F00) == MODULETYPE_P500e) 
-					retval=PIXIE500E_ProgramFPGA(hDev[i], 3, MODULETYPE_P500e); // For P500e: Boot Virtex 
-				if((BoardRevision & 0x0F00) == MODULETYPE_P4e)
-					retval = PIXIE4E_ProgramFPGA(hDev[i], 2, (BoardRevision & 0x0FF0)); // P4e: common boot function
-				if((BoardRevision & 0x0F00) == MODULETYPE_P32) 
-				{
-					retval=Load_U16(Boot_File_Name_List[9], P32_FPGA_CONFIG, (N_P32_BYTES/4));
-					sprintf(ErrMSG, "*DEBUG* (Pixie_Boot_System): Loading P32 file from P500e file list entry.");
-					Pixie_Print_MSG(ErrMSG,1);
-					if(retval < 0) {
-						sprintf(ErrMSG, "*ERROR* (Pixie_Boot_System): Unable to read FiPPI configuration (P32).");
-						Pixie_Print_MSG(ErrMSG,1);
-						return(RD_FIP_ERR);
-					}
-					retval = PIXIE4E_ProgramFPGA(hDev[i], 2, (BoardRevision & 0x0FF0)); // P4e+P32: common boot function
-				}
-
-#endif
-				if(retval < 0) {
-					sprintf(ErrMSG, "*ERROR* (Pixie_Boot): downloading FiPPI configuration to module %d was not successful.", i);
-					Pixie_Print_MSG(ErrMSG,1);
-					if (retval==REGIO_ERR) {
-						sprintf(ErrMSG, "Encountered potentially fatal error communicating to module, PC may lock up.");
-						Pixie_Print_MSG(ErrMSG,1);
-						sprintf(ErrMSG, "Save all open files now, then try a PLL reset for a chance to recover");
-						Pixie_Print_MSG(ErrMSG,1);
-					}
-					return(BOOT_FIPPI_ERR);
-				}
-				else {
-					sprintf(ErrMSG, "*INFO* (Pixie_Boot): FiPPI configuration in module %d was successful.", i);
-					Pixie_Print_MSG(ErrMSG,PrintDebugMsg_Boot);
-					Pixie_Sleep(1);
-				}
-			} // for
-        } // boot pattern 0x2
-
-        if (PCIBusType == REGULAR_PCI) {
-                /* enable LED */
-                for(i=0; i<Number_Modules; i++) {
-                        buffer[0] = 0x38;
-                        Pixie_Register_IO(i, PCI_CFCTRL, MOD_WRITE, buffer);
-                }
-        }
-
-        // **************************************************************
-        // Download DSP code
-        // **************************************************************
-        if(Boot_Pattern & 0x4) {
-                sprintf(ErrMSG, "*INFO* (Pixie_Boot): Begin booting DSP");
-                Pixie_Print_MSG(ErrMSG,PrintDebugMsg_Boot);
-                /* Boot DSP */
                 for(i=0; i<Number_Modules; i++) {
                         BoardRevision = (U16)Pixie_Devices[i].Module_Parameter_Values[Find_Xact_Match("BOARD_VERSION", Module_Parameter_Names, N_MODULE_PAR)];
-                        if((BoardRevision & 0x0F00) == MODULETYPE_P4 ) retval=Pixie_Boot_DSP(i, MODULETYPE_P4);                 // Boot DSP for Pixie-4 
-        #ifdef WINDRIVER_API            
-                        if((BoardRevision & 0x0F00) == MODULETYPE_P500e ) retval=PIXIE500E_ProgramDSP(hDev[i]);         // Boot DSP for P500e
-                        if((BoardRevision & 0x0F00) == MODULETYPE_P4e)    retval=PIXIE500E_ProgramDSP(hDev[i]);     // Boot DSP for P4e (same as P500e) 
-        #endif
-                        if(retval < 0) {
-                                sprintf(ErrMSG, "*ERROR* (Pixie_Boot): downloading DSP code to module %d was not successful.", i);
+                        if((BoardRevision & 0x0F00) == MODULETYPE_P32) 
+                        {
+                                retval=Load_U16(Boot_File_Name_List[9], P32_FPGA_CONFIG, (N_P32_BYTES/4));
+                                sprintf(ErrMSG, "*DEBUG* (Pixie_Boot_System): Loading P32 file from P500e file list entry.");
                                 Pixie_Print_MSG(ErrMSG,1);
-                                return(BOOT_DSP_ERR);
+                                if(retval < 0) {
+                                        sprintf(ErrMSG, "*ERROR* (Pixie_Boot_System): Unable to read FiPPI configuration (P32).");
+                                        Pixie_Print_MSG(ErrMSG,1);
+                                        return(RD_FIP_ERR);
+                                }
+                                break;
                         }
                 }
         }
 
         // **************************************************************
-        // Download DSP parameter values
-        // Pass the 64 Module parameters and 48*4 channel parameters
-        // to DSP (DSP_IO_BORDER)
+        // Download FIPPI, DSP code and DSP parameters, program FIPPI
         // **************************************************************
-        if((Boot_Pattern & 0x8)) {
-                sprintf(ErrMSG, "*INFO* (Pixie_Boot): Begin DSP parameter download");
-                Pixie_Print_MSG(ErrMSG,PrintDebugMsg_Boot);
-                /* Download DSP parameter values */
-                for(i=0; i<Number_Modules; i++) {
-                                /* Convert data type */
-                        for(k=0; k < DSP_IO_BORDER; k++) buffer[k] = (U32)Pixie_Devices[i].DSP_Parameter_Values[k];
-                        /* Download new settings into the module */
-                        Pixie_IODM(i, DATA_MEMORY_ADDRESS, MOD_WRITE, DSP_IO_BORDER, buffer);
-                        // NOTE: MUST HAVE Sleep below for Sample.c (otherwise DSP parameters are set with errors)
-                        Pixie_Sleep(500);
-                }
+        start = Boot_ms();
+        for(i=0; i<Number_Modules; i++) {
+                memset(&BootWorker[i], 0, sizeof(struct Boot_Worker));
+                BootWorker[i].ModNum = i;
+                BootWorker[i].Pattern = Boot_Pattern;
         }
 
-        // **************************************************************
-        // Now start control tasks 0 and 5 to set DACs and program FIPPI
-        // **************************************************************
-        if(Boot_Pattern & 0x10)  {
-                sprintf(ErrMSG, "*INFO* (Pixie_Boot): Begin Program FIPPI");
+        if(BootParallel && (PCIBusType == EXPRESS_PCI) && (Number_Modules > 1)) {
+                sprintf(ErrMSG, "*INFO* (Pixie_Boot): Begin booting %d modules in parallel", Number_Modules);
                 Pixie_Print_MSG(ErrMSG,PrintDebugMsg_Boot);
                 for(i=0; i<Number_Modules; i++) {
-                        retval=Control_Task_Run(i, SET_DACS, 1000); /* Set DACs */
-                        if(retval < 0) {
-                                sprintf(ErrMSG, "*ERROR* (Pixie_Boot): Set DACs in module %d failed.", i);
-                                Pixie_Print_MSG(ErrMSG,1);
-                                return(SET_DAC_ERR);
+                        if(pthread_create(&BootWorker[i].Thread, NULL, Boot_Module_Thread, &BootWorker[i]) != 0) {
+                                // no thread: boot this one here, the others continue meanwhile
+                                BootWorker[i].Thread = 0;
+                                Boot_Module_Thread(&BootWorker[i]);
                         }
-                        retval=Control_Task_Run(i, PROGRAM_FIPPI, 1000); /* Program FiPPI */
-                        if(retval < 0) {
-                                sprintf(ErrMSG, "*ERROR* (Pixie_Boot): Program FiPPI in module %d failed.", i);
-                                Pixie_Print_MSG(ErrMSG,1);
-                                return(PROG_FIPPI_ERR);
-                        }
-                        retval=Control_Task_Run(i, ENABLE_INPUT, 1000); /* Connect detector input */
-                        if(retval < 0) {
-                                sprintf(ErrMSG, "*ERROR* (Pixie_Boot): Enable detector input in module %d failed.", i);
-                                Pixie_Print_MSG(ErrMSG,1);
-                                return(ENA_INTS_ERR);
+                }
+                for(i=0; i<Number_Modules; i++) {
+                        if(BootWorker[i].Thread)
+                                pthread_join(BootWorker[i].Thread, NULL);
+                }
+        }
+        else {
+                // one phase after the other, each for all modules; stop at the first error
+                for(phase=0; phase<BOOT_PHASES; phase++) {
+                        if ((phase == 1) && (PCIBusType == REGULAR_PCI)) {
+                                /* enable LED */
+                                for(i=0; i<Number_Modules; i++) {
+                                        buffer[0] = 0x38;
+                                        Pixie_Register_IO(i, PCI_CFCTRL, MOD_WRITE, buffer);
+                                }
                         }
-
-        /*              BoardRevision = (U16)Pixie_Devices[i].Module_Parameter_Values[Find_Xact_Match("BOARD_VERSION", Module_Parameter_Names, N_MODULE_PAR)];
-                        if((BoardRevision & 0x0F00) == MODULETYPE_P500e ) 
-         //TODO: Add P4e, 500 MHZ versions
-                        {
-                                retval=Apply_default_I2E(i); // Enable/apply ADC I2E calibration 
+                        if(!(Boot_Pattern & (0x2 << phase)))
+                                continue;
+                        sprintf(ErrMSG, "*INFO* (Pixie_Boot): Begin %s", Boot_Phase_Names[phase]);
+                        Pixie_Print_MSG(ErrMSG,PrintDebugMsg_Boot);
+                        for(i=0; i<Number_Modules; i++) {
+                                t = Boot_ms();
+                                retval = Boot_Module_Phase(i, phase);
+                                BootWorker[i].Time[phase] = Boot_ms() - t;
                                 if(retval < 0) {
-                                        sprintf(ErrMSG, "*Warning* (Pixie_Boot): Enabling ADC calibration in module %d failed.", i);
-                                        Pixie_Print_MSG(ErrMSG,1);
-                                //      return(-7);
+                                        BootWorker[i].Status = retval;
+                                        BootWorker[i].Failed = 0x2 << phase;
+                                        return(retval);
                                 }
                         }
-                        */
                 }
         }
 
+        // per module timing, and the first error in module order
+        retval = 0;
+        for(i=0; i<Number_Modules; i++) {
+                sprintf(ErrMSG, "*INFO* (Pixie_Boot): module %d: FiPPI %d ms, DSP %d ms, DSP parameters %d ms, control tasks %d ms", i, 
+                        BootWorker[i].Time[0], BootWorker[i].Time[1], BootWorker[i].Time[2], BootWorker[i].Time[3]);
+                Pixie_Print_MSG(ErrMSG,PrintDebugMsg_Boot);
+                if(BootWorker[i].Status < 0) {
+                        sprintf(ErrMSG, "*ERROR* (Pixie_Boot): module %d failed in %s, error %d", i, 
+                                Boot_Phase_Names[Boot_Phase_Index(BootWorker[i].Failed)], BootWorker[i].Status);
+                        Pixie_Print_MSG(ErrMSG,1);
+                        if(retval == 0) retval = BootWorker[i].Status;
+                }
+        }
+        sprintf(ErrMSG, "*INFO* (Pixie_Boot): %d modules booted in %d ms", Number_Modules, Boot_ms() - start);
+        Pixie_Print_MSG(ErrMSG,PrintDebugMsg_Boot);
+        if(retval < 0)
+                return(retval);
+
         // Success
         for(i=0; i<Number_Modules; i++) {
                 sprintf(ErrMSG, "Module %d in slot %d started up successfully!", i, Phy_Slot_Wave[i]);
@@ -672,6 +841,32 @@ S32 Pixie_Boot (U16 Boot_Pattern)               // boot pattern is a bit mask
 }
 
 
+/****************************************************************
+*       Boot_Report:
+*               Fill BOOT_REPORT_LENGTH words with the result of the last
+*               Pixie_Boot for one module:
+*                       0: 0 or the Pixie_Boot error code (S32)
+*                       1: Boot_Pattern bit of the step that failed, 0 if none
+*                       2: time to download the FiPPI configuration, ms
+*                       3: time to download the DSP code, ms
+*                       4: time to download the DSP parameters, ms
+*                       5: time of the control tasks applying them, ms
+*
+****************************************************************/
+
+void Boot_Report (
+                U8  ModNum,             // Pixie module number
+                U32 *report )           // receives BOOT_REPORT_LENGTH words
+{
+        U16 phase;
+
+        report[0] = (U32)BootWorker[ModNum].Status;
+        report[1] = BootWorker[ModNum].Failed;
+        for(phase=0; phase<BOOT_PHASES; phase++)
+                report[2+phase] = BootWorker[ModNum].Time[phase];
+}
+
+
 /****************************************************************
 *       Pixie_Boot_ComFPGA:
 *               Download communication FPGA configuration.
@@ -939,6 +1134,8 @@ S32 Pixie_Boot_DSP (
 *       Pixie_Scan_Crate_Slots:
 *               Scan all PXI/CompactPCI crate slots and obtain virtual address
 *               for each slot where a PCI device is installed.
+*               With OFFLINE_ANALYSIS = OFFLINE_EMULATOR, open emulated 
+*               modules instead (pixie_emu.c).
 *
 *               Return Value:
 *                        0 - Successful
@@ -1032,6 +1229,29 @@ S32 Pixie_Scan_Crate_Slots ( U8 NumModules, // Number of modules present
         }
 
 #ifdef WINDRIVER_API
+        /* Emulated modules: no bus to scan, P4e 16/125 with the serial numbers of the slot map */
+        PIXIE500E_Backend = &PIXIE500E_WinDriver_Backend;
+        if(Offline == OFFLINE_EMULATOR) {
+                PCIBusType = EXPRESS_PCI;
+                PIXIE500E_Backend = &Pixie_Emu_Backend;
+                for (k = 0; k < NumModules; k++) {
+                        hDev[k] = Pixie_Emu_Open((U8)k);
+                        if (!hDev[k]) {
+                                sprintf(ErrMSG, "*ERROR* (Pixie_Scan_Crate_Slots): Failed to open emulated module %d", k);
+                                Pixie_Print_MSG(ErrMSG,1);
+                                return(-5);
+                        }
+                        VAddr[k] = (U32)(k + 1);        // not mapped, only tested for != 0
+                        Pixie_Devices[k].Module_Parameter_Values[index_BV] = (double)EMU_BOARD_VERSION;
+                        Pixie_Devices[k].Module_Parameter_Values[index_SN] = (double)PXISlotMap[k];
+                        Pixie_Devices[k].Module_Parameter_Values[index_AB] = 16.0;
+                        Pixie_Devices[k].Module_Parameter_Values[index_AR] = 125.0;
+                        sprintf(ErrMSG, "*INFO* (Pixie_Scan_Crate_Slots): Device %d emulated, Board version= 0x%04X, S/N = %d", k, EMU_BOARD_VERSION, PXISlotMap[k]);
+                        Pixie_Print_MSG(ErrMSG,1);
+                }
+                return(0);
+        }
+
         /* Determine the PCI bus type */
         PCIBusType = 0;
         memset(&DevKey, PCI_FIELD_IGNORE, sizeof(PLX_DEVICE_KEY));
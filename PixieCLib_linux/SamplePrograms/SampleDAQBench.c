@@ -0,0 +1,401 @@
+/**************************************************************************/
+/*	SampleDAQBench.c						  */
+/*									  */
+/*	This is a sample program based on the Pixie-4 C library.          */
+/*	It measures the list mode data path from framebuffer to parsed    */
+/*	events. Emulated modules (OFFLINE_ANALYSIS = 2, see pixie_emu.c)  */
+/*	record a fixed number of framebuffers for each run type 0x400 to  */
+/*	0x403, with buffer QC on and off. Buffers are polled module by    */
+/*	module and written without writer thread, so every poll that      */
+/*	saves a buffer times QC and file write of one framebuffer in      */
+/*	Write_DMA_List_Mode_File. Each file is then indexed and parsed    */
+/*	with tasks 0x7001, 0x7007 and 0x7030, and events are looked up    */
+/*	with Pixie_Event_Browser.                                         */
+/*	Recorded list mode files given on the command line are only       */
+/*	indexed, parsed and browsed (reported with runtype 0x000 and      */
+/*	qc -1).                                                           */
+/*									  */
+/*	Results are printed one stage per line as JSON (the lines that    */
+/*	start with '{'): events, MB, seconds, events/s, MB/s and          */
+/*	percentiles of the time per buffer, per file or per browsed event */
+/*	in ms. Stage "run" includes the run stop, which is also reported  */
+/*	as stage "stop". The emulator starts from the same seed on every  */
+/*	boot, so runs with the same arguments produce the same data.      */
+/*									  */
+/*	usage: SampleDAQBench [buffers per module [modules]]		  */
+/*	       SampleDAQBench file.b00 [file.b01 ...]			  */
+/*									  */
+/**************************************************************************/
+
+#include <time.h>
+#include <ctype.h>
+#include <sys/stat.h>
+#include "Sample.h"
+
+#define BENCH_NAME		"DAQBench"	// list mode files are DAQBench.b00, DAQBench.b01, ...
+#define MAX_FILES		PRESET_MAX_MODULES
+#define REPEAT			3			// passes over the files for each parser stage
+#define BROWSE_EVENTS	1000		// events looked up per file by Pixie_Event_Browser
+#define RUN_TIMEOUT_MS	120000.0
+
+static double now_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return(ts.tv_sec*1000.0 + ts.tv_nsec/1e6);
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+	return((x > y) - (x < y));
+}
+
+static double file_bytes(const char *name)
+{
+	struct stat st;
+	return(stat(name, &st) == 0 ? (double)st.st_size : 0.0);
+}
+
+static void set_system_par(double *values, char *name, double value)
+{
+	values[Pixie_Get_Par_Idx(name, "SYSTEM")] = value;
+	Pixie_User_Par_IO(values, name, "SYSTEM", MOD_WRITE, 0, 0);
+}
+
+/* one JSON line per stage; lat holds n samples in ms and is sorted here */
+static void report(const char *stage, const char *source, U16 runtype, int qc,
+				   double events, double bytes, double ms, double *lat, U32 n)
+{
+	double s = ms/1000.0;
+
+	qsort(lat, n, sizeof(double), cmp_double);
+	printf("{\"stage\":\"%s\",\"source\":\"%s\",\"runtype\":\"0x%03X\",\"qc\":%d,"
+		   "\"events\":%.0f,\"MB\":%.3f,\"seconds\":%.4f,\"events_per_s\":%.0f,\"MB_per_s\":%.2f,"
+		   "\"latency_ms\":{\"n\":%u,\"p50\":%.4f,\"p90\":%.4f,\"p99\":%.4f,\"max\":%.4f}}\n",
+		stage, source, runtype, qc, events, bytes/1e6, s,
+		s > 0 ? events/s : 0.0, s > 0 ? bytes/1e6/s : 0.0, n,
+		n ? lat[(n-1)*50/100] : 0.0, n ? lat[(n-1)*90/100] : 0.0,
+		n ? lat[(n-1)*99/100] : 0.0, n ? lat[n-1] : 0.0);
+	fflush(stdout);
+}
+
+/* Index and parse the list mode files, then browse them. runtype 0 if not known. */
+/* Returns the number of events per pass, or -1 on error.                          */
+static double parse_stages(double *sysValues, const char *source, U16 runtype, int qc,
+						   S8 **files, U32 nfiles)
+{
+	U32 psaControl[11] = {0, 12, 64, 0, 32, 10, 90, 0, 0, 0, 0};	// words 1-10 of task 0x7030
+	U32 *UserData = NULL, *Pos = NULL;
+	U32 events[MAX_FILES], maxEvents = 0, size, f, r, k, n;
+	double *lat = NULL, bytes = 0, total = 0, ms, t;
+	char idxName[1024];
+	S32 retval;
+
+	for(f = 0; f < nfiles; f++)
+		bytes += file_bytes(files[f]);
+	lat = malloc((REPEAT*MAX_FILES + BROWSE_EVENTS*MAX_FILES) * sizeof(double));
+	UserData = calloc(2*PRESET_MAX_MODULES + 17, sizeof(U32));
+	if(!lat || !UserData) {
+		printf("*ERROR* (SampleDAQBench): memory allocation failure\n");
+		free(lat);
+		free(UserData);
+		return(-1);
+	}
+
+	/* index: first use of a file builds <file>.idx with error checking (task 0x7001, count only) */
+	set_system_par(sysValues, "AUTO_PROCESSLMDATA", 0);
+	ms = 0;
+	n = 0;
+	for(r = 0; r < REPEAT; r++) {
+		total = 0;
+		for(f = 0; f < nfiles; f++) {
+			sprintf(idxName, "%s.idx", files[f]);
+			remove(idxName);
+			memset(UserData, 0, 2*PRESET_MAX_MODULES*sizeof(U32));
+			t = now_ms();
+			retval = Pixie_List_Mode_Parser(files[f], UserData, 0x7001);
+			lat[n] = now_ms() - t;
+			ms += lat[n++];
+			if(retval < 0 && retval != -3) {
+				printf("*ERROR* (SampleDAQBench): can not parse %s, retval = %d\n", files[f], retval);
+				free(lat);
+				free(UserData);
+				return(-1);
+			}
+			events[f] = 0;
+			for(k = 0; k < PRESET_MAX_MODULES; k++)
+				events[f] += UserData[k];
+			total += events[f];
+			if(events[f] > maxEvents)
+				maxEvents = events[f];
+		}
+	}
+	report("index", source, runtype, qc, total, bytes, ms/REPEAT, lat, n);
+
+	/* all later stages take the events from the index */
+	size = 3*maxEvents + 17;
+	if(size < 4*MAX_TRACE_LENGTH + 4096)
+		size = 4*MAX_TRACE_LENGTH + 4096;				// Pixie_Event_Browser returns up to 4 traces
+	free(UserData);
+	UserData = calloc(size, sizeof(U32));
+	Pos = calloc(3*maxEvents + 3, sizeof(U32));
+	if(!UserData || !Pos) {
+		printf("*ERROR* (SampleDAQBench): memory allocation failure\n");
+		free(lat);
+		free(UserData);
+		free(Pos);
+		return(-1);
+	}
+
+	/* task 0x7001 with ASCII output of energy and time stamps */
+	set_system_par(sysValues, "AUTO_PROCESSLMDATA", 1);
+	ms = 0;
+	n = 0;
+	for(r = 0; r < REPEAT; r++) {
+		for(f = 0; f < nfiles; f++) {
+			t = now_ms();
+			Pixie_List_Mode_Parser(files[f], UserData, 0x7001);
+			lat[n] = now_ms() - t;
+			ms += lat[n++];
+		}
+	}
+	report("0x7001", source, runtype, qc, total, bytes, ms/REPEAT, lat, n);
+	set_system_par(sysValues, "AUTO_PROCESSLMDATA", 0);
+
+	/* task 0x7007: event positions and lengths */
+	ms = 0;
+	n = 0;
+	for(r = 0; r < REPEAT; r++) {
+		for(f = 0; f < nfiles; f++) {
+			t = now_ms();
+			Pixie_List_Mode_Parser(files[f], UserData, 0x7007);
+			lat[n] = now_ms() - t;
+			ms += lat[n++];
+		}
+	}
+	report("0x7007", source, runtype, qc, total, bytes, ms/REPEAT, lat, n);
+
+	/* task 0x7030: PSA values of all traces, 0x400 files only */
+	if(runtype == 0 || runtype == 0x400) {
+		set_system_par(sysValues, "AUTO_PROCESSLMDATA", 3);
+		ms = 0;
+		n = 0;
+		for(r = 0; r < REPEAT; r++) {
+			for(f = 0; f < nfiles; f++) {
+				memcpy(UserData, psaControl, sizeof(psaControl));
+				t = now_ms();
+				retval = Pixie_List_Mode_Parser(files[f], UserData, 0x7030);
+				lat[n] = now_ms() - t;
+				ms += lat[n++];
+				if(retval < 0 && retval != -3)
+					break;
+			}
+			if(f < nfiles)
+				break;
+		}
+		set_system_par(sysValues, "AUTO_PROCESSLMDATA", 0);
+		if(r == REPEAT)
+			report("0x7030", source, runtype, qc, total, bytes, ms/REPEAT, lat, n);
+		else if(runtype)
+			printf("*ERROR* (SampleDAQBench): task 0x7030 failed on %s, retval = %d\n", files[f], retval);
+	}
+
+	/* Pixie_Event_Browser: look up events spread evenly over each file, as the event display does */
+	ms = 0;
+	n = 0;
+	total = 0;
+	bytes = 0;
+	for(f = 0; f < nfiles; f++) {
+		U32 step;
+		if(!events[f])
+			continue;
+		Pixie_List_Mode_Parser(files[f], Pos, 0x7007);
+		step = (events[f] > BROWSE_EVENTS) ? events[f]/BROWSE_EVENTS : 1;
+		for(k = 0; k < events[f] && k/step < BROWSE_EVENTS; k += step) {
+			UserData[0] = Pos[3*k];
+			UserData[2] = Pos[3*k+2];
+			UserData[3] = 0;			// no coincidence window
+			t = now_ms();
+			retval = Pixie_Event_Browser(files[f], UserData);
+			lat[n] = now_ms() - t;
+			ms += lat[n++];
+			total++;
+			bytes += 2.0*Pos[3*k+2];
+		}
+	}
+	report("browser", source, runtype, qc, total, bytes, ms, lat, n);
+
+	for(f = 0, total = 0; f < nfiles; f++)
+		total += events[f];
+	free(lat);
+	free(UserData);
+	free(Pos);
+	return(total);
+}
+
+/* Record buffers framebuffers per module in one run, then run the parser stages on the files */
+static int bench_run(double *sysValues, double *modValues, U8 NumberOfModules, U16 runtype, int qc, U32 buffers)
+{
+	S8 fileName[64], names[MAX_FILES][64], *files[MAX_FILES];
+	char source[64];
+	U32 saved[PRESET_MAX_MODULES] = {0}, done, k;
+	U16 idx, value16;
+	U8 ModNum;
+	double *lat, ms, t, t0, bytes = 0, events, stopMs, stopBytes = 0;
+	S32 retval;
+	U32 n = 0;
+
+	lat = malloc(buffers * NumberOfModules * 2 * sizeof(double));
+	if(!lat) {
+		printf("*ERROR* (SampleDAQBench): memory allocation failure\n");
+		return(-1);
+	}
+
+	/* polling, no multi threading, QC on or off */
+	idx = Pixie_Get_Par_Idx("C_CONTROL", "MODULE");
+	for(ModNum = 0; ModNum < NumberOfModules; ModNum++) {
+		Pixie_User_Par_IO(modValues, "C_CONTROL", "MODULE", MOD_READ, ModNum, 0);
+		value16 = (U16)modValues[ModNum*N_MODULE_PAR+idx];
+		value16 &= ~(0x1A00);		// MultiThreadDAQ, PollForNewData, BufferQC
+		value16 |= 0x100;			// Polling
+		if(qc)
+			value16 |= 0x200;
+		modValues[ModNum*N_MODULE_PAR+idx] = value16;
+		Pixie_User_Par_IO(modValues, "C_CONTROL", "MODULE", MOD_WRITE, ModNum, 0);
+	}
+
+	/* 0x401 runs write .dt3 files instead of .b00 */
+	sprintf(fileName, "%s.bin", BENCH_NAME);
+	for(k = 0; k < NumberOfModules; k++) {
+		if(runtype == 0x401)
+			sprintf(names[k], "%s_m%u.dt3", BENCH_NAME, k);
+		else
+			sprintf(names[k], "%s.b%02d", BENCH_NAME, k);
+		files[k] = names[k];
+		remove(names[k]);
+	}
+
+	t0 = now_ms();
+	if((retval = Pixie_Acquire_Data((U16)(0x1000 | runtype), NULL, fileName, NumberOfModules)) < 0) {
+		printf("*ERROR* (SampleDAQBench): run start 0x%X failed, retval = %d\n", 0x1000 | runtype, retval);
+		free(lat);
+		return(-1);
+	}
+	/* poll each module on its own, a poll that saves a buffer has done QC and write of one framebuffer */
+	do {
+		done = 0;
+		for(ModNum = 0; ModNum < NumberOfModules; ModNum++) {
+			if(saved[ModNum] >= buffers) {
+				done++;
+				continue;
+			}
+			t = now_ms();
+			retval = Pixie_Acquire_Data((U16)(0x4000 | runtype), NULL, fileName, ModNum);
+			if(retval < 0) {
+				printf("*ERROR* (SampleDAQBench): poll 0x%X failed, retval = %d\n", 0x4000 | runtype, retval);
+				break;
+			}
+			if((U32)retval > saved[ModNum]) {
+				lat[n++] = now_ms() - t;
+				saved[ModNum] = retval;
+			}
+		}
+	} while(retval >= 0 && done < NumberOfModules && now_ms() - t0 < RUN_TIMEOUT_MS);
+	if(done < NumberOfModules)
+		printf("*ERROR* (SampleDAQBench): run 0x%X stopped before all buffers were saved\n", runtype);
+	for(k = 0; k < NumberOfModules; k++)
+		stopBytes -= file_bytes(names[k]);
+	t = now_ms();
+	Pixie_Acquire_Data((U16)(0x3000 | runtype), NULL, fileName, NumberOfModules);
+	stopMs = now_ms() - t;
+	ms = now_ms() - t0;
+
+	for(k = 0; k < NumberOfModules; k++)
+		bytes += file_bytes(names[k]);
+	stopBytes += bytes;
+	sprintf(source, "emulator %u modules", NumberOfModules);
+	if(runtype == 0x401) {
+		/* no binary file to parse: count the events of the DSP run statistics */
+		idx = Pixie_Get_Par_Idx("NUMBER_EVENTS", "MODULE");
+		for(ModNum = 0, events = 0; ModNum < NumberOfModules; ModNum++) {
+			Pixie_User_Par_IO(modValues, "NUMBER_EVENTS", "MODULE", MOD_READ, ModNum, 0);
+			events += modValues[ModNum*N_MODULE_PAR+idx];
+		}
+	}
+	else
+		events = parse_stages(sysValues, source, runtype, qc, files, NumberOfModules);
+	/* the run is reported last since the events are counted by the index stage; */
+	/* the time of the run stop (end of run flush) is included, and also reported on its own */
+	if(events >= 0) {
+		report("run", source, runtype, qc, events, bytes, ms, lat, n);
+		report("stop", source, runtype, qc, 0, stopBytes, stopMs, &stopMs, 1);
+	}
+
+	for(k = 0; k < NumberOfModules; k++) {
+		char name[1024];
+		remove(names[k]);
+		sprintf(name, "%s.idx", names[k]);
+		remove(name);
+		sprintf(name, "%s_m%u.dat", BENCH_NAME, k);
+		remove(name);
+		sprintf(name, "%s_PSA_m%u.dt3", BENCH_NAME, k);
+		remove(name);
+	}
+	free(lat);
+	return((events < 0 || done < NumberOfModules) ? -1 : 0);
+}
+
+int main(int argc, char *argv[]){
+
+	U8     NumberOfModules = 2;
+	U8     Slots[PRESET_MAX_MODULES];
+	U32    buffers = 32;
+	S32    retval, i, j;
+	U16    runtype;
+	int    qc, fail = 0;
+
+	static double SystemParameterValues[N_SYSTEM_PAR];
+	static double ModuleParameterValues[PRESET_MAX_MODULES*N_MODULE_PAR];
+
+	/* recorded files: parser stages only */
+	if(argc > 1 && !isdigit((unsigned char)argv[1][0])) {
+		if(argc - 1 > MAX_FILES) {
+			printf("*ERROR* (SampleDAQBench): at most %d files\n", MAX_FILES);
+			return(-1);
+		}
+		Pixie_User_Par_IO(SystemParameterValues, "AUTO_PROCESSLMDATA", "SYSTEM", MOD_READ, 0, 0);
+		return(parse_stages(SystemParameterValues, "file", 0, -1, (S8 **)&argv[1], argc - 1) < 0 ? -1 : 0);
+	}
+
+	if(argc > 1)
+		buffers = atoi(argv[1]);
+	if(argc > 2)
+		NumberOfModules = (U8)atoi(argv[2]);
+	if(buffers < 1 || NumberOfModules < 1 || NumberOfModules > MAX_FILES) {
+		printf("usage: SampleDAQBench [buffers per module [modules]]\n       SampleDAQBench file.b00 [file.b01 ...]\n");
+		return(-1);
+	}
+	for(i = 0; i < NumberOfModules; i++)
+		Slots[i] = (U8)(2 + i);
+
+	/* System configuration, emulated modules at full speed, QC and write on the polling thread */
+	#include "SystemConfig.c"
+	set_system_par(SystemParameterValues, "OFFLINE_ANALYSIS", 2);
+	set_system_par(SystemParameterValues, "EMU_RATE", 0);
+	set_system_par(SystemParameterValues, "EMU_ERRORS", 0);
+	set_system_par(SystemParameterValues, "LM_WRITER_THREAD", 0);
+
+	if((retval = Pixie_Boot_System(0x1F)) < 0) {
+		printf("*ERROR* (Pixie_Boot_System): boot of emulated modules failed, retval = %d\n", retval);
+		return(retval);
+	}
+
+	for(runtype = 0x400; runtype <= 0x403; runtype++) {
+		for(qc = 1; qc >= 0; qc--) {
+			if(bench_run(SystemParameterValues, ModuleParameterValues, NumberOfModules, runtype, qc, buffers) < 0)
+				fail = 1;
+		}
+	}
+	return(fail ? -1 : 0);
+}
@@ -0,0 +1,85 @@
+/**************************************************************************/
+/*	SampleLiveStats.c						  */
+/*									  */
+/*	This is a sample program based on the Pixie-4 C library.          */
+/*	It maps the live statistics block that the library publishes in   */
+/*	shared memory during list mode runs (system parameter LIVE_STATS  */
+/*	set to 1) and prints rates and buffer QC counters ten times a     */
+/*	second. It runs as a separate process next to the DAQ and does    */
+/*	not touch the modules.                                            */
+/*									  */
+/*	usage: SampleLiveStats [seconds]				  */
+/*									  */
+/**************************************************************************/
+
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include "Sample.h"
+#include "live_stats.h"
+
+/* copy the DSP run statistics of one module, retry while the library updates them */
+static void read_dsp(struct Live_Stats_Module *s, struct Live_Stats_Module *copy)
+{
+	U32 seq;
+
+	do {
+		seq = __atomic_load_n(&s->DSPSeq, __ATOMIC_ACQUIRE);
+		memcpy(copy, s, sizeof(*copy));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	} while((seq & 1) || seq != __atomic_load_n(&s->DSPSeq, __ATOMIC_RELAXED));
+}
+
+int main(int argc, char *argv[]){
+
+	struct Live_Stats *b;
+	struct Live_Stats_Module m, prev[PRESET_MAX_MODULES];
+	double seconds = (argc > 1) ? atof(argv[1]) : 10.0;
+	U32 k, ch, loops;
+	int fd;
+
+	fd = shm_open(LIVE_STATS_NAME, O_RDONLY, 0);
+	if(fd < 0) {
+		printf("*ERROR* (SampleLiveStats): no live statistics %s, set LIVE_STATS to 1 and start a list mode run\n", LIVE_STATS_NAME);
+		return(-1);
+	}
+	b = (struct Live_Stats *)mmap(NULL, sizeof(struct Live_Stats), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(b == MAP_FAILED) {
+		printf("*ERROR* (SampleLiveStats): can not map %s\n", LIVE_STATS_NAME);
+		return(-1);
+	}
+	if(__atomic_load_n(&b->Magic, __ATOMIC_ACQUIRE) != LIVE_STATS_MAGIC || b->Version != LIVE_STATS_VERSION || b->Size != sizeof(struct Live_Stats)) {
+		printf("*ERROR* (SampleLiveStats): %s is from another library version\n", LIVE_STATS_NAME);
+		return(-1);
+	}
+
+	memset(prev, 0, sizeof(prev));
+	for(loops = 0; loops < seconds*10; loops++) {
+		for(k = 0; k < b->NumModules && k < PRESET_MAX_MODULES; k++) {
+			read_dsp(&b->Module[k], &m);
+			if(m.Run == 0)
+				continue;
+			printf("Mod %u run %llu %s: %llu buffers, %.1f MB, %.0f ev/s written, buffer %u us (max %u), queue %u (max %u), stalls %u\n",
+				k, (unsigned long long)m.Run, m.Active ? "active" : "ended ", (unsigned long long)m.Buffers,
+				m.BytesWritten/1e6, (prev[k].Run == m.Run) ? (m.QC[LIVE_QC_EVENTS] - prev[k].QC[LIVE_QC_EVENTS])*10.0 : 0.0,
+				m.BufferTime, m.MaxBufferTime, m.QueueDepth, m.MaxQueueDepth, m.RingStalls);
+			printf("        QC: events %llu, short %llu, splitH %llu, splitT %llu, traceMismatch %llu, badWM %llu, badChanNum %llu, badCheckSum %llu\n",
+				(unsigned long long)m.QC[LIVE_QC_EVENTS], (unsigned long long)m.QC[LIVE_QC_SHORT],
+				(unsigned long long)m.QC[LIVE_QC_SPLIT_HEADER], (unsigned long long)m.QC[LIVE_QC_SPLIT_TRACE],
+				(unsigned long long)m.QC[LIVE_QC_TRACE_MISMATCH], (unsigned long long)m.QC[LIVE_QC_BAD_WATERMARK],
+				(unsigned long long)m.QC[LIVE_QC_BAD_CHANNEL], (unsigned long long)m.QC[LIVE_QC_BAD_CHECKSUM]);
+			if(m.DSPSamples) {
+				printf("        DSP: run time %.2f s, %.0f events, %.0f ev/s\n", m.RunTime, m.NumberEvents, m.EventRate);
+				for(ch = 0; ch < NUMBER_OF_CHANNELS; ch++)
+					printf("        Chan %u: ICR %.0f /s, OCR %.0f /s, live time %.2f s, %llu events written\n",
+						ch, m.InputCountRate[ch], m.OutputCountRate[ch], m.CountTime[ch], (unsigned long long)m.ChannelEvents[ch]);
+			}
+			prev[k] = m;
+		}
+		usleep(100000);
+	}
+	munmap(b, sizeof(struct Live_Stats));
+	return(0);
+}
@@ -0,0 +1,140 @@
+/**************************************************************************/
+/*	SamplePSABench.c						  */
+/*									  */
+/*	This is a sample program based on the Pixie-4 C library.          */
+/*	It computes the PSA values of task 0x7030 (rise time, amplitude,  */
+/*	baseline, Q0, Q1, PSA ratio) for synthetic pulses, one trace at a */
+/*	time with ComputePSA and in batches with each PSA kernel, and     */
+/*	checks that all results are the same. No module is needed.        */
+/*									  */
+/**************************************************************************/
+
+#include <time.h>
+#include "Sample.h"
+
+#define NUM_TRACES	20000
+#define MAX_LEN		2048
+#define PAD			1024		// zeros after each trace for ComputePSA, which may sum past the end
+#define REPEAT		5
+
+static double now_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return(ts.tv_sec*1000.0 + ts.tv_nsec/1e6);
+}
+
+/* Pulse on a noisy baseline: random length, position, amplitude and decay.     */
+/* Every 50th trace is flat, every 70th has its peak in the first samples       */
+/* (unsigned wrap of the search start in ComputePSA), every 90th is very short. */
+static U32 make_trace(U16 *t, U32 n)
+{
+	U32 len = 256 + (U32)(rand() % (MAX_LEN - 256));
+	U32 pos = 40 + (U32)(rand() % 100);
+	double amp = 200.0 + rand() % 12000;
+	double tau = 10.0 + rand() % 200;
+	U32 i;
+
+	if(n % 90 == 89)
+		len = 4 + rand() % 20;
+	if(n % 70 == 69)
+		pos = rand() % 6;
+	for(i = 0; i < len; i++) {
+		double v = 300.0 + (rand() % 16);
+		if(i >= pos && n % 50 != 49)
+			v += amp * (1.0 - exp(-(double)(i - pos)/3.0)) * exp(-(double)(i - pos)/tau);
+		t[i] = (U16)(v > 65535.0 ? 65535.0 : v);
+	}
+	return(len);
+}
+
+int main(void){
+
+	const char *names[] = {"scalar", "SSE2", "AVX2"};
+	/* control words 1-10 as for task 0x7030: Q0 length, Q1 length, Q0 delay, Q1 delay, */
+	/* rise time start and stop (%), PSA option, divide by 8, LE trigger, LE threshold  */
+	U32 params[3][17] = {
+		{0, 12, 64,  0, 32, 10, 90, 0, 0, 0,  0},
+		{0,  8, 40,  2, 20, 20, 80, 1, 1, 0,  0},
+		{0, 16, 96,  0, 48, 10, 90, 0, 0, 1, 50}
+	};
+	U16 *trace, *padded;
+	U32 *len, *ref, i, p, r;
+	PSABatch *B;
+	S32 k, used, *refStatus;
+	double t, tref;
+	U32 mismatch;
+	int fail = 0;
+
+	trace     = malloc((size_t)NUM_TRACES * MAX_LEN * sizeof(U16));
+	padded    = calloc(MAX_LEN + PAD, sizeof(U16));
+	len       = malloc(NUM_TRACES * sizeof(U32));
+	ref       = malloc(NUM_TRACES * 6 * sizeof(U32));
+	refStatus = malloc(NUM_TRACES * sizeof(S32));
+	B = PSA_Batch_Create(NUM_TRACES, NUM_TRACES * MAX_LEN);
+	if(!trace || !padded || !len || !ref || !refStatus || !B) {
+		printf("*ERROR* (SamplePSABench): memory allocation failure\n");
+		return(-1);
+	}
+	srand(4321);
+	for(i = 0; i < NUM_TRACES; i++)
+		len[i] = make_trace(&trace[(size_t)i*MAX_LEN], i);
+
+	for(p = 0; p < 3; p++) {
+		printf("\nQ0 %u@%u, Q1 %u@%u, rise time %u-%u%%, option %u, div8 %u, LE trigger %u (%u):\n",
+			params[p][1], params[p][3], params[p][2], params[p][4], params[p][5], params[p][6],
+			params[p][7], params[p][8], params[p][9], params[p][10]);
+
+		/* reference: ComputePSA, one trace at a time, on a zero padded copy */
+		tref = now_ms();
+		for(r = 0; r < REPEAT; r++) {
+			for(i = 0; i < NUM_TRACES; i++) {
+				memcpy(padded, &trace[(size_t)i*MAX_LEN], len[i]*sizeof(U16));
+				memset(&padded[len[i]], 0, PAD*sizeof(U16));
+				refStatus[i] = ComputePSA(padded, len[i], params[p]);
+				memcpy(&ref[6*i], &params[p][11], 6*sizeof(U32));
+			}
+		}
+		tref = (now_ms() - tref)/REPEAT;
+		printf("ComputePSA %8.2f ms %8.1f ktraces/s\n", tref, NUM_TRACES/tref);
+
+		for(k = QC_KERNEL_SCALAR; k <= QC_KERNEL_AVX2; k++) {
+			used = PSA_Kernel_Select(k);
+			if(used != k) {
+				printf("%-10s not supported by this CPU\n", names[k]);
+				continue;
+			}
+			t = now_ms();
+			for(r = 0; r < REPEAT; r++) {
+				PSA_Batch_Clear(B);
+				for(i = 0; i < NUM_TRACES; i++)
+					PSA_Batch_Add(B, &trace[(size_t)i*MAX_LEN], len[i]);
+				PSA_Batch_Compute(B, params[p]);
+			}
+			t = (now_ms() - t)/REPEAT;
+
+			mismatch = 0;
+			for(i = 0; i < NUM_TRACES; i++) {
+				if(B->Status[i] != refStatus[i] || B->RiseTime[i] != ref[6*i] || B->Amplitude[i] != ref[6*i+1] ||
+				   B->Baseline[i] != ref[6*i+2] || B->Q0Sum[i] != ref[6*i+3] || B->Q1Sum[i] != ref[6*i+4] ||
+				   B->PSAValue[i] != ref[6*i+5])
+					mismatch++;
+			}
+			printf("%-10s %8.2f ms %8.1f ktraces/s  (x%.1f)  %u of %u traces differ\n",
+				names[k], t, NUM_TRACES/t, tref/t, mismatch, NUM_TRACES);
+			if(mismatch) {
+				printf("*ERROR* (SamplePSABench): %s kernel results differ from ComputePSA\n", names[k]);
+				fail = 1;
+			}
+		}
+	}
+	printf("\nkernel used for task 0x7030: %s\n", names[PSA_Kernel_Select(QC_KERNEL_AUTO)]);
+
+	PSA_Batch_Free(B);
+	free(trace);
+	free(padded);
+	free(len);
+	free(ref);
+	free(refStatus);
+	return(fail ? -1 : 0);
+}
@@ -0,0 +1,187 @@
+/**************************************************************************/
+/*	SampleQCBench.c							  */
+/*									  */
+/*	This is a sample program based on the Pixie-4 C library.          */
+/*	It compares the list mode buffer quality check kernels            */
+/*	(watermark search, header checksum) against the original          */
+/*	word-by-word scan on a synthetic 2MB framebuffer, and checks      */
+/*	that all give the same counts. No module is needed.               */
+/*									  */
+/**************************************************************************/
+
+#include <time.h>
+#include "Sample.h"
+
+#define NUM_WORDS	(DMA_LM_FRAMEBUFFER_LENGTH/sizeof(U32))
+#define HEAD_WORDS	(MAX_CHAN_HEAD_LENGTH/2)
+#define TRACE_WORDS	(4*BLOCKSIZE/2)		// 4 blocks of trace per event
+#define REPEAT		50
+
+typedef struct {
+	U32 events;		// headers accepted
+	U32 offset;		// words skipped looking for a watermark
+	U32 fixedWM;	// watermarks with one wrong digit
+	U32 badCS;		// checksum mismatches
+} QCCount;
+
+static double now_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return(ts.tv_sec*1000.0 + ts.tv_nsec/1e6);
+}
+
+/* Synthetic buffer: events of header + trace, random ADC data in traces,  */
+/* every 50th watermark with one bad digit, every 70th with two (rejected), */
+/* every 30th checksum wrong, and gapWords junk words after every gapEvery */
+/* events (lost sync, e.g. after dropped words).                            */
+static void fill_buffer(U32 *buf, U32 gapEvery, U32 gapWords)
+{
+	U32 k = 0, n = 0, i, cs;
+
+	memset(buf, 0, DMA_LM_FRAMEBUFFER_LENGTH);
+	srand(1234);
+	while(k + HEAD_WORDS + TRACE_WORDS <= NUM_WORDS) {
+		U32 *h = &buf[k];
+		memset(h, 0, HEAD_WORDS*sizeof(U32));
+		h[chanHeadEventStatusIdx]   = 0x00000001;
+		h[chanHeadNumBlocksIdx]     = 4 + (4 << 16);
+		h[chanHeadLoMidTrigTimeIdx] = (U32)rand();
+		h[chanHeadHiTrigTimeIdx]    = n;
+		h[chanHeadEnChanIdx]        = (U32)(rand() & 0xFFFF);
+		h[chanHeadPSAIdx]           = (U32)rand();
+		cs = 0;
+		for(i = 0; i < 8; i++)
+			cs ^= h[i];
+		h[chanHeadCheckSumIdx]  = (n % 30 == 29) ? cs ^ 0x100 : cs;
+		h[chanHeadWatermarkIdx] = WATERMARK;
+		if(n % 50 == 49) h[chanHeadWatermarkIdx] ^= 0x00000300;
+		if(n % 70 == 69) h[chanHeadWatermarkIdx] ^= 0x00330000;
+		for(i = 0; i < TRACE_WORDS; i++)
+			buf[k+HEAD_WORDS+i] = (U32)((rand() & 0x3FFF) | ((rand() & 0x3FFF) << 16));
+		k += HEAD_WORDS + TRACE_WORDS;
+		if(n % gapEvery == gapEvery-1) {
+			for(i = 0; i < gapWords && k < NUM_WORDS; i++, k++)
+				buf[k] = (U32)rand();		// junk between events
+		}
+		n++;
+	}
+	for( ; k < NUM_WORDS; k++)
+		buf[k] = (U32)rand();
+}
+
+/* The original scan: fuzzy match one word at a time, branchy checksum loop */
+static void qc_original(U32 *buf, QCCount *c)
+{
+	U32 ptr = 0, i, value, word, cs;
+
+	memset(c, 0, sizeof(QCCount));
+	while(ptr + HEAD_WORDS <= NUM_WORDS) {
+		word = buf[ptr+chanHeadWatermarkIdx];
+		if(word == WATERMARK)
+			value = 8;
+		else {
+			value = 0;
+			for(i = 0; i < 8; i++) {
+				if(((word >> (i*4)) & 0xF) == ((WATERMARK >> (i*4)) & 0xF))
+					value++;
+			}
+			if(value > 6 && value < 8)
+				c->fixedWM++;
+		}
+		if(value <= 6) {
+			ptr++;
+			c->offset++;
+			continue;
+		}
+		cs = 0;
+		for(i = 0; i < HEAD_WORDS; i++) {
+			if(i == chanHeadEventStatusIdx || i == chanHeadNumBlocksIdx ||
+			   i == chanHeadLoMidTrigTimeIdx || i == chanHeadHiTrigTimeIdx ||
+			   i == chanHeadEnChanIdx || i == chanHeadPSAIdx ||
+			   i == chanHeadPSA0Idx || i == chanHeadPSA1Idx)
+				cs ^= buf[ptr+i];
+		}
+		if(cs != buf[ptr+chanHeadCheckSumIdx])
+			c->badCS++;
+		c->events++;
+		ptr += HEAD_WORDS + (buf[ptr+chanHeadNumBlocksIdx] & 0xFFFF)*BLOCKSIZE/2;
+	}
+}
+
+/* The same walk with the library kernels */
+static void qc_kernel(U32 *buf, QCCount *c)
+{
+	U32 ptr = 0, k;
+
+	memset(c, 0, sizeof(QCCount));
+	while(ptr + HEAD_WORDS <= NUM_WORDS) {
+		k = QC_Find_Watermark(buf, ptr, NUM_WORDS - HEAD_WORDS + 1);
+		c->offset += k - ptr;
+		ptr = k;
+		if(ptr + HEAD_WORDS > NUM_WORDS)
+			break;
+		if(QC_Watermark_Score(buf[ptr+chanHeadWatermarkIdx]) < 8)
+			c->fixedWM++;
+		if((U32)QC_Header_Checksum(&buf[ptr]) != buf[ptr+chanHeadCheckSumIdx])
+			c->badCS++;
+		c->events++;
+		ptr += HEAD_WORDS + (buf[ptr+chanHeadNumBlocksIdx] & 0xFFFF)*BLOCKSIZE/2;
+	}
+}
+
+static double run(void (*qc)(U32 *, QCCount *), U32 *buf, QCCount *c)
+{
+	double t0 = now_ms();
+	int r;
+
+	for(r = 0; r < REPEAT; r++)
+		qc(buf, c);
+	return((now_ms() - t0)/REPEAT);
+}
+
+int main(void){
+
+	const char *names[] = {"scalar", "SSE2", "AVX2"};
+	const U32 gapEvery[] = {100, 5};
+	const U32 gapWords[] = {3, 500};
+	U32 *buf, b;
+	QCCount ref, c;
+	double t, tref;
+	S32 k, used;
+	int fail = 0;
+
+	buf = malloc(DMA_LM_FRAMEBUFFER_LENGTH);
+	if(!buf) {
+		printf("*ERROR* (SampleQCBench): memory allocation failure\n");
+		return(-1);
+	}
+
+	for(b = 0; b < 2; b++) {
+		fill_buffer(buf, gapEvery[b], gapWords[b]);
+		printf("\n%d junk words after every %d events:\n", gapWords[b], gapEvery[b]);
+
+		tref = run(qc_original, buf, &ref);
+		printf("original   %8.3f ms/buffer %8.1f MB/s  events %u, offset %u, fixed WM %u, bad checksum %u\n",
+			tref, DMA_LM_FRAMEBUFFER_LENGTH/1e3/tref, ref.events, ref.offset, ref.fixedWM, ref.badCS);
+
+		for(k = QC_KERNEL_SCALAR; k <= QC_KERNEL_AVX2; k++) {
+			used = QC_Kernel_Select(k);
+			if(used != k) {
+				printf("%-10s not supported by this CPU\n", names[k]);
+				continue;
+			}
+			t = run(qc_kernel, buf, &c);
+			printf("%-10s %8.3f ms/buffer %8.1f MB/s  events %u, offset %u, fixed WM %u, bad checksum %u  (x%.1f)\n",
+				names[k], t, DMA_LM_FRAMEBUFFER_LENGTH/1e3/t, c.events, c.offset, c.fixedWM, c.badCS, tref/t);
+			if(memcmp(&c, &ref, sizeof(QCCount)) != 0) {
+				printf("*ERROR* (SampleQCBench): %s kernel counts differ from original scan\n", names[k]);
+				fail = 1;
+			}
+		}
+	}
+	printf("\nkernel used in list mode runs: %s\n", names[QC_Kernel_Select(QC_KERNEL_AUTO)]);
+
+	free(buf);
+	return(fail ? -1 : 0);
+}
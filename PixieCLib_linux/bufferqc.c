@@ -0,0 +1,341 @@
+/*----------------------------------------------------------------------
+* Copyright (c) 2004, 2009, 2015 XIA LLC
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, 
+* with or without modification, are permitted provided 
+* that the following conditions are met:
+*
+*   * Redistributions of source code must retain the above 
+*     copyright notice, this list of conditions and the 
+*     following disclaimer.
+*   * Redistributions in binary form must reproduce the 
+*     above copyright notice, this list of conditions and the 
+*     following disclaimer in the documentation and/or other 
+*     materials provided with the distribution.
+*   * Neither the name of XIA LLC
+*     nor the names of its contributors may be used to endorse 
+*     or promote products derived from this software without 
+*     specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND 
+* CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+* INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF 
+* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+* IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE 
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON 
+* ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR 
+* TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF 
+* THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF 
+* SUCH DAMAGE.
+*----------------------------------------------------------------------*/
+
+/******************************************************************************
+*
+* File name:
+*
+*      bufferqc.c
+*
+* Description:
+*
+*      Kernels for the list mode buffer quality check (Process_DMA_Buffer):
+*      watermark search and channel header checksum, and the 32 to 16-bit 
+*      pack of Pixie-4 I/O buffers read from DSP data memory.
+*      The search skips all words that can not be a (possibly damaged) 
+*      watermark several words at a time. A word is accepted as watermark 
+*      if at most one of its 8 hex digits differs from WATERMARK, exactly 
+*      as in the word-by-word scan it replaces.
+*      SSE2 and AVX2 versions are selected at run time, with a scalar 
+*      fallback for other CPUs. All versions give identical results.
+*
+* Member functions:
+*					QC_Kernel_Select()			- select kernel (auto, scalar, SSE2, AVX2)
+*					QC_Watermark_Score()		- number of hex digits matching WATERMARK
+*					QC_Find_Watermark()			- find next candidate channel header
+*					QC_Header_Checksum()		- XOR checksum of a channel header
+*					QC_Pack16()					- low 16 bits of each 32-bit word
+*
+******************************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "PlxTypes.h"
+#include "PciTypes.h"
+#include "Plx.h"
+
+#include "globals.h"
+#include "sharedfiles.h"
+#include "utilities.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define QC_X86
+#include <immintrin.h>
+#endif
+
+// the checksum covers channel header words 0-7, chanHeadEventStatusIdx .. chanHeadPSA1Idx
+#define QC_CHECKSUM_WORDS	8
+
+static U32 (*QC_Find_Kernel)(U32 *pBuf, U32 start, U32 end) = NULL;
+static S32 (*QC_Checksum_Kernel)(U32 *pHeader) = NULL;
+static void (*QC_Pack_Kernel)(U32 *src, U16 *dst, U32 n) = NULL;
+static S32 QC_Kernel = -1;
+
+
+// nibbles of x that are not zero, as one bit (bit 0 of the nibble) each
+#define QC_NIBBLE_BITS(x)	(((x) | ((x) >> 1) | ((x) >> 2) | ((x) >> 3)) & 0x11111111)
+
+
+/****************************************************************
+*	Scalar kernels
+****************************************************************/
+
+static U32 QC_Find_Scalar (U32 *pBuf, U32 start, U32 end)
+{
+	U32 k, t;
+
+	for(k = start; k < end; k++) {
+		t = QC_NIBBLE_BITS(pBuf[k+chanHeadWatermarkIdx] ^ WATERMARK);
+		if((t & (t-1)) == 0)			// at most one wrong digit
+			return(k);
+	}
+	return(end);
+}
+
+static S32 QC_Checksum_Scalar (U32 *pHeader)
+{
+	return((S32)(pHeader[0] ^ pHeader[1] ^ pHeader[2] ^ pHeader[3] ^ 
+				 pHeader[4] ^ pHeader[5] ^ pHeader[6] ^ pHeader[7]));
+}
+
+static void QC_Pack_Scalar (U32 *src, U16 *dst, U32 n)
+{
+	U32 k;
+
+	for(k = 0; k < n; k++)
+		dst[k] = (U16)src[k];
+}
+
+
+#ifdef QC_X86
+/****************************************************************
+*	SSE2 kernels, 4 words at a time
+****************************************************************/
+
+__attribute__((target("sse2")))
+static U32 QC_Find_SSE2 (U32 *pBuf, U32 start, U32 end)
+{
+	__m128i wm  = _mm_set1_epi32((int)WATERMARK);
+	__m128i lsb = _mm_set1_epi32(0x11111111);
+	__m128i one = _mm_set1_epi32(1);
+	__m128i x, t;
+	U32 k = start;
+	int mask;
+
+	for( ; k + 4 <= end; k += 4) {
+		x = _mm_xor_si128(_mm_loadu_si128((__m128i *)&pBuf[k+chanHeadWatermarkIdx]), wm);
+		t = _mm_or_si128(x, _mm_srli_epi32(x, 1));
+		t = _mm_or_si128(t, _mm_srli_epi32(t, 2));
+		t = _mm_and_si128(t, lsb);
+		t = _mm_and_si128(t, _mm_sub_epi32(t, one));
+		mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(t, _mm_setzero_si128())));
+		if(mask)
+			return(k + __builtin_ctz(mask));
+	}
+	return(QC_Find_Scalar(pBuf, k, end));
+}
+
+__attribute__((target("sse2")))
+static S32 QC_Checksum_SSE2 (U32 *pHeader)
+{
+	__m128i x;
+
+	x = _mm_xor_si128(_mm_loadu_si128((__m128i *)&pHeader[0]), _mm_loadu_si128((__m128i *)&pHeader[4]));
+	x = _mm_xor_si128(x, _mm_shuffle_epi32(x, 0x4E));
+	x = _mm_xor_si128(x, _mm_shuffle_epi32(x, 0xB1));
+	return((S32)_mm_cvtsi128_si32(x));
+}
+
+// sign extend the low 16 bits so that the saturating pack keeps them unchanged
+__attribute__((target("sse2")))
+static void QC_Pack_SSE2 (U32 *src, U16 *dst, U32 n)
+{
+	__m128i a, b;
+	U32 k = 0;
+
+	for( ; k + 8 <= n; k += 8) {
+		a = _mm_srai_epi32(_mm_slli_epi32(_mm_loadu_si128((__m128i *)&src[k]), 16), 16);
+		b = _mm_srai_epi32(_mm_slli_epi32(_mm_loadu_si128((__m128i *)&src[k+4]), 16), 16);
+		_mm_storeu_si128((__m128i *)&dst[k], _mm_packs_epi32(a, b));
+	}
+	QC_Pack_Scalar(&src[k], &dst[k], n - k);
+}
+
+
+/****************************************************************
+*	AVX2 kernels, 8 words at a time
+****************************************************************/
+
+__attribute__((target("avx2")))
+static U32 QC_Find_AVX2 (U32 *pBuf, U32 start, U32 end)
+{
+	__m256i wm  = _mm256_set1_epi32((int)WATERMARK);
+	__m256i lsb = _mm256_set1_epi32(0x11111111);
+	__m256i one = _mm256_set1_epi32(1);
+	__m256i x, t;
+	U32 k = start;
+	int mask;
+
+	for( ; k + 8 <= end; k += 8) {
+		x = _mm256_xor_si256(_mm256_loadu_si256((__m256i *)&pBuf[k+chanHeadWatermarkIdx]), wm);
+		t = _mm256_or_si256(x, _mm256_srli_epi32(x, 1));
+		t = _mm256_or_si256(t, _mm256_srli_epi32(t, 2));
+		t = _mm256_and_si256(t, lsb);
+		t = _mm256_and_si256(t, _mm256_sub_epi32(t, one));
+		mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(t, _mm256_setzero_si256())));
+		if(mask)
+			return(k + __builtin_ctz(mask));
+	}
+	return(QC_Find_Scalar(pBuf, k, end));
+}
+
+__attribute__((target("avx2")))
+static void QC_Pack_AVX2 (U32 *src, U16 *dst, U32 n)
+{
+	__m256i a, b;
+	U32 k = 0;
+
+	for( ; k + 16 <= n; k += 16) {
+		a = _mm256_srai_epi32(_mm256_slli_epi32(_mm256_loadu_si256((__m256i *)&src[k]), 16), 16);
+		b = _mm256_srai_epi32(_mm256_slli_epi32(_mm256_loadu_si256((__m256i *)&src[k+8]), 16), 16);
+		// the pack works per 128-bit lane: a0-3 b0-3 a4-7 b4-7, put the quarters back in order
+		_mm256_storeu_si256((__m256i *)&dst[k], _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xD8));
+	}
+	QC_Pack_SSE2(&src[k], &dst[k], n - k);
+}
+#endif // QC_X86
+
+
+/****************************************************************
+*	QC_Kernel_Select function:
+*		Select the buffer QC kernels.
+*			QC_KERNEL_AUTO:   best supported by this CPU
+*			QC_KERNEL_SCALAR, QC_KERNEL_SSE2, QC_KERNEL_AVX2
+*		An unsupported choice falls back to the next lower one.
+*		Returns the kernel in use.
+*
+****************************************************************/
+
+S32 QC_Kernel_Select (
+					  S32 Kernel)		// QC_KERNEL_AUTO, _SCALAR, _SSE2 or _AVX2
+{
+	S32 best = QC_KERNEL_SCALAR;
+
+#ifdef QC_X86
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("sse2"))
+		best = QC_KERNEL_SSE2;
+	if(__builtin_cpu_supports("avx2"))
+		best = QC_KERNEL_AVX2;
+#endif
+
+	if(Kernel == QC_KERNEL_AUTO || Kernel > best)
+		Kernel = best;
+
+	switch(Kernel) {
+#ifdef QC_X86
+		case QC_KERNEL_AVX2:
+			QC_Find_Kernel = QC_Find_AVX2;
+			QC_Checksum_Kernel = QC_Checksum_SSE2;	// only 8 words
+			QC_Pack_Kernel = QC_Pack_AVX2;
+			break;
+		case QC_KERNEL_SSE2:
+			QC_Find_Kernel = QC_Find_SSE2;
+			QC_Checksum_Kernel = QC_Checksum_SSE2;
+			QC_Pack_Kernel = QC_Pack_SSE2;
+			break;
+#endif
+		default:
+			Kernel = QC_KERNEL_SCALAR;
+			QC_Find_Kernel = QC_Find_Scalar;
+			QC_Checksum_Kernel = QC_Checksum_Scalar;
+			QC_Pack_Kernel = QC_Pack_Scalar;
+			break;
+	}
+	__atomic_store_n(&QC_Kernel, Kernel, __ATOMIC_RELEASE);	// kernels set before they are used by other threads
+
+	return(Kernel);
+}
+
+/****************************************************************
+*	QC_Watermark_Score function:
+*		Returns the number of hex digits of Word matching WATERMARK,
+*		0 (no match) to 8 (full match)
+*
+****************************************************************/
+
+U32 QC_Watermark_Score (
+						U32 Word)		// candidate watermark
+{
+	return(8 - __builtin_popcount(QC_NIBBLE_BITS(Word ^ WATERMARK)));
+}
+
+/****************************************************************
+*	QC_Find_Watermark function:
+*		Returns the first position k, start <= k < end, at which 
+*		pBuf[k+chanHeadWatermarkIdx] matches WATERMARK in at least 
+*		7 of 8 hex digits, or end if there is none.
+*		pBuf must be readable up to end-1+chanHeadWatermarkIdx.
+*
+****************************************************************/
+
+U32 QC_Find_Watermark (
+					   U32 *pBuf,		// list mode buffer
+					   U32 start,		// first position of a channel header to try
+					   U32 end)			// last position + 1
+{
+	if(__atomic_load_n(&QC_Kernel, __ATOMIC_ACQUIRE) < 0)
+		QC_Kernel_Select(QC_KERNEL_AUTO);
+	if(start >= end)
+		return(end);
+	if(pBuf[start+chanHeadWatermarkIdx] == WATERMARK)		// most common case: next event starts right here
+		return(start);
+	return(QC_Find_Kernel(pBuf, start, end));
+}
+
+/****************************************************************
+*	QC_Header_Checksum function:
+*		Returns the checksum of a channel header as written by 
+*		the DSP: XOR of header words 0-7.
+*
+****************************************************************/
+
+S32 QC_Header_Checksum (
+						U32 *pHeader)		// channel header, at least MAX_CHAN_HEAD_LENGTH/2 words
+{
+	if(__atomic_load_n(&QC_Kernel, __ATOMIC_ACQUIRE) < 0)
+		QC_Kernel_Select(QC_KERNEL_AUTO);
+	return(QC_Checksum_Kernel(pHeader));
+}
+
+/****************************************************************
+*	QC_Pack16 function:
+*		Copies the low 16 bits of nWords 32-bit words, as read
+*		from DSP data memory, into 16-bit words. src and dst must
+*		not overlap.
+*
+****************************************************************/
+
+void QC_Pack16 (
+				U32 *src,		// 32-bit words
+				U16 *dst,		// receives nWords 16-bit words
+				U32 nWords)		// number of words
+{
+	if(__atomic_load_n(&QC_Kernel, __ATOMIC_ACQUIRE) < 0)
+		QC_Kernel_Select(QC_KERNEL_AUTO);
+	QC_Pack_Kernel(src, dst, nWords);
+}
@@ -178,6 +178,12 @@ extern "C" {
 #define IO_BUFFER_ADDRESS			24540//	// Address of I/O output buffer (absolute DSP address for P4/500) TODO: this should be read from module
 #define IO_BUFFER_LENGTH			8192	// Length of I/O output buffer
 #define DMA_LM_FRAMEBUFFER_LENGTH	0x200000 // Length of DMA buffer in LM runs. 2MB for Win32 and Win64.
+#define DMA_LM_RING_DEPTH			4		// Default number of DMA framebuffers per module in LM runs (ring)
+#define DMA_LM_RING_MAX				8		// Maximum number of DMA framebuffers per module in LM runs
+#define LM_SLOT_FREE				0		// DMA ring slot states: available for the sequencer
+#define LM_SLOT_FILLING				1		// sequencer is writing into this slot
+#define LM_SLOT_FULL				2		// filled, handed to the host for QC and disk I/O
+#define LM_WRITER_STATS_LENGTH		8		// words per module returned by list mode pipeline statistics (0x40E0)
 #define RUN_HEAD_LENGTH				32		// Run header length in Pixie-500 Express list mode files
 #define FIRST_HEAD_LENGTH			64		// Run header length + first event header lengthin Pixie-500 Express list mode files
 #define BUFFER_HEAD_LENGTH			6		// Output buffer header length
@@ -273,6 +279,66 @@ extern "C" {
 
 #define DMABUFREFILL_TIMEOUT	50		// 2MB refill timeout limit in ms
 #define DMATRANSFER_TIMEOUT		500	// DMA transfer timeout limit in ms
+#define END_RUN_FLUSH_DEADLINE	10000	// max time in ms to read out remaining data of all modules at run stop
+
+// End_Run_Flush() result per module
+#define END_RUN_NONE			0		// module not flushed
+#define END_RUN_EOR				1		// EOR found, all data read out
+#define END_RUN_TIMEOUT			2		// no new data for DMATRANSFER_TIMEOUT, no EOR
+#define END_RUN_DEADLINE		3		// END_RUN_FLUSH_DEADLINE passed, no EOR
+#define END_RUN_REPORT_LENGTH	4		// words per module returned by End_Run_Report (0x40E1)
+
+// Wait_Run_Done(): waiting for the end of a control task
+#define RUN_WAIT_ACK_US			1000	// inactive counts as done only if seen active before, or after this time in us
+#define RUN_WAIT_SPIN_US		1000	// poll continuously for this time in us around the expected end of the task
+#define RUN_WAIT_POLL_US		5		// pause between polls while polling continuously, us
+#define RUN_WAIT_TASKS			64		// control tasks with their own statistics, higher numbers share the last
+#define RUN_WAIT_STATS_LENGTH	7		// words per control task returned by Run_Wait_Stats (0x40E2)
+
+// Pixie_Boot(): boot phases done per module, Boot_Pattern bits 1-4 (FiPPI, DSP, DSP parameters, control tasks)
+#define BOOT_PHASES				4
+#define BOOT_REPORT_LENGTH		6		// words per module returned by Boot_Report (0x40E3)
+
+// Pixie_Log: per thread rings of messages, written by a flusher thread
+#define LOG_RING_LENGTH			512		// messages per thread ring, power of 2; when full, the thread flushes the log
+#define LOG_MAX_ARGS			8		// integer arguments of a Pixie_Log_Rec message
+#define LOG_TEXT_LENGTH			256		// longest message + 1, as ErrMSG
+#define LOG_FLUSH_MS			10		// time between flushes, ms
+#define LOG_STATS_LENGTH		5		// words returned by Pixie_Log_Stats (0x40E4)
+
+// Live_Stats: shared memory statistics of list mode runs, see live_stats.h
+#define LIVE_STATS_DSP_MS		1000	// default time between samples of the DSP run statistics, ms
+
+// LM_Hist: online histograms of list mode runs (0x9008 - 0x900A)
+#define LM_HIST_BINS			32768	// bins per histogram, as the module's MCA per channel
+#define LM_HIST_SHIFT			1		// bin = energy >> LM_HIST_SHIFT
+#define LM_HIST_GATES			8		// gated histograms
+#define LM_HIST_GATE_WORDS		8		// words of a gate definition
+#define LM_HIST_ANY				0xFFFF	// gate module or channel: all
+#define LM_HIST_PSA_NONE		0		// gate PSA value: no cut
+#define LM_HIST_PSA_USER		1		// gate PSA value: UserPSA
+#define LM_HIST_PSA_XIA			2		// gate PSA value: XIAPSA
+#define LM_HIST_PSA_EXT0		3		// gate PSA value: ExtendedPSA0 ...
+#define LM_HIST_PSA_EXT3		6		// ... ExtendedPSA3
+
+// MCA_View: partial readout of the MCA spectra (0x900B)
+#define MCA_VIEW_ALL			0xFFFF	// channel: all channels
+#define MCA_VIEW_COUNTS			0		// mode: counts
+#define MCA_VIEW_DELTA			1		// mode: change since the last read, per bin
+#define MCA_VIEW_CHANGED		2		// mode: list of the bins that changed since the last read
+
+// Emulated modules (pixie_emu.c), used with OFFLINE_ANALYSIS = OFFLINE_EMULATOR
+#define OFFLINE_EMULATOR		2		// OFFLINE_ANALYSIS value: P4e modules emulated in software
+#define EMU_BOARD_VERSION		0xA550	// emulated modules are P4e 16/125
+#define EMU_ERR_WATERMARK		0x1		// EmuErrors: one wrong digit in the watermark
+#define EMU_ERR_CHECKSUM		0x2		// EmuErrors: wrong header checksum
+#define EMU_ERR_SHORT			0x4		// EmuErrors: trace 2 words short
+#define EMU_ERR_SPLIT			0x8		// EmuErrors: rest of an event at a framebuffer boundary lost
+#define EMU_ERR_INTERVAL		1000	// events between injected errors of each kind
+#define EMU_MCA_RATE			100		// if EmuRate is 0: event rate of MCA runs and time stamp spacing, kcps per module
+#define EMU_CTRL_US				1000	// duration of a control task, us
+#define EMU_MCA_SHIFT			1		// MCA bin = energy >> EMU_MCA_SHIFT
+
 #define MOD_READ				1		// Host read from modules
 #define MOD_WRITE				0		// Host write to modules  
 
@@ -383,6 +449,16 @@ extern "C" {
 #define chanHeadCheckSumIdx				14
 #define chanHeadWatermarkIdx			15 
 
+// buffer QC kernels (QC_Kernel_Select)
+#define QC_KERNEL_AUTO					-1
+#define QC_KERNEL_SCALAR				0
+#define QC_KERNEL_SSE2					1
+#define QC_KERNEL_AVX2					2
+
+// I/O staged by an open parameter transaction (Par_Trans_Defer)
+#define PAR_TRANS_PARAM_RAM				1
+#define PAR_TRANS_FIPPI					2
+
 // ***********************************************************
 //		Error codes
 // ***********************************************************
@@ -0,0 +1,239 @@
+/*----------------------------------------------------------------------
+* Copyright (c) 2004, 2009, 2015 XIA LLC
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms,
+* with or without modification, are permitted provided
+* that the following conditions are met:
+*
+*   * Redistributions of source code must retain the above
+*     copyright notice, this list of conditions and the
+*     following disclaimer.
+*   * Redistributions in binary form must reproduce the
+*     above copyright notice, this list of conditions and the
+*     following disclaimer in the documentation and/or other
+*     materials provided with the distribution.
+*   * Neither the name of XIA LLC
+*     nor the names of its contributors may be used to endorse
+*     or promote products derived from this software without
+*     specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+* CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+* INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+* ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+* TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+* THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+* SUCH DAMAGE.
+*----------------------------------------------------------------------*/
+
+/******************************************************************************
+*
+* File name:
+*
+*      fpga_image.c
+*
+* Description:
+*
+*      FPGA configurations ready to stream into the FPGA configuration loader.
+*      The configuration files are written for the FIFO of the Gennum FCL 
+*      with the bits of each byte in reverse order. The reversed image is 
+*      made once when a file is read, and kept with the file's size and 
+*      modification time. PIXIE4E/PIXIE500E_ProgramFPGA then push it 
+*      128 words at a time, and Load_U16 skips reading a configuration 
+*      file again as long as it is unchanged on disk.
+*
+* Member functions:
+*					FPGA_Image_Current()	- check if the configuration in memory matches the file
+*					FPGA_Image_Build()		- make the reversed image after a configuration was read
+*					FPGA_Image_Words()		- reversed image of a configuration buffer
+*					FPGA_Image_Reverse()	- reverse the bits of each byte into FIFO words
+*
+******************************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/stat.h>
+
+#include "PlxTypes.h"
+#include "PciTypes.h"
+#include "Plx.h"
+
+#include "globals.h"
+#include "sharedfiles.h"
+#include "utilities.h"
+
+#define FPGA_IMAGES		4		// P4e, P4e 14/500, P500e, P32
+
+static struct FPGA_Image {
+	U8   ConfigName;				// P4E_FPGA_CONFIG etc., 0 if unused
+	S8   File[MAX_FILE_NAME_LENGTH];	// file read into Raw, "" if Raw may not match it
+	long long Size;					// of the file when read
+	long long MTime;
+	U8  *Raw;						// configuration buffer the file was read into
+	U32  Len;						// bytes
+	U32 *Words;						// bit-reversed FIFO words, (Len+3)/4
+} FPGAImage[FPGA_IMAGES];
+
+
+static struct FPGA_Image *FPGA_Image_Slot (
+	U8 ConfigName,			// configuration type, as for Load_U16
+	U8 **raw,				// receives the configuration buffer
+	U32 *len )				// receives its length in bytes
+{
+	U32 k;
+
+	switch(ConfigName) {
+		case P4E_FPGA_CONFIG:		*raw = P4e_FPGA_Configuration;		*len = N_P4E_BYTES;		k = 0; break;
+		case P4E14500_FPGA_CONFIG:	*raw = P4e14500_FPGA_Configuration;	*len = N_P4E_BYTES;		k = 1; break;
+		case P500E_FPGA_CONFIG:		*raw = P500e_FPGA_Configuration;	*len = N_P500E_BYTES;	k = 2; break;
+		case P32_FPGA_CONFIG:		*raw = P32_FPGA_Configuration;		*len = N_P32_BYTES;		k = 3; break;
+		default:
+			return(NULL);		// not an FPGA configuration
+	}
+	FPGAImage[k].ConfigName = ConfigName;
+	return(&FPGAImage[k]);
+}
+
+
+/****************************************************************
+*	FPGA_Image_Reverse function:
+*		Reverse the bit order of each of nBytes bytes from src, 
+*		as required by the Xilinx configuration port, and pack 
+*		them into (nBytes+3)/4 FIFO words. Missing bytes of the 
+*		last word are 0.
+*
+****************************************************************/
+
+void FPGA_Image_Reverse (
+	const U8 *src,			// configuration bytes
+	U32 *dst,				// receives the FIFO words
+	U32 nBytes )			// number of bytes
+{
+	U8 *d = (U8 *)dst;
+	U32 k, b;
+
+	for(k = 0; k < nBytes; k++) {
+		b = src[k];
+		d[k] = (U8)(((b & 0x80) >> 7) | ((b & 0x40) >> 5) | ((b & 0x20) >> 3) | ((b & 0x10) >> 1) |
+					((b & 0x08) << 1) | ((b & 0x04) << 3) | ((b & 0x02) << 5) | ((b & 0x01) << 7));
+	}
+	for(; k & 3; k++)
+		d[k] = 0;
+}
+
+
+/****************************************************************
+*	FPGA_Image_Current function:
+*		Check if the configuration buffer for ConfigName holds the
+*		file filnam as it is now on disk (same name, size and time 
+*		of modification), so Load_U16 does not have to read it.
+*		Otherwise the buffer is marked as not matching any file,
+*		since it is about to be read again.
+*
+*		Return Value:
+*			1 - buffer and reversed image match the file
+*			0 - file has to be read (or ConfigName is not an FPGA 
+*			    configuration)
+*
+****************************************************************/
+
+S32 FPGA_Image_Current (
+	S8 *filnam,				// configuration file
+	U8 ConfigName )			// configuration type, as for Load_U16
+{
+	struct FPGA_Image *img;
+	struct stat st;
+	U8 *raw;
+	U32 len;
+
+	img = FPGA_Image_Slot(ConfigName, &raw, &len);
+	if(img == NULL)
+		return(0);
+
+	if(img->Words != NULL && img->Raw == raw && img->Len == len && strcmp(img->File, filnam) == 0 &&
+	   stat(filnam, &st) == 0 && (long long)st.st_size == img->Size && (long long)st.st_mtime == img->MTime)
+		return(1);
+
+	img->File[0] = 0;
+	return(0);
+}
+
+
+/****************************************************************
+*	FPGA_Image_Build function:
+*		Make the bit-reversed FIFO image of the configuration 
+*		buffer for ConfigName after Load_U16 has read filnam into 
+*		it, and note the file's size and modification time.
+*		Without memory for the image, ProgramFPGA reverses the 
+*		configuration while writing it, as before.
+*
+*		Return Value:
+*			 0 - image made (or ConfigName is not an FPGA configuration)
+*			-1 - no memory for the image
+*
+****************************************************************/
+
+S32 FPGA_Image_Build (
+	S8 *filnam,				// configuration file
+	U8 ConfigName )			// configuration type, as for Load_U16
+{
+	struct FPGA_Image *img;
+	struct stat st;
+	U8 *raw;
+	U32 len;
+
+	img = FPGA_Image_Slot(ConfigName, &raw, &len);
+	if(img == NULL || raw == NULL)
+		return(0);
+
+	if(img->Words == NULL || img->Len != len) {
+		free(img->Words);
+		img->Words = (U32 *)malloc(((len + 3) / 4) * sizeof(U32));
+		if(img->Words == NULL) {
+			img->File[0] = 0;
+			sprintf(ErrMSG, "*WARNING* (FPGA_Image_Build): no memory to keep the configuration from %s", filnam);
+			Pixie_Print_MSG(ErrMSG,1);
+			return(-1);
+		}
+	}
+	FPGA_Image_Reverse(raw, img->Words, len);
+	img->Raw = raw;
+	img->Len = len;
+
+	img->File[0] = 0;
+	if(stat(filnam, &st) == 0 && strlen(filnam) < MAX_FILE_NAME_LENGTH) {
+		strcpy(img->File, filnam);
+		img->Size = (long long)st.st_size;
+		img->MTime = (long long)st.st_mtime;
+	}
+	return(0);
+}
+
+
+/****************************************************************
+*	FPGA_Image_Words function:
+*		Return the bit-reversed FIFO image of the configuration
+*		buffer raw of len bytes, or NULL if there is none.
+*
+****************************************************************/
+
+const U32 *FPGA_Image_Words (
+	const U8 *raw,			// configuration buffer
+	U32 len )				// bytes to write
+{
+	U32 k;
+
+	for(k = 0; k < FPGA_IMAGES; k++) {
+		if(FPGAImage[k].Words != NULL && FPGAImage[k].Raw == raw && FPGAImage[k].Len == len)
+			return(FPGAImage[k].Words);
+	}
+	return(NULL);
+}
@@ -72,7 +72,7 @@ double Filter_Int[PRESET_MAX_MODULES];				// Energy filter interval (depends on
 U16 Writing_IOBuffer_Address;						// The start address of I/O buffer for writing
 U16 Writing_IOBuffer_Length;						// The number of words to write into the I/O buffer
 double One_Cycle_Time;								// Number of ns for each wait cycle
-S8  ErrMSG[256];									// A string for error messages
+__thread S8  ErrMSG[256];							// A string for error messages (per thread, list mode writer threads report too)
 S8  next_base_name[256];							// A string for future file name (without suffixes) for a multi-file run
 U16 MakeNewFile;									// if 1, Write_DMA_List_Mode_File switches to new files when done
 U32 MODULE_EVENTS[2*PRESET_MAX_MODULES];			// Internal copy of ModuleEvents array modified by task 0x7001 and used by other 0x7000 tasks
@@ -93,6 +93,18 @@ U32 MultiThreadDAQ;									// if 1, run 0x400 or 0x10x as a separate thread
 U8 AutoProcessLMData;								// To control if the LM parse routine processes compressed LM data
 U8 KeepCW;											// To control update and enforced minimum of coincidence wait
 U8 KeepBL;											// if 1, do not automatically adjust BLcut after gain or filter settings changes  //by Hongyi Wu
+U16 LMRingDepth = DMA_LM_RING_DEPTH;				// number of DMA framebuffers per module in 0x40# runs (1 = single buffer, no ring)
+U16 LMWriterThread = 1;							// if 1, QC and file writes of 0x40# runs are done by one writer thread per module
+U16 LMZeroCopy = 1;								// if 1, binary list mode files are written directly from the DMA buffer (no LMBufferCopy)
+U16 LMParseThreads = 0;							// number of threads indexing a list mode file in the 0x70xx tasks (0 = one per CPU)
+U16 BootParallel = 1;								// if 1, Pixie_Boot boots all express modules at the same time, one thread per module
+U16 LiveStats = 0;									// if 1, list mode runs keep live statistics in shared memory (live_stats.h)
+U16 LiveStatsDSPms = LIVE_STATS_DSP_MS;			// time between samples of the DSP run statistics for the live statistics, ms (0 = none)
+U16 TuneParallel = 1;								// if 1, offsets, BLcut and tau of all express modules are adjusted at the same time, one thread per module
+U16 LMHist = 0;										// if 1, list mode runs fill online energy histograms (lm_hist.c)
+U16 EmuRate = 0;									// event rate of emulated modules, kcps per module (0 = as fast as possible, pixie_emu.c)
+U16 EmuErrors = 0;									// errors injected into the data of emulated modules, EMU_ERR_* bits
+U16 SpillParallel = 1;								// if 1, spills of 0x10# runs are read from all modules at the same time, one thread per module
 
 
 #ifdef WINDRIVER_API
@@ -107,6 +119,9 @@ U32 LMBufferCounter[PRESET_MAX_MODULES]; // framebuffer counter for all modules
 //U32 EndRunFound[PRESET_MAX_MODULES];  // EOR block found in data strea,
 U32 dt3EventCounter[PRESET_MAX_MODULES];
 U32 numDWordsLeftover[PRESET_MAX_MODULES];			// carryover from LM buffer to next
+U32 *LMCarry[PRESET_MAX_MODULES];				// incomplete event at the end of a LM buffer, joined with the start of the next
+U32 LMCarryCount[PRESET_MAX_MODULES];			// words in LMCarry
+U32 LMCarrySize[PRESET_MAX_MODULES];			// allocated words in LMCarry
 U16 EventLengthTotal[PRESET_MAX_MODULES]; // TODO: this has to be global? Need one for each module?
 U16 EventLength[PRESET_MAX_MODULES][NUMBER_OF_CHANNELS];// TODO: this has to be global? Need one for each module?
 U16 traceBlocksPrev_QC[PRESET_MAX_MODULES];
@@ -115,6 +130,14 @@ U32 RunStopTicks;
 S8 msgBuffer[65536]; // message buffer for info from the polling thread
 U32 DMADataPos;		 // position from which to read new data in DMA buffer
 S32 EndRunFound[PRESET_MAX_MODULES];	//
+WD_DMA *pDmaRing[PRESET_MAX_MODULES][DMA_LM_RING_MAX];	// SG lists of the DMA framebuffer ring
+INT32 *LMRingCode[PRESET_MAX_MODULES][DMA_LM_RING_MAX];	// pre-generated sequencer images, one per ring slot
+U32 *LMRing[PRESET_MAX_MODULES][DMA_LM_RING_MAX];		// DMA framebuffer ring
+U8 LMRingState[PRESET_MAX_MODULES][DMA_LM_RING_MAX];		// LM_SLOT_FREE, _FILLING, _FULL
+U16 LMRingSlots[PRESET_MAX_MODULES];				// number of ring slots set up at run start
+U16 LMRingFill[PRESET_MAX_MODULES];					// ring slot currently filled by the sequencer (LMBuffer points to it)
+U32 *LMBufferDone[PRESET_MAX_MODULES];				// last framebuffer handed to the host
+U32 LMRingStalls[PRESET_MAX_MODULES];				// number of times no free slot was available to re-arm the sequencer
 
 #ifdef COMPILE_IGOR_XOP  // Printing from polling thread
 DWORD pollingThreadId;
@@ -312,10 +335,10 @@ S8 System_Parameter_Names[N_SYSTEM_PAR][MAX_PAR_NAME_LENGTH] = {
 	"C_LIBRARY_BUILD",
 	"KEEP_CW",
 	"SLOT_WAVE",
+	"","","","","","","","",		// SLOT_WAVE occupies PRESET_MAX_MODULES entries
 	"","","","","","","","",
-	"","","","","","","","",
-	"","","","","","","","",
-	"","","","","","","","",
+	"LM_RING_DEPTH","LM_WRITER_THREAD","LM_ZERO_COPY","LM_PARSE_THREADS","BOOT_PARALLEL","TUNE_PARALLEL","LIVE_STATS","LIVE_STATS_DSP_MS",
+	"LM_HIST","EMU_RATE","EMU_ERRORS","SPILL_PARALLEL","","","","",
 	"","","","","","","","",
 	"","","","","","","","",
 	"","","","","","","",""
@@ -109,7 +109,7 @@ extern double Filter_Int[PRESET_MAX_MODULES];				// Energy filter interval (depe
 extern U16 Writing_IOBuffer_Address;						// The start address of I/O buffer for writing
 extern U16 Writing_IOBuffer_Length;							// The number of words to write into the I/O buffer
 extern double One_Cycle_Time;								// Number of ns for each wait cycle
-extern S8  ErrMSG[256];										// A string for error messages
+extern __thread S8  ErrMSG[256];								// A string for error messages (per thread)
 extern S8  next_base_name[256];								// A string for future file name (without suffixes) for a multi-file run
 extern U16 MakeNewFile;									// if 1, Write_DMA_List_Mode_File switches to new files when done
 extern U32 MODULE_EVENTS[2*PRESET_MAX_MODULES];				// Internal copy of ModuleEvents array modified by task 0x7001 and used by other 0x7000 tasks
@@ -129,6 +129,18 @@ extern U32 MultiThreadDAQ;									// if 1, run 0x400 or 0x10x as a separate thr
 extern U8 AutoProcessLMData;								// To control if the LM parse routine processes compressed LM data
 extern U8 KeepCW;											// To control update and enforced minimum of coincidence wait
 extern U8 KeepBL;											// if 1, do not automatically adjust BLcut after gain or filter settings changes
+extern U16 LMRingDepth;										// number of DMA framebuffers per module in 0x40# runs
+extern U16 LMWriterThread;									// if 1, 0x40# runs use a writer thread per module
+extern U16 LMZeroCopy;										// if 1, binary list mode files are written directly from the DMA buffer
+extern U16 LMParseThreads;									// number of threads indexing a list mode file (0 = one per CPU)
+extern U16 BootParallel;									// if 1, Pixie_Boot boots express modules in parallel
+extern U16 LiveStats;										// if 1, list mode runs keep live statistics in shared memory
+extern U16 LiveStatsDSPms;									// time between samples of the DSP run statistics, ms
+extern U16 TuneParallel;									// if 1, Tune_Modules adjusts express modules in parallel
+extern U16 LMHist;											// if 1, list mode runs fill online energy histograms
+extern U16 EmuRate;											// event rate of emulated modules, kcps per module (0 = as fast as possible)
+extern U16 EmuErrors;										// errors injected into the data of emulated modules, EMU_ERR_* bits
+extern U16 SpillParallel;									// if 1, spills of 0x10# runs are read from all modules in parallel
 
 
 #ifdef WINDRIVER_API
@@ -142,6 +154,9 @@ extern U32 LMBufferCounter[PRESET_MAX_MODULES];
 //extern U32 EndRunFound[PRESET_MAX_MODULES];  // EOR block found in data strea,
 extern U32 dt3EventCounter[PRESET_MAX_MODULES];
 extern U32 numDWordsLeftover[PRESET_MAX_MODULES];								// carryover from LM buffer to next
+extern U32 *LMCarry[PRESET_MAX_MODULES];									// incomplete event at the end of a LM buffer
+extern U32 LMCarryCount[PRESET_MAX_MODULES];
+extern U32 LMCarrySize[PRESET_MAX_MODULES];
 extern U16 EventLengthTotal[PRESET_MAX_MODULES];
 extern U16 EventLength[PRESET_MAX_MODULES][NUMBER_OF_CHANNELS];
 extern U16 traceBlocksPrev_QC[PRESET_MAX_MODULES];
@@ -150,6 +165,14 @@ extern U32 RunStopTicks;
 extern S8 msgBuffer[65536];									//  message buffer for info from the polling thread
 extern U32 DMADataPos;									// position from which to read new data in DMA buffer
 extern S32 EndRunFound[PRESET_MAX_MODULES];	
+extern WD_DMA *pDmaRing[PRESET_MAX_MODULES][DMA_LM_RING_MAX];	// SG lists of the DMA framebuffer ring
+extern INT32 *LMRingCode[PRESET_MAX_MODULES][DMA_LM_RING_MAX];	// pre-generated sequencer images, one per ring slot
+extern U32 *LMRing[PRESET_MAX_MODULES][DMA_LM_RING_MAX];		// DMA framebuffer ring
+extern U8 LMRingState[PRESET_MAX_MODULES][DMA_LM_RING_MAX];		// LM_SLOT_FREE, _FILLING, _FULL
+extern U16 LMRingSlots[PRESET_MAX_MODULES];						// number of ring slots set up at run start
+extern U16 LMRingFill[PRESET_MAX_MODULES];						// ring slot currently filled by the sequencer
+extern U32 *LMBufferDone[PRESET_MAX_MODULES];					// last framebuffer handed to the host
+extern U32 LMRingStalls[PRESET_MAX_MODULES];					// number of times no free slot was available to re-arm
 
 #ifdef COMPILE_IGOR_XOP
 extern DWORD pollingThreadId;
@@ -0,0 +1,328 @@
+/*----------------------------------------------------------------------
+* Copyright (c) 2004, 2009, 2015 XIA LLC
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms,
+* with or without modification, are permitted provided
+* that the following conditions are met:
+*
+*   * Redistributions of source code must retain the above
+*     copyright notice, this list of conditions and the
+*     following disclaimer.
+*   * Redistributions in binary form must reproduce the
+*     above copyright notice, this list of conditions and the
+*     following disclaimer in the documentation and/or other
+*     materials provided with the distribution.
+*   * Neither the name of XIA LLC
+*     nor the names of its contributors may be used to endorse
+*     or promote products derived from this software without
+*     specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+* CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+* INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+* ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+* TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+* THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+* SUCH DAMAGE.
+*----------------------------------------------------------------------*/
+
+/******************************************************************************
+*
+* File name:
+*
+*      live_stats.c
+*
+* Description:
+*
+*      Live statistics of list mode runs for monitoring programs. With 
+*      LiveStats set, the library keeps a struct Live_Stats (live_stats.h) in 
+*      the POSIX shared memory object LIVE_STATS_NAME. It is updated after 
+*      every DMA framebuffer by whoever processes it (writer thread or 
+*      polling loop), from counters the buffer QC keeps anyway, so a monitor
+*      can read it as often as it likes without touching the modules.
+*      The DSP run statistics are sampled by the 0x440# polls at most every
+*      LiveStatsDSPms, and once more at run end.
+*
+* Member functions:
+*					Live_Stats_Start()	- reset a module's block at run start
+*					Live_Stats_Buffer()	- add the QC counters of one DMA framebuffer
+*					Live_Stats_Bytes()	- add bytes written to the list mode file
+*					Live_Stats_Time()	- start time of a buffer for Live_Stats_Buffer()
+*					Live_Stats_Sample()	- sample the DSP run statistics
+*					Live_Stats_Stop()	- final sample at run end
+*
+******************************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "PlxTypes.h"
+#include "PciTypes.h"
+#include "Plx.h"
+
+#include "globals.h"
+#include "sharedfiles.h"
+#include "utilities.h"
+#include "live_stats.h"
+
+static struct Live_Stats *LiveBlock = NULL;			// mapped block, NULL if not (yet) set up
+static U64 LiveLastBuffer[PRESET_MAX_MODULES];		// ns, end of the previous buffer
+static double LiveChanPar[PRESET_MAX_MODULES*N_CHANNEL_PAR*NUMBER_OF_CHANNELS];	// for UA_PAR_IO
+static double LiveModPar[PRESET_MAX_MODULES*N_MODULE_PAR];
+
+
+static U64 Live_ns (void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return((U64)ts.tv_sec*1000000000ULL + (U64)ts.tv_nsec);
+}
+
+static void Live_Add (U64 *counter, U64 n)
+{
+	__atomic_store_n(counter, *counter + n, __ATOMIC_RELAXED);		// one writer per module
+}
+
+
+/* Create or open the shared memory object, map it */
+static S32 Live_Stats_Map (void)
+{
+	struct Live_Stats *b;
+	S32 fd;
+
+	fd = shm_open(LIVE_STATS_NAME, O_CREAT | O_RDWR, 0644);
+	if(fd < 0) {
+		sprintf(ErrMSG, "*ERROR* (Live_Stats_Map): can not open shared memory %s, errno %d", LIVE_STATS_NAME, errno);
+		Pixie_Print_MSG(ErrMSG,1);
+		return(-1);
+	}
+	if(ftruncate(fd, sizeof(struct Live_Stats)) != 0) {
+		sprintf(ErrMSG, "*ERROR* (Live_Stats_Map): can not size shared memory %s, errno %d", LIVE_STATS_NAME, errno);
+		Pixie_Print_MSG(ErrMSG,1);
+		close(fd);
+		return(-1);
+	}
+	b = (struct Live_Stats *)mmap(NULL, sizeof(struct Live_Stats), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(b == MAP_FAILED) {
+		sprintf(ErrMSG, "*ERROR* (Live_Stats_Map): can not map shared memory %s, errno %d", LIVE_STATS_NAME, errno);
+		Pixie_Print_MSG(ErrMSG,1);
+		return(-1);
+	}
+
+	// a block of another library version is set up again
+	if(b->Magic != LIVE_STATS_MAGIC || b->Version != LIVE_STATS_VERSION || b->Size != sizeof(struct Live_Stats)) {
+		memset(b, 0, sizeof(struct Live_Stats));
+		b->Version = LIVE_STATS_VERSION;
+		b->Size = sizeof(struct Live_Stats);
+		__atomic_store_n(&b->Magic, LIVE_STATS_MAGIC, __ATOMIC_RELEASE);
+	}
+	LiveBlock = b;
+	return(0);
+}
+
+
+/****************************************************************
+*	Live_Stats_Start function:
+*		Set up the live statistics block if LiveStats is set,
+*		and reset the counters of module ModNum for a new run.
+*
+****************************************************************/
+
+void Live_Stats_Start (
+					   U8  ModNum,		// Pixie module number
+					   U16 RunType )	// 0x400 - 0x403
+{
+	struct Live_Stats_Module *s;
+
+	if(!LiveStats)
+		return;
+	if(LiveBlock == NULL && Live_Stats_Map() < 0)
+		return;
+
+	LiveBlock->NumModules = Number_Modules;
+	s = &LiveBlock->Module[ModNum];
+	__atomic_store_n(&s->Active, 0, __ATOMIC_RELEASE);
+	memset(&s->Time, 0, (U8 *)&s->DSPSeq - (U8 *)&s->Time);
+	s->DSPSamples = 0;
+	s->RunType = RunType;
+	s->Run++;
+	LiveLastBuffer[ModNum] = 0;
+	__atomic_store_n(&s->Active, 1, __ATOMIC_RELEASE);
+}
+
+
+/****************************************************************
+*	Live_Stats_Buffer function:
+*		Add the QC counters and per channel event counts of one 
+*		processed DMA framebuffer, with the time it took.
+*
+****************************************************************/
+
+void Live_Stats_Buffer (
+						U8  ModNum,			// Pixie module number
+						U32 *qc,			// LIVE_QC_COUNTERS counters of this buffer
+						U32 *chanEvents,	// NUMBER_OF_CHANNELS events, or NULL
+						U64 start )			// Live_Stats_Time() when the buffer was taken up
+{
+	struct Live_Stats_Module *s;
+	U32 stats[LM_WRITER_STATS_LENGTH] = {0};
+	U64 now;
+	U32 k, us;
+
+	if(LiveBlock == NULL || !LiveStats)
+		return;
+	s = &LiveBlock->Module[ModNum];
+	now = Live_ns();
+
+	for(k = 0; k < LIVE_QC_COUNTERS; k++)
+		if(qc[k]) Live_Add(&s->QC[k], qc[k]);
+	if(chanEvents)
+		for(k = 0; k < NUMBER_OF_CHANNELS; k++)
+			if(chanEvents[k]) Live_Add(&s->ChannelEvents[k], chanEvents[k]);
+
+	us = (U32)((now - start)/1000);
+	s->BufferTime = us;
+	if(us > s->MaxBufferTime)
+		s->MaxBufferTime = us;
+	if(LiveLastBuffer[ModNum])
+		s->BufferPeriod = (U32)((now - LiveLastBuffer[ModNum])/1000);
+	LiveLastBuffer[ModNum] = now;
+
+#ifdef WINDRIVER_API
+	LM_Writer_Stats(ModNum, stats);
+#endif
+	s->QueueDepth    = stats[0];
+	s->MaxQueueDepth = stats[1];
+	s->RingStalls    = stats[2];
+	s->RingSlots     = stats[6];
+
+	Live_Add(&s->Buffers, 1);
+	__atomic_store_n(&s->Time, now, __ATOMIC_RELEASE);
+}
+
+
+/****************************************************************
+*	Live_Stats_Bytes function:
+*		Add bytes written to the list mode file of module ModNum.
+*
+****************************************************************/
+
+void Live_Stats_Bytes (
+					   U8  ModNum,		// Pixie module number
+					   U64 bytes )		// bytes written
+{
+	if(LiveBlock == NULL || !LiveStats)
+		return;
+	Live_Add(&LiveBlock->Module[ModNum].BytesWritten, bytes);
+}
+
+
+/****************************************************************
+*	Live_Stats_Time function:
+*		Time to pass to Live_Stats_Buffer, CLOCK_MONOTONIC ns.
+*		0 if there is no live statistics block.
+*
+****************************************************************/
+
+U64 Live_Stats_Time (void)
+{
+	if(LiveBlock == NULL || !LiveStats)
+		return(0);
+	return(Live_ns());
+}
+
+
+/****************************************************************
+*	Live_Stats_Sample function:
+*		Read the run statistics of module ModNum from the module,
+*		as MODULE_RUN_STATISTICS and CHANNEL_RUN_STATISTICS, and
+*		publish them. Unless force is set, only if LiveStatsDSPms 
+*		have passed since the last sample. Never if LiveStatsDSPms
+*		is 0.
+*
+****************************************************************/
+
+void Live_Stats_Sample (
+						U8  ModNum,		// Pixie module number
+						U8  force )		// 1: sample now
+{
+	struct Live_Stats_Module *s;
+	U64 now;
+	U16 idx;
+	U32 k, off;
+
+	if(LiveBlock == NULL || !LiveStats || !LiveStatsDSPms)
+		return;
+	s = &LiveBlock->Module[ModNum];
+	now = Live_ns();
+	if(!force && s->DSPSamples && (now - s->DSPTime < (U64)LiveStatsDSPms*1000000ULL))
+		return;
+
+	if(UA_PAR_IO(LiveModPar, "MODULE_RUN_STATISTICS", "MODULE", MOD_READ, ModNum, 0) < 0)
+		return;
+	if(UA_PAR_IO(LiveChanPar, "CHANNEL_RUN_STATISTICS", "CHANNEL", MOD_READ, ModNum, 0) < 0)
+		return;
+
+	__atomic_store_n(&s->DSPSeq, s->DSPSeq + 1, __ATOMIC_RELEASE);		// odd: being updated
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	s->NumberEvents = LiveModPar[ModNum*N_MODULE_PAR + Find_Xact_Match("NUMBER_EVENTS", Module_Parameter_Names, N_MODULE_PAR)];
+	s->RunTime      = LiveModPar[ModNum*N_MODULE_PAR + Find_Xact_Match("RUN_TIME", Module_Parameter_Names, N_MODULE_PAR)];
+	s->EventRate    = LiveModPar[ModNum*N_MODULE_PAR + Find_Xact_Match("EVENT_RATE", Module_Parameter_Names, N_MODULE_PAR)];
+	s->TotalTime    = LiveModPar[ModNum*N_MODULE_PAR + Find_Xact_Match("TOTAL_TIME", Module_Parameter_Names, N_MODULE_PAR)];
+	for(k = 0; k < NUMBER_OF_CHANNELS; k++) {
+		off = ModNum*N_CHANNEL_PAR*NUMBER_OF_CHANNELS + k*N_CHANNEL_PAR;
+		idx = Find_Xact_Match("COUNT_TIME", Channel_Parameter_Names, N_CHANNEL_PAR);
+		s->CountTime[k] = LiveChanPar[off+idx];
+		idx = Find_Xact_Match("INPUT_COUNT_RATE", Channel_Parameter_Names, N_CHANNEL_PAR);
+		s->InputCountRate[k] = LiveChanPar[off+idx];
+		idx = Find_Xact_Match("OUTPUT_COUNT_RATE", Channel_Parameter_Names, N_CHANNEL_PAR);
+		s->OutputCountRate[k] = LiveChanPar[off+idx];
+		idx = Find_Xact_Match("FAST_PEAKS", Channel_Parameter_Names, N_CHANNEL_PAR);
+		s->FastPeaks[k] = LiveChanPar[off+idx];
+		idx = Find_Xact_Match("NOUT", Channel_Parameter_Names, N_CHANNEL_PAR);
+		s->NOut[k] = LiveChanPar[off+idx];
+		idx = Find_Xact_Match("FTDT", Channel_Parameter_Names, N_CHANNEL_PAR);
+		s->FTDT[k] = LiveChanPar[off+idx];
+		idx = Find_Xact_Match("SFDT", Channel_Parameter_Names, N_CHANNEL_PAR);
+		s->SFDT[k] = LiveChanPar[off+idx];
+		idx = Find_Xact_Match("GDT", Channel_Parameter_Names, N_CHANNEL_PAR);
+		s->GDT[k] = LiveChanPar[off+idx];
+	}
+	s->DSPTime = now;
+	s->DSPSamples++;
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	__atomic_store_n(&s->DSPSeq, s->DSPSeq + 1, __ATOMIC_RELEASE);		// even: consistent
+}
+
+
+/****************************************************************
+*	Live_Stats_Stop function:
+*		Take the final sample of the DSP run statistics of 
+*		module ModNum and mark its run as ended.
+*
+****************************************************************/
+
+void Live_Stats_Stop (
+					  U8 ModNum )		// Pixie module number
+{
+	if(LiveBlock == NULL || !LiveStats)
+		return;
+	Live_Stats_Sample(ModNum, 1);
+	__atomic_store_n(&LiveBlock->Module[ModNum].Active, 0, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,133 @@
+#ifndef __LIVE_STATS_H
+#define __LIVE_STATS_H
+
+/*----------------------------------------------------------------------
+ * Copyright (c) 2004, 2009 XIA LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, 
+ * with or without modification, are permitted provided 
+ * that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above 
+ *     copyright notice, this list of conditions and the 
+ *     following disclaimer.
+ *   * Redistributions in binary form must reproduce the 
+ *     above copyright notice, this list of conditions and the 
+ *     following disclaimer in the documentation and/or other 
+ *     materials provided with the distribution.
+ *   * Neither the name of XIA LLC 
+ *     nor the names of its contributors may be used to endorse 
+ *     or promote products derived from this software without 
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND 
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF 
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+ * IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE 
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON 
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR 
+ * TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF 
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF 
+ * SUCH DAMAGE.
+ *----------------------------------------------------------------------*/
+
+
+
+/******************************************************************************
+ *
+ * File Name:
+ *
+ *     live_stats.h
+ *
+ * Description:
+ *
+ *     Layout of the live statistics block that the library keeps in the 
+ *     POSIX shared memory object LIVE_STATS_NAME during list mode runs 
+ *     (see live_stats.c). Monitoring programs map it read only and need
+ *     no locks and no access to the modules:
+ *     - the readout counters are 64-bit words, each updated by itself;
+ *       rates follow from two readings and their Time.
+ *     - the sampled DSP run statistics of a module are consistent if 
+ *       DSPSeq was even and the same before and after reading them.
+ *
+ ******************************************************************************/
+
+
+/* If this is compiled by a C++ compiler, make it */
+/* clear that these are C routines.               */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef __DEFS_H
+	#include "defs.h"
+#endif
+
+#include "PlxTypes.h"
+
+#define LIVE_STATS_NAME		"/pixie4e_live_stats"	// shm_open name
+#define LIVE_STATS_MAGIC	0x4C345850				// "PX4L"
+#define LIVE_STATS_VERSION	1
+
+/* the counters of the list mode buffer QC, in the order of Process_DMA_Buffer's summary */
+#define LIVE_QC_EVENTS			0		// events written
+#define LIVE_QC_SHORT			1		// short events
+#define LIVE_QC_SPLIT_HEADER	2		// events discarded, channel header split over two buffers
+#define LIVE_QC_SPLIT_TRACE		3		// events split over two buffers
+#define LIVE_QC_TRACE_MISMATCH	4		// trace length differs from the header
+#define LIVE_QC_BAD_WATERMARK	5		// watermarks fixed
+#define LIVE_QC_BAD_CHANNEL		6		// wrong channel numbers
+#define LIVE_QC_BAD_CHECKSUM	7		// checksum mismatches
+#define LIVE_QC_COUNTERS		8
+
+struct Live_Stats_Module {
+	// set at run start
+	U64 Run;							// runs started since the block was created, 0 if never
+	U32 Active;							// 1 while a run is in progress
+	U32 RunType;						// 0x400 - 0x403
+
+	// list mode readout, updated after every DMA framebuffer
+	U64 Time;							// CLOCK_MONOTONIC ns of the last update
+	U64 Buffers;						// DMA framebuffers processed
+	U64 QC[LIVE_QC_COUNTERS];			// buffer QC counters, see LIVE_QC_*
+	U64 ChannelEvents[NUMBER_OF_CHANNELS];	// events per channel (not counted in run type 0x402)
+	U64 BytesWritten;					// bytes written to the list mode file
+	U32 BufferTime;						// time to process the last buffer, us
+	U32 MaxBufferTime;					// longest time to process one buffer, us
+	U32 BufferPeriod;					// time between the last two buffers, us
+	U32 QueueDepth;						// buffers waiting for the writer thread
+	U32 MaxQueueDepth;					// most buffers waiting for the writer thread
+	U32 RingSlots;						// DMA framebuffers in the ring
+	U32 RingStalls;						// times no ring slot was free to re-arm the DMA
+	U32 Reserved;
+
+	// DSP run statistics, sampled every LiveStatsDSPms
+	U32 DSPSeq;							// odd while the sample is updated
+	U32 DSPSamples;						// samples taken this run
+	U64 DSPTime;						// CLOCK_MONOTONIC ns of the sample
+	double NumberEvents, RunTime, EventRate, TotalTime;					// as MODULE_RUN_STATISTICS
+	double CountTime[NUMBER_OF_CHANNELS];								// live time, as CHANNEL_RUN_STATISTICS
+	double InputCountRate[NUMBER_OF_CHANNELS], OutputCountRate[NUMBER_OF_CHANNELS];
+	double FastPeaks[NUMBER_OF_CHANNELS], NOut[NUMBER_OF_CHANNELS];
+	double FTDT[NUMBER_OF_CHANNELS], SFDT[NUMBER_OF_CHANNELS];			// fast trigger and slow filter dead time
+	double GDT[NUMBER_OF_CHANNELS];										// gate dead time
+};
+
+struct Live_Stats {
+	U32 Magic;							// LIVE_STATS_MAGIC when the block is set up
+	U32 Version;						// LIVE_STATS_VERSION
+	U32 Size;							// sizeof(struct Live_Stats)
+	U32 NumModules;						// modules in the system
+	struct Live_Stats_Module Module[PRESET_MAX_MODULES];
+};
+
+#ifdef __cplusplus
+}
+#endif	/* End of notice for C++ compilers */
+
+#endif	/* End of live_stats.h */
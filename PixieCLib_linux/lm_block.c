@@ -0,0 +1,242 @@
+/*----------------------------------------------------------------------
+* Copyright (c) 2004, 2009, 2015 XIA LLC
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, 
+* with or without modification, are permitted provided 
+* that the following conditions are met:
+*
+*   * Redistributions of source code must retain the above 
+*     copyright notice, this list of conditions and the 
+*     following disclaimer.
+*   * Redistributions in binary form must reproduce the 
+*     above copyright notice, this list of conditions and the 
+*     following disclaimer in the documentation and/or other 
+*     materials provided with the distribution.
+*   * Neither the name of XIA LLC
+*     nor the names of its contributors may be used to endorse 
+*     or promote products derived from this software without 
+*     specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND 
+* CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+* INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF 
+* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+* IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE 
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON 
+* ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR 
+* TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF 
+* THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF 
+* SUCH DAMAGE.
+*----------------------------------------------------------------------*/
+
+/******************************************************************************
+*
+* File name:
+*
+*      lm_block.c
+*
+* Description:
+*
+*      Buffered block reader for list mode files that are read event by
+*      event at arbitrary positions (Pixie-4 event browser, ErrorChecking).
+*      Words are served from a window of the file kept in memory; the
+*      window is refilled with a single fseek and fread when a request
+*      falls outside it, at least readAhead words at a time. Requests are
+*      made by file position, so callers parse whole events from memory
+*      instead of reading them word by word.
+*      The window buffer is kept when the reader is closed and reused by
+*      the next LM_Block_Open, so readers opened for every browsed event
+*      do not allocate each time.
+*
+* Member functions:
+*					LM_Block_Open()				- open list mode file for block reads
+*					LM_Block_Close()			- close file, keep window buffer for reuse
+*					LM_Block_Get()				- pointer to words at a file position
+*					LM_Block_Read()				- copy words from a file position
+*
+******************************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+
+#include "PlxTypes.h"
+#include "PciTypes.h"
+#include "Plx.h"
+
+#include "reader.h"
+
+// window buffer of the last closed reader, taken by the next LM_Block_Open
+static U16 *LMBlockSpare = NULL;
+static U32  LMBlockSpareSize = 0;
+static pthread_mutex_t LMBlockSpareLock = PTHREAD_MUTEX_INITIALIZER;
+
+
+/****************************************************************
+*	LM_Block_Open function:
+*		Open a list mode file for block reads. The window buffer
+*		is allocated on first use.
+*
+*		Return Value:
+*			 0 - success
+*			-1 - can't open file
+*			-2 - memory allocation error
+*
+****************************************************************/
+
+S32 LM_Block_Open (
+				   S8 *filename,			// list mode file name
+				   U32 readAhead,			// words read at least per refill, 0 for LM_BLOCK_READ_AHEAD
+				   LMB_t *pBlock)			// receives reader
+{
+	LMB_t B;
+
+	*pBlock = NULL;
+	if(!(B = calloc(1, sizeof(*B)))) {
+		sprintf(ErrMSG, "*ERROR* (LM_Block_Open): memory allocation failure");
+		Pixie_Print_MSG(ErrMSG,1);
+		return(-2);
+	}
+	if(!(B->File = fopen(filename, "rb"))) {
+		free(B);
+		return(-1);
+	}
+	Pixie_fseek(B->File, 0, SEEK_END);
+	B->FileSize = Pixie_ftell(B->File);
+	B->ReadAhead = readAhead ? readAhead : LM_BLOCK_READ_AHEAD;
+
+	pthread_mutex_lock(&LMBlockSpareLock);
+	B->Buf  = LMBlockSpare;
+	B->Size = LMBlockSpareSize;
+	LMBlockSpare = NULL;
+	LMBlockSpareSize = 0;
+	pthread_mutex_unlock(&LMBlockSpareLock);
+
+	*pBlock = B;
+	return(0);
+}
+
+
+/****************************************************************
+*	LM_Block_Close function:
+*		Close the file. The window buffer is kept for the next
+*		reader if it is larger than the one kept already.
+*
+****************************************************************/
+
+void LM_Block_Close (
+					 LMB_t B)				// reader
+{
+	if(!B)
+		return;
+	if(B->File)
+		fclose(B->File);
+	pthread_mutex_lock(&LMBlockSpareLock);
+	if(B->Size > LMBlockSpareSize) {
+		free(LMBlockSpare);
+		LMBlockSpare = B->Buf;
+		LMBlockSpareSize = B->Size;
+		B->Buf = NULL;
+	}
+	pthread_mutex_unlock(&LMBlockSpareLock);
+	free(B->Buf);
+	free(B);
+}
+
+
+/****************************************************************
+*	LM_Block_Get function:
+*		Make numWords 16-bit words starting at byte position pos
+*		available in the window, refilling it with one read if
+*		they are not there yet. Reading backwards, the window is
+*		filled so that it ends with the requested words.
+*		The pointer is valid until the next LM_Block_Get or
+*		LM_Block_Read on this reader.
+*
+*		Return Value:
+*			pointer to the words, NULL if pos is outside the file
+*			or on memory allocation error
+*
+****************************************************************/
+
+U16 *LM_Block_Get (
+				   LMB_t B,					// reader
+				   S64 pos,					// position in bytes
+				   U32 numWords,			// number of words wanted
+				   U32 *got)				// receives number of words available, fewer at the end of the file
+{
+	S64 avail, start;
+	U32 n;
+	U16 *buf;
+
+	*got = 0;
+	if(pos < 0 || pos + 2 > B->FileSize)
+		return(NULL);
+	avail = (B->FileSize - pos) / 2;
+	if((S64)numWords > avail)
+		numWords = (U32)avail;
+
+	if(pos < B->Pos || ((pos - B->Pos) & 1) || pos + 2*(S64)numWords > B->Pos + 2*(S64)B->Valid) {
+		n = MAX(numWords, B->ReadAhead);
+		if(n > B->Size) {
+			if(!(buf = realloc(B->Buf, (size_t)n * sizeof(U16)))) {
+				sprintf(ErrMSG, "*ERROR* (LM_Block_Get): not enough memory for %u words", n);
+				Pixie_Print_MSG(ErrMSG,1);
+				return(NULL);
+			}
+			B->Buf  = buf;
+			B->Size = n;
+		}
+		start = pos;
+		if(pos < B->Pos && B->Valid > 0) {
+			start = pos + 2*(S64)numWords - 2*(S64)n;	// going backwards: keep what precedes pos
+			if(start < 0)
+				start = pos & 1;
+		}
+		B->Valid = 0;
+		if(Pixie_fseek(B->File, start, SEEK_SET) != 0)
+			return(NULL);
+		B->Pos   = start;
+		B->Valid = (U32)fread(B->Buf, sizeof(U16), n, B->File);
+		B->Reads++;
+		if(pos + 2*(S64)numWords > B->Pos + 2*(S64)B->Valid) {		// file shorter than when opened
+			if(pos + 2 > B->Pos + 2*(S64)B->Valid)
+				return(NULL);
+			numWords = (U32)((B->Pos + 2*(S64)B->Valid - pos) / 2);
+		}
+	}
+	*got = numWords;
+	return(B->Buf + (pos - B->Pos) / 2);
+}
+
+
+/****************************************************************
+*	LM_Block_Read function:
+*		Copy up to numWords 16-bit words from the file, starting at
+*		byte position pos. Like fread, fewer words are copied at
+*		the end of the file.
+*
+*		Return Value:
+*			number of words copied
+*
+****************************************************************/
+
+U32 LM_Block_Read (
+				   LMB_t B,					// reader
+				   S64 pos,					// position in bytes
+				   U16 *dst,				// receives data
+				   U32 numWords)			// number of words to read
+{
+	U16 *src;
+	U32 got;
+
+	if(!(src = LM_Block_Get(B, pos, numWords, &got)))
+		return(0);
+	memcpy(dst, src, (size_t)got * sizeof(U16));
+	return(got);
+}
@@ -0,0 +1,496 @@
+/*----------------------------------------------------------------------
+* Copyright (c) 2004, 2009, 2015 XIA LLC
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms,
+* with or without modification, are permitted provided
+* that the following conditions are met:
+*
+*   * Redistributions of source code must retain the above
+*     copyright notice, this list of conditions and the
+*     following disclaimer.
+*   * Redistributions in binary form must reproduce the
+*     above copyright notice, this list of conditions and the
+*     following disclaimer in the documentation and/or other
+*     materials provided with the distribution.
+*   * Neither the name of XIA LLC
+*     nor the names of its contributors may be used to endorse
+*     or promote products derived from this software without
+*     specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+* CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+* INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+* ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+* TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+* THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+* SUCH DAMAGE.
+*----------------------------------------------------------------------*/
+
+/******************************************************************************
+*
+* File name:
+*
+*      lm_columns.c
+*
+* Description:
+*
+*      Columnar binary export of Pixie-4e/500e list mode files (task 0x7040).
+*      The decoded channel headers are written as fixed width arrays, one
+*      per quantity (time stamp, energy, channel, ...), to <file>_m<mod>.lmc.
+*      The file starts with a small header and a table of the columns,
+*      giving name, type and offset of each, so analysis programs can map
+*      the columns they need instead of parsing the ASCII outputs.
+*      Events come from the list mode file index (lm_index.c); traces are
+*      not read.
+*
+*      File layout, native byte order:
+*			LMColumnsHeader
+*			LMColumnDesc[NumColumns]
+*			column 0: NumRows values, starting at a LM_COLUMNS_ALIGN boundary
+*			column 1: ...
+*      Run type 0x402 has 4 rows per event, one per channel.
+*      The same format holds the time ordered events of several modules
+*      (task 0x7050, lm_merge.c); ModNum in the header is then 0xFFFF.
+*
+* Member functions:
+*					LM_Columns_Create()			- open a columnar output file
+*					LM_Columns_Event()			- add the rows of an event
+*					LM_Columns_Close()			- write header and remaining rows, close
+*					LM_Columns_Write()			- write the columnar file of a list mode file
+*
+******************************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "PlxTypes.h"
+#include "PciTypes.h"
+#include "Plx.h"
+
+#include "reader.h"
+
+#define LM_COLUMNS_ROWS			65536		// rows buffered per column before writing
+
+// columns in file order
+enum {
+	LM_COL_EVENT = 0,
+	LM_COL_TIMESTAMP,
+	LM_COL_ENERGY,
+	LM_COL_CHANNEL,
+	LM_COL_MODULE,
+	LM_COL_STATUS,
+	LM_COL_XIAPSA,
+	LM_COL_USERPSA,
+	LM_COL_EXTPSA0,
+	LM_COL_EXTPSA1,
+	LM_COL_EXTPSA2,
+	LM_COL_EXTPSA3,
+	LM_COL_NUM
+};
+
+static const struct {
+	S8  *Name;
+	S8  *Type;
+	U32 Width;
+} LMColumnDef[LM_COL_NUM] = {
+	{"event",     "u32", 4},		// event number in the list mode file
+	{"timestamp", "u64", 8},		// 48-bit trigger time, ADC clock ticks
+	{"energy",    "u16", 2},
+	{"channel",   "u8",  1},
+	{"module",    "u8",  1},
+	{"status",    "u32", 4},		// hit pattern + 65536 * event info, bit 31 set for bad events
+	{"xia_psa",   "u16", 2},
+	{"user_psa",  "u16", 2},
+	{"ext_psa0",  "u16", 2},
+	{"ext_psa1",  "u16", 2},
+	{"ext_psa2",  "u16", 2},
+	{"ext_psa3",  "u16", 2}
+};
+
+
+
+// columnar output file being written
+struct LMColumnsOutStruct {
+	FILE   *File;
+	S8     *FileName;
+	FILE   *Spool[LM_COL_NUM];		// number of rows not known: columns are collected in <FileName>.<k> first
+	LMColumnsHeader Header;
+	LMColumnDesc Desc[LM_COL_NUM];
+	U8     *Block;					// row buffers of all columns
+	U8     *Buf[LM_COL_NUM];
+	U32    NumBuf;					// rows buffered
+	U64    RowsDone;				// rows written to the file or spooled
+	S32    Status;					// 0, -1 after a write error
+};
+
+
+/****************************************************************
+*	LM_Columns_Layout function:
+*		Column table for NumRows rows, each column starting on a
+*		LM_COLUMNS_ALIGN boundary after the header.
+*
+****************************************************************/
+
+static void LM_Columns_Layout (LMC_t Out)
+{
+	U64 offset = Out->Header.HeaderSize;
+	U32 k;
+
+	for(k = 0; k < LM_COL_NUM; k++) {
+		offset = (offset + LM_COLUMNS_ALIGN - 1) / LM_COLUMNS_ALIGN * LM_COLUMNS_ALIGN;
+		Out->Desc[k].Offset = offset;
+		offset += Out->Header.NumRows * Out->Desc[k].Width;
+	}
+}
+
+
+/****************************************************************
+*	LM_Columns_Flush function:
+*		Write the buffered rows of every column to their place
+*		in the file, or append them to the column spool files.
+*
+*		Return Value:
+*			 0 - success
+*			-1 - write error
+*
+****************************************************************/
+
+static S32 LM_Columns_Flush (LMC_t Out)
+{
+	U32 k;
+
+	if(Out->NumBuf == 0 || Out->Status < 0)
+		return(Out->Status);
+	for(k = 0; k < LM_COL_NUM; k++) {
+		if(Out->Spool[k]) {
+			if(fwrite(Out->Buf[k], Out->Desc[k].Width, Out->NumBuf, Out->Spool[k]) != Out->NumBuf)
+				Out->Status = -1;
+		}
+		else {
+			if(Pixie_fseek(Out->File, (S64)(Out->Desc[k].Offset + Out->RowsDone * Out->Desc[k].Width), SEEK_SET) != 0 ||
+			   fwrite(Out->Buf[k], Out->Desc[k].Width, Out->NumBuf, Out->File) != Out->NumBuf)
+				Out->Status = -1;
+		}
+	}
+	Out->RowsDone += Out->NumBuf;
+	Out->NumBuf = 0;
+	return(Out->Status);
+}
+
+
+/****************************************************************
+*	LM_Columns_Release function:
+*		Close and remove the spool files, free the output file.
+*
+****************************************************************/
+
+static void LM_Columns_Release (LMC_t Out)
+{
+	S8 *spoolname;
+	U32 k;
+
+	spoolname = malloc(strlen(Out->FileName) + 8);
+	for(k = 0; k < LM_COL_NUM; k++) {
+		if(!Out->Spool[k])
+			continue;
+		fclose(Out->Spool[k]);
+		if(spoolname) {
+			sprintf(spoolname, "%s.%u", Out->FileName, k);
+			remove(spoolname);
+		}
+	}
+	free(spoolname);
+	free(Out->Block);
+	free(Out->FileName);
+	free(Out);
+}
+
+
+/****************************************************************
+*	LM_Columns_Create function:
+*		Open a columnar output file for events of the given run
+*		type. If NumRows is known, columns are written in place;
+*		if it is 0, they are collected in spool files next to the
+*		output file and copied into it by LM_Columns_Close.
+*
+*		Return Value:
+*			 0 - success
+*			-1 - can't open output file
+*			-2 - memory allocation error
+*
+****************************************************************/
+
+S32 LM_Columns_Create (
+					   S8 *outname,				// output file name
+					   LMColumnsHeader *Info,	// ModNum, RunType, BlockSize of the events
+					   U64 NumRows,				// number of rows, 0 if not known in advance
+					   LMC_t *pOut)				// receives output file, to be closed with LM_Columns_Close
+{
+	LMC_t Out;
+	S8 *spoolname;
+	U32 k, rowBytes = 0;
+
+	*pOut = NULL;
+	if(!(Out = calloc(1, sizeof(*Out))) || !(Out->FileName = malloc(strlen(outname) + 1))) {
+		sprintf(ErrMSG, "*ERROR* (LM_Columns_Create): not enough memory for output file");
+		Pixie_Print_MSG(ErrMSG,1);
+		free(Out);
+		return(-2);
+	}
+	strcpy(Out->FileName, outname);
+
+	memcpy(Out->Header.Magic, LM_COLUMNS_MAGIC, sizeof(Out->Header.Magic));
+	Out->Header.ByteOrder  = LM_COLUMNS_BYTEORDER;
+	Out->Header.HeaderSize = sizeof(LMColumnsHeader) + LM_COL_NUM * sizeof(LMColumnDesc);
+	Out->Header.NumColumns = LM_COL_NUM;
+	Out->Header.NumRows    = NumRows;
+	Out->Header.ModNum     = Info->ModNum;
+	Out->Header.RunType    = Info->RunType;
+	Out->Header.BlockSize  = Info->BlockSize;
+	Out->Header.ClockMHz   = P500E_ADC_CLOCK_MHZ;
+	for(k = 0; k < LM_COL_NUM; k++) {
+		strncpy(Out->Desc[k].Name, LMColumnDef[k].Name, sizeof(Out->Desc[k].Name) - 1);
+		strncpy(Out->Desc[k].Type, LMColumnDef[k].Type, sizeof(Out->Desc[k].Type) - 1);
+		Out->Desc[k].Width = LMColumnDef[k].Width;
+		rowBytes += Out->Desc[k].Width;
+	}
+	LM_Columns_Layout(Out);
+
+	if(!(Out->Block = malloc((size_t)LM_COLUMNS_ROWS * rowBytes)) || !(spoolname = malloc(strlen(outname) + 8))) {
+		sprintf(ErrMSG, "*ERROR* (LM_Columns_Create): not enough memory for column buffers");
+		Pixie_Print_MSG(ErrMSG,1);
+		LM_Columns_Release(Out);
+		return(-2);
+	}
+	Out->Buf[0] = Out->Block;
+	for(k = 1; k < LM_COL_NUM; k++)
+		Out->Buf[k] = Out->Buf[k-1] + (size_t)LM_COLUMNS_ROWS * Out->Desc[k-1].Width;
+
+	if(NumRows == 0) {
+		for(k = 0; k < LM_COL_NUM; k++) {
+			sprintf(spoolname, "%s.%u", outname, k);
+			if(!(Out->Spool[k] = fopen(spoolname, "w+b"))) {
+				sprintf(ErrMSG, "*ERROR* (LM_Columns_Create): can't open spool file %s", spoolname);
+				Pixie_Print_MSG(ErrMSG,1);
+				free(spoolname);
+				LM_Columns_Release(Out);
+				return(-1);
+			}
+		}
+	}
+	free(spoolname);
+
+	if(!(Out->File = fopen(outname, "wb"))) {
+		sprintf(ErrMSG, "*ERROR* (LM_Columns_Create): can't open output file %s", outname);
+		Pixie_Print_MSG(ErrMSG,1);
+		LM_Columns_Release(Out);
+		return(-1);
+	}
+	*pOut = Out;
+	return(0);
+}
+
+
+/****************************************************************
+*	LM_Columns_Event function:
+*		Add the rows of one event: one row, or one per channel
+*		for run type 0x402 (time and energy of each channel, no
+*		PSA values). ChanNo and TimeStamp are only used for single
+*		channel records.
+*
+*		Return Value:
+*			 0 - success
+*			-1 - write error
+*
+****************************************************************/
+
+S32 LM_Columns_Event (
+					  LMC_t Out,				// output file
+					  U32 EventNum,				// event number in its list mode file
+					  U16 ModNum,				// module number
+					  U16 ChanNo,				// channel number (single channel records)
+					  U64 TimeStamp,			// event time (single channel records)
+					  U16 *hdr)					// channel header, corrected
+{
+	U32 status = (U32)hdr[0] + 65536 * (U32)hdr[1];
+	U32 ch, k, r;
+	U16 rt = Out->Header.RunType & 0xFF0F;
+
+	for(ch = 0; ch < ((rt == 0x402) ? 4U : 1U); ch++) {
+		r = Out->NumBuf;
+		((U32 *)Out->Buf[LM_COL_EVENT])[r]  = EventNum;
+		((U8 *) Out->Buf[LM_COL_MODULE])[r] = (U8)ModNum;
+		((U32 *)Out->Buf[LM_COL_STATUS])[r] = status;
+		if(rt == 0x402) {		// 4-channel records
+			((U64 *)Out->Buf[LM_COL_TIMESTAMP])[r] = ((U64)hdr[4] << 32) + ((U64)hdr[9+4*ch] << 16) + (U64)hdr[8+4*ch];
+			((U16 *)Out->Buf[LM_COL_ENERGY])[r]    = hdr[10+4*ch];
+			((U8 *) Out->Buf[LM_COL_CHANNEL])[r]   = (U8)ch;
+			for(k = LM_COL_XIAPSA; k <= LM_COL_EXTPSA3; k++)
+				((U16 *)Out->Buf[k])[r] = 0;
+		}
+		else {
+			((U64 *)Out->Buf[LM_COL_TIMESTAMP])[r] = TimeStamp;
+			((U16 *)Out->Buf[LM_COL_ENERGY])[r]    = hdr[8];
+			((U8 *) Out->Buf[LM_COL_CHANNEL])[r]   = (U8)ChanNo;
+			((U16 *)Out->Buf[LM_COL_XIAPSA])[r]    = hdr[11];
+			((U16 *)Out->Buf[LM_COL_USERPSA])[r]   = hdr[10];
+			((U16 *)Out->Buf[LM_COL_EXTPSA0])[r]   = hdr[12];
+			((U16 *)Out->Buf[LM_COL_EXTPSA1])[r]   = hdr[13];
+			((U16 *)Out->Buf[LM_COL_EXTPSA2])[r]   = hdr[14];
+			((U16 *)Out->Buf[LM_COL_EXTPSA3])[r]   = hdr[15];
+		}
+		if(++Out->NumBuf == LM_COLUMNS_ROWS)
+			LM_Columns_Flush(Out);
+	}
+	return(Out->Status);
+}
+
+
+/****************************************************************
+*	LM_Columns_Close function:
+*		Write the remaining rows and the file header, copy spooled
+*		columns into the file, and close it.
+*
+*		Return Value:
+*			 0 - success
+*			-1 - write error
+*
+****************************************************************/
+
+S32 LM_Columns_Close (
+					  LMC_t Out,				// output file
+					  U32 NumEvents,			// events written, for the file header
+					  U32 BadEvents,			// of which bad
+					  U64 *NumRows)				// receives number of rows written
+{
+	U32 k;
+	size_t n;
+	S32 retval;
+
+	LM_Columns_Flush(Out);
+	*NumRows = Out->RowsDone;
+	Out->Header.NumEvents = NumEvents;
+	Out->Header.BadEvents = BadEvents;
+	if(Out->Spool[0]) {		// now the number of rows is known
+		Out->Header.NumRows = Out->RowsDone;
+		LM_Columns_Layout(Out);
+	}
+
+	if(Out->Status == 0) {
+		if(Pixie_fseek(Out->File, 0, SEEK_SET) != 0 ||
+		   fwrite(&Out->Header, sizeof(Out->Header), 1, Out->File) != 1 ||
+		   fwrite(Out->Desc, sizeof(Out->Desc), 1, Out->File) != 1)
+			Out->Status = -1;
+	}
+	for(k = 0; k < LM_COL_NUM && Out->Spool[k] && Out->Status == 0; k++) {
+		rewind(Out->Spool[k]);
+		if(Pixie_fseek(Out->File, (S64)Out->Desc[k].Offset, SEEK_SET) != 0)
+			Out->Status = -1;
+		while(Out->Status == 0 && (n = fread(Out->Block, 1, (size_t)LM_COLUMNS_ROWS * sizeof(U64), Out->Spool[k])) > 0) {
+			if(fwrite(Out->Block, 1, n, Out->File) != n)
+				Out->Status = -1;
+		}
+	}
+	if(fclose(Out->File) != 0)
+		Out->Status = -1;
+
+	if(Out->Status < 0) {
+		sprintf(ErrMSG, "*ERROR* (LM_Columns_Close): failed to write output file %s", Out->FileName);
+		Pixie_Print_MSG(ErrMSG,1);
+	}
+	else {
+		sprintf(ErrMSG, "*INFO* (LM_Columns_Close): wrote %llu rows of %u events to %s", (unsigned long long)Out->RowsDone, NumEvents, Out->FileName);
+		Pixie_Print_MSG(ErrMSG,PrintDebugMsg_other);
+	}
+	retval = Out->Status;
+	LM_Columns_Release(Out);
+	return(retval);
+}
+
+
+/****************************************************************
+*	LM_Columns_Write function:
+*		Task 0x7040: write the events of a list mode file as a
+*		columnar binary file <file>_m<mod>.lmc (see top of file).
+*		UserData[0] receives the number of rows written,
+*		UserData[1] the number of events, UserData[2] the number
+*		of bad events.
+*
+*		Return Value:
+*			 0 - success
+*			-1 - can't open list mode data file or output file, write error
+*			-2 - memory allocation error
+*			-3 - invalid data in file. Events up to the damage are written
+*			-4 - invalid data pointer for return data
+*			-5 - invalid run type in file
+*
+****************************************************************/
+
+S32 LM_Columns_Write (
+					  S8 *filename,				// list mode file name
+					  U32 *UserData)			// receives number of rows, events and bad events
+{
+	LMI_t Idx = NULL;
+	LMC_t Out = NULL;
+	LMColumnsHeader Info;
+	U16 hdr[MAX_CHAN_HEAD_LENGTH];
+	S8 *outname, *dot;
+	U64 rows = 0;
+	U32 n;
+	S32 retval, status;
+
+	if(!UserData) {
+		sprintf(ErrMSG, "*ERROR* (LM_Columns_Write): NULL pointer *UserData");
+		Pixie_Print_MSG(ErrMSG,1);
+		return(-4);
+	}
+
+	retval = LM_Index_Open(filename, &Idx);
+	if(!Idx)
+		return(retval);
+
+	/* Output file name: list mode file name without extension, module number and .lmc */
+	if(!(outname = malloc(strlen(filename) + 16))) {
+		sprintf(ErrMSG, "*ERROR* (LM_Columns_Write): not enough memory for output file name");
+		Pixie_Print_MSG(ErrMSG,1);
+		LM_Index_Close(Idx);
+		return(-2);
+	}
+	strcpy(outname, filename);
+	if((dot = strrchr(outname, '.')) != NULL)
+		*dot = '\0';
+	sprintf(outname + strlen(outname), "_m%hu.lmc", Idx->RunHeader[1]);
+
+	memset(&Info, 0, sizeof(Info));
+	Info.ModNum    = Idx->RunHeader[1];
+	Info.RunType   = Idx->RunType;
+	Info.BlockSize = Idx->BlockSize;
+	status = LM_Columns_Create(outname, &Info, (U64)Idx->NumEvents * (((Idx->RunType & 0xFF0F) == 0x402) ? 4 : 1), &Out);
+	free(outname);
+	if(status < 0) {
+		LM_Index_Close(Idx);
+		return(status);
+	}
+
+	for(n = 0; n < Idx->NumEvents && status == 0; n++) {
+		LM_Index_Header(Idx, n, hdr);
+		status = LM_Columns_Event(Out, n, Idx->RunHeader[1], Idx->Entry[n].ChanNo, Idx->Entry[n].TimeStamp, hdr);
+	}
+	if(LM_Columns_Close(Out, Idx->NumEvents, Idx->BadEvents, &rows) < 0)
+		retval = -1;
+
+	UserData[0] = (U32)rows;
+	UserData[1] = Idx->NumEvents;
+	UserData[2] = Idx->BadEvents;
+
+	LM_Index_Close(Idx);
+	return(retval);
+}
@@ -0,0 +1,274 @@
+/*----------------------------------------------------------------------
+* Copyright (c) 2004, 2009, 2015 XIA LLC
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms,
+* with or without modification, are permitted provided
+* that the following conditions are met:
+*
+*   * Redistributions of source code must retain the above
+*     copyright notice, this list of conditions and the
+*     following disclaimer.
+*   * Redistributions in binary form must reproduce the
+*     above copyright notice, this list of conditions and the
+*     following disclaimer in the documentation and/or other
+*     materials provided with the distribution.
+*   * Neither the name of XIA LLC
+*     nor the names of its contributors may be used to endorse
+*     or promote products derived from this software without
+*     specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+* CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+* INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+* ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+* TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+* THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+* SUCH DAMAGE.
+*----------------------------------------------------------------------*/
+
+/******************************************************************************
+*
+* File name:
+*
+*      lm_hist.c
+*
+* Description:
+*
+*      Online histograms of list mode runs. With LMHist set, every event that
+*      passed the buffer QC in Process_DMA_Buffer is histogrammed by energy, 
+*      per channel, and into up to LM_HIST_GATES gated histograms defined by
+*      hit pattern and PSA value cuts. Each module has its own bins, filled 
+*      only by the thread processing that module's buffers, so filling needs
+*      no locks; the gated histograms of all modules are summed when they 
+*      are read. Histograms can be read at any time during or after the run.
+*
+* Member functions:
+*					LM_Hist_Set_Gate()		- define a gated histogram
+*					LM_Hist_Start()			- clear a module's histograms at run start
+*					LM_Hist_Event()			- histogram one event
+*					LM_Hist_Read()			- copy a module's energy histograms
+*					LM_Hist_Read_Gated()	- sum the gated histograms of all modules
+*
+******************************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "PlxTypes.h"
+#include "PciTypes.h"
+#include "Plx.h"
+
+#include "globals.h"
+#include "sharedfiles.h"
+#include "utilities.h"
+
+/* gate definition words, as passed to LM_Hist_Set_Gate */
+#define GATE_ENABLE			0		// 0: gate not used
+#define GATE_MODULE			1		// module number, or LM_HIST_ANY
+#define GATE_CHANNEL		2		// channel number, or LM_HIST_ANY
+#define GATE_PATTERN_MASK	3		// hit pattern bits to compare (EvtPattern)
+#define GATE_PATTERN_VALUE	4		// required value of these bits
+#define GATE_PSA			5		// PSA value to cut on, LM_HIST_PSA_xxx
+#define GATE_PSA_MIN		6		// lowest PSA value accepted
+#define GATE_PSA_MAX		7		// highest PSA value accepted
+
+static U32 HistGate[LM_HIST_GATES][LM_HIST_GATE_WORDS];			// as defined by the user
+static U32 RunGate[PRESET_MAX_MODULES][LM_HIST_GATES][LM_HIST_GATE_WORDS];	// enabled gates of a module, taken at run start
+static U32 RunGates[PRESET_MAX_MODULES];						// number of entries in RunGate
+static U32 RunGateNum[PRESET_MAX_MODULES][LM_HIST_GATES];		// gate number of each entry
+static U32 *HistBins[PRESET_MAX_MODULES];						// NUMBER_OF_CHANNELS energy, then LM_HIST_GATES gated histograms
+
+
+/****************************************************************
+*	LM_Hist_Set_Gate function:
+*		Define gated histogram number gate from LM_HIST_GATE_WORDS
+*		words: enable, module, channel, hit pattern mask and value,
+*		PSA value (LM_HIST_PSA_xxx) with lowest and highest value.
+*		The gate applies from the next run start.
+*
+*		Return Value:
+*			 0 - success
+*			-1 - invalid gate number
+*
+****************************************************************/
+
+S32 LM_Hist_Set_Gate (
+					  U32 gate,			// gated histogram number, 0 to LM_HIST_GATES-1
+					  U32 *def )		// LM_HIST_GATE_WORDS words
+{
+	if(gate >= LM_HIST_GATES) {
+		sprintf(ErrMSG, "*ERROR* (LM_Hist_Set_Gate): invalid gate number %u", gate);
+		Pixie_Print_MSG(ErrMSG,1);
+		return(-1);
+	}
+	memcpy(HistGate[gate], def, sizeof(HistGate[gate]));
+	return(0);
+}
+
+
+/****************************************************************
+*	LM_Hist_Start function:
+*		Set up and clear the histograms of module ModNum at the
+*		start of a list mode run, if LMHist is set.
+*
+*		Return Value:
+*			 0 - success, or LMHist not set
+*			-1 - memory allocation failure
+*
+****************************************************************/
+
+S32 LM_Hist_Start (
+				   U8 ModNum )		// Pixie module number
+{
+	U32 k;
+
+	RunGates[ModNum] = 0;
+	if(!LMHist)
+		return(0);
+
+	if(HistBins[ModNum] == NULL) {
+		HistBins[ModNum] = malloc((NUMBER_OF_CHANNELS + LM_HIST_GATES)*LM_HIST_BINS*sizeof(U32));
+		if(HistBins[ModNum] == NULL) {
+			sprintf(ErrMSG, "*ERROR* (LM_Hist_Start): memory allocation failure, module %d", ModNum);
+			Pixie_Print_MSG(ErrMSG,1);
+			return(-1);
+		}
+	}
+	memset(HistBins[ModNum], 0, (NUMBER_OF_CHANNELS + LM_HIST_GATES)*LM_HIST_BINS*sizeof(U32));
+
+	for(k = 0; k < LM_HIST_GATES; k++) {
+		if(!HistGate[k][GATE_ENABLE])
+			continue;
+		if(HistGate[k][GATE_MODULE] != LM_HIST_ANY && HistGate[k][GATE_MODULE] != ModNum)
+			continue;
+		memcpy(RunGate[ModNum][RunGates[ModNum]], HistGate[k], sizeof(HistGate[k]));
+		RunGateNum[ModNum][RunGates[ModNum]] = k;
+		RunGates[ModNum]++;
+	}
+	return(0);
+}
+
+
+/* add one count, the bins may be read by another thread at the same time */
+static void Hist_Add (U32 *bin)
+{
+	__atomic_store_n(bin, *bin + 1, __ATOMIC_RELAXED);		// one writer per module
+}
+
+
+/* channel entry of an event: energy histogram, then the gates it passes */
+static void Hist_Fill (U8 ModNum, U32 ChanNum, U32 energy, U32 pattern, U16 *psa)
+{
+	U32 *bins = HistBins[ModNum];
+	U32 bin = energy >> LM_HIST_SHIFT;
+	U32 k, value;
+	U32 *g;
+
+	Hist_Add(&bins[ChanNum*LM_HIST_BINS + bin]);
+	for(k = 0; k < RunGates[ModNum]; k++) {
+		g = RunGate[ModNum][k];
+		if(g[GATE_CHANNEL] != LM_HIST_ANY && g[GATE_CHANNEL] != ChanNum)
+			continue;
+		if((pattern & g[GATE_PATTERN_MASK]) != g[GATE_PATTERN_VALUE])
+			continue;
+		if(g[GATE_PSA] != LM_HIST_PSA_NONE) {
+			if(psa == NULL || g[GATE_PSA] > LM_HIST_PSA_EXT3)
+				continue;
+			value = psa[g[GATE_PSA] - LM_HIST_PSA_USER];
+			if(value < g[GATE_PSA_MIN] || value > g[GATE_PSA_MAX])
+				continue;
+		}
+		Hist_Add(&bins[(NUMBER_OF_CHANNELS + RunGateNum[ModNum][k])*LM_HIST_BINS + bin]);
+	}
+}
+
+
+/****************************************************************
+*	LM_Hist_Event function:
+*		Histogram one event of a DMA framebuffer after QC. Events
+*		QC marked as bad are not histogrammed. In run type 0x402,
+*		each channel in the hit pattern is histogrammed, and gates
+*		with a PSA cut never pass.
+*
+****************************************************************/
+
+void LM_Hist_Event (
+					U8  ModNum,		// Pixie module number
+					U32 *event,		// channel header, 32-bit words
+					U16 RunType )	// 0x400 - 0x403
+{
+	U16 *head = (U16 *)event;
+	U32 k;
+
+	if(HistBins[ModNum] == NULL || !LMHist)
+		return;
+	if(event[chanHeadEventStatusIdx] & 0x80000000)		// bad event
+		return;
+
+	if(RunType == 0x402) {
+		for(k = 0; k < NUMBER_OF_CHANNELS; k++)			// energy of channel k at 10+4k
+			if(head[0] & (1 << k))
+				Hist_Fill(ModNum, k, head[10 + 4*k], head[0], NULL);
+	}
+	else {
+		k = head[9] & 0xFF;
+		if(k < NUMBER_OF_CHANNELS)
+			Hist_Fill(ModNum, k, head[8], head[0], &head[10]);
+	}
+}
+
+
+/****************************************************************
+*	LM_Hist_Read function:
+*		Copy the energy histograms of module ModNum, 
+*		NUMBER_OF_CHANNELS x LM_HIST_BINS words. Zeros if there
+*		are none.
+*
+****************************************************************/
+
+void LM_Hist_Read (
+				   U8  ModNum,			// Pixie module number
+				   U32 *User_data )		// NUMBER_OF_CHANNELS*LM_HIST_BINS words
+{
+	U32 *bins = (ModNum < PRESET_MAX_MODULES) ? HistBins[ModNum] : NULL;
+	U32 k;
+
+	if(bins == NULL) {
+		memset(User_data, 0, NUMBER_OF_CHANNELS*LM_HIST_BINS*sizeof(U32));
+		return;
+	}
+	for(k = 0; k < NUMBER_OF_CHANNELS*LM_HIST_BINS; k++)
+		User_data[k] = __atomic_load_n(&bins[k], __ATOMIC_RELAXED);
+}
+
+
+/****************************************************************
+*	LM_Hist_Read_Gated function:
+*		Sum the gated histograms of all modules, 
+*		LM_HIST_GATES x LM_HIST_BINS words.
+*
+****************************************************************/
+
+void LM_Hist_Read_Gated (
+						 U32 *User_data )	// LM_HIST_GATES*LM_HIST_BINS words
+{
+	U32 *bins;
+	U32 m, k;
+
+	memset(User_data, 0, LM_HIST_GATES*LM_HIST_BINS*sizeof(U32));
+	for(m = 0; m < PRESET_MAX_MODULES; m++) {
+		if(HistBins[m] == NULL)
+			continue;
+		bins = &HistBins[m][NUMBER_OF_CHANNELS*LM_HIST_BINS];
+		for(k = 0; k < LM_HIST_GATES*LM_HIST_BINS; k++)
+			User_data[k] += __atomic_load_n(&bins[k], __ATOMIC_RELAXED);
+	}
+}
@@ -0,0 +1,1053 @@
+/*----------------------------------------------------------------------
+* Copyright (c) 2004, 2009, 2015 XIA LLC
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, 
+* with or without modification, are permitted provided 
+* that the following conditions are met:
+*
+*   * Redistributions of source code must retain the above 
+*     copyright notice, this list of conditions and the 
+*     following disclaimer.
+*   * Redistributions in binary form must reproduce the 
+*     above copyright notice, this list of conditions and the 
+*     following disclaimer in the documentation and/or other 
+*     materials provided with the distribution.
+*   * Neither the name of XIA LLC
+*     nor the names of its contributors may be used to endorse 
+*     or promote products derived from this software without 
+*     specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND 
+* CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+* INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF 
+* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+* IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE 
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON 
+* ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR 
+* TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF 
+* THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF 
+* SUCH DAMAGE.
+*----------------------------------------------------------------------*/
+
+/******************************************************************************
+*
+* File name:
+*
+*      lm_index.c
+*
+* Description:
+*
+*      Event index of Pixie-4e/500e list mode files (run types 0x400-0x403).
+*      The list mode file is mapped into memory and walked once with the
+*      same watermark, checksum, channel number and trace length checks as
+*      Pixie_List_Mode_Parser always did. For every event the position,
+*      channel, time stamp, corrected trace lengths and QC result are kept
+*      in a compact index, which is saved next to the list mode file
+*      (<file>.idx) and reused as long as the list mode file is unchanged.
+*      The 0x70xx tasks and Pixie_Event_Browser then read headers and traces
+*      straight from the mapped file, event by event or at random.
+*      Large files are indexed in parallel chunks, each resynced on the
+*      next valid watermark and checksum (see LM_Index_Build).
+*      A file can also be streamed: the index then only holds the events
+*      of a window that moves through the file (LM_Index_Stream_Next),
+*      so memory use does not grow with the file size.
+*
+* Member functions:
+*					LM_Index_Open()				- map list mode file, load or build its index
+*					LM_Index_Close()			- release mappings and memory
+*					LM_Index_Stream_Open()		- map list mode file, index it window by window
+*					LM_Index_Stream_Next()		- index the next window of a streamed file
+*					LM_Index_Find()				- first event at or after a file position
+*					LM_Index_Header()			- channel header of an event, with QC corrections
+*					LM_Index_Read()				- read words from the mapped file
+*					LM_Index_Trace()			- trace of an event
+*					LM_Index_Next()				- file position after an event, as left by a sequential reader
+*
+******************************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef XIA_LINUX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+#include <pthread.h>
+
+#include "PlxTypes.h"
+#include "PciTypes.h"
+#include "Plx.h"
+
+#include "reader.h"
+
+#define LM_INDEX_MAGIC			"PXLMIDX1"
+#define LM_INDEX_SUFFIX			".idx"
+#define LM_INDEX_CHUNK_MIN		(4*1024*1024)	// smallest part of a file indexed by its own thread, bytes
+
+// sidecar file header, followed by NumEvents LMIndexEntry
+typedef struct {
+	U8  Magic[8];				// LM_INDEX_MAGIC
+	U32 EntrySize;				// sizeof(LMIndexEntry)
+	U32 NumEvents;
+	S64 FileSize;				// size and modification time of the list mode file when indexed
+	S64 FileTime;
+	U32 BadEvents;
+	S32 Status;
+	U16 RunHeader[RUN_HEAD_LENGTH];
+} LMIndexFileHeader;
+
+// part of the file walked by one thread while indexing, and the state of the walk where it stopped
+typedef struct {
+	LMI_t Idx;
+	S64  Pos;					// next channel header position, bytes
+	S64  End;					// stop at the first header position at or after End
+	S64  Skipped32;				// 32-bit words skipped looking for a watermark
+	U16  NumTraceBlksPrev;		// corrected trace length of the previous event
+	U16  Done;					// 1 at end of run or file, or if damaged. Nothing to index after Pos
+	S32  Status;				// 0, -2 memory allocation error, -3 damaged
+	LMIndexEntry *Entry;
+	U32  NumEvents;
+	U32  Size;					// number of entries allocated
+	pthread_t Thread;
+	U16  Started;				// 1 if Thread was started
+	S64  Released;				// streamed: mapping released up to here, bytes
+} LMIndexChunk;
+
+
+/****************************************************************
+*	LM_Index_Map function:
+*		Map (or read) a whole file into memory.
+*
+*		Return Value:
+*			pointer to the data, NULL if empty or on error
+*
+****************************************************************/
+
+static void *LM_Index_Map (
+						   S8 *filename,		// file name
+						   S64 *size,			// receives file size in bytes, -1 if file can't be opened
+						   S64 *mtime)			// receives modification time
+{
+	void *data = NULL;
+	struct stat st;
+#ifdef XIA_LINUX
+	int fd;
+
+	*size = -1;
+	fd = open(filename, O_RDONLY);
+	if(fd < 0)
+		return(NULL);
+	if(fstat(fd, &st) != 0) {
+		close(fd);
+		return(NULL);
+	}
+	*size = (S64)st.st_size;
+	*mtime = (S64)st.st_mtime;
+	if(*size > 0) {
+		data = mmap(NULL, (size_t)*size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(data == MAP_FAILED)
+			data = NULL;
+		else
+			madvise(data, (size_t)*size, MADV_WILLNEED);
+	}
+	close(fd);		// mapping stays valid
+#else
+	FILE *f;
+
+	*size = -1;
+	if(stat(filename, &st) != 0)
+		return(NULL);
+	if(!(f = fopen(filename, "rb")))
+		return(NULL);
+	*size = (S64)st.st_size;
+	*mtime = (S64)st.st_mtime;
+	if(*size > 0 && (data = malloc((size_t)*size)) != NULL) {
+		if(fread(data, 1, (size_t)*size, f) != (size_t)*size) {
+			free(data);
+			data = NULL;
+		}
+	}
+	fclose(f);
+#endif
+	return(data);
+}
+
+static void LM_Index_Unmap (void *data, S64 size)
+{
+	if(!data)
+		return;
+#ifdef XIA_LINUX
+	munmap(data, (size_t)size);
+#else
+	free(data);
+#endif
+}
+
+
+/****************************************************************
+*	LM_Index_Read function:
+*		Copy up to numWords 16-bit words from the list mode file,
+*		starting at byte position pos. Like fread, fewer words are
+*		copied at the end of the file.
+*
+*		Return Value:
+*			number of words copied
+*
+****************************************************************/
+
+U32 LM_Index_Read (
+				   LMI_t Idx,			// list mode file index
+				   S64 pos,				// position in bytes
+				   U16 *dst,			// receives data
+				   U32 numWords)		// number of words to read
+{
+	S64 avail;
+
+	if(pos < 0 || pos >= Idx->FileSize)
+		return(0);
+	avail = (Idx->FileSize - pos) / 2;
+	if((S64)numWords > avail)
+		numWords = (U32)avail;
+	memcpy(dst, Idx->Data + pos/2, (size_t)numWords * sizeof(U16));
+	return(numWords);
+}
+
+
+/****************************************************************
+*	LM_Index_Header function:
+*		Channel header of event n, with the corrections and bad event
+*		mark of the QC applied as when the index was built.
+*
+*		Return Value:
+*			ChannelHeader
+*
+****************************************************************/
+
+U16 *LM_Index_Header (
+					  LMI_t Idx,				// list mode file index
+					  U32 n,					// event number
+					  U16 *ChannelHeader)		// receives ChanHeadLen words
+{
+	LMIndexEntry *e = &Idx->Entry[n];
+
+	memcpy(ChannelHeader, Idx->Data + e->Pos/2, Idx->ChanHeadLen * sizeof(U16));
+	if(e->Flags & LM_INDEX_BAD)
+		ChannelHeader[1] |= 0x8000;			// Mark as bad event
+	ChannelHeader[2] = e->NumTraceBlks;
+	ChannelHeader[3] = e->NumTraceBlksPrev;
+	return(ChannelHeader);
+}
+
+
+/****************************************************************
+*	LM_Index_Trace function:
+*		Trace of event n, as many words as the (corrected) channel
+*		header says, limited by the end of the file and maxWords.
+*
+*		Return Value:
+*			number of words copied
+*
+****************************************************************/
+
+U32 LM_Index_Trace (
+					LMI_t Idx,				// list mode file index
+					U32 n,					// event number
+					U16 *Trace,				// receives trace
+					U32 maxWords)			// size of Trace
+{
+	LMIndexEntry *e = &Idx->Entry[n];
+	U32 numWords = (U32)e->NumTraceBlks * (U32)Idx->BlockSize;
+
+	return(LM_Index_Read(Idx, e->Pos + 2*(S64)Idx->ChanHeadLen, Trace, MIN(numWords, maxWords)));
+}
+
+
+/****************************************************************
+*	LM_Index_Next function:
+*		File position after event n, where the sequential parser
+*		left the file pointer: after the trace if the next watermark
+*		was found, else just after the channel header.
+*
+*		Return Value:
+*			position in bytes
+*
+****************************************************************/
+
+S64 LM_Index_Next (
+				   LMI_t Idx,				// list mode file index
+				   U32 n)					// event number
+{
+	LMIndexEntry *e = &Idx->Entry[n];
+	S64 pos = e->Pos + 2*(S64)Idx->ChanHeadLen;
+	S64 avail;
+	U16 rt = Idx->RunType & 0xFF0F;
+
+	if((rt == 0x400 || rt == 0x402 || rt == 0x403) && (e->Flags & LM_INDEX_NEXTWM) && e->NumTraceBlks > 0) {
+		avail = (Idx->FileSize - pos) / 2;
+		pos += 2 * MIN((S64)e->NumTraceBlks * (S64)Idx->BlockSize, avail);
+	}
+	return(pos);
+}
+
+
+/****************************************************************
+*	LM_Index_Find function:
+*		Binary search for the first event with its channel header
+*		at or after byte position pos.
+*
+*		Return Value:
+*			event number, -1 if there is none
+*
+****************************************************************/
+
+S32 LM_Index_Find (
+				   LMI_t Idx,				// list mode file index
+				   S64 pos)					// position in bytes
+{
+	U32 lo = 0, hi = Idx->NumEvents, mid;
+
+	while(lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if(Idx->Entry[mid].Pos < pos)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return((lo < Idx->NumEvents) ? (S32)lo : -1);
+}
+
+
+/****************************************************************
+*	LM_Index_Word2 function:
+*		Read 2 words at byte position pos like fread into Words:
+*		words beyond the end of the file are left unchanged.
+*
+*		Return Value:
+*			number of words read
+*
+****************************************************************/
+
+static U32 LM_Index_Word2 (LMI_t Idx, S64 pos, U16 *Words)
+{
+	return(LM_Index_Read(Idx, pos, Words, 2));
+}
+
+
+/****************************************************************
+*	LM_Index_Add function:
+*		Next free entry of a chunk, growing its list as needed.
+*
+*		Return Value:
+*			entry, NULL on memory allocation error
+*
+****************************************************************/
+
+static LMIndexEntry *LM_Index_Add (LMIndexChunk *c)
+{
+	LMIndexEntry *e;
+	U32 size;
+
+	if(c->NumEvents == c->Size) {
+		size = c->Size ? 2*c->Size : 65536;
+		if(!(e = realloc(c->Entry, size * sizeof(LMIndexEntry)))) {
+			sprintf(ErrMSG, "*ERROR* (LM_Index_Add): not enough memory for %u events", size);
+			Pixie_Print_MSG(ErrMSG,1);
+			return(NULL);
+		}
+		c->Entry = e;
+		c->Size = size;
+	}
+	return(&c->Entry[c->NumEvents++]);
+}
+
+
+/****************************************************************
+*	LM_Index_Match function:
+*		Find the event of a chunk whose channel header starts
+*		exactly at byte position pos.
+*
+*		Return Value:
+*			event number in the chunk, -1 if there is none
+*
+****************************************************************/
+
+static S32 LM_Index_Match (LMIndexChunk *c, S64 pos)
+{
+	U32 lo = 0, hi = c->NumEvents, mid;
+
+	while(lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if(c->Entry[mid].Pos < pos)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return((lo < c->NumEvents && c->Entry[lo].Pos == pos) ? (S32)lo : -1);
+}
+
+
+/****************************************************************
+*	LM_Index_Walk function:
+*		Walk the mapped list mode file event by event from c->Pos and
+*		check each channel header (watermark, checksum, channel number,
+*		trace lengths) exactly as the sequential Pixie_List_Mode_Parser
+*		did. Stops before the first header at or after c->End, or with
+*		c->Done set at the end of the run or file.
+*		If sync is given, the walk also stops after the first event
+*		that sync has indexed at the same position: from there on
+*		both walks are the same.
+*
+*		Return Value:
+*			event number in sync of that event, else -1
+*
+****************************************************************/
+
+static S32 LM_Index_Walk (
+						  LMIndexChunk *c,			// walk state, receives events
+						  LMIndexChunk *sync)		// walk of the following chunk, or NULL
+{
+	LMI_t Idx = c->Idx;
+	U16  hdr[MAX_CHAN_HEAD_LENGTH];
+	U16  Words[2] = {0};
+	U16  hit;
+	U16  ChannelNo;
+	U16  EventLengthRH;
+	U16  CHL = Idx->ChanHeadLen;
+	U16  rt = Idx->RunType & 0xFF0F;
+	U16  flags;
+	U32  CheckSumComputed, CheckSumRecorded;
+	U32  WaterMark;
+	S32  synced;
+	S64  GoodHeaderPos;
+	S64  offset16;
+	S64  traceWords;
+	BOOL nextWMfound = FALSE;
+	LMIndexEntry *e;
+
+	while (!c->Done && c->Pos < c->End) {
+
+		synced = sync ? LM_Index_Match(sync, c->Pos) : -1;
+
+		if(LM_Index_Read(Idx, c->Pos, hdr, CHL) != CHL) {
+			sprintf(ErrMSG, "*ERROR* (LM_Index_Walk): Less than a channel header remaining in file, exiting file");
+			Pixie_Print_MSG(ErrMSG,1);
+			c->Done = 1;
+			break;
+		}
+		c->Pos += 2*(S64)CHL;
+
+		// if the event pattern is all zero, exit the loop over events
+		if(hdr[0] == 0) {
+			Pixie_Log_Rec(PrintDebugMsg_QCdetail, "*ERROR* (LM_Index_Walk): Found all zero event pattern, exiting file", 0);
+			c->Done = 1;
+			break;
+		}
+
+		// for other run types, this default may be overwritten in channel error check
+		ChannelNo = (rt == 0x402) ? 0 : hdr[9];
+		EventLengthRH = (rt == 0x402) ? Idx->RunHeader[6] - 3 : 0;	// EventLengthTotal = 4x (header + TL), in blocks; so subtract 3 for actual length in runtype 0x402
+
+		/* Begin check watermark */
+		WaterMark = (U32)hdr[WATERMARKINDEX16] + (U32)hdr[WATERMARKINDEX16+1] * 65536;
+		if (WaterMark != WATERMARK) {
+			Pixie_Log_Rec(PrintDebugMsg_QCerror && c->Skipped32==0, "*ERROR* (LM_Index_Walk): Bad watermark: 0x%X, event %d", 2, WaterMark, c->NumEvents);	// if bad watermark and we did not skip in the previous cycle, it's a new error: print
+
+			c->Pos += (S64)CHL*(-2)+4;		// 2 16 bit words ahead from previous read and try again
+			c->Skipped32++;
+			if(c->Skipped32 > (MAXFIFOBLOCKS * BLOCKSIZE)/2 * 4) {		// give up if too many skips (4* the max waveform length
+				sprintf(ErrMSG, "*ERROR* (LM_Index_Walk): list file badly damaged. Event: %d", c->NumEvents);
+				Pixie_Print_MSG(ErrMSG,1);
+				c->Status = -3;
+				c->Done = 1;
+			}
+			continue;
+		}
+		if (c->Skipped32 > 0) {
+			Pixie_Log_Rec(PrintDebugMsg_QCdetail, "*DEBUG* (LM_Index_Walk): Skipped %d words before finding event %d", 2, (U32)c->Skipped32, c->NumEvents);
+			c->Skipped32=0;
+		}
+		GoodHeaderPos = c->Pos;
+		flags = 0;
+
+		/* Begin check checksums */
+		CheckSums (&CheckSumComputed, &CheckSumRecorded, hdr);
+		if (CheckSumComputed != CheckSumRecorded) {
+			Pixie_Log_Rec(PrintDebugMsg_QCerror, "*ERROR* (LM_Index_Walk): Checksums do not match. Computed: 0x%X, Recorded: 0x%X Event: %d", 3, CheckSumComputed, CheckSumRecorded, c->NumEvents);
+			hdr[1] |= 0x8000;
+			flags |= LM_INDEX_BAD | LM_INDEX_BADCS;
+		}
+
+		/* checking channel number, even if checksums are ok */
+		if(rt != 0x402) {
+			if (ChannelNo > (NUMBER_OF_CHANNELS - 1)) {
+				Pixie_Log_Rec(PrintDebugMsg_QCerror, "*ERROR* (LM_Index_Walk): wrong channel number: %hu, event %d", 2, hdr[9], c->NumEvents);
+				hdr[1] |= 0x8000;
+				flags |= LM_INDEX_BAD;
+
+				// try to recover from hit pattern
+				hit = (hdr[0] & 0x000F);
+				switch(hit)
+				{
+					case 0x2: ChannelNo = 1; break;
+					case 0x4: ChannelNo = 2; break;
+					case 0x8: ChannelNo = 3; break;
+					default:  ChannelNo = 0; break;		// 0x1, or default to zero if both header and hit are bad
+				}
+			}
+			EventLengthRH = Idx->RunHeader[8+ ChannelNo];
+		}
+
+		/* check previous trace length against known value from processing */
+		if (hdr[3] != c->NumTraceBlksPrev) {
+			Pixie_Log_Rec(PrintDebugMsg_QCerror, "*ERROR* (LM_Index_Walk): wrong previous trace size in blocks: %hu, event %d", 2, hdr[3], c->NumEvents);
+			hdr[1] |= 0x8000;
+			flags |= LM_INDEX_BAD;
+			hdr[3] = c->NumTraceBlksPrev;
+		}
+
+		/* check following trace length by looking for next watermark */
+		if (((U32)hdr[0] + (U32)hdr[1] * 65536) == EORMARK) {
+			Pixie_Log_Rec(PrintDebugMsg_QCdetail, "*DEBUG* (LM_Index_Walk): reached end of run", 0);
+			hdr[2] = 0;
+			c->Done = 1;
+		}
+		else {
+			nextWMfound = FALSE;
+			// 1. try place of next watermark per channel header
+			offset16 = (S64)hdr[2] * Idx->BlockSize + WATERMARKINDEX16;
+			if (LM_Index_Word2(Idx, GoodHeaderPos+offset16*2, Words) == 0) {
+				Pixie_Log_Rec(PrintDebugMsg_QCerror, "*DEBUG* (LM_Index_Walk): unexpected end of file", 0);
+				c->Done = 1;
+			}
+			else if (((U32)Words[0] + (U32)Words[1]*65536) == WATERMARK)
+				nextWMfound = TRUE;
+
+			// 2. try zero (some special code may suppress traces)
+			if (!nextWMfound) {
+				offset16 = WATERMARKINDEX16;
+				if (LM_Index_Word2(Idx, GoodHeaderPos+offset16*2, Words) == 0) {
+					Pixie_Log_Rec(PrintDebugMsg_QCerror, "*DEBUG* (LM_Index_Walk): unexpected end of file", 0);
+					c->Done = 1;
+				}
+				else if (((U32)Words[0] + (U32)Words[1]*65536) == WATERMARK)
+					nextWMfound = TRUE;
+			}
+
+			// 3. try using file header value (assumes ChannelNo is correct. Make sure it's at least in range)
+			if (!nextWMfound) {
+				if( (ChannelNo < NUMBER_OF_CHANNELS) && (EventLengthRH>0) && (EventLengthRH<MAXFIFOBLOCKS+1) ) {
+					offset16 = (S64)(EventLengthRH -1) * Idx->BlockSize + WATERMARKINDEX16;	 //RunHeader 8-11 have event size in blocks (header+trace)
+					if (LM_Index_Word2(Idx, GoodHeaderPos+offset16*2, Words) == 0) {
+						Pixie_Log_Rec(PrintDebugMsg_QCerror, "*DEBUG* (LM_Index_Walk): unexpected end of file", 0);
+						c->Done = 1;
+					}
+					else if (((U32)Words[0] + (U32)Words[1]*65536) == WATERMARK)
+						nextWMfound = TRUE;
+				}
+			}
+
+			// no point finding true value now. Just use file header value for processing below.
+			// But advance only by channel header (not trace), so next cycle starts looking for watermark
+			if(!nextWMfound) {
+				hdr[1] |= 0x8000;
+				flags |= LM_INDEX_BAD | LM_INDEX_BADTL;
+				Pixie_Log_Rec(PrintDebugMsg_QCerror, "*ERROR* (LM_Index_Walk): wrong following trace size in blocks: %hu, event %d", 2, hdr[2], c->NumEvents);
+			}
+			hdr[2] = (U16)(offset16  - (S64)WATERMARKINDEX16) / Idx->BlockSize;	// update trace blocks to follow
+			hdr[2] = MIN(hdr[2], Idx->RunHeader[6]);
+			c->NumTraceBlksPrev = hdr[2];
+		}
+
+		/* skip trace if it is run 0x400, 0x402, or 0x403 and the next watermark is where it should be */
+		if ((rt == 0x400 || rt == 0x402 || rt == 0x403) && nextWMfound && hdr[2] > 0) {
+			traceWords = MIN((S64)Idx->BlockSize * (S64)hdr[2], (Idx->FileSize - GoodHeaderPos) / 2);
+			c->Pos = GoodHeaderPos + 2*traceWords;
+		}
+		else
+			c->Pos = GoodHeaderPos;
+
+		/* add to index */
+		if(!(e = LM_Index_Add(c))) {
+			c->Status = -2;
+			c->Done = 1;
+			break;
+		}
+		e->Pos = GoodHeaderPos - 2*(S64)CHL;
+		if(rt == 0x402)
+			e->TimeStamp = ((U64)hdr[4] << 32) + ((U64)hdr[27] << 16) + (U64)hdr[26];
+		else
+			e->TimeStamp = ((U64)hdr[6] << 32) + ((U64)hdr[5] << 16) + (U64)hdr[4];
+		e->ChanNo = ChannelNo;
+		e->NumTraceBlks = hdr[2];
+		e->NumTraceBlksPrev = hdr[3];
+		e->Flags = flags | (nextWMfound ? LM_INDEX_NEXTWM : 0);
+
+		if(synced >= 0)
+			return(synced);
+	}
+
+	return(-1);
+}
+
+
+/****************************************************************
+*	LM_Index_Resync function:
+*		Move the start of a chunk to the first channel header at or
+*		after c->Pos with a valid watermark and checksum.
+*
+****************************************************************/
+
+static void LM_Index_Resync (LMIndexChunk *c)
+{
+	LMI_t Idx = c->Idx;
+	U16 *hdr;
+	U32 Computed, Recorded;
+	S64 last = Idx->FileSize - 2*(S64)Idx->ChanHeadLen;	// last position with a complete header
+
+	for( ; c->Pos < c->End && c->Pos <= last; c->Pos += 2) {
+		hdr = Idx->Data + c->Pos/2;
+		if(hdr[0] == 0 || ((U32)hdr[WATERMARKINDEX16] + (U32)hdr[WATERMARKINDEX16+1]*65536) != WATERMARK)
+			continue;
+		CheckSums (&Computed, &Recorded, hdr);
+		if(Computed == Recorded)
+			return;
+	}
+	c->Pos = c->End;		// nothing found, the walk of the previous chunk covers this one
+}
+
+static void *LM_Index_Chunk_Thread (void *arg)
+{
+	LMIndexChunk *c = (LMIndexChunk *)arg;
+
+	LM_Index_Resync(c);
+	LM_Index_Walk(c, NULL);
+	return(NULL);
+}
+
+
+/****************************************************************
+*	LM_Index_Build function:
+*		Index the mapped list mode file. Large files are split into
+*		LMParseThreads chunks (0: one per CPU). Each chunk is resynced
+*		on the first valid watermark and checksum and walked by its own
+*		thread. The chunks are then joined in file order: the walk of
+*		one chunk continues until it meets an event of the next, so the
+*		result is the same as for a single walk over the whole file.
+*
+*		Return Value:
+*			 0 - success
+*			-2 - memory allocation error
+*			-3 - invalid data in file. Events up to the damage are indexed
+*
+****************************************************************/
+
+static S32 LM_Index_Build (LMI_t Idx)
+{
+	LMIndexChunk *chunk, *cur, *next;
+	LMIndexEntry *e;
+	U32 numChunks, k, i;
+	S32 synced;
+	S64 first = RUN_HEAD_LENGTH*2;		// just after the run header
+	S64 len = MAX(Idx->FileSize - first, 0);
+
+	numChunks = LMParseThreads;
+	if(numChunks == 0) {
+#ifdef XIA_LINUX
+		numChunks = (U32)MAX(sysconf(_SC_NPROCESSORS_ONLN), 1);
+#else
+		numChunks = 1;
+#endif
+	}
+	numChunks = (U32)MIN((S64)numChunks, len / LM_INDEX_CHUNK_MIN);
+	numChunks = MAX(numChunks, 1);
+
+	if(!(chunk = calloc(numChunks, sizeof(LMIndexChunk)))) {
+		sprintf(ErrMSG, "*ERROR* (LM_Index_Build): not enough memory for %u chunks", numChunks);
+		Pixie_Print_MSG(ErrMSG,1);
+		return(-2);
+	}
+	for(k = 0; k < numChunks; k++) {
+		chunk[k].Idx = Idx;
+		chunk[k].Pos = (first + len * k / numChunks) & ~(S64)1;			// chunk boundaries on 16-bit words
+		chunk[k].End = (k == numChunks-1) ? Idx->FileSize + 1 : (first + len * (k+1) / numChunks) & ~(S64)1;
+	}
+	for(k = 1; k < numChunks; k++) {
+		if(pthread_create(&chunk[k].Thread, NULL, LM_Index_Chunk_Thread, &chunk[k]) == 0)
+			chunk[k].Started = 1;
+		else
+			chunk[k].Pos = chunk[k].End;		// not walked, covered when joining
+	}
+	LM_Index_Walk(&chunk[0], NULL);
+	for(k = 1; k < numChunks; k++)
+		if(chunk[k].Started)
+			pthread_join(chunk[k].Thread, NULL);
+
+	/* join the chunks in file order */
+	cur = &chunk[0];
+	for(k = 1; k < numChunks; k++) {
+		next = &chunk[k];
+		if(cur->Done || next->Status == -2)
+			break;
+		cur->End = next->Pos;				// where the walk of the next chunk stopped
+		synced = LM_Index_Walk(cur, next);
+		if(synced < 0)
+			continue;						// walked through the next chunk on its own
+		for(i = (U32)synced + 1; i < next->NumEvents; i++) {
+			if(!(e = LM_Index_Add(cur))) {
+				cur->Status = -2;
+				break;
+			}
+			*e = next->Entry[i];
+		}
+		if(cur->Status == -2)
+			break;
+		cur->Pos              = next->Pos;
+		cur->Skipped32        = next->Skipped32;
+		cur->NumTraceBlksPrev = next->NumTraceBlksPrev;
+		cur->Done             = next->Done;
+		cur->Status           = next->Status;
+	}
+	if(cur->Status != -2 && !cur->Done) {
+		cur->End = Idx->FileSize + 1;
+		LM_Index_Walk(cur, NULL);
+	}
+	for(k = 1; k < numChunks; k++) {
+		if(chunk[k].Status == -2)
+			cur->Status = -2;
+		free(chunk[k].Entry);
+	}
+
+	Idx->Entry = cur->Entry;
+	Idx->NumEvents = cur->NumEvents;
+	Idx->Status = cur->Status;
+	Idx->BadEvents = 0;
+	for(i = 0; i < Idx->NumEvents; i++)
+		Idx->BadEvents += ((Idx->Entry[i].Flags & LM_INDEX_BADCS) ? 1 : 0) + ((Idx->Entry[i].Flags & LM_INDEX_BADTL) ? 1 : 0);
+	free(chunk);
+
+	sprintf(ErrMSG, "*DEBUG* (LM_Index_Build): %u events, %u chunks", Idx->NumEvents, numChunks);
+	Pixie_Print_MSG(ErrMSG,PrintDebugMsg_other);
+	return(Idx->Status);
+}
+
+
+/****************************************************************
+*	LM_Index_Load function:
+*		Map the sidecar index file if it belongs to the list mode
+*		file as it is now.
+*
+*		Return Value:
+*			 0 - success
+*			-1 - no (valid) index file
+*
+****************************************************************/
+
+static S32 LM_Index_Load (LMI_t Idx, S8 *idxname)
+{
+	S64 size, mtime;
+	LMIndexFileHeader *h;
+
+	h = LM_Index_Map(idxname, &size, &mtime);
+	if(!h)
+		return(-1);
+	if(   size < (S64)sizeof(LMIndexFileHeader)
+	   || memcmp(h->Magic, LM_INDEX_MAGIC, sizeof(h->Magic)) != 0
+	   || h->EntrySize != sizeof(LMIndexEntry)
+	   || size != (S64)sizeof(LMIndexFileHeader) + (S64)h->NumEvents * (S64)sizeof(LMIndexEntry)
+	   || h->FileSize != Idx->FileSize
+	   || h->FileTime != Idx->FileTime
+	   || memcmp(h->RunHeader, Idx->RunHeader, sizeof(Idx->RunHeader)) != 0 ) {
+		LM_Index_Unmap(h, size);
+		return(-1);
+	}
+	Idx->Sidecar = h;
+	Idx->SidecarSize = size;
+	Idx->Entry = (LMIndexEntry *)(h + 1);
+	Idx->NumEvents = h->NumEvents;
+	Idx->BadEvents = h->BadEvents;
+	Idx->Status = h->Status;
+	return(0);
+}
+
+
+/****************************************************************
+*	LM_Index_Save function:
+*		Write the index to the sidecar file. Failure is not an error,
+*		the index is just built again next time.
+*
+****************************************************************/
+
+static void LM_Index_Save (LMI_t Idx, S8 *idxname)
+{
+	LMIndexFileHeader h;
+	FILE *f;
+	BOOL ok;
+
+	memset(&h, 0, sizeof(h));
+	memcpy(h.Magic, LM_INDEX_MAGIC, sizeof(h.Magic));
+	h.EntrySize = sizeof(LMIndexEntry);
+	h.NumEvents = Idx->NumEvents;
+	h.FileSize  = Idx->FileSize;
+	h.FileTime  = Idx->FileTime;
+	h.BadEvents = Idx->BadEvents;
+	h.Status    = Idx->Status;
+	memcpy(h.RunHeader, Idx->RunHeader, sizeof(h.RunHeader));
+
+	if(!(f = fopen(idxname, "wb"))) {
+		sprintf(ErrMSG, "*DEBUG* (LM_Index_Save): can't create index file %s", idxname);
+		Pixie_Print_MSG(ErrMSG,PrintDebugMsg_other);
+		return;
+	}
+	ok = (fwrite(&h, sizeof(h), 1, f) == 1);
+	if(ok && Idx->NumEvents > 0)
+		ok = (fwrite(Idx->Entry, sizeof(LMIndexEntry), Idx->NumEvents, f) == Idx->NumEvents);
+	if(fclose(f) != 0)
+		ok = FALSE;
+	if(!ok) {
+		remove(idxname);		// never leave a truncated index behind
+		sprintf(ErrMSG, "*DEBUG* (LM_Index_Save): can't write index file %s", idxname);
+		Pixie_Print_MSG(ErrMSG,PrintDebugMsg_other);
+	}
+}
+
+
+/****************************************************************
+*	LM_Index_Map_File function:
+*		Map a list mode file and check its run header. The
+*		index has no events yet.
+*
+*		Return Value:
+*			 0 - success
+*			-1 - can't open list mode data file
+*			-2 - memory allocation error
+*			-3 - invalid run header
+*			-5 - invalid run type in file
+*
+****************************************************************/
+
+static S32 LM_Index_Map_File (
+							  S8 *filename,			// list mode file name
+							  LMI_t *pIdx)			// receives index
+{
+	LMI_t Idx;
+
+	*pIdx = NULL;
+	if(!(Idx = calloc(1, sizeof(*Idx)))) {
+		sprintf(ErrMSG, "*ERROR* (LM_Index_Open): not enough memory for index");
+		Pixie_Print_MSG(ErrMSG,1);
+		return(-2);
+	}
+
+	Idx->Data = LM_Index_Map(filename, &Idx->FileSize, &Idx->FileTime);
+	if(Idx->FileSize < 0 || (Idx->FileSize > 0 && !Idx->Data)) {
+		sprintf(ErrMSG, "*ERROR* (LM_Index_Open): can't open list mode data file %s", filename);
+		Pixie_Print_MSG(ErrMSG,1);
+		free(Idx);
+		return(-1);
+	}
+
+	/* Run header. Missing words of a short file read as zero */
+	LM_Index_Read(Idx, 0, Idx->RunHeader, RUN_HEAD_LENGTH);
+	Idx->BlockSize   = Idx->RunHeader[0];
+	Idx->RunType     = Idx->RunHeader[2];
+	Idx->ChanHeadLen = Idx->RunHeader[3];
+	if (Idx->RunType < 0x400 || Idx->RunType > 0x4F3) {
+		sprintf(ErrMSG, "*ERROR* (LM_Index_Open): wrong run type 0x%x", Idx->RunType);
+		Pixie_Print_MSG(ErrMSG,1);
+		LM_Index_Close(Idx);
+		return(-5);
+	}
+	if (   Idx->ChanHeadLen < WATERMARKINDEX16+2 || Idx->ChanHeadLen > MAX_CHAN_HEAD_LENGTH
+		|| Idx->BlockSize == 0 ) {
+		sprintf(ErrMSG, "*ERROR* (LM_Index_Open): invalid run header, block size %hu, channel header length %hu", Idx->BlockSize, Idx->ChanHeadLen);
+		Pixie_Print_MSG(ErrMSG,1);
+		LM_Index_Close(Idx);
+		return(-3);
+	}
+	*pIdx = Idx;
+	return(0);
+}
+
+
+/****************************************************************
+*	LM_Index_Open function:
+*		Map a list mode file and get its event index, from the
+*		sidecar file if it is up to date, else by walking the file.
+*
+*		Return Value:
+*			 0 - success
+*			-1 - can't open list mode data file
+*			-2 - memory allocation error
+*			-3 - no valid watermark found or other invalid data in file.
+*			     The index holds the events before the damage.
+*			-5 - invalid run type in file
+*		Except for -3, *pIdx is NULL on error.
+*
+****************************************************************/
+
+S32 LM_Index_Open (
+				   S8 *filename,			// list mode file name
+				   LMI_t *pIdx)				// receives index, to be released with LM_Index_Close
+{
+	LMI_t Idx;
+	S8 *idxname;
+	S32 retval;
+
+	retval = LM_Index_Map_File(filename, pIdx);
+	if(!(Idx = *pIdx))
+		return(retval);
+	*pIdx = NULL;
+
+	if(!(idxname = malloc(strlen(filename) + sizeof(LM_INDEX_SUFFIX)))) {
+		sprintf(ErrMSG, "*ERROR* (LM_Index_Open): not enough memory for index file name");
+		Pixie_Print_MSG(ErrMSG,1);
+		LM_Index_Close(Idx);
+		return(-2);
+	}
+	sprintf(idxname, "%s%s", filename, LM_INDEX_SUFFIX);
+
+	if(LM_Index_Load(Idx, idxname) == 0) {
+		sprintf(ErrMSG, "*INFO* (LM_Index_Open): %u events from index file %s", Idx->NumEvents, idxname);
+		Pixie_Print_MSG(ErrMSG,PrintDebugMsg_other);
+		retval = Idx->Status;
+	}
+	else {
+#ifdef XIA_LINUX
+		if(Idx->Data)
+			madvise(Idx->Data, (size_t)Idx->FileSize, MADV_SEQUENTIAL);
+#endif
+		retval = LM_Index_Build(Idx);
+		if(retval == -2) {
+			free(idxname);
+			LM_Index_Close(Idx);
+			return(-2);
+		}
+		LM_Index_Save(Idx, idxname);
+		sprintf(ErrMSG, "*INFO* (LM_Index_Open): indexed %u events, %u bad", Idx->NumEvents, Idx->BadEvents);
+		Pixie_Print_MSG(ErrMSG,PrintDebugMsg_other);
+	}
+	free(idxname);
+	*pIdx = Idx;
+	return(retval);
+}
+
+
+/****************************************************************
+*	LM_Index_Close function:
+*		Release the mapped list mode file and the index.
+*
+****************************************************************/
+
+void LM_Index_Close (
+					 LMI_t Idx)				// list mode file index
+{
+	if(!Idx)
+		return;
+	LM_Index_Unmap(Idx->Data, Idx->FileSize);
+	if(Idx->Sidecar)
+		LM_Index_Unmap(Idx->Sidecar, Idx->SidecarSize);
+	else
+		free(Idx->Entry);
+	free(Idx->Stream);
+	free(Idx);
+}
+
+
+/****************************************************************
+*	LM_Index_Stream_Open function:
+*		Map a list mode file for streaming. The index starts
+*		empty; LM_Index_Stream_Next fills it with the events of
+*		the next part of the file. The sidecar index is neither
+*		used nor written.
+*
+*		Return Value:
+*			 0 - success
+*			-1 - can't open list mode data file
+*			-2 - memory allocation error
+*			-3 - invalid run header
+*			-5 - invalid run type in file
+*
+****************************************************************/
+
+S32 LM_Index_Stream_Open (
+						  S8 *filename,			// list mode file name
+						  LMI_t *pIdx)			// receives index, to be released with LM_Index_Close
+{
+	LMIndexChunk *c;
+	S32 retval;
+
+	retval = LM_Index_Map_File(filename, pIdx);
+	if(retval < 0)
+		return(retval);
+	if(!(c = calloc(1, sizeof(LMIndexChunk)))) {
+		sprintf(ErrMSG, "*ERROR* (LM_Index_Stream_Open): not enough memory for index");
+		Pixie_Print_MSG(ErrMSG,1);
+		LM_Index_Close(*pIdx);
+		*pIdx = NULL;
+		return(-2);
+	}
+	c->Idx = *pIdx;
+	c->Pos = RUN_HEAD_LENGTH*2;
+	c->Released = 0;
+	(*pIdx)->Stream = c;
+#ifdef XIA_LINUX
+	if((*pIdx)->Data)
+		madvise((*pIdx)->Data, (size_t)(*pIdx)->FileSize, MADV_SEQUENTIAL);
+#endif
+	return(0);
+}
+
+
+/****************************************************************
+*	LM_Index_Stream_Next function:
+*		Replace the events of a streamed index with those of the
+*		next readAhead bytes of the file (or more, until at least
+*		one event is found). Idx->First is the event number in the
+*		file of Idx->Entry[0]. Pages of the mapped file before the
+*		new window are released, so traces of earlier events should
+*		be read before the call.
+*
+*		Return Value:
+*			number of events in the window, 0 at the end of the file,
+*			-2 on memory allocation error, -3 if the rest of the file
+*			is damaged
+*
+****************************************************************/
+
+S32 LM_Index_Stream_Next (
+						  LMI_t Idx,			// list mode file index, from LM_Index_Stream_Open
+						  S64 readAhead)		// size of the window in bytes
+{
+	LMIndexChunk *c = (LMIndexChunk *)Idx->Stream;
+	U32 i;
+#ifdef XIA_LINUX
+	S64 page = (S64)sysconf(_SC_PAGESIZE);
+	S64 release = c->Pos / page * page;
+
+	if(Idx->Data && release > c->Released) {
+		madvise((U8 *)Idx->Data + c->Released, (size_t)(release - c->Released), MADV_DONTNEED);
+		c->Released = release;
+	}
+#endif
+
+	Idx->First += Idx->NumEvents;
+	c->NumEvents = 0;
+	while(c->NumEvents == 0 && !c->Done) {
+		c->End = c->Pos + MAX(readAhead, 2*(S64)Idx->ChanHeadLen);
+		LM_Index_Walk(c, NULL);
+	}
+	Idx->Entry = c->Entry;
+	Idx->NumEvents = c->NumEvents;
+	Idx->Status = c->Status;
+	for(i = 0; i < c->NumEvents; i++)
+		Idx->BadEvents += ((c->Entry[i].Flags & LM_INDEX_BADCS) ? 1 : 0) + ((c->Entry[i].Flags & LM_INDEX_BADTL) ? 1 : 0);
+
+	return((c->NumEvents > 0) ? (S32)c->NumEvents : c->Status);
+}
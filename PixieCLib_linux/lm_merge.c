@@ -0,0 +1,439 @@
+/*----------------------------------------------------------------------
+* Copyright (c) 2004, 2009, 2015 XIA LLC
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms,
+* with or without modification, are permitted provided
+* that the following conditions are met:
+*
+*   * Redistributions of source code must retain the above
+*     copyright notice, this list of conditions and the
+*     following disclaimer.
+*   * Redistributions in binary form must reproduce the
+*     above copyright notice, this list of conditions and the
+*     following disclaimer in the documentation and/or other
+*     materials provided with the distribution.
+*   * Neither the name of XIA LLC
+*     nor the names of its contributors may be used to endorse
+*     or promote products derived from this software without
+*     specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+* CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+* INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+* ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+* TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+* THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+* SUCH DAMAGE.
+*----------------------------------------------------------------------*/
+
+/******************************************************************************
+*
+* File name:
+*
+*      lm_merge.c
+*
+* Description:
+*
+*      Time ordered merge of the list mode files of several modules
+*      (<base>.b00, <base>.b01, ...). Each file is streamed through a window
+*      of its event index (LM_Index_Stream_Next); a min-heap over the 48-bit
+*      time stamps of the next event of every file picks the earliest one.
+*      Memory use is set by the number of files and the read-ahead window,
+*      not by the size of the files.
+*      The events of each file are expected in time order, as the module
+*      writes them; an event out of order in its file is passed on in file
+*      order. Events with the same time stamp come in order of the files.
+*
+* Member functions:
+*					LM_Merge_Open()				- open the files, index the first window of each
+*					LM_Merge_Next()				- next event in time
+*					LM_Merge_Trace()			- trace of an event
+*					LM_Merge_Status()			- event counts and QC status so far
+*					LM_Merge_Close()			- close the files
+*					LM_Merge_Write()			- task 0x7050: columnar file of the merged events
+*
+******************************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "PlxTypes.h"
+#include "PciTypes.h"
+#include "Plx.h"
+
+#include "reader.h"
+
+#define LM_MERGE_READAHEAD		(4*1024*1024)	// bytes indexed ahead in each file for task 0x7050
+
+struct LMMergeStruct {
+	U16    NumFiles;
+	LMI_t  *Idx;				// streamed index of each file
+	U32    *Next;				// next event of each file, in its index window
+	U16    *Heap;				// files with events left, min-heap on the time of their next event
+	U16    HeapSize;
+	S64    ReadAhead;			// bytes
+	S32    Status;				// 0, or the first error of a file: -2, -3
+};
+
+
+/****************************************************************
+*	LM_Merge_Before function:
+*		Order of the next events of files a and b: by time stamp,
+*		then by file.
+*
+*		Return Value:
+*			TRUE if the event of file a comes first
+*
+****************************************************************/
+
+static BOOL LM_Merge_Before (LMM_t M, U16 a, U16 b)
+{
+	U64 ta = M->Idx[a]->Entry[M->Next[a]].TimeStamp;
+	U64 tb = M->Idx[b]->Entry[M->Next[b]].TimeStamp;
+
+	return((ta < tb) || (ta == tb && a < b));
+}
+
+
+/****************************************************************
+*	LM_Merge_Down function:
+*		Move heap element i down to its place.
+*
+****************************************************************/
+
+static void LM_Merge_Down (LMM_t M, U16 i)
+{
+	U16 child, f = M->Heap[i];
+
+	while((child = 2*i + 1) < M->HeapSize) {
+		if(child + 1 < M->HeapSize && LM_Merge_Before(M, M->Heap[child+1], M->Heap[child]))
+			child++;
+		if(!LM_Merge_Before(M, M->Heap[child], f))
+			break;
+		M->Heap[i] = M->Heap[child];
+		i = child;
+	}
+	M->Heap[i] = f;
+}
+
+
+/****************************************************************
+*	LM_Merge_Open function:
+*		Open the list mode files for streaming and index the
+*		first readAhead bytes of each. A file damaged at the
+*		start (-3) or without events just does not contribute.
+*
+*		Return Value:
+*			 0 - success
+*			-1 - can't open list mode data file
+*			-2 - memory allocation error
+*			-3 - invalid run header
+*			-5 - invalid run type in file
+*
+****************************************************************/
+
+S32 LM_Merge_Open (
+				   S8 **filenames,			// list mode files, one per module
+				   U16 NumFiles,			// number of files
+				   S64 readAhead,			// bytes indexed ahead in each file
+				   LMM_t *pMerge)			// receives merge state, to be released with LM_Merge_Close
+{
+	LMM_t M;
+	S32 retval;
+	U16 f;
+	S32 i;
+
+	*pMerge = NULL;
+	if(   !(M = calloc(1, sizeof(*M))) 
+	   || !(M->Idx  = calloc(MAX(NumFiles, 1), sizeof(LMI_t))) 
+	   || !(M->Next = calloc(MAX(NumFiles, 1), sizeof(U32))) 
+	   || !(M->Heap = calloc(MAX(NumFiles, 1), sizeof(U16))) ) {
+		sprintf(ErrMSG, "*ERROR* (LM_Merge_Open): not enough memory for %hu files", NumFiles);
+		Pixie_Print_MSG(ErrMSG,1);
+		LM_Merge_Close(M);
+		return(-2);
+	}
+	M->NumFiles = NumFiles;
+	M->ReadAhead = readAhead;
+
+	for(f = 0; f < NumFiles; f++) {
+		retval = LM_Index_Stream_Open(filenames[f], &M->Idx[f]);
+		if(retval < 0) {
+			LM_Merge_Close(M);
+			return(retval);
+		}
+		retval = LM_Index_Stream_Next(M->Idx[f], M->ReadAhead);
+		if(retval > 0)
+			M->Heap[M->HeapSize++] = f;
+		else if(retval < 0) {
+			sprintf(ErrMSG, "*ERROR* (LM_Merge_Open): no events in %s", filenames[f]);
+			Pixie_Print_MSG(ErrMSG,1);
+			if(M->Status == 0)
+				M->Status = retval;
+			if(retval == -2) {
+				LM_Merge_Close(M);
+				return(-2);
+			}
+		}
+	}
+	for(i = (S32)M->HeapSize/2 - 1; i >= 0; i--)
+		LM_Merge_Down(M, (U16)i);
+
+	*pMerge = M;
+	return(0);
+}
+
+
+/****************************************************************
+*	LM_Merge_Next function:
+*		Take the earliest event of all files. The next window of
+*		its file is indexed when the current one is used up.
+*
+*		Return Value:
+*			 1 - event returned
+*			 0 - no more events
+*			-2 - memory allocation error
+*
+****************************************************************/
+
+S32 LM_Merge_Next (
+				   LMM_t M,					// merge state
+				   LMMergeEvent *Event)		// receives the next event in time
+{
+	LMI_t Idx;
+	LMIndexEntry *e;
+	U16 f;
+	S32 retval;
+
+	if(M->HeapSize == 0)
+		return(0);
+	f = M->Heap[0];
+	Idx = M->Idx[f];
+	e = &Idx->Entry[M->Next[f]];
+
+	LM_Index_Header(Idx, M->Next[f], Event->Header);
+	Event->TimeStamp = e->TimeStamp;
+	Event->Pos       = e->Pos;
+	Event->EventNum  = Idx->First + M->Next[f];
+	Event->File      = f;
+	Event->ModNum    = Idx->RunHeader[1];
+	Event->RunType   = Idx->RunType;
+	Event->ChanNo    = e->ChanNo;
+	Event->Flags     = e->Flags;
+
+	if(++M->Next[f] == Idx->NumEvents) {
+		M->Next[f] = 0;
+		retval = LM_Index_Stream_Next(Idx, M->ReadAhead);
+		if(retval <= 0) {			// file done
+			if(retval < 0 && M->Status == 0)
+				M->Status = retval;
+			M->Heap[0] = M->Heap[--M->HeapSize];
+		}
+	}
+	if(M->HeapSize > 0)
+		LM_Merge_Down(M, 0);
+
+	return((M->Status == -2) ? -2 : 1);
+}
+
+
+/****************************************************************
+*	LM_Merge_Trace function:
+*		Trace of an event returned by LM_Merge_Next, as many words
+*		as its (corrected) channel header says.
+*
+*		Return Value:
+*			number of words copied
+*
+****************************************************************/
+
+U32 LM_Merge_Trace (
+					LMM_t M,				// merge state
+					LMMergeEvent *Event,	// event from LM_Merge_Next
+					U16 *Trace,				// receives trace
+					U32 maxWords)			// size of Trace
+{
+	LMI_t Idx = M->Idx[Event->File];
+	U32 numWords = (U32)Event->Header[2] * (U32)Idx->BlockSize;
+
+	return(LM_Index_Read(Idx, Event->Pos + 2*(S64)Idx->ChanHeadLen, Trace, MIN(numWords, maxWords)));
+}
+
+
+/****************************************************************
+*	LM_Merge_Status function:
+*		Events and bad events of all files indexed so far.
+*
+*		Return Value:
+*			 0 - no errors
+*			-2 - memory allocation error
+*			-3 - a file is damaged, its events before the damage are merged
+*
+****************************************************************/
+
+S32 LM_Merge_Status (
+					 LMM_t M,				// merge state
+					 U32 *NumEvents,		// receives events of all files so far
+					 U32 *BadEvents)		// receives bad events of all files so far
+{
+	U16 f;
+
+	*NumEvents = 0;
+	*BadEvents = 0;
+	for(f = 0; f < M->NumFiles; f++) {
+		*NumEvents += M->Idx[f]->First + M->Idx[f]->NumEvents;
+		*BadEvents += M->Idx[f]->BadEvents;
+	}
+	return(M->Status);
+}
+
+
+/****************************************************************
+*	LM_Merge_Close function:
+*		Close the files and release the merge state.
+*
+****************************************************************/
+
+void LM_Merge_Close (
+					 LMM_t M)				// merge state
+{
+	U16 f;
+
+	if(!M)
+		return;
+	if(M->Idx) {
+		for(f = 0; f < M->NumFiles; f++)
+			LM_Index_Close(M->Idx[f]);
+	}
+	free(M->Idx);
+	free(M->Next);
+	free(M->Heap);
+	free(M);
+}
+
+
+/****************************************************************
+*	LM_Merge_Write function:
+*		Task 0x7050: merge the list mode files of all modules of
+*		a run in time order and write them as one columnar file
+*		<base>.lmc (see lm_columns.c). filename is the file of
+*		any module, <base>.b##; all existing files <base>.b00 to
+*		<base>.b(PRESET_MAX_MODULES-1) are merged. They must be
+*		of the same run type.
+*		UserData[0] receives the number of rows written,
+*		UserData[1] the number of events, UserData[2] the number
+*		of bad events, UserData[3] the number of files merged.
+*
+*		Return Value:
+*			 0 - success
+*			-1 - can't open list mode data file or output file, write error
+*			-2 - memory allocation error
+*			-3 - invalid data in a file. Its events up to the damage are merged
+*			-4 - invalid data pointer for return data
+*			-5 - invalid run type in file, or files of different run types
+*
+****************************************************************/
+
+S32 LM_Merge_Write (
+					S8 *filename,			// list mode file of one of the modules
+					U32 *UserData)			// receives number of rows, events, bad events and files
+{
+	LMM_t M = NULL;
+	LMC_t Out = NULL;
+	LMColumnsHeader Info;
+	LMMergeEvent Event;
+	S8 *base, *dot;
+	S8 *names[PRESET_MAX_MODULES];
+	FILE *f;
+	U64 rows = 0;
+	U32 NumEvents, BadEvents;
+	U16 k, NumFiles = 0;
+	S32 retval;
+
+	if(!UserData) {
+		sprintf(ErrMSG, "*ERROR* (LM_Merge_Write): NULL pointer *UserData");
+		Pixie_Print_MSG(ErrMSG,1);
+		return(-4);
+	}
+
+	/* Files of all modules: <base>.b00, <base>.b01, ... */
+	if(!(base = malloc(strlen(filename) + 8))) {
+		sprintf(ErrMSG, "*ERROR* (LM_Merge_Write): not enough memory for file names");
+		Pixie_Print_MSG(ErrMSG,1);
+		return(-2);
+	}
+	strcpy(base, filename);
+	if((dot = strrchr(base, '.')) != NULL)
+		*dot = '\0';
+	for(k = 0; k < PRESET_MAX_MODULES; k++) {
+		if(!(names[NumFiles] = malloc(strlen(base) + 8)))
+			break;
+		sprintf(names[NumFiles], "%s.b%02hu", base, k);
+		if((f = fopen(names[NumFiles], "rb")) != NULL) {
+			fclose(f);
+			NumFiles++;
+		}
+		else
+			free(names[NumFiles]);
+	}
+	if(k < PRESET_MAX_MODULES || NumFiles == 0) {
+		sprintf(ErrMSG, "*ERROR* (LM_Merge_Write): no list mode files %s.b##", base);
+		Pixie_Print_MSG(ErrMSG,1);
+		retval = (k < PRESET_MAX_MODULES) ? -2 : -1;
+		goto done;
+	}
+
+	retval = LM_Merge_Open(names, NumFiles, LM_MERGE_READAHEAD, &M);
+	if(retval < 0)
+		goto done;
+	for(k = 1; k < NumFiles; k++) {
+		if((M->Idx[k]->RunType & 0xFF0F) != (M->Idx[0]->RunType & 0xFF0F)) {
+			sprintf(ErrMSG, "*ERROR* (LM_Merge_Write): run type 0x%x of %s differs from 0x%x of %s", M->Idx[k]->RunType, names[k], M->Idx[0]->RunType, names[0]);
+			Pixie_Print_MSG(ErrMSG,1);
+			retval = -5;
+			goto done;
+		}
+	}
+
+	memset(&Info, 0, sizeof(Info));
+	Info.ModNum    = 0xFFFF;		// several modules, see module column
+	Info.RunType   = M->Idx[0]->RunType;
+	Info.BlockSize = M->Idx[0]->BlockSize;
+	sprintf(base + strlen(base), ".lmc");
+	retval = LM_Columns_Create(base, &Info, 0, &Out);
+	if(retval < 0)
+		goto done;
+
+	while((retval = LM_Merge_Next(M, &Event)) > 0) {
+		if(LM_Columns_Event(Out, Event.EventNum, Event.ModNum, Event.ChanNo, Event.TimeStamp, Event.Header) < 0)
+			break;
+	}
+	if(retval == 0)
+		retval = LM_Merge_Status(M, &NumEvents, &BadEvents);
+	else
+		LM_Merge_Status(M, &NumEvents, &BadEvents);
+	if(LM_Columns_Close(Out, NumEvents, BadEvents, &rows) < 0)
+		retval = -1;
+
+	sprintf(ErrMSG, "*INFO* (LM_Merge_Write): merged %u events of %hu files", NumEvents, NumFiles);
+	Pixie_Print_MSG(ErrMSG,PrintDebugMsg_other);
+	UserData[0] = (U32)rows;
+	UserData[1] = NumEvents;
+	UserData[2] = BadEvents;
+	UserData[3] = NumFiles;
+
+done:
+	LM_Merge_Close(M);
+	for(k = 0; k < NumFiles; k++)
+		free(names[k]);
+	free(base);
+	return(retval);
+}
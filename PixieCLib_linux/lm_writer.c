@@ -0,0 +1,656 @@
+/*----------------------------------------------------------------------
+* Copyright (c) 2004, 2009, 2015 XIA LLC
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, 
+* with or without modification, are permitted provided 
+* that the following conditions are met:
+*
+*   * Redistributions of source code must retain the above 
+*     copyright notice, this list of conditions and the 
+*     following disclaimer.
+*   * Redistributions in binary form must reproduce the 
+*     above copyright notice, this list of conditions and the 
+*     following disclaimer in the documentation and/or other 
+*     materials provided with the distribution.
+*   * Neither the name of XIA LLC
+*     nor the names of its contributors may be used to endorse 
+*     or promote products derived from this software without 
+*     specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND 
+* CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+* INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF 
+* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+* IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE 
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON 
+* ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR 
+* TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF 
+* THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF 
+* SUCH DAMAGE.
+*----------------------------------------------------------------------*/
+
+/******************************************************************************
+*
+* File name:
+*
+*      lm_writer.c
+*
+* Description:
+*
+*      List mode writer threads for run types 0x400-0x403.
+*      Whoever services the DMA (interrupt handler, polling loop) hands filled 
+*      framebuffers to a per-module single producer / single consumer queue.
+*      One writer thread per module takes them off the queue, runs the 
+*      buffer QC and writes the list mode file, then returns the framebuffer 
+*      to the DMA ring. A slow disk or long QC pass of one module therefore
+*      does not delay re-arming the DMA of any module.
+*
+*      The queue itself is lock free (head written only by the producer, 
+*      tail only by the consumer); semaphores are only used to sleep when
+*      there is nothing to do.
+*
+* Member functions:
+*					LM_Writer_Start()			- start writer thread of a module at run start
+*					LM_Writer_Stop()			- drain queue and stop writer thread
+*					LM_Writer_Active()			- check if a module's buffers go to a writer thread
+*					LM_Writer_Push()			- queue a filled framebuffer (producer)
+*					LM_Writer_Wait_Slot()		- wait until the writer returned a ring slot, re-arm DMA
+*					LM_Writer_Drain()			- wait until all queued buffers are written
+*					LM_Writer_Request_New_File()- switch files in multi-file runs
+*					LM_Writer_Stats()			- queue depth and stall counters
+*					End_Run_Flush()				- read out remaining data of all modules in parallel at run stop
+*					End_Run_Report()			- per module result of the last End_Run_Flush()
+*
+******************************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#include "PlxTypes.h"
+#include "PciTypes.h"
+#include "Plx.h"
+
+#include "globals.h"
+#include "sharedfiles.h"
+#include "utilities.h"
+
+#ifdef WINDRIVER_API
+
+#define LM_QUEUE_LENGTH		DMA_LM_RING_MAX		// power of 2, at least the number of ring slots
+
+struct LM_Writer {
+	U32 *Queue[LM_QUEUE_LENGTH];	// filled framebuffers, in DMA order
+	U32 Head;						// next entry to fill, written by producer only
+	U32 Tail;						// next entry to write, written by writer only
+	U32 Active;						// writer thread running
+	U32 Stop;						// request writer to exit when queue is empty
+	U32 Busy;						// writer is processing a buffer
+	U32 NewFile;					// switch to next_base_name before next buffer
+	U16 RunType;
+	U8  ModNum;
+	pthread_t Thread;
+	sem_t Filled;					// posted by producer for every queued buffer
+	sem_t Freed;					// posted by writer for every buffer returned to the ring
+	// statistics
+	U32 MaxDepth;					// largest number of buffers queued
+	U32 Waits;						// number of times the producer had to wait for a free slot
+	U32 Written;					// buffers written by the thread
+	U32 MaxWriteTime;				// longest time to process one buffer, in ms
+	S32 Error;						// last error from Process_DMA_Buffer
+};
+
+static struct LM_Writer LMWriter[PRESET_MAX_MODULES];
+
+
+static U32 LM_Writer_ms (void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return((U32)(ts.tv_sec*1000 + ts.tv_nsec/1000000));
+}
+
+static S32 LM_Writer_TimedWait (sem_t *sem, U32 ms)
+{
+	struct timespec ts;
+	S32 retval;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_sec  += ms / 1000;
+	ts.tv_nsec += (ms % 1000) * 1000000;
+	if(ts.tv_nsec >= 1000000000) {
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000;
+	}
+	while((retval = sem_timedwait(sem, &ts)) == -1 && errno == EINTR)
+		;
+	return(retval);
+}
+
+static U32 LM_Writer_Depth (struct LM_Writer *w)
+{
+	return(__atomic_load_n(&w->Head, __ATOMIC_ACQUIRE) - __atomic_load_n(&w->Tail, __ATOMIC_ACQUIRE));
+}
+
+
+/****************************************************************
+*	LM_Writer_Thread function:
+*		Writer thread of one module: take filled framebuffers off
+*		the queue, QC and write to file, return them to the ring.
+*
+****************************************************************/
+
+static void *LM_Writer_Thread (void *arg)
+{
+	struct LM_Writer *w = (struct LM_Writer *)arg;
+	U8  ModNum = w->ModNum;
+	U32 *pBuf;
+	U32 tail, start, dt;
+	S32 retval;
+
+	while(1)
+	{
+		while(sem_wait(&w->Filled) == -1 && errno == EINTR)
+			;
+
+		tail = w->Tail;
+		if(tail == __atomic_load_n(&w->Head, __ATOMIC_ACQUIRE)) {
+			if(__atomic_load_n(&w->Stop, __ATOMIC_ACQUIRE))
+				break;
+			continue;
+		}
+		pBuf = w->Queue[tail % LM_QUEUE_LENGTH];
+		__atomic_store_n(&w->Busy, 1, __ATOMIC_RELEASE);
+		__atomic_store_n(&w->Tail, tail + 1, __ATOMIC_RELEASE);
+
+		if(__atomic_exchange_n(&w->NewFile, 0, __ATOMIC_ACQ_REL)) {
+			// multi-file run: the rest of a split event is at the start of this buffer, 
+			// it still goes into the old file. Then switch files.
+			if(numDWordsLeftover[ModNum] > 0)
+				fwrite(pBuf, numDWordsLeftover[ModNum]*sizeof(U32), 1, listFile[ModNum]);
+			Create_List_Mode_File(ModNum, next_base_name, w->RunType);
+		}
+
+		start = LM_Writer_ms();
+		retval = Process_DMA_Buffer(ModNum, pBuf, w->RunType, TRUE);
+		dt = LM_Writer_ms() - start;
+		if(retval < 0) {
+			w->Error = retval;
+			Free_DMA_Ring_Slot(ModNum, pBuf);		// Process_DMA_Buffer bailed out before returning it
+		}
+		if(dt > w->MaxWriteTime)
+			w->MaxWriteTime = dt;
+		w->Written++;
+
+		__atomic_store_n(&w->Busy, 0, __ATOMIC_RELEASE);
+		sem_post(&w->Freed);
+	}
+
+	return(NULL);
+}
+
+
+/****************************************************************
+*	LM_Writer_Start function:
+*		Start the writer thread of one module at run start.
+*		Requires a DMA ring with at least two slots.
+*		return values
+*			<0: error, or not used (buffers are written inline)
+*			 0: ok
+****************************************************************/
+
+S32 LM_Writer_Start (
+					 U8  ModNum,		// Pixie module number
+					 U16 RunType)		// run type, lower 12 bits
+{
+	struct LM_Writer *w = &LMWriter[ModNum];
+
+	if(w->Active)
+		LM_Writer_Stop(ModNum);
+
+	if(!LMWriterThread || LMRingSlots[ModNum] < 2)
+		return(-1);
+
+	memset(w, 0, sizeof(struct LM_Writer));
+	w->ModNum = ModNum;
+	w->RunType = RunType;
+	sem_init(&w->Filled, 0, 0);
+	sem_init(&w->Freed, 0, 0);
+
+	if(pthread_create(&w->Thread, NULL, LM_Writer_Thread, w) != 0) {
+		sprintf(ErrMSG, "*ERROR* (LM_Writer_Start): cannot create writer thread for module %d, writing inline", ModNum);
+		Pixie_Print_MSG(ErrMSG,1);
+		sem_destroy(&w->Filled);
+		sem_destroy(&w->Freed);
+		return(-2);
+	}
+	__atomic_store_n(&w->Active, 1, __ATOMIC_RELEASE);
+
+	sprintf(ErrMSG, "*DEBUG* (LM_Writer_Start): writer thread started for module %d", ModNum);
+	Pixie_Print_MSG(ErrMSG,PrintDebugMsg_daq);
+	return(0);
+}
+
+/****************************************************************
+*	LM_Writer_Stop function:
+*		Write all queued buffers and stop the writer thread of 
+*		one module. Must be called before the DMA ring is released.
+*
+****************************************************************/
+
+S32 LM_Writer_Stop (
+					U8  ModNum)		// Pixie module number
+{
+	struct LM_Writer *w = &LMWriter[ModNum];
+
+	if(!w->Active)
+		return(0);
+
+	__atomic_store_n(&w->Stop, 1, __ATOMIC_RELEASE);
+	sem_post(&w->Filled);
+	pthread_join(w->Thread, NULL);
+	__atomic_store_n(&w->Active, 0, __ATOMIC_RELEASE);
+	sem_destroy(&w->Filled);
+	sem_destroy(&w->Freed);
+
+	sprintf(ErrMSG, "*DEBUG* (LM_Writer_Stop): module %d, buffers written %d, max queue %d, waits %d, ring stalls %d, max write time %d ms", 
+		ModNum, w->Written, w->MaxDepth, w->Waits, LMRingStalls[ModNum], w->MaxWriteTime);
+	Pixie_Print_MSG(ErrMSG,PrintDebugMsg_daq);
+
+	return(w->Error);
+}
+
+/****************************************************************
+*	LM_Writer_Active function:
+*		return 1 if buffers of this module are written by a 
+*		writer thread, 0 otherwise
+*
+****************************************************************/
+
+S32 LM_Writer_Active (
+					  U8  ModNum)		// Pixie module number
+{
+	return(__atomic_load_n(&LMWriter[ModNum].Active, __ATOMIC_ACQUIRE) && !LMWriter[ModNum].Stop);
+}
+
+/****************************************************************
+*	LM_Writer_Push function:
+*		Queue a filled framebuffer for the writer thread.
+*		Only one thread may push for a given module.
+*		return values
+*			<0: queue full
+*			 0: ok
+****************************************************************/
+
+S32 LM_Writer_Push (
+					U8  ModNum,		// Pixie module number
+					U32 *pBuf)		// filled framebuffer, from Advance_DMA_Ring
+{
+	struct LM_Writer *w = &LMWriter[ModNum];
+	U32 head, depth;
+
+	head = w->Head;
+	depth = head - __atomic_load_n(&w->Tail, __ATOMIC_ACQUIRE);
+	if(depth >= LM_QUEUE_LENGTH)
+		return(-1);
+
+	w->Queue[head % LM_QUEUE_LENGTH] = pBuf;
+	__atomic_store_n(&w->Head, head + 1, __ATOMIC_RELEASE);
+	sem_post(&w->Filled);
+
+	if(depth + 1 > w->MaxDepth)
+		w->MaxDepth = depth + 1;
+
+	return(0);
+}
+
+/****************************************************************
+*	LM_Writer_Wait_Slot function:
+*		Called by the producer when the sequencer has filled the 
+*		current framebuffer but all other ring slots are still 
+*		queued. Waits for the writer to return one and re-arms the
+*		sequencer on it (via Advance_DMA_Ring).
+*		Returns the filled framebuffer; if it is still LMBuffer[ModNum],
+*		no slot was freed within DMATRANSFER_TIMEOUT.
+*
+****************************************************************/
+
+U32 *LM_Writer_Wait_Slot (
+						  U8  ModNum)		// Pixie module number
+{
+	struct LM_Writer *w = &LMWriter[ModNum];
+	U32 *pBuf = LMBuffer[ModNum];
+	U32 start;
+
+	w->Waits++;
+	start = LM_Writer_ms();
+	while(LM_Writer_ms() - start < DMATRANSFER_TIMEOUT) {
+		LM_Writer_TimedWait(&w->Freed, 10);
+		pBuf = Advance_DMA_Ring(ModNum);
+		if(pBuf != LMBuffer[ModNum])
+			break;
+	}
+	return(pBuf);
+}
+
+/****************************************************************
+*	LM_Writer_Drain function:
+*		Wait until the writer thread of a module has written all
+*		queued buffers.
+*		return values
+*			<0: timeout
+*			 0: ok
+****************************************************************/
+
+S32 LM_Writer_Drain (
+					 U8  ModNum)		// Pixie module number
+{
+	struct LM_Writer *w = &LMWriter[ModNum];
+	U32 start;
+
+	if(!w->Active)
+		return(0);
+
+	start = LM_Writer_ms();
+	while(LM_Writer_Depth(w) > 0 || __atomic_load_n(&w->Busy, __ATOMIC_ACQUIRE)) {
+		if(LM_Writer_ms() - start > 10*DMATRANSFER_TIMEOUT) {
+			sprintf(ErrMSG, "*WARNING* (LM_Writer_Drain): writer of module %d still busy", ModNum);
+			Pixie_Print_MSG(ErrMSG,1);
+			return(-1);
+		}
+		LM_Writer_TimedWait(&w->Freed, 10);
+	}
+	return(0);
+}
+
+/****************************************************************
+*	LM_Writer_Request_New_File function:
+*		Multi-file runs: each writer thread switches its module to 
+*		the file next_base_name before writing its next buffer
+*
+****************************************************************/
+
+void LM_Writer_Request_New_File (void)
+{
+	U32 k;
+
+	for(k = 0; k < PRESET_MAX_MODULES; k++) {
+		if(LMWriter[k].Active)
+			__atomic_store_n(&LMWriter[k].NewFile, 1, __ATOMIC_RELEASE);
+	}
+}
+
+/****************************************************************
+*	LM_Writer_Stats function:
+*		Fill LM_WRITER_STATS_LENGTH words with the pipeline 
+*		counters of one module:
+*			0: buffers currently queued
+*			1: maximum number of buffers queued
+*			2: ring stalls (attempts to re-arm with no free slot)
+*			3: producer waits for a free slot
+*			4: buffers written by the writer thread
+*			5: longest time to process one buffer (ms)
+*			6: number of ring slots
+*			7: 1 if writer thread active
+*
+****************************************************************/
+
+void LM_Writer_Stats (
+					  U8  ModNum,		// Pixie module number
+					  U32 *stats)		// receives LM_WRITER_STATS_LENGTH words
+{
+	struct LM_Writer *w = &LMWriter[ModNum];
+
+	stats[0] = LM_Writer_Depth(w);
+	stats[1] = w->MaxDepth;
+	stats[2] = LMRingStalls[ModNum];
+	stats[3] = w->Waits;
+	stats[4] = w->Written;
+	stats[5] = w->MaxWriteTime;
+	stats[6] = LMRingSlots[ModNum];
+	stats[7] = __atomic_load_n(&w->Active, __ATOMIC_ACQUIRE);
+}
+
+/****************************************************************
+*	End of run flush
+*		After run enable is cleared, every module still has data 
+*		in SDRAM. Each module is read out by its own worker until 
+*		EOR is found, its transfer times out, or the shared deadline 
+*		for the whole crate has passed.
+****************************************************************/
+
+struct End_Run_Worker {
+	U8  ModNum;
+	U16 RunType;
+	U32 Start;				// common start time, ms
+	pthread_t Thread;
+	S32 Status;				// END_RUN_EOR, END_RUN_TIMEOUT, END_RUN_DEADLINE or <0 on error
+	U32 Spills;				// buffers processed during the flush
+	U32 Time;				// time to finish, ms
+};
+
+static struct End_Run_Worker EndRunWorker[PRESET_MAX_MODULES];
+
+
+/****************************************************************
+*	End_Run_Flush_Module function:
+*		Read out remaining data of one module and dump to disk 
+*		until DMA is idle. 
+*		return values
+*			-1: failed to read run status
+*			-2: error writing DMA data to file
+*			END_RUN_EOR, END_RUN_TIMEOUT, END_RUN_DEADLINE
+****************************************************************/
+
+static S32 End_Run_Flush_Module (
+								 struct End_Run_Worker *w)
+{
+	U8  ModNum = w->ModNum;
+	U32 datatimeout = 0;	// combined end condition
+	U32 timeout = 0;		// timeout just for time
+	U32 deadline = 0;		// shared deadline for all modules passed
+	U32 extraspillcount = 1;	// number of extra spills for a module
+	U32 CSR, value, val;
+	S32 active, retval;
+	S32 status = END_RUN_TIMEOUT;
+
+	while(!datatimeout)
+	{
+		Pixie_Sleep(1);
+
+		active = Check_Run_Status(ModNum);
+		if(active<0) {
+			sprintf(ErrMSG, "*ERROR* (End_Run_Flush): Failed to read Run Status, module %d", ModNum);
+			Pixie_Print_MSG(ErrMSG,1);
+			return(-1);
+		}
+		deadline = (LM_Writer_ms() - w->Start >= END_RUN_FLUSH_DEADLINE);
+
+		if (Polling==1 || MultiThreadDAQ==1)	// if no interupts, we still need to read out the old way
+		{
+			// if the frame buffer is not filled yet, we should not be idle.
+			PIXIE500E_ReadWriteReg(hDev[ModNum], VDMA_CSRx, WDC_READ, &val, FALSE); // polling module if DMA done
+			value = LMBuffer[ModNum][DMA_LM_FRAMEBUFFER_LENGTH/sizeof(UINT32)-1];
+			if ( val==0 || !(value==0xA5A5A5A5 || value==0x69696969) ) {											 
+				// Finished transferring the buffer: dump it, rewind, restart DMA sequencer
+				retval = Write_DMA_List_Mode_File (ModNum, "", w->RunType);	// =1 if end 
+				if(retval <0) {
+					sprintf(ErrMSG, "*ERROR* (End_Run_Flush): Error writing DMA data to file, module %d", ModNum);
+					Pixie_Print_MSG(ErrMSG,1);
+					return(-2);
+				}
+				sprintf(ErrMSG, "*INFO* (End_Run_Flush): End run: Written another spill for ModNum=%d, count=%d", ModNum, extraspillcount);
+				Pixie_Print_MSG(ErrMSG,1);
+				timeout = 0;		// every new spill starts the DMA transfer timeout
+				extraspillcount++;
+			} // if DMA is not idle	
+
+			timeout++;
+
+			// DMATRANSFER_TIMEOUT after the last transfer, or the crate deadline
+			if( timeout>=DMATRANSFER_TIMEOUT || deadline) {	
+				datatimeout=1;		
+				sprintf(ErrMSG, "*DEBUG* (End_Run_Flush): End run: Timeout EndRunFound[%d]=%d, LMBuffer[last]=0x%x, LMBufferCounter=%d, P4e DMA status 0x%x ", ModNum, __atomic_load_n(&EndRunFound[ModNum], __ATOMIC_ACQUIRE), value, LMBufferCounter[ModNum], val);
+				Pixie_Print_MSG(ErrMSG,PrintDebugMsg_daq);
+
+				// Also check what partial data we have in the buffer, check for EOR
+				retval = Write_DMA_List_Mode_File (ModNum, "", w->RunType);	// =1 if end 
+				if(retval <0) {	// error
+					sprintf(ErrMSG, "*ERROR* (End_Run_Flush): Error writing DMA data to file, module %d", ModNum);
+					Pixie_Print_MSG(ErrMSG,1);
+					return(-2);
+				}
+				sprintf(ErrMSG, "*INFO* (End_Run_Flush): End run: Written a partial spill for ModNum=%d, count=%d", ModNum, extraspillcount);
+				Pixie_Print_MSG(ErrMSG,1);
+				extraspillcount++;
+				if(retval == 0)		// processed buffer, but no EOR, DMA still on
+					status = deadline ? END_RUN_DEADLINE : END_RUN_TIMEOUT;
+			}	// endif timeout 		
+		}	// polling
+		else {
+			// interrupts do the readout, just wait for EOR
+			timeout++;
+			if( timeout>=DMATRANSFER_TIMEOUT || deadline) {	
+				datatimeout=1;												
+				status = deadline ? END_RUN_DEADLINE : END_RUN_TIMEOUT;
+			}	
+		}
+
+		if(__atomic_load_n(&EndRunFound[ModNum], __ATOMIC_ACQUIRE)) {	// set by the QC on the DMA service or writer thread
+			sprintf(ErrMSG, "*DEBUG* (End_Run_Flush): End run: QC found EOR, module %d", ModNum);
+			Pixie_Print_MSG(ErrMSG,PrintDebugMsg_daq);
+			datatimeout=1;
+			status = END_RUN_EOR;
+
+			// also break the DSP out of its loop to flush the SDRAM data, which may wait forever
+			PIXIE500E_ReadWriteReg(hDev[ModNum], APP_HOST_CTL, WDC_READ, &CSR, FALSE);
+			CSR=(U32)SetBit(BIT_EORR, (U16)CSR);	// Set bit 7 of APP_HOST_CTL to indicate EOR received 
+			PIXIE500E_ReadWriteReg(hDev[ModNum], APP_HOST_CTL, WDC_WRITE, &CSR, FALSE);
+		}	// end if end run found
+	}	// time out loop
+
+	w->Spills = extraspillcount - 1;
+	return(status);
+}
+
+static void *End_Run_Flush_Thread (void *arg)
+{
+	struct End_Run_Worker *w = (struct End_Run_Worker *)arg;
+
+	w->Status = End_Run_Flush_Module(w);
+	w->Time = LM_Writer_ms() - w->Start;
+	return(NULL);
+}
+
+
+/****************************************************************
+*	End_Run_Flush function:
+*		Read out remaining data of modules MNstart..MNend-1 at run 
+*		stop, all modules in parallel, with a common deadline of 
+*		END_RUN_FLUSH_DEADLINE ms. Run stop takes as long as the 
+*		slowest module instead of the sum over modules.
+*		A completion report for each module is printed and kept
+*		for End_Run_Report().
+*		return values
+*			-1: failed to read run status (some module)
+*			-2: error writing DMA data to file (some module)
+*			 0: EOR found in all modules
+*			 1: at least one module timed out, data may be incomplete
+****************************************************************/
+
+S32 End_Run_Flush (
+				   U8  MNstart,		// first module
+				   U8  MNend,		// last module + 1
+				   U16 RunType)		// run type, lower 12 bits
+{
+	struct End_Run_Worker *w;
+	U32 start;
+	U8  k;
+	S32 retval = 0;
+
+	MakeNewFile = 0;	// no file switch while modules are flushed in parallel
+
+	start = LM_Writer_ms();
+	for(k = MNstart; k < MNend; k++) {
+		w = &EndRunWorker[k];
+		memset(w, 0, sizeof(struct End_Run_Worker));
+		w->ModNum = k;
+		w->RunType = RunType;
+		w->Start = start;
+		w->Status = END_RUN_NONE;
+	}
+
+	if(MNend - MNstart == 1) {
+		End_Run_Flush_Thread(&EndRunWorker[MNstart]);
+	}
+	else {
+		for(k = MNstart; k < MNend; k++) {
+			w = &EndRunWorker[k];
+			if(pthread_create(&w->Thread, NULL, End_Run_Flush_Thread, w) != 0) {
+				// no thread: read out this one here, it still shares the deadline
+				w->Thread = 0;
+				End_Run_Flush_Thread(w);
+			}
+		}
+		for(k = MNstart; k < MNend; k++) {
+			if(EndRunWorker[k].Thread)
+				pthread_join(EndRunWorker[k].Thread, NULL);
+		}
+	}
+
+	for(k = MNstart; k < MNend; k++) {
+		w = &EndRunWorker[k];
+		switch(w->Status) {
+			case END_RUN_EOR:
+				sprintf(ErrMSG, "*INFO* (End_Run_Flush): module %d: EOR found after %d ms, %d extra spills", k, w->Time, w->Spills);
+				Pixie_Print_MSG(ErrMSG,PrintDebugMsg_daq);
+				break;
+			case END_RUN_TIMEOUT:
+			case END_RUN_DEADLINE:
+				sprintf(ErrMSG, "*WARNING* (End_Run_Flush): End run timed out for ModNum=%d (polling = %d) after %d ms, %d extra spills%s", 
+					k, Polling, w->Time, w->Spills, (w->Status == END_RUN_DEADLINE) ? ", deadline for all modules passed" : "");
+				Pixie_Print_MSG(ErrMSG,1);
+				if(retval == 0) retval = 1;
+				break;
+			default:
+				if(retval >= 0) retval = w->Status;
+				break;
+		}
+	}
+
+	return(retval);
+}
+
+/****************************************************************
+*	End_Run_Report function:
+*		Fill END_RUN_REPORT_LENGTH words with the completion report
+*		of the last run stop for one module:
+*			0: status (END_RUN_EOR, END_RUN_TIMEOUT, END_RUN_DEADLINE, 
+*			   or 0xFFFFFFFF/0xFFFFFFFE for run status/file errors)
+*			1: spills written during the flush
+*			2: time to finish, ms
+*			3: reserved
+*
+****************************************************************/
+
+void End_Run_Report (
+					 U8  ModNum,		// Pixie module number
+					 U32 *report)		// receives END_RUN_REPORT_LENGTH words
+{
+	report[0] = (U32)EndRunWorker[ModNum].Status;
+	report[1] = EndRunWorker[ModNum].Spills;
+	report[2] = EndRunWorker[ModNum].Time;
+	report[3] = 0;
+}
+
+
+#endif // WINDRIVER_API
@@ -0,0 +1,203 @@
+/*----------------------------------------------------------------------
+* Copyright (c) 2004, 2009, 2015 XIA LLC
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms,
+* with or without modification, are permitted provided
+* that the following conditions are met:
+*
+*   * Redistributions of source code must retain the above
+*     copyright notice, this list of conditions and the
+*     following disclaimer.
+*   * Redistributions in binary form must reproduce the
+*     above copyright notice, this list of conditions and the
+*     following disclaimer in the documentation and/or other
+*     materials provided with the distribution.
+*   * Neither the name of XIA LLC
+*     nor the names of its contributors may be used to endorse
+*     or promote products derived from this software without
+*     specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+* CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+* INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+* ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+* TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+* THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+* SUCH DAMAGE.
+*----------------------------------------------------------------------*/
+
+/******************************************************************************
+*
+* File name:
+*
+*      mca_view.c
+*
+* Description:
+*
+*      Partial readout of the MCA spectra in external memory, for live
+*      displays during MCA runs. Only the requested bin range of one or all
+*      channels is read from the module, not the whole histogram memory.
+*      The host keeps the counts of the last read of each bin (snapshot),
+*      so a read can return the change since then, dense or as a list of
+*      the bins that changed. The snapshot is cleared with the histogram
+*      memory at the start of a new run, and when the histogram memory is
+*      written (0x9002). There is one snapshot per bin, so two displays
+*      reading overlapping ranges see each other's reads.
+*      Not to be called from several threads for the same module at once.
+*
+* Member functions:
+*					MCA_View_Read()			- read a bin range, counts or changes
+*					MCA_View_Reset()		- clear a module's snapshot
+*
+******************************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "PlxTypes.h"
+#include "PciTypes.h"
+#include "Plx.h"
+
+#include "globals.h"
+#include "sharedfiles.h"
+#include "utilities.h"
+
+static U32 *ViewSnapshot[PRESET_MAX_MODULES];		// NUMBER_OF_CHANNELS x MAX_HISTOGRAM_LENGTH counts as last read
+static U32 *ViewScratch[PRESET_MAX_MODULES];		// MAX_HISTOGRAM_LENGTH words read from the module
+
+
+/****************************************************************
+*	MCA_View_Reset function:
+*		Clear the snapshot of module ModNum, as when its histogram
+*		memory is cleared at the start of a new run: the next
+*		changes are counted from zero.
+*
+****************************************************************/
+
+void MCA_View_Reset (
+					 U8 ModNum )		// Pixie module number
+{
+	if(ViewSnapshot[ModNum])
+		memset(ViewSnapshot[ModNum], 0, NUMBER_OF_CHANNELS*MAX_HISTOGRAM_LENGTH*sizeof(U32));
+}
+
+
+/****************************************************************
+*	MCA_View_Read function:
+*		Read bins FirstBin to FirstBin+NumBins-1 of channel Chan, or
+*		of all channels one after the other (MCA_VIEW_ALL), from the
+*		histogram memory of module ModNum, and update the snapshot.
+*		Data receives, depending on Mode:
+*			MCA_VIEW_COUNTS:	the counts, NumBins words per channel
+*			MCA_VIEW_DELTA:		counts minus the snapshot, as S32,
+*								NumBins words per channel
+*			MCA_VIEW_CHANGED:	the number n of bins that changed,
+*								then n pairs of histogram memory 
+*								address (channel*MAX_HISTOGRAM_LENGTH
+*								+ bin) and counts
+*		In mode MCA_VIEW_CHANGED, Data needs room for 1+2*NumBins
+*		words per channel read: 1+2*NUMBER_OF_CHANNELS*
+*		MAX_HISTOGRAM_LENGTH words for the full range of all
+*		channels, twice HISTOGRAM_MEMORY_LENGTH.
+*
+*		Return Value:
+*			number of words written to Data
+*			-1 - invalid module, channel, bin range or mode
+*			-2 - memory allocation failure
+*			-3 - failure to read the histogram memory
+*
+****************************************************************/
+
+S32 MCA_View_Read (
+				   U8  ModNum,		// Pixie module number
+				   U16 Chan,		// channel number, or MCA_VIEW_ALL
+				   U32 FirstBin,	// first bin
+				   U32 NumBins,		// number of bins per channel
+				   U16 Mode,		// MCA_VIEW_COUNTS, _DELTA or _CHANGED
+				   U32 *Data )		// receives counts or changes, see above for its size
+{
+	U16 ch, chFirst, chLast;
+	U32 k, n, start, len, address, changed = 0;
+	U32 *snap, *rd;
+	S32 retval;
+
+	if(ModNum >= Number_Modules || (Chan >= NUMBER_OF_CHANNELS && Chan != MCA_VIEW_ALL) || Mode > MCA_VIEW_CHANGED ||
+	   NumBins == 0 || FirstBin >= MAX_HISTOGRAM_LENGTH || NumBins > MAX_HISTOGRAM_LENGTH - FirstBin) {
+		sprintf(ErrMSG, "*ERROR* (MCA_View_Read): invalid request: module %d, channel %d, bins %u + %u, mode %d", ModNum, Chan, FirstBin, NumBins, Mode);
+		Pixie_Print_MSG(ErrMSG,1);
+		return(-1);
+	}
+
+	if(Offline == 1) {
+		sprintf(ErrMSG, "*ERROR* (MCA_View_Read): Offline mode. No I/O operations possible");
+		Pixie_Print_MSG(ErrMSG,1);
+		return(-3);
+	}
+
+	if(ViewSnapshot[ModNum] == NULL) {
+		ViewSnapshot[ModNum] = calloc(NUMBER_OF_CHANNELS*MAX_HISTOGRAM_LENGTH, sizeof(U32));
+		ViewScratch[ModNum] = malloc(MAX_HISTOGRAM_LENGTH*sizeof(U32));
+		if(ViewSnapshot[ModNum] == NULL || ViewScratch[ModNum] == NULL) {
+			free(ViewSnapshot[ModNum]);
+			free(ViewScratch[ModNum]);
+			ViewSnapshot[ModNum] = ViewScratch[ModNum] = NULL;
+			sprintf(ErrMSG, "*ERROR* (MCA_View_Read): memory allocation failure, module %d", ModNum);
+			Pixie_Print_MSG(ErrMSG,1);
+			return(-2);
+		}
+	}
+
+	chFirst = (Chan == MCA_VIEW_ALL) ? 0 : Chan;
+	chLast  = (Chan == MCA_VIEW_ALL) ? NUMBER_OF_CHANNELS-1 : Chan;
+	n = (Mode == MCA_VIEW_CHANGED) ? 1 : 0;		// changed bins: count first
+	for(ch = chFirst; ch <= chLast; ch++) {
+		// a block read needs 2 words or more: take the bin before (or after) a single one along
+		start = FirstBin;
+		len   = NumBins;
+		if(len < 2) {
+			if(start > 0) start--;
+			len = 2;
+		}
+		address = (U32)ch*MAX_HISTOGRAM_LENGTH;
+		retval = Pixie_IOEM(ModNum, HISTOGRAM_MEMORY_ADDRESS + address + start, MOD_READ, len, ViewScratch[ModNum]);
+		if(retval < 0) {
+			sprintf(ErrMSG, "*ERROR* (MCA_View_Read): failure to read histogram memory of module %d, retval=%d", ModNum, retval);
+			Pixie_Print_MSG(ErrMSG,1);
+			return(-3);
+		}
+		rd   = ViewScratch[ModNum] + (FirstBin - start);
+		snap = ViewSnapshot[ModNum] + address + FirstBin;
+
+		switch(Mode) {
+			case MCA_VIEW_COUNTS:
+				memcpy(&Data[n], rd, NumBins*sizeof(U32));
+				n += NumBins;
+				break;
+			case MCA_VIEW_DELTA:
+				for(k = 0; k < NumBins; k++)
+					Data[n++] = rd[k] - snap[k];
+				break;
+			default:
+				for(k = 0; k < NumBins; k++) {
+					if(rd[k] != snap[k]) {
+						Data[n++] = address + FirstBin + k;
+						Data[n++] = rd[k];
+						changed++;
+					}
+				}
+				break;
+		}
+		memcpy(snap, rd, NumBins*sizeof(U32));
+	}
+	if(Mode == MCA_VIEW_CHANGED)
+		Data[0] = changed;
+	return((S32)n);
+}
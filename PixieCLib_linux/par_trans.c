@@ -0,0 +1,315 @@
+/*----------------------------------------------------------------------
+* Copyright (c) 2004, 2009, 2015 XIA LLC
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms,
+* with or without modification, are permitted provided
+* that the following conditions are met:
+*
+*   * Redistributions of source code must retain the above
+*     copyright notice, this list of conditions and the
+*     following disclaimer.
+*   * Redistributions in binary form must reproduce the
+*     above copyright notice, this list of conditions and the
+*     following disclaimer in the documentation and/or other
+*     materials provided with the distribution.
+*   * Neither the name of XIA LLC
+*     nor the names of its contributors may be used to endorse
+*     or promote products derived from this software without
+*     specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+* CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+* INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+* ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+* TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+* THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+* SUCH DAMAGE.
+*----------------------------------------------------------------------*/
+
+/******************************************************************************
+*
+* File name:
+*
+*      par_trans.c
+*
+* Description:
+*
+*      Parameter transactions: many Pixie_User_Par_IO writes, applied to the 
+*      modules at once. Without a transaction, each write to a DSP parameter 
+*      of a Pixie-4e/500e copies all DSP_IO_BORDER words into the parameter 
+*      RAM and waits for the DSP to take them over, and most writes also run 
+*      the PROGRAM_FIPPI control task.
+*      While a module's transaction is open, Pixie_IODM only updates the local 
+*      DSP parameter values and Control_Task_Run only notes that the FiPPI has 
+*      to be programmed. User and dependent DSP parameters are still computed 
+*      by each write, from the local values. On commit, every module gets its 
+*      parameter RAM written once and PROGRAM_FIPPI run at most once, all 
+*      modules in parallel.
+*      Pending changes are applied before anything that depends on them: 
+*      reading DSP memory or starting a run or another control task.
+*
+* Member functions:
+*					Par_Trans_Begin()		- open transactions
+*					Par_Trans_Defer()		- stage a parameter RAM write or PROGRAM_FIPPI
+*					Par_Trans_Flush()		- apply pending changes of a module now
+*					Par_Trans_Start_Run()	- Start_Run with pending changes applied first
+*					Par_Trans_Open()		- check for open transactions
+*					Par_Trans_Commit()		- apply pending changes of all modules in parallel, close
+*
+******************************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+
+#include "PlxTypes.h"
+#include "PciTypes.h"
+#include "Plx.h"
+
+#include "globals.h"
+#include "sharedfiles.h"
+#include "utilities.h"
+
+struct Par_Trans {
+	U8  Open;				// transaction open; writes are staged
+	U8  ParamRAM;			// local DSP parameter values changed since the last flush
+	U8  Fippi;				// PROGRAM_FIPPI requested since the last flush
+	pthread_t Thread;		// commit worker
+	S32 Status;				// result of the commit
+};
+
+static struct Par_Trans ParTrans[PRESET_MAX_MODULES];
+
+
+/****************************************************************
+*	Par_Trans_Begin function:
+*		Open the transactions of modules MNstart..MNend-1.
+*		Pending changes of a transaction that is already open
+*		are kept.
+****************************************************************/
+
+void Par_Trans_Begin (
+					  U8 MNstart,		// first module
+					  U8 MNend)			// last module + 1
+{
+	U8 k;
+
+	for(k = MNstart; k < MNend; k++)
+		ParTrans[k].Open = 1;
+}
+
+
+/****************************************************************
+*	Par_Trans_Defer function:
+*		Called by Pixie_IODM before writing the parameter RAM
+*		(PAR_TRANS_PARAM_RAM) and by Control_Task_Run before
+*		running PROGRAM_FIPPI (PAR_TRANS_FIPPI).
+*
+*		Return Value:
+*			1 - transaction open, the caller skips the I/O
+*			0 - no transaction, the caller does the I/O
+****************************************************************/
+
+S32 Par_Trans_Defer (
+					 U8 ModNum,		// Pixie module number
+					 U8 What)		// PAR_TRANS_PARAM_RAM or PAR_TRANS_FIPPI
+{
+	struct Par_Trans *t;
+
+	if(ModNum >= PRESET_MAX_MODULES || !ParTrans[ModNum].Open)
+		return(0);
+	t = &ParTrans[ModNum];
+	if(What == PAR_TRANS_PARAM_RAM) t->ParamRAM = 1;
+	if(What == PAR_TRANS_FIPPI)     t->Fippi = 1;
+	return(1);
+}
+
+
+/****************************************************************
+*	Par_Trans_Flush function:
+*		Apply the pending changes of a module: write the local 
+*		DSP parameter values to the parameter RAM, then program 
+*		the FiPPI. The transaction stays open. Changes that
+*		failed stay pending, so a retried commit applies them.
+*		ModNum==Number_Modules flushes all modules, one by one.
+*
+*		Return Value:
+*			 0 - success, or nothing pending
+*			-1 - writing the parameter RAM failed
+*			-2 - PROGRAM_FIPPI failed
+****************************************************************/
+
+S32 Par_Trans_Flush (
+					 U8 ModNum)		// Pixie module number
+{
+	struct Par_Trans *t;
+	U32 value[DSP_IO_BORDER];
+	U8  open, paramRAM, fippi;
+	S32 retval = 0;
+	U16 k;
+
+	if(ModNum == Number_Modules) {
+		for(k = 0; k < Number_Modules; k++)
+			if(Par_Trans_Flush((U8)k) < 0 && retval == 0) retval = -1;
+		return(retval);
+	}
+	if(ModNum >= PRESET_MAX_MODULES)
+		return(0);
+
+	t = &ParTrans[ModNum];
+	if(!t->ParamRAM && !t->Fippi)
+		return(0);
+
+	/* do the I/O directly, then stage again */
+	open = t->Open;
+	paramRAM = t->ParamRAM;
+	fippi = t->Fippi;
+	t->Open = t->ParamRAM = t->Fippi = 0;
+
+	if(paramRAM) {
+		for(k = 0; k < DSP_IO_BORDER; k++)
+			value[k] = (U32)Pixie_Devices[ModNum].DSP_Parameter_Values[k];
+		if(Pixie_IODM(ModNum, DATA_MEMORY_ADDRESS, MOD_WRITE, DSP_IO_BORDER, value) < 0) {
+			sprintf(ErrMSG, "*ERROR* (Par_Trans_Flush): failure to write DSP parameters to Module %d", ModNum);
+			Pixie_Print_MSG(ErrMSG,1);
+			retval = -1;
+		}
+	}
+	if(fippi && retval == 0) {
+		if(Control_Task_Run(ModNum, PROGRAM_FIPPI, 1000) < 0) {
+			sprintf(ErrMSG, "*ERROR* (Par_Trans_Flush): failure to program FiPPI in Module %d", ModNum);
+			Pixie_Print_MSG(ErrMSG,1);
+			retval = -2;
+		}
+	}
+
+	// keep what was not applied for a retry
+	if(retval == -1) {
+		t->ParamRAM = paramRAM;
+		t->Fippi = fippi;
+	}
+	if(retval == -2)
+		t->Fippi = fippi;
+	t->Open = open;
+	return(retval);
+}
+
+
+/****************************************************************
+*	Par_Trans_Start_Run function:
+*		Start_Run for modules with an open transaction: apply
+*		the pending changes, then start the run or control task
+*		with staging suspended, so the run task parameters
+*		Start_Run writes are written right away.
+****************************************************************/
+
+S32 Par_Trans_Start_Run (
+						 U8  ModNum,		// Pixie module number
+						 U8  Type,			// run type (NEW_RUN or RESUME_RUN)
+						 U16 Run_Task,		// run task
+						 U16 Control_Task )	// control task
+{
+	U8  open[PRESET_MAX_MODULES];
+	U8  k, MNstart, MNend;
+	S32 retval;
+
+	MNstart = (ModNum == Number_Modules) ? 0 : ModNum;
+	MNend   = (ModNum == Number_Modules) ? Number_Modules : ModNum + 1;
+
+	Par_Trans_Flush(ModNum);
+	for(k = MNstart; k < MNend; k++) {
+		open[k] = ParTrans[k].Open;
+		ParTrans[k].Open = 0;
+	}
+	retval = Start_Run(ModNum, Type, Run_Task, Control_Task);
+	for(k = MNstart; k < MNend; k++)
+		ParTrans[k].Open = open[k];
+	return(retval);
+}
+
+
+/****************************************************************
+*	Par_Trans_Open function:
+*		Check if a transaction is open in module ModNum, or in
+*		any module if ModNum==Number_Modules.
+****************************************************************/
+
+S32 Par_Trans_Open (
+					U8 ModNum)		// Pixie module number
+{
+	U8 k;
+
+	if(ModNum == Number_Modules) {
+		for(k = 0; k < Number_Modules; k++)
+			if(ParTrans[k].Open) return(1);
+		return(0);
+	}
+	return(ModNum < PRESET_MAX_MODULES && ParTrans[ModNum].Open);
+}
+
+
+static void *Par_Trans_Commit_Thread (void *arg)
+{
+	struct Par_Trans *t = (struct Par_Trans *)arg;
+
+	t->Status = Par_Trans_Flush((U8)(t - ParTrans));
+	return(NULL);
+}
+
+
+/****************************************************************
+*	Par_Trans_Commit function:
+*		Apply the pending changes of modules MNstart..MNend-1,
+*		each module in its own thread, and close their
+*		transactions. The commit takes as long as the slowest
+*		module instead of the sum over modules.
+*
+*		Return Value:
+*			 0 - success
+*			-1 - writing the parameter RAM failed (some module)
+*			-2 - PROGRAM_FIPPI failed (some module)
+****************************************************************/
+
+S32 Par_Trans_Commit (
+					  U8 MNstart,		// first module
+					  U8 MNend)			// last module + 1
+{
+	struct Par_Trans *t;
+	U8  k, busy = 0;
+	S32 retval = 0;
+
+	for(k = MNstart; k < MNend; k++) {
+		t = &ParTrans[k];
+		t->Status = 0;
+		t->Thread = 0;
+		if(t->ParamRAM || t->Fippi) busy++;
+	}
+
+	for(k = MNstart; k < MNend; k++) {
+		t = &ParTrans[k];
+		if(!t->ParamRAM && !t->Fippi)
+			continue;
+		if(busy == 1 || pthread_create(&t->Thread, NULL, Par_Trans_Commit_Thread, t) != 0) {
+			// single module, or no thread: flush this one here
+			t->Thread = 0;
+			Par_Trans_Commit_Thread(t);
+		}
+	}
+	for(k = MNstart; k < MNend; k++) {
+		t = &ParTrans[k];
+		if(t->Thread)
+			pthread_join(t->Thread, NULL);
+		t->Open = 0;
+		if(t->Status < 0 && retval == 0) retval = t->Status;
+	}
+
+	return(retval);
+}
@@ -51,6 +51,11 @@ static void DLLCALLCONV PIXIE500E_IntHandler(PVOID pData);
 static void PIXIE500E_EventHandler(WD_EVENT *pEvent, PVOID pData);
 static void ErrLog(const CHAR *sFormat, ...);
 static void TraceLog(const CHAR *sFormat, ...);
+static BOOL WinDriver_DeviceClose(WDC_DEVICE_HANDLE hDev);
+static DWORD WinDriver_IntDisable(WDC_DEVICE_HANDLE hDev);
+static DWORD WinDriver_ReadWriteReg(WDC_DEVICE_HANDLE hDev, DWORD dwReg, WDC_DIRECTION direction, void *value, BOOL fPciCfg);
+static DWORD WinDriver_WriteFIFO(WDC_DEVICE_HANDLE hDev, DWORD dwReg, const UINT32 *data, UINT32 nWords);
+static void WinDriver_InterruptSetup_INT3(WDC_DEVICE_HANDLE hDev, U8 ModNum, U16 RunType);
 
 
 static inline BOOL IsValidDevice(PWDC_DEVICE pDev, const CHAR *sFunc)
@@ -191,7 +196,7 @@ Error:
 	return NULL;
 }
 
-BOOL PIXIE500E_DeviceClose(WDC_DEVICE_HANDLE hDev)
+static BOOL WinDriver_DeviceClose(WDC_DEVICE_HANDLE hDev)
 {
 	DWORD dwStatus;
 	PWDC_DEVICE pDev = (PWDC_DEVICE)hDev;
@@ -210,7 +215,7 @@ BOOL PIXIE500E_DeviceClose(WDC_DEVICE_HANDLE hDev)
 	/* Disable interrupts */
 	if (WDC_IntIsEnabled(hDev))
 	{
-		dwStatus = PIXIE500E_IntDisable(hDev);
+		dwStatus = WinDriver_IntDisable(hDev);
 		if (WD_STATUS_SUCCESS != dwStatus)
 		{
 			ErrLog("Failed disabling interrupts. Error 0x%lx - %s\n",
@@ -451,7 +456,7 @@ DWORD PIXIE500E_IntEnable(WDC_DEVICE_HANDLE hDev, PIXIE500E_INT_HANDLER funcIntH
 	return WD_STATUS_SUCCESS;
 }
 
-DWORD PIXIE500E_IntDisable(WDC_DEVICE_HANDLE hDev)
+static DWORD WinDriver_IntDisable(WDC_DEVICE_HANDLE hDev)
 {
 	DWORD dwStatus;
 	PWDC_DEVICE pDev = (PWDC_DEVICE)hDev;
@@ -662,7 +667,33 @@ BOOL PIXIE500E_GetAddrSpaceInfo(WDC_DEVICE_HANDLE hDev, PIXIE500E_ADDR_SPACE_INF
 // A general function for register IO
 // Modified WDC_DIAG_ReadWriteReg() from wdc_diag_lib.c of WinDriver distribution.
 // 
-DWORD PIXIE500E_ReadWriteReg(WDC_DEVICE_HANDLE hDev, DWORD dwReg, WDC_DIRECTION direction, void *value, BOOL fPciCfg)
+/* Write nWords to a FIFO register, as one block write to the same address; 
+   one word at a time if the block write fails */
+static DWORD WinDriver_WriteFIFO(WDC_DEVICE_HANDLE hDev, DWORD dwReg, const UINT32 *data, UINT32 nWords)
+{
+	DWORD dwStatus;
+	const WDC_REG *pReg = &gPIXIE500E_Regs[dwReg];
+	UINT32 i;
+
+	if (!hDev)
+	{
+		ErrLog("*ERROR* (PIXIE500E_WriteFIFO): NULL WDC device handle\n");
+		return WD_WINDRIVER_STATUS_ERROR;
+	}
+
+	dwStatus = WDC_WriteAddrBlock(hDev, pReg->dwAddrSpace, pReg->dwOffset, nWords*sizeof(UINT32), (PVOID)data, 
+		WDC_MODE_32, WDC_ADDR_RW_NO_AUTOINC);
+	if (WD_STATUS_SUCCESS != dwStatus) {
+		for (i = 0; i < nWords; i++) {
+			dwStatus = WDC_WriteAddr32(hDev, pReg->dwAddrSpace, pReg->dwOffset, data[i]);
+			if (WD_STATUS_SUCCESS != dwStatus)
+				break;
+		}
+	}
+	return dwStatus;
+}
+
+static DWORD WinDriver_ReadWriteReg(WDC_DEVICE_HANDLE hDev, DWORD dwReg, WDC_DIRECTION direction, void *value, BOOL fPciCfg)
 {
 	DWORD dwStatus;
 	//DWORD dwReg;
@@ -1245,26 +1276,26 @@ UINT32 PIXIE500E_ProgramFPGA(WDC_DEVICE_HANDLE hDev, UINT32 fcl_clk_div, UINT32
 	char ErrMSG[256] = {0};
 	DWORD dwStatus = WD_WINDRIVER_STATUS_ERROR;
 	UINT32 len = N_P4E_BYTES; // initialize to default P4e
-	UINT8  value;
-	UINT32 i, j, k, word_counter = 0, doneInt = 0;
+	UINT32 i, k, word_counter = 0, doneInt = 0;
 	UINT32 dwData, svData;
 	INT16 fcl_irq, fcl_ctrl;
 	UINT8 *pu8Ptr = P500e_FPGA_Configuration;		// initialize to default P4e
-	UINT8 tmpU8Ptr[4]; // temp buffer for bit-reversed configuration chunks to go in FCL_FIFO_DATA
+	const UINT32 *pImage, *pChunk;
+	UINT32 tmpChunk[128]; // bit-reversed configuration chunk to go in FCL_FIFO_DATA, if there is no image
 
 	if(type == MODULETYPE_P4e)
 	{
-		*pu8Ptr = P4e_FPGA_Configuration;
+		pu8Ptr = P4e_FPGA_Configuration;
 		len = N_P4E_BYTES;
 	}
 	else if(type == MODULETYPE_P500e)
 	{
-		*pu8Ptr = P500e_FPGA_Configuration;
+		pu8Ptr = P500e_FPGA_Configuration;
 		len = N_P500E_BYTES;
 	}
 	else if(type == MODULETYPE_P32)
 	{
-			*pu8Ptr = P32_FPGA_Configuration;
+			pu8Ptr = P32_FPGA_Configuration;
 			len = N_P32_BYTES;
 			sprintf(ErrMSG, "*DEBUG* (PIXIE500E_ProgramFPGA(): P32 configuration");
 			Pixie_Print_MSG(ErrMSG,PrintDebugMsg_Boot);
@@ -1395,6 +1426,7 @@ UINT32 PIXIE500E_ProgramFPGA(WDC_DEVICE_HANDLE hDev, UINT32 fcl_clk_div, UINT32
 	fcl_ctrl |= 0x1;
 	dwStatus = PIXIE500E_ReadWriteReg(hDev, FCL_CTRL, WDC_WRITE, &fcl_ctrl, FALSE);
 
+	pImage = FPGA_Image_Words(pu8Ptr, len);
 	while(len > 0) { // load configuration
 		// Check to see if FPGA configuation has error
 		dwStatus = PIXIE500E_ReadWriteReg(hDev, FCL_IRQ, WDC_READ, &fcl_irq, FALSE);
@@ -1417,38 +1449,19 @@ UINT32 PIXIE500E_ProgramFPGA(WDC_DEVICE_HANDLE hDev, UINT32 fcl_clk_div, UINT32
 		}
 
 		//Write 128 dwords into FIFO at a time.
-
-		for(i = 0; (i < 128) && (len > 0); i++, word_counter++)
-		{
 		// Bit reorder each byte of the file content.  This is required for Xilinx
-		// FPGA's PROM file.
-			for (k = 0; k < 4; k++) { // 4 U8 words to put in j
-				value = *(pu8Ptr + k);
-				value = ((value & 0x80) >> 7 |
-					((value & 0x40) >> 5) |
-					((value & 0x20) >> 3) |
-					((value & 0x10) >> 1) |
-					((value & 0x08) << 1) |
-					((value & 0x04) << 3) |
-					((value & 0x02) << 5) |
-					((value & 0x01) << 7));
-				tmpU8Ptr[k] = value;
-			}
-			memcpy(&j, tmpU8Ptr, 4);
-
-			pu8Ptr += 4;
-			dwStatus = PIXIE500E_ReadWriteReg(hDev, FCL_FIFO_DATA, WDC_WRITE, &j, FALSE);
-#if (DEBUG_PRINT)
-			if (len<=218) {
-				sprintf(ErrMSG, "*DEBUG* (PIXIE500E_ProgramFPGA():  FCL_FIFO_DATA=0x%08X", j);
-				Pixie_Print_MSG(ErrMSG,1);
-			}
-#endif
-			if(len > 4)
-				len -= 4;
-			else
-				len = 0;
+		// FPGA's PROM file. Normally done once when the file is read (FPGA_Image_Build).
+		k = (len > 512) ? 512 : len;
+		if(pImage)
+			pChunk = pImage + word_counter;
+		else {
+			FPGA_Image_Reverse(pu8Ptr, tmpChunk, k);
+			pChunk = tmpChunk;
 		}
+		dwStatus = PIXIE500E_WriteFIFO(hDev, FCL_FIFO_DATA, pChunk, (k + 3) / 4);
+		pu8Ptr += k;
+		word_counter += (k + 3) / 4;
+		len -= k;
 	} // while loading configuration, len >0
 
 	//Assert last data word written flag
@@ -1516,12 +1529,12 @@ UINT32 PIXIE4E_ProgramFPGA(WDC_DEVICE_HANDLE hDev, UINT32 fcl_clk_div, UINT32 ty
 
 	DWORD dwStatus = WD_WINDRIVER_STATUS_ERROR;
 	UINT32 len;
-	UINT8  value;
-	UINT32 i, j, k, word_counter = 0, doneInt = 0;
+	UINT32 i, k, word_counter = 0, doneInt = 0;
 	UINT32 dwData, svData;
 	INT16 fcl_irq, fcl_ctrl, fcl_status;
 	UINT8 *pu8Ptr;
-	UINT8 tmpU8Ptr[4]; // temp buffer for bit-reversed configuration chunks to go in FCL_FIFO_DATA
+	const UINT32 *pImage, *pChunk;
+	UINT32 tmpChunk[128]; // bit-reversed configuration chunk to go in FCL_FIFO_DATA, if there is no image
 
 	sprintf(ErrMSG, "*INFO* (PIXIE4E_ProgramFPGA(): BEGIN");
 	Pixie_Print_MSG(ErrMSG,1);
@@ -1718,6 +1731,7 @@ UINT32 PIXIE4E_ProgramFPGA(WDC_DEVICE_HANDLE hDev, UINT32 fcl_clk_div, UINT32 ty
 	fcl_ctrl |= 0x1;
 	dwStatus = PIXIE500E_ReadWriteReg(hDev, FCL_CTRL, WDC_WRITE, &fcl_ctrl, FALSE);
 
+	pImage = FPGA_Image_Words(pu8Ptr, len);
 	while(len > 0) { // load configuration
 		// Check to see if FPGA configuation has error
 		dwStatus = PIXIE500E_ReadWriteReg(hDev, FCL_IRQ, WDC_READ, &fcl_irq, FALSE);
@@ -1739,37 +1753,19 @@ UINT32 PIXIE4E_ProgramFPGA(WDC_DEVICE_HANDLE hDev, UINT32 fcl_clk_div, UINT32 ty
 		}
 
 		//Write 128 dwords into FIFO at a time.
-		for(i = 0; (i < 128) && (len > 0); i++, word_counter++)
-		{
 		// Bit reorder each byte of the file content.  This is required for Xilinx
-		// FPGA's PROM file.
-			for (k = 0; k < 4; k++) { // 4 U8 words to put in j
-				value = *(pu8Ptr + k);
-				value = ((value & 0x80) >> 7 |
-					((value & 0x40) >> 5) |
-					((value & 0x20) >> 3) |
-					((value & 0x10) >> 1) |
-					((value & 0x08) << 1) |
-					((value & 0x04) << 3) |
-					((value & 0x02) << 5) |
-					((value & 0x01) << 7));
-				tmpU8Ptr[k] = value;
-			}
-			memcpy(&j, tmpU8Ptr, 4);
-
-			pu8Ptr += 4;
-			dwStatus = PIXIE500E_ReadWriteReg(hDev, FCL_FIFO_DATA, WDC_WRITE, &j, FALSE);
-
-			//if (len<=218) {
-			//	sprintf(ErrMSG, "*DEBUG* (PIXIE500E_ProgramFPGA():  FCL_FIFO_DATA=0x%08X", j);
-			//	Pixie_Print_MSG(ErrMSG,PrintDebugMsg_Boot);
-			//}
-
-			if(len > 4)
-				len -= 4;
-			else
-				len = 0;
+		// FPGA's PROM file. Normally done once when the file is read (FPGA_Image_Build).
+		k = (len > 512) ? 512 : len;
+		if(pImage)
+			pChunk = pImage + word_counter;
+		else {
+			FPGA_Image_Reverse(pu8Ptr, tmpChunk, k);
+			pChunk = tmpChunk;
 		}
+		dwStatus = PIXIE500E_WriteFIFO(hDev, FCL_FIFO_DATA, pChunk, (k + 3) / 4);
+		pu8Ptr += k;
+		word_counter += (k + 3) / 4;
+		len -= k;
 	} // while loading configuration, len >0
 
 	//Assert last data word written flag
@@ -2157,7 +2153,7 @@ UINT32 PIXIE500E_DMA_Trace_Setup (WDC_DEVICE_HANDLE hDev, DWORD dwDMABufSize, DW
 	// Try Scatter Gather first
 	//sprintf(ErrMSG, "*DEBUG* (PIXIE500E_DMA_Trace_Setup): Size of buffer %X (%d)", dwDMABufSize,dwDMABufSize);
 	//Pixie_Print_MSG(ErrMSG,1);
-	dwStatus = WDC_DMASGBufLock(hDev, dwDMABuffer, DMA_FROM_DEVICE | DMA_ALLOW_CACHE | DMA_ALLOW_64BIT_ADDRESS, dwDMABufSize, ppDmaL2P);
+	dwStatus = PIXIE500E_DMASGBufLock(hDev, dwDMABuffer, DMA_FROM_DEVICE | DMA_ALLOW_CACHE | DMA_ALLOW_64BIT_ADDRESS, dwDMABufSize, ppDmaL2P);
 	if (dwStatus != WD_STATUS_SUCCESS) {
 		sprintf(ErrMSG, "*ERROR* (PIXIE500E_DMA_Trace_Setup): Failed to lock Scatter Gather DMA buffer, status=0x%08X", dwStatus);
 		Pixie_Print_MSG(ErrMSG,1);
@@ -2191,6 +2187,77 @@ UINT32 PIXIE500E_DMA_Trace_Setup (WDC_DEVICE_HANDLE hDev, DWORD dwDMABufSize, DW
 }
 
 
+// DMA framebuffer ring for list mode runs.
+// Each slot is locked once at run start and gets its own sequencer image (code + SG list).
+// The sequencer code is the same for all slots, so only the first slot's image is programmed in full.
+// Switching to another slot only rewrites LDM_SG_CNT and the SG list in descriptor RAM
+// (the descriptor RAM holds one 2MB SG list at a time, so the lists can not be resident simultaneously).
+
+UINT32 PIXIE500E_DMA_Ring_Setup (WDC_DEVICE_HANDLE hDev, DWORD dwDMABufSize, DWORD *dwDMABuffer, WD_DMA **ppDmaL2P, INT32 *pCodeBuffer)
+{
+	DWORD dwStatus = WD_WINDRIVER_STATUS_ERROR;
+
+	memset(pCodeBuffer, 0, m_RAMSize);
+
+	// Lock DMA buffer
+	dwStatus = PIXIE500E_DMASGBufLock(hDev, dwDMABuffer, DMA_FROM_DEVICE | DMA_ALLOW_CACHE | DMA_ALLOW_64BIT_ADDRESS, dwDMABufSize, ppDmaL2P);
+	if (dwStatus != WD_STATUS_SUCCESS) {
+		sprintf(ErrMSG, "*ERROR* (PIXIE500E_DMA_Ring_Setup): Failed to lock Scatter Gather DMA buffer, status=0x%08X", (UINT32)dwStatus);
+		Pixie_Print_MSG(ErrMSG,1);
+		return (dwStatus);
+	}	
+
+	// Construct VMDA sequencer code from the DMA structures, but do not program it yet
+	PIXIE500E_VDMACodeGen_TraceOut(hDev, pCodeBuffer, *(ppDmaL2P));
+
+	if ( DATA_SECTION_START + pCodeBuffer[LDM_SG_CNT]*SG_ENTRY_SIZE > m_RAMSize/sizeof(INT32) ) {
+		sprintf(ErrMSG, "*ERROR* (PIXIE500E_DMA_Ring_Setup): SG list too long for descriptor RAM (%d entries)", pCodeBuffer[LDM_SG_CNT]);
+		Pixie_Print_MSG(ErrMSG,1);
+		PIXIE500E_DMABufUnlock(*ppDmaL2P);
+		*ppDmaL2P = NULL;
+		return (WD_WINDRIVER_STATUS_ERROR);
+	}
+
+	return (WD_STATUS_SUCCESS);
+}
+
+
+// Point the (idle) sequencer to a ring slot: write only that slot's SG count and SG list, 
+// rewind to MAIN_START. The sequencer is not started here.
+UINT32 PIXIE500E_DMA_Ring_Arm (WDC_DEVICE_HANDLE hDev, INT32 *pCodeBuffer, WD_DMA *pDmaL2P)
+{
+	DWORD dwStatus = WD_WINDRIVER_STATUS_ERROR;
+	UINT32 val;
+
+	if(!VDMADriver_isIdle(hDev))
+	{
+		sprintf(ErrMSG, "*ERROR* (PIXIE500E_DMA_Ring_Arm): Sequencer not idle");
+		Pixie_Print_MSG(ErrMSG,1);
+		return (WD_WINDRIVER_STATUS_ERROR);
+	}
+
+	dwStatus = PIXIE500E_WriteAddrBlock(hDev, AD_PCI_BAR0, m_RAMBase + DATA_SECTION_START*sizeof(INT32), pCodeBuffer[LDM_SG_CNT]*SG_ENTRY_SIZE*sizeof(INT32), 
+		pCodeBuffer + DATA_SECTION_START, WDC_MODE_32, WDC_ADDR_RW_DEFAULT);
+	if(dwStatus == WD_STATUS_SUCCESS)
+		dwStatus = PIXIE500E_WriteAddr32(hDev, AD_PCI_BAR0, m_RAMBase + LDM_SG_CNT*sizeof(INT32), pCodeBuffer[LDM_SG_CNT]);
+
+	// verify the SG count, the rest is checked once in PIXIE500E_DMA_ProgramSequencer
+	if(dwStatus == WD_STATUS_SUCCESS)
+		dwStatus = PIXIE500E_ReadAddr32(hDev, AD_PCI_BAR0, m_RAMBase + LDM_SG_CNT*sizeof(INT32), &val);
+	if(dwStatus != WD_STATUS_SUCCESS || val != (UINT32)pCodeBuffer[LDM_SG_CNT])
+	{
+		sprintf(ErrMSG, "*ERROR* (PIXIE500E_DMA_Ring_Arm): Failure to write SG list, status=0x%08X", (UINT32)dwStatus);
+		Pixie_Print_MSG(ErrMSG,1);
+		return (WD_WINDRIVER_STATUS_ERROR);
+	}
+
+	PIXIE500E_DMASyncCpu(pDmaL2P);
+	VDMADriver_SetDPTR(hDev, MAIN_START);
+
+	return (WD_STATUS_SUCCESS);
+}
+
+
 
 
 
@@ -2308,13 +2375,13 @@ UINT32 PIXIE500E_DMA_ProgramSequencer(WDC_DEVICE_HANDLE hDev, INT32 *m_CodeBuff)
 	// Write the sequencer code into descriptor RAM 
 	//	dwStatus = m_PCIAccessor->BlockWriteMemoryAddrSpace(m_PCIBar, m_RAMBase, m_CodeBuff, m_RAMSize);
 	// 09/20/13 keep getting comparison errors. Maybe the Block Addr write is not working right. 
-	dwStatus = WDC_WriteAddrBlock(hDev, AD_PCI_BAR0, m_RAMBase, m_RAMSize, m_CodeBuff, WDC_MODE_32, WDC_ADDR_RW_DEFAULT);
+	dwStatus = PIXIE500E_WriteAddrBlock(hDev, AD_PCI_BAR0, m_RAMBase, m_RAMSize, m_CodeBuff, WDC_MODE_32, WDC_ADDR_RW_DEFAULT);
 
 
 	// Verify the written data is correct 
 	for(i = 0; i < m_RAMSize/sizeof(INT32); i++)
 	{
-		dwStatus = WDC_ReadAddr32(hDev, AD_PCI_BAR0, (m_RAMBase + i*sizeof(INT32)), &j); 
+		dwStatus = PIXIE500E_ReadAddr32(hDev, AD_PCI_BAR0, (m_RAMBase + i*sizeof(INT32)), &j); 
 
 		if(dwStatus == WD_STATUS_SUCCESS && memcmp(&j, (m_CodeBuff+i), sizeof(UINT32)) != 0)
 		{
@@ -2636,7 +2703,7 @@ UINT32 VDMADriver_CreateXferCtlInstruction(WDC_DEVICE_HANDLE hDev, UINT8 c, UINT
  //Setup GN registers for INT3 external interrupt.
  //Connect with the ISR.
  //This will be called from Pixie_Acquire_Data(0x1000)
-void PIXIE500E_InterruptSetup_INT3(WDC_DEVICE_HANDLE hDev, U8 ModNum, U16 RunType)
+static void WinDriver_InterruptSetup_INT3(WDC_DEVICE_HANDLE hDev, U8 ModNum, U16 RunType)
 {
 	DWORD dwStatus, i;
 	PPIXIE500E_DEV_CTX pDevCtx;	
@@ -2962,3 +3029,93 @@ UINT32 PIXIE500E_ProgramDSP(WDC_DEVICE_HANDLE hDev)
 
 }
 
+
+/* -----------------------------------------------
+*    Device backend
+*   ----------------------------------------------- */
+
+// Modules accessed through WinDriver
+const PIXIE500E_BACKEND PIXIE500E_WinDriver_Backend = {
+	"WinDriver",
+	WinDriver_ReadWriteReg,
+	WinDriver_WriteFIFO,
+	WDC_ReadAddr32,
+	WDC_WriteAddr32,
+	WDC_ReadAddrBlock,
+	WDC_WriteAddrBlock,
+	WDC_DMASGBufLock,
+	WDC_DMABufUnlock,
+	WDC_DMASyncCpu,
+	WDC_DMASyncIo,
+	WinDriver_InterruptSetup_INT3,
+	WinDriver_IntDisable,
+	WinDriver_DeviceClose
+};
+
+// Backend of all modules, set by Pixie_Scan_Crate_Slots
+const PIXIE500E_BACKEND *PIXIE500E_Backend = &PIXIE500E_WinDriver_Backend;
+
+BOOL PIXIE500E_DeviceClose(WDC_DEVICE_HANDLE hDev)
+{
+	return PIXIE500E_Backend->DeviceClose(hDev);
+}
+
+DWORD PIXIE500E_IntDisable(WDC_DEVICE_HANDLE hDev)
+{
+	return PIXIE500E_Backend->IntDisable(hDev);
+}
+
+void PIXIE500E_InterruptSetup_INT3(WDC_DEVICE_HANDLE hDev, U8 ModNum, U16 RunType)
+{
+	PIXIE500E_Backend->IntSetup(hDev, ModNum, RunType);
+}
+
+DWORD PIXIE500E_ReadWriteReg(WDC_DEVICE_HANDLE hDev, DWORD dwReg, WDC_DIRECTION direction, void *value, BOOL fPciCfg)
+{
+	return PIXIE500E_Backend->ReadWriteReg(hDev, dwReg, direction, value, fPciCfg);
+}
+
+DWORD PIXIE500E_WriteFIFO(WDC_DEVICE_HANDLE hDev, DWORD dwReg, const UINT32 *data, UINT32 nWords)
+{
+	return PIXIE500E_Backend->WriteFIFO(hDev, dwReg, data, nWords);
+}
+
+DWORD PIXIE500E_ReadAddr32(WDC_DEVICE_HANDLE hDev, DWORD dwAddrSpace, KPTR dwOffset, UINT32 *val)
+{
+	return PIXIE500E_Backend->ReadAddr32(hDev, dwAddrSpace, dwOffset, val);
+}
+
+DWORD PIXIE500E_WriteAddr32(WDC_DEVICE_HANDLE hDev, DWORD dwAddrSpace, KPTR dwOffset, UINT32 val)
+{
+	return PIXIE500E_Backend->WriteAddr32(hDev, dwAddrSpace, dwOffset, val);
+}
+
+DWORD PIXIE500E_ReadAddrBlock(WDC_DEVICE_HANDLE hDev, DWORD dwAddrSpace, KPTR dwOffset, DWORD dwBytes, PVOID pData, WDC_ADDR_MODE mode, WDC_ADDR_RW_OPTIONS options)
+{
+	return PIXIE500E_Backend->ReadAddrBlock(hDev, dwAddrSpace, dwOffset, dwBytes, pData, mode, options);
+}
+
+DWORD PIXIE500E_WriteAddrBlock(WDC_DEVICE_HANDLE hDev, DWORD dwAddrSpace, KPTR dwOffset, DWORD dwBytes, PVOID pData, WDC_ADDR_MODE mode, WDC_ADDR_RW_OPTIONS options)
+{
+	return PIXIE500E_Backend->WriteAddrBlock(hDev, dwAddrSpace, dwOffset, dwBytes, pData, mode, options);
+}
+
+DWORD PIXIE500E_DMASGBufLock(WDC_DEVICE_HANDLE hDev, PVOID pBuf, DWORD dwOptions, DWORD dwDMABufSize, WD_DMA **ppDma)
+{
+	return PIXIE500E_Backend->DMASGBufLock(hDev, pBuf, dwOptions, dwDMABufSize, ppDma);
+}
+
+DWORD PIXIE500E_DMABufUnlock(WD_DMA *pDma)
+{
+	return PIXIE500E_Backend->DMABufUnlock(pDma);
+}
+
+DWORD PIXIE500E_DMASyncCpu(WD_DMA *pDma)
+{
+	return PIXIE500E_Backend->DMASyncCpu(pDma);
+}
+
+DWORD PIXIE500E_DMASyncIo(WD_DMA *pDma)
+{
+	return PIXIE500E_Backend->DMASyncIo(pDma);
+}
@@ -433,6 +433,31 @@ extern "C" {
 	} PIXIE500E_DEV_CTX, *PPIXIE500E_DEV_CTX;
 	/* TODO: You can add fields to store additional device-specific information */
 
+	/* Device backend: register, memory, DMA and interrupt access of the library.
+	   PIXIE500E_WinDriver_Backend accesses the modules through WinDriver,
+	   Pixie_Emu_Backend (pixie_emu.c) emulates them in software (OFFLINE_ANALYSIS = OFFLINE_EMULATOR).
+	   The PIXIE500E_* functions of the same names call the backend selected in PIXIE500E_Backend. */
+	typedef struct {
+		const char *sName;
+		DWORD (*ReadWriteReg)(WDC_DEVICE_HANDLE hDev, DWORD dwReg, WDC_DIRECTION direction, void *value, BOOL fPciCfg);
+		DWORD (*WriteFIFO)(WDC_DEVICE_HANDLE hDev, DWORD dwReg, const UINT32 *data, UINT32 nWords);
+		DWORD (DLLCALLCONV *ReadAddr32)(WDC_DEVICE_HANDLE hDev, DWORD dwAddrSpace, KPTR dwOffset, UINT32 *val);
+		DWORD (DLLCALLCONV *WriteAddr32)(WDC_DEVICE_HANDLE hDev, DWORD dwAddrSpace, KPTR dwOffset, UINT32 val);
+		DWORD (DLLCALLCONV *ReadAddrBlock)(WDC_DEVICE_HANDLE hDev, DWORD dwAddrSpace, KPTR dwOffset, DWORD dwBytes, PVOID pData, WDC_ADDR_MODE mode, WDC_ADDR_RW_OPTIONS options);
+		DWORD (DLLCALLCONV *WriteAddrBlock)(WDC_DEVICE_HANDLE hDev, DWORD dwAddrSpace, KPTR dwOffset, DWORD dwBytes, PVOID pData, WDC_ADDR_MODE mode, WDC_ADDR_RW_OPTIONS options);
+		DWORD (DLLCALLCONV *DMASGBufLock)(WDC_DEVICE_HANDLE hDev, PVOID pBuf, DWORD dwOptions, DWORD dwDMABufSize, WD_DMA **ppDma);
+		DWORD (DLLCALLCONV *DMABufUnlock)(WD_DMA *pDma);
+		DWORD (DLLCALLCONV *DMASyncCpu)(WD_DMA *pDma);
+		DWORD (DLLCALLCONV *DMASyncIo)(WD_DMA *pDma);
+		void  (*IntSetup)(WDC_DEVICE_HANDLE hDev, U8 ModNum, U16 RunType);
+		DWORD (*IntDisable)(WDC_DEVICE_HANDLE hDev);
+		BOOL  (*DeviceClose)(WDC_DEVICE_HANDLE hDev);
+	} PIXIE500E_BACKEND;
+
+	extern const PIXIE500E_BACKEND PIXIE500E_WinDriver_Backend;
+	extern const PIXIE500E_BACKEND Pixie_Emu_Backend;
+	extern const PIXIE500E_BACKEND *PIXIE500E_Backend;
+
 
 
 	/*************************************************************
@@ -468,6 +493,20 @@ extern "C" {
 	const char *PIXIE500E_GetLastErr(void);
 
 	DWORD PIXIE500E_ReadWriteReg(WDC_DEVICE_HANDLE hDev, DWORD dwReg, WDC_DIRECTION direction, void * value, BOOL fPciCfg);
+	DWORD PIXIE500E_WriteFIFO(WDC_DEVICE_HANDLE hDev, DWORD dwReg, const UINT32 *data, UINT32 nWords);
+
+	// Memory and DMA buffer access through the selected backend, as the WDC_ functions of the same names
+	DWORD PIXIE500E_ReadAddr32(WDC_DEVICE_HANDLE hDev, DWORD dwAddrSpace, KPTR dwOffset, UINT32 *val);
+	DWORD PIXIE500E_WriteAddr32(WDC_DEVICE_HANDLE hDev, DWORD dwAddrSpace, KPTR dwOffset, UINT32 val);
+	DWORD PIXIE500E_ReadAddrBlock(WDC_DEVICE_HANDLE hDev, DWORD dwAddrSpace, KPTR dwOffset, DWORD dwBytes, PVOID pData, WDC_ADDR_MODE mode, WDC_ADDR_RW_OPTIONS options);
+	DWORD PIXIE500E_WriteAddrBlock(WDC_DEVICE_HANDLE hDev, DWORD dwAddrSpace, KPTR dwOffset, DWORD dwBytes, PVOID pData, WDC_ADDR_MODE mode, WDC_ADDR_RW_OPTIONS options);
+	DWORD PIXIE500E_DMASGBufLock(WDC_DEVICE_HANDLE hDev, PVOID pBuf, DWORD dwOptions, DWORD dwDMABufSize, WD_DMA **ppDma);
+	DWORD PIXIE500E_DMABufUnlock(WD_DMA *pDma);
+	DWORD PIXIE500E_DMASyncCpu(WD_DMA *pDma);
+	DWORD PIXIE500E_DMASyncIo(WD_DMA *pDma);
+
+	// Emulated modules (pixie_emu.c)
+	WDC_DEVICE_HANDLE Pixie_Emu_Open(U8 ModNum);
 
 	// EEPROM IO
 	UINT32 PIXIE500E_ReadI2C(WDC_DEVICE_HANDLE hDev, void *buffer, UINT32 devAddr, UINT32 offset, UINT32 len);
@@ -485,6 +524,8 @@ extern "C" {
 	void PIXIE500E_LBClkReset(WDC_DEVICE_HANDLE hDev);
 	// DMA tests
 	UINT32 PIXIE500E_DMA_Trace_Setup(WDC_DEVICE_HANDLE hDev, DWORD dwDMABufSize, DWORD *dwDMABuffer, WD_DMA **ppDmaL2P);
+	UINT32 PIXIE500E_DMA_Ring_Setup(WDC_DEVICE_HANDLE hDev, DWORD dwDMABufSize, DWORD *dwDMABuffer, WD_DMA **ppDmaL2P, INT32 *pCodeBuffer);
+	UINT32 PIXIE500E_DMA_Ring_Arm(WDC_DEVICE_HANDLE hDev, INT32 *pCodeBuffer, WD_DMA *pDmaL2P);
 //	UINT32 PIXIE500E_DMA_SDRAM_Test(WDC_DEVICE_HANDLE hDev, DWORD dwDMABufSize, BOOL fPolling, BOOL fIsRead);
 //	UINT32 PIXIE500E_DMA_SDRAM_Trace(WDC_DEVICE_HANDLE hDev, DWORD dwDMABufSize, DWORD *dwDMABuffer, BOOL fPolling, BOOL fIsRead);
 //	void PIXIE500E_VDMACodeGen_P2L_L2P(WDC_DEVICE_HANDLE hDev, const void *pCodeBuffer, const WD_DMA *pDmaP2L, const WD_DMA *pDmaL2P);
@@ -53,6 +53,8 @@
  *		Pixie_Hand_Down_Names
  *		Pixie_Boot_System
  *		Pixie_User_Par_IO
+ *		Pixie_User_Par_Begin
+ *		Pixie_User_Par_Commit
  *		Pixie_Acquire_Data
  *		Pixie_Set_Current_ModChan
  *		Pixie_Buffer_IO
@@ -319,6 +321,8 @@ S32 Pixie_Boot_System ( U16 Boot_Pattern )	// bit mask
 			} */
 			break;
 		case EXPRESS_PCI:
+			if(Offline == OFFLINE_EMULATOR)		/* emulated modules take no FPGA and DSP code */
+				break;
 			/* Read P4e FPGA configuration (general)   */
 			retval=Load_U16(Boot_File_Name_List[0], P4E_FPGA_CONFIG, (N_P4E_BYTES/4));
 			if(retval < 0) {
@@ -488,6 +492,79 @@ S32 Pixie_User_Par_IO (
 }
 
 
+/****************************************************************
+ *	Pixie_User_Par_Begin function
+ *		Open a parameter transaction in a module, or in all modules
+ *		if ModNum==Number_Modules. Until Pixie_User_Par_Commit,
+ *		Pixie_User_Par_IO writes update the user and DSP parameters
+ *		of the library, but DSP parameters are not downloaded and
+ *		the FiPPI is not programmed. A whole settings set is then
+ *		applied with one download and one PROGRAM_FIPPI per module.
+ *		Reading DSP memory or starting a run or control task in 
+ *		a module applies its changes first.
+ *
+ *		Return Value:
+ *			 0 - success
+ *			-1 - invalid Pixie module number
+ *
+ ****************************************************************/
+
+S32 Pixie_User_Par_Begin (
+			U8  ModNum )				// number of the module to work on
+{
+	if(ModNum > Number_Modules)
+	{
+		sprintf(ErrMSG, "*ERROR* (Pixie_User_Par_Begin): invalid Pixie module number, ModNum=%d", ModNum);
+		Pixie_Print_MSG(ErrMSG,1);
+		return(-1);
+	}
+
+	if(ModNum == Number_Modules) Par_Trans_Begin(0, Number_Modules);
+	else                         Par_Trans_Begin(ModNum, ModNum + 1);
+	return(0);
+}
+
+
+/****************************************************************
+ *	Pixie_User_Par_Commit function
+ *		Apply the parameter writes since Pixie_User_Par_Begin and
+ *		close the transaction, in a module or in all modules if
+ *		ModNum==Number_Modules. Each module with changes gets its
+ *		DSP parameters downloaded once and the FiPPI programmed at
+ *		most once; modules are done in parallel.
+ *
+ *		Return Value:
+ *			 0 - success
+ *			-1 - invalid Pixie module number
+ *			-2 - failure to download DSP parameters
+ *			-3 - failure to program FiPPI
+ *
+ ****************************************************************/
+
+S32 Pixie_User_Par_Commit (
+			U8  ModNum )				// number of the module to work on
+{
+	S32 retval;
+
+	if(ModNum > Number_Modules)
+	{
+		sprintf(ErrMSG, "*ERROR* (Pixie_User_Par_Commit): invalid Pixie module number, ModNum=%d", ModNum);
+		Pixie_Print_MSG(ErrMSG,1);
+		return(-1);
+	}
+
+	if(ModNum == Number_Modules) retval = Par_Trans_Commit(0, Number_Modules);
+	else                         retval = Par_Trans_Commit(ModNum, ModNum + 1);
+	if(retval < 0)
+	{
+		sprintf(ErrMSG, "*ERROR* (Pixie_User_Par_Commit): failure to apply parameters, retval=%d", retval);
+		Pixie_Print_MSG(ErrMSG,1);
+		return(retval - 1);
+	}
+	return(0);
+}
+
+
 /****************************************************************
  *	Pixie_Acquire_Data function:
  *		This is the main function used for data acquisition in MCA run
@@ -524,6 +601,9 @@ S32 Pixie_User_Par_IO (
  *					0x7010					call custom process function
  *					0x7020					error check and save in new file (.b##)
  *					0x7021					error check and save in new file (.bin)
+ *					0x7030					computed PSA values
+ *					0x7040					save decoded events as columnar binary file (.lmc)
+ *					0x7050					merge files of all modules in time order, save as columnar file
  *				0x8000					manually read spectrum from a previously saved MCA file
  *				0x9000					external memory (EM) I/O
  *					0x9001					read histogram memory section of EM 
@@ -533,6 +613,14 @@ S32 Pixie_User_Par_IO (
  *					0x9005					read 2D memory section of EM
  *					0x9006					write to 2D memory section of EM
  *					0x9007					read first 8K of histogram memory section of EM 
+ *					0x9008					read online histograms of list mode runs (LM_HIST), one module,
+ *											NUMBER_OF_CHANNELS*LM_HIST_BINS (4*32768) words
+ *					0x9009					read gated online histograms, summed over all modules,
+ *											LM_HIST_GATES*LM_HIST_BINS (8*32768) words, twice HISTOGRAM_MEMORY_LENGTH
+ *					0x900A					define a gated online histogram
+ *					0x900B					read a bin range of the MCA spectra, counts or changes since the last read,
+ *											up to 1+2*NUMBER_OF_CHANNELS*MAX_HISTOGRAM_LENGTH (262145) words
+ *											in mode MCA_VIEW_CHANGED, twice HISTOGRAM_MEMORY_LENGTH
  *				0xA000 					special tasks
  *					0xA001					read data, then resume
  *
@@ -580,6 +668,16 @@ S32 Pixie_User_Par_IO (
  *					0						- no run in progress
  *					1						- run in progress
  *				CSR value					- when run tpye = 0x40FF
+ *				0							- when run type = 0x40E0, User_data receives LM_WRITER_STATS_LENGTH
+ *											  list mode pipeline counters per module (see LM_Writer_Stats)
+ *				0							- when run type = 0x40E1, User_data receives END_RUN_REPORT_LENGTH
+ *											  words per module on the last run stop (see End_Run_Report)
+ *				0							- when run type = 0x40E2, User_data receives RUN_WAIT_STATS_LENGTH
+ *											  words per control task on the time to finish (see Run_Wait_Stats)
+ *				0							- when run type = 0x40E3, User_data receives BOOT_REPORT_LENGTH
+ *											  words per module on the last boot (see Boot_Report)
+ *				0							- when run type = 0x40E4, User_data receives LOG_STATS_LENGTH
+ *											  message log counters (see Pixie_Log_Stats)
  *          total number of spills written  - when run tpye = 0x4400 or 0x4401
  *
  *			Run type 0x5000
@@ -613,6 +711,8 @@ S32 Pixie_User_Par_IO (
  * 				-0x96 - failure to read out 2D section of external memory
  *				-0x97 - failure to write to 2D section of external memory
  *				-0x98 - failure to read out first 8K of MCA section of external memory
+ *				-0x99 - invalid gated online histogram definition
+ *				-0x9A - failure to read a bin range of the MCA spectra
  *
  *          Run type 0xA000
  *				 0xA0 - success
@@ -630,19 +730,16 @@ S32 Pixie_Acquire_Data (
 			S8  *file_name,		// file name for storing run data 
 			U8  ModNum )		// Pixie module number
 {
-	U8  str[256];
 	S8  base_name[256];
-	U8	k, m, len;
+	U8	m, len;
 	U16	upper, lower, i;
 	U32 tl, th, tlh;
-	U16 idx = 65535;
 	U16 *Run_Header = NULL;
 	U16  HeaderInfo[6] = {0};
 	U16 ListFileVariant, BoardRevision;
 	U32	CSR;
 	U32 value;
 	S32	allexpress, retval=0, active, error=0, status;
-	double 	BLcut, tau;
 	unsigned char eepromEntry[6];
 	FILE *ListFilePointer = NULL;	
 	U32 CurrentModNum, MNstart, MNend;	// for looping over modules if ModNum==Number_Modules
@@ -653,7 +750,7 @@ S32 Pixie_Acquire_Data (
 	UINT32 valdptrx=0;
 	// for temp list run
 	U32 *listBuffer = NULL;
-	U32 Wcount, dwStatus, datatimeout, timeout, timeouterror, extraspillcount;
+	U32 Wcount, dwStatus, timeouterror;
 	U32 clrbuffer[MAX_HISTOGRAM_LENGTH*NUMBER_OF_CHANNELS]={0};
 //#define MEASURERUNTIME	// to measure time between spills for data rate measurement
 
@@ -706,7 +803,7 @@ S32 Pixie_Acquire_Data (
 			{  
 				case ADJUST_OFFSETS:  
 					if (PCIBusType==EXPRESS_PCI) 
-						retval=Adjust_Offsets_DSP(ModNum);	// for P4e, redirect old adjust offsets with ramp to new DSP implementation 
+						retval=Tune_Modules(ModNum, ADJUST_OFFSETS_DSP);	// for P4e, redirect old adjust offsets with ramp to new DSP implementation 
 					else
 						retval=Adjust_Offsets(ModNum);
 					if(retval < 0)
@@ -718,7 +815,7 @@ S32 Pixie_Acquire_Data (
 					break;
 
 				case ADJUST_OFFSETS_DSP:  
-					retval=Adjust_Offsets_DSP(ModNum);
+					retval=Tune_Modules(ModNum, ADJUST_OFFSETS_DSP);
 					if(retval < 0)
 					{
 						sprintf(ErrMSG, "*ERROR* (Pixie_Acquire_Data): failure to adjust offsets in Module %d, retval=%d", ModNum, retval);
@@ -760,54 +857,15 @@ S32 Pixie_Acquire_Data (
 					break;
 					
 				case ADJUST_BLCUT:
-					/* Find baseline cut value */
-					/* k is the current channel number */
-					/* CurrentModNum is the current module number */
-					for(CurrentModNum = MNstart; CurrentModNum < MNend ; CurrentModNum ++) {
-						for(k = 0; k < NUMBER_OF_CHANNELS; k++) {
-							BLcut_Finder(CurrentModNum, k, &BLcut);
-						}
-						/* Program FiPPI */
-						Control_Task_Run(CurrentModNum, PROGRAM_FIPPI, 1000);
-						sprintf(ErrMSG, "Module %d finished adjusting BLcut", CurrentModNum);
-						Pixie_Print_MSG(ErrMSG,1);
-					}
+					/* Find baseline cut value in all channels, then program FiPPI */
+					Tune_Modules(ModNum, ADJUST_BLCUT);
 					break;
 					
 
 				case ADJUST_TAU:
 						
-				    /* Find tau value */
-				    /* k is the current channel number */
-				    /* CurrentModNum is the current module number */ 
-				    for(CurrentModNum = MNstart; CurrentModNum < MNend ; CurrentModNum ++) {
-						for(k = 0; k < NUMBER_OF_CHANNELS; k++) {
-							/* The index offset for channel parameters */
-							idx=Find_Xact_Match("TAU", Channel_Parameter_Names, N_CHANNEL_PAR);
-							tau = Pixie_Devices[CurrentModNum].Channel_Parameter_Values[k][idx]*1.0e-6; 
-							Tau_Finder(CurrentModNum, (U8)k, &tau);	
-							tau /= 1.0e-6;
-							Pixie_Devices[CurrentModNum].Channel_Parameter_Values[k][idx]=tau;
-							/* Update DSP parameters */
-							sprintf(str,"PREAMPTAUA%d",k);
-							idx=Find_Xact_Match(str, DSP_Parameter_Names, N_DSP_PAR);
-							Pixie_Devices[CurrentModNum].DSP_Parameter_Values[idx]=(U16)floor(tau);
-							/* Download to the data memory */
-							value = (U32)Pixie_Devices[CurrentModNum].DSP_Parameter_Values[idx];
-							Pixie_IODM(CurrentModNum, (DATA_MEMORY_ADDRESS+idx), MOD_WRITE, 1, &value);
-							sprintf(str,"PREAMPTAUB%d",k);
-							idx=Find_Xact_Match(str, DSP_Parameter_Names, N_DSP_PAR);
-							Pixie_Devices[CurrentModNum].DSP_Parameter_Values[idx]=(U16)((tau-floor(tau))*65536);
-							/* Download to the data memory */
-							value = (U32)Pixie_Devices[CurrentModNum].DSP_Parameter_Values[idx];
-							Pixie_IODM(CurrentModNum, (DATA_MEMORY_ADDRESS+idx), MOD_WRITE, 1, &value);			
-							BLcut_Finder(CurrentModNum, (U8)k, &BLcut);
-						}
-						/* Program FiPPI */
-						Control_Task_Run(CurrentModNum, PROGRAM_FIPPI, 1000);
-						sprintf(ErrMSG, "Module %d finished adjusting tau", CurrentModNum);
-						Pixie_Print_MSG(ErrMSG,1);
-				    }
+				    /* Find tau value in all channels, download it, find BLcut, then program FiPPI */
+				    Tune_Modules(ModNum, ADJUST_TAU);
 				    break;
 
 				
@@ -954,7 +1012,7 @@ S32 Pixie_Acquire_Data (
 					listFile[0] = fopen(file_name, "wb"); // create empty file, kept open for polling loop 
 					for  (CurrentModNum = MNstart; CurrentModNum < MNend ; CurrentModNum ++) {
 						LMBufferCounter[CurrentModNum]=0;
-						EndRunFound[CurrentModNum]=0;
+						__atomic_store_n(&EndRunFound[CurrentModNum], 0, __ATOMIC_RELEASE);
 					}
 					
 					sprintf(ErrMSG, "*INFO* (Pixie_Acquire_Data): MultiThreadDAQ, Going into polling loop, file %s",file_name);
@@ -1010,7 +1068,8 @@ S32 Pixie_Acquire_Data (
 					
 					// Create file and write file header
 					MakeNewFile = 0;  // initialize global, also indicates to Create_List_Mode_File that this is the first call (no next)
-					EndRunFound[CurrentModNum]=0;
+					__atomic_store_n(&EndRunFound[CurrentModNum], 0, __ATOMIC_RELEASE);
+					LMCarryCount[CurrentModNum]=0;	// no event carried over from a previous run
 					retval = Create_List_Mode_File(CurrentModNum, base_name, lower);
 					if(retval<0) {						
 						sprintf(ErrMSG, "*ERROR* (Pixie_Acquire_Data): StartRun 0x140# file not found error");
@@ -1022,35 +1081,36 @@ S32 Pixie_Acquire_Data (
 	
 					// This shall be moved to Boot.
 					// DMA setup
-					pDmaList[CurrentModNum] = NULL;
-					LMBuffer[CurrentModNum] = malloc(DMA_LM_FRAMEBUFFER_LENGTH);
-					if (!LMBuffer[CurrentModNum]) {
-						sprintf(ErrMSG, "*ERROR* (Pixie_Acquire_Data): Memory allocation for list mode buffer failure");
-						Pixie_Print_MSG(ErrMSG,1);
-						return(-0x15);
+					// cache for list mode data for buffer quality control
+					// binary files are written directly from the DMA buffer if LM_ZERO_COPY is set
+					if (LMZeroCopy && (lower != 0x401) && (Setup_LM_Spans((U8)CurrentModNum) == 0)) {
+						LMBufferCopy[CurrentModNum] = NULL;
 					}
-					sprintf(ErrMSG, "*INFO* (Pixie_Acquire_Data): DMA setup ok ");
-					Pixie_Print_MSG(ErrMSG,PrintDebugMsg_daq);
-
-					memset(LMBuffer[CurrentModNum], 0x69, DMA_LM_FRAMEBUFFER_LENGTH); 
-					// cache for list mode data for buffer quality control, only if not allocated yet
-					LMBufferCopy[CurrentModNum] = malloc(DMA_LM_FRAMEBUFFER_LENGTH);
-					if (!LMBufferCopy[CurrentModNum]) {
-						sprintf(ErrMSG, "*ERROR* (Pixie_Acquire_Data): Memory allocation for list mode buffer copy failure");
-						Pixie_Print_MSG(ErrMSG,1);
-						return(-0x15);
+					else {
+						// events carried over from the previous buffer come on top of this buffer's
+						LMBufferCopy[CurrentModNum] = malloc(2*DMA_LM_FRAMEBUFFER_LENGTH);
+						if (!LMBufferCopy[CurrentModNum]) {
+							sprintf(ErrMSG, "*ERROR* (Pixie_Acquire_Data): Memory allocation for list mode buffer copy failure");
+							Pixie_Print_MSG(ErrMSG,1);
+							return(-0x15);
+						}
 					}
-					// PIXIE500E_DMA_Trace_Setup() does
+					// Setup_DMA_Ring() allocates LMRingDepth framebuffers, and for each does
 					// 1. WDC_DMASGBufLock()
 					// 2. PIXIE500E_VDMACodeGen_TraceOut()
-					// 3. PIXIE500E_DMA_ProgramSequencer()
-					retval = PIXIE500E_DMA_Trace_Setup(hDev[CurrentModNum],  DMA_LM_FRAMEBUFFER_LENGTH, LMBuffer[CurrentModNum], &pDmaList[CurrentModNum]);
+					// then PIXIE500E_DMA_ProgramSequencer() for the first one. LMBuffer points to the buffer being filled.
+					retval = Setup_DMA_Ring((U8)CurrentModNum);
+					if (retval == -1) {
+						sprintf(ErrMSG, "*ERROR* (Pixie_Acquire_Data): Memory allocation for list mode buffer failure");
+						Pixie_Print_MSG(ErrMSG,1);
+						return(-0x15);
+					}
 					if (retval != 0) {
 						sprintf(ErrMSG, "*ERROR* (Pixie_Acquire_Data): Run start, DMA setup failed, %d", retval);
 						Pixie_Print_MSG(ErrMSG,1);
 						return(-0x16);
 					}
-					sprintf(ErrMSG, "*INFO* (Pixie_Acquire_Data): PIXIE500E_DMA_Trace_Setup ok ");
+					sprintf(ErrMSG, "*INFO* (Pixie_Acquire_Data): DMA setup ok ");
 					Pixie_Print_MSG(ErrMSG,PrintDebugMsg_daq);
 					
 					retval = PIXIE500E_DMA_Init(hDev[CurrentModNum]);
@@ -1061,6 +1121,13 @@ S32 Pixie_Acquire_Data (
 					}
 					sprintf(ErrMSG, "*INFO* (Pixie_Acquire_Data): PIXIE500E_DMA_Init ok ");
 					Pixie_Print_MSG(ErrMSG,PrintDebugMsg_daq);
+
+					// with a ring of framebuffers, QC and file output move to a writer thread for this module
+					if(LMWriterThread && (LMRingSlots[CurrentModNum] > 1))
+						LM_Writer_Start((U8)CurrentModNum, lower);
+					Live_Stats_Start((U8)CurrentModNum, lower);		// if LiveStats, publish statistics of this run
+					if (LM_Hist_Start((U8)CurrentModNum) < 0)		// if LMHist, online histograms of this run
+						return(-0x15);
 					// Up to this point, moved to Boot
 
 					// Prepare interrupt processing
@@ -1110,7 +1177,7 @@ S32 Pixie_Acquire_Data (
 #endif
 
 				for(CurrentModNum = MNstart; CurrentModNum < MNend ; CurrentModNum ++) {	
-					retval = WDC_DMASyncCpu(pDmaList[CurrentModNum]); // SyncCpu needed before performing DMA transfers.
+					retval = PIXIE500E_DMASyncCpu(pDmaList[CurrentModNum]); // SyncCpu needed before performing DMA transfers.
 					sprintf(ErrMSG, "*DEBUG* (Pixie_Acquire_Data): Done with WDC_DMASyncCpu");
 					Pixie_Print_MSG(ErrMSG,PrintDebugMsg_daq);
 
@@ -1288,169 +1355,32 @@ S32 Pixie_Acquire_Data (
 
 
 					// 2. read out any remaining data from SDRAM until the module indicates run is no longer active. 
-					//	  (could be improved in speed by reading out modules in parallel)
-					timeouterror = 0;
-					for(CurrentModNum = MNstart; CurrentModNum < MNend ; CurrentModNum ++)
-					{
-						// DSP is stopped now, but there was some data out of DSP.
-						// Read it out and dump to disk until DMA is idle.
-						datatimeout=0;			// combined end condition
-						timeout=0;				// timeout just for time
-						//Wcount = 0;				// timeout after each transfer
-						extraspillcount = 1;	// number of extra spills for a module
-						if (Polling==1 || MultiThreadDAQ==1)	// if no interupts, we still need to read out the old way. But what about multi-thread 0x403?
-						{
-							while(!datatimeout)
-							{
-								Pixie_Sleep(1);
-
-								active = Check_Run_Status((U8)CurrentModNum);
-								if(active<0) {
-									sprintf(ErrMSG, "*ERROR* (Pixie_Acquire_Data): Failed to read Run Status, aborting");
-									Pixie_Print_MSG(ErrMSG,1);
-									return (-0x32);
-								}
-							//	if(active) Wcount = 0;		// this ensures we wait at least DMABUFREFILL_TIMEOUT cycles after DSP is done
-							//	sprintf(ErrMSG, "*DEBUG* (Pixie_Acquire_Data): End run: Checked RS =  %x",active);
-							//	Pixie_Print_MSG(ErrMSG,PrintDebugMsg_daq);
-
-
-								retval = 0; 
-								// if the frame buffer is not filled yet, we should not be idle.
-								dwStatus = PIXIE500E_ReadWriteReg(hDev[CurrentModNum], VDMA_CSRx, WDC_READ, &val, FALSE); // debug: polling module if DMA done
-								value = LMBuffer[CurrentModNum][DMA_LM_FRAMEBUFFER_LENGTH/sizeof(UINT32)-1];
-								//if(val!=0) {
-								// } else {
-								if ( val==0 || !(value==0xA5A5A5A5 || value==0x69696969) ) {											 
-									// Finished transferring the buffer: dump it, rewind, restart DMA sequencer
-									retval = Write_DMA_List_Mode_File ((U8)CurrentModNum, "", lower);	// =1 if end 
-									if(retval <0) 
-									{
-										sprintf(ErrMSG, "*ERROR* (Pixie_Acquire_Data): Error writing DMA data to file");
-										Pixie_Print_MSG(ErrMSG,1);
-										return (-0x38);
-									} else {
-										sprintf(ErrMSG, "*INFO* (Pixie_Acquire_Data): End run: Written another spill for ModNum=%d, count=%d",CurrentModNum, extraspillcount);
-										Pixie_Print_MSG(ErrMSG,1);
-								//		Wcount = 0;			// this ensures we wait at least N cycles after each transfer
-										timeout = 0;		// every new spill starts the DMA transfer timeout
-										extraspillcount++;
-									}		
-								} // if DMA is not idle	
-
-							//	Wcount++; 
-								timeout++;
-
-								// end conditions for the while loop
-
-								//if( (Wcount==DMABUFREFILL_TIMEOUT && active==0) || EndRunFound[CurrentModNum]==1 || retval<0 || timeout==DMATRANSFER_TIMEOUT) {		// end with timeout after DSP finished DMA flush, or on error or timeout
-								// DMABUFREFILL_TIMEOUT (50ms) after DSP or transfer done, DMATRANSFER_TIMEOUT (5000ms) max
-								// Also assumes that a max of 128 x 2MB buffer (SDRAM completely full with backlog) is read out in < 5s 
-								if( timeout>=DMATRANSFER_TIMEOUT) {	
-									datatimeout=1;		
-									sprintf(ErrMSG, "*DEBUG* (Pixie_Acquire_Data): End run: Timeout EndRunFound[0]=%d, LMBuffer[0][last]=0x%x, LMBufferCounter[0]=%d, P4e DMA status 0x%x ", EndRunFound[0],value, LMBufferCounter[0], val);
-									Pixie_Print_MSG(ErrMSG,PrintDebugMsg_daq);
-
-									// Also check what partial data we have in the buffer, check for EOR
-									retval = Write_DMA_List_Mode_File ((U8)CurrentModNum, "", lower);	// =1 if end 
-									if(retval <0) {	// error
-										sprintf(ErrMSG, "*ERROR* (Pixie_Acquire_Data): Error writing DMA data to file");
-										Pixie_Print_MSG(ErrMSG,1);
-										return (-0x38);
-									}
-									if(retval ==0) {	// processed buffer, but no EOR, DMA still on
-										sprintf(ErrMSG, "*INFO* (Pixie_Acquire_Data): End run: Written a partial spill for ModNum=%d, count=%d",CurrentModNum, extraspillcount);
-										Pixie_Print_MSG(ErrMSG,1);
-										extraspillcount++;
-									}
-									if(retval ==1)  {	// processed buffer, found EOR, stopped DMA
-										sprintf(ErrMSG, "*INFO* (Pixie_Acquire_Data): End run: Written a partial spill for ModNum=%d, count=%d",CurrentModNum, extraspillcount);
-										Pixie_Print_MSG(ErrMSG,1);
-										timeout = 0;		// every new spill starts the DMA transfer timeout
-										extraspillcount++;
-									}	
-								}	// endif timeout 		
-
-								if(EndRunFound[CurrentModNum]) {
-									sprintf(ErrMSG, "*DEBUG* (Pixie_Acquire_Data): End run: QC found EOR");
-									Pixie_Print_MSG(ErrMSG,PrintDebugMsg_daq);
-									datatimeout=1;
-
-									// also break the DSP out of its loop to flush the SDRAM data, which may wait forever
-									dwStatus = PIXIE500E_ReadWriteReg(hDev[CurrentModNum], APP_HOST_CTL, WDC_READ, &CSR, FALSE);
-									CSR=(U32)SetBit(BIT_EORR, (U16)CSR);	// Set bit 7 of APP_HOST_CTL to indicate EOR received 
-									dwStatus = PIXIE500E_ReadWriteReg(hDev[CurrentModNum], APP_HOST_CTL, WDC_WRITE, &CSR, FALSE);
-								}	// end if end run found
-							}	// time out loop
-						}	// polling
-						else {
-							while(!datatimeout)
-							{
-								Pixie_Sleep(1); 
-								//sprintf(ErrMSG, "*DEBUG* (Pixie_Acquire_Data): Waiting for endrun timeout=%d, active=%d,Wcount=%d",timeout,active,Wcount );
-								//Pixie_Print_MSG(ErrMSG,1);
-
-								active = Check_Run_Status((U8)CurrentModNum);
-								if(active<0) {
-									sprintf(ErrMSG, "*ERROR* (Pixie_Acquire_Data): Failed to read Run Status, aborting");
-									Pixie_Print_MSG(ErrMSG,1);
-									return (-0x32);
-								}
-						//		if(active) Wcount = 0;										// this ensures we wait at least N cycles after DSP is done
-						//		sprintf(ErrMSG, "*DEBUG* (Pixie_Acquire_Data): End run: Checked RS =  %x",active);
-						//		Pixie_Print_MSG(ErrMSG,PrintDebugMsg_daq);
-
-						//		Wcount++;
-								timeout++;
-
-								// end conditions for the while loop
-								if(EndRunFound[CurrentModNum]) {
-									sprintf(ErrMSG, "*DEBUG* (Pixie_Acquire_Data): End run: QC found EOR");
-									Pixie_Print_MSG(ErrMSG,PrintDebugMsg_daq);
-									datatimeout=1;
-
-									// also break the DSP out of its loop to flush the SDRAM data, which may wait forever
-									dwStatus = PIXIE500E_ReadWriteReg(hDev[CurrentModNum], APP_HOST_CTL, WDC_READ, &CSR, FALSE);
-									CSR=(U32)SetBit(BIT_EORR, (U16)CSR);	// Set bit 7 of APP_HOST_CTL to indicate EOR received 
-									dwStatus = PIXIE500E_ReadWriteReg(hDev[CurrentModNum], APP_HOST_CTL, WDC_WRITE, &CSR, FALSE);
-
-								}
-								if( timeout>=DMATRANSFER_TIMEOUT) {	
-									datatimeout=1;												
-								}	
-								//// TODO: remove Wcount from the condition below? As is will stop loop 50ms after DSP finishes, with no guarantee that interrupts are all done. But required if QC turned off?
-							    ////	if( (Wcount==DMABUFREFILL_TIMEOUT && active==0) || EndRunFound[CurrentModNum]==1 || timeout==DMATRANSFER_TIMEOUT) {				// end with timeout after DSP finished DMA flush, or on error or timeout
-								// if(                                                EndRunFound[CurrentModNum]==1 || timeout==DMATRANSFER_TIMEOUT) {				// end with timeout after DSP finished DMA flush, or on error or timeout
-								//	datatimeout=1;											// 50ms after DSP or transfer done, 5000ms max, or EOR found by readout routine 	
-								//}
-
-							}	// end while
-
-							FlushIgorMSG();
-						}	// end not polling
-						
-						if(timeout>=DMATRANSFER_TIMEOUT) {
-							// TODO: before issueing error, check if module's DSP ok
-							//Pixie_ReadCSR(CurrentModNum, &CSR);
-							//sprintf(ErrMSG, "ModNum=%d: CSR=0x%X, LMbuffer[last]=0x%X",CurrentModNum, CSR, LMBuffer[CurrentModNum][DMA_LM_FRAMEBUFFER_LENGTH/sizeof(UINT32)-1]);
-							//Pixie_Print_MSG(ErrMSG,1);
-							//sprintf(ErrMSG, "ModNum=%d: LMbuffer[first]=0x%X, LMbuffer[WM]=0x%X",CurrentModNum, LMBuffer[CurrentModNum][0],LMBuffer[CurrentModNum][WATERMARKINDEX16/2]);
-							//Pixie_Print_MSG(ErrMSG,1);
-							sprintf(ErrMSG, "*WARNING* (Pixie_Acquire_Data): End run timed out for ModNum=%d (polling = %d)",CurrentModNum, Polling);
-							Pixie_Print_MSG(ErrMSG,1);
-							timeouterror =1;
-							//return(-0x32);
-						}
+					//	  All modules in parallel, with a common deadline; End_Run_Flush() reports per module
+					retval = End_Run_Flush((U8)MNstart, (U8)MNend, lower);
+					FlushIgorMSG();
+					timeouterror = (retval == 1);
 
-					//	sprintf(ErrMSG, "*DEBUG* (Pixie_Acquire_Data): data read wait done for module %d",CurrentModNum);
-					//	Pixie_Print_MSG(ErrMSG,PrintDebugMsg_daq);
+					// all buffers handed over: let the writer threads finish the files
+					for(CurrentModNum = MNstart; CurrentModNum < MNend ; CurrentModNum ++) {
+						LM_Writer_Stop((U8)CurrentModNum);
+						Live_Stats_Stop((U8)CurrentModNum);
+					}
 
-					} // for modules
+					if(retval == -1) {
+						sprintf(ErrMSG, "*ERROR* (Pixie_Acquire_Data): Failed to read Run Status, aborting");
+						Pixie_Print_MSG(ErrMSG,1);
+						return (-0x32);
+					}
+					if(retval == -2) {
+						sprintf(ErrMSG, "*ERROR* (Pixie_Acquire_Data): Error writing DMA data to file");
+						Pixie_Print_MSG(ErrMSG,1);
+						return (-0x38);
+					}
 
 					if(timeouterror) {
 						sprintf(ErrMSG, "*WARNING* (Pixie_Acquire_Data): End run timed out for at least one module, data may be incomplete");
 						Pixie_Print_MSG(ErrMSG,1);
-						return(0); //-0x32); suppress error return here: still need to clean up DMA etc. 
+						// no error return here: still need to clean up DMA etc., 0 is returned after that
 					}
 
 #ifdef MEASURERUNTIME
@@ -1485,20 +1415,27 @@ S32 Pixie_Acquire_Data (
 						Pixie_Sleep(10);
 			
 						// Clean up after the run
-						if (pDmaList[CurrentModNum] != NULL) {
-							retval = WDC_DMASyncIo(pDmaList[CurrentModNum]);
-							retval = WDC_DMABufUnlock(pDmaList[CurrentModNum]);
-							pDmaList[CurrentModNum] = NULL;
-						}
-						if (LMBuffer[CurrentModNum] != NULL) {
-							free(LMBuffer[CurrentModNum]);
-							LMBuffer[CurrentModNum] = NULL;
-						}
+						LM_Writer_Stop((U8)CurrentModNum);
+						Release_DMA_Ring((U8)CurrentModNum);
 						if (LMBufferCopy[CurrentModNum] != NULL) {
 							free(LMBufferCopy[CurrentModNum]);
 							LMBufferCopy[CurrentModNum] = NULL;
 						}
-						fclose(listFile[CurrentModNum]); // close if using global listFile array
+						Release_LM_Spans((U8)CurrentModNum);
+						if (LMCarryCount[CurrentModNum] > 0) {
+							sprintf(ErrMSG, "*WARNING* (Pixie_Acquire_Data): EndRun: module %d, incomplete event at end of run discarded (%d words)", CurrentModNum, LMCarryCount[CurrentModNum]);
+							Pixie_Print_MSG(ErrMSG,1);
+							LMCarryCount[CurrentModNum] = 0;
+						}
+						if (LMCarry[CurrentModNum] != NULL) {
+							free(LMCarry[CurrentModNum]);
+							LMCarry[CurrentModNum] = NULL;
+							LMCarrySize[CurrentModNum] = 0;
+						}
+						if (listFile[CurrentModNum]) {
+							fclose(listFile[CurrentModNum]); // close if using global listFile array
+							listFile[CurrentModNum] = NULL;	// not closed again by Create_List_Mode_File of the next run
+						}
 						sprintf(ErrMSG, "*DEBUG* (Pixie_Acquire_Data): EndRun: ListMode DMA resources released.");
 						Pixie_Print_MSG(ErrMSG,PrintDebugMsg_daq);
 
@@ -1583,7 +1520,7 @@ S32 Pixie_Acquire_Data (
 							Pixie_Print_MSG(ErrMSG,1);
 							return(-0x36);
 						}
-						retval = WDC_DMASyncCpu(pDmaTrace);
+						retval = PIXIE500E_DMASyncCpu(pDmaTrace);
 						retval = Start_Run((U8)CurrentModNum, NEW_RUN, 0, GET_TRACES);
 						if (retval != 0) {
 							sprintf(ErrMSG, "*ERROR* (Pixie_Acquire_Data): EndRun: Dummy start run failed");
@@ -1629,6 +1566,9 @@ S32 Pixie_Acquire_Data (
 
 
 					} // for modules
+
+					if(timeouterror)
+						return(0); //-0x32); data may be incomplete
 #endif
 					break;
 
@@ -1731,7 +1671,7 @@ S32 Pixie_Acquire_Data (
 								if (PollForNewData)
 								{
 									// return new data = from current to end of block	
-									memcpy(User_data, &LMBuffer[0][DMADataPos], (DMA_LM_FRAMEBUFFER_LENGTH/4-DMADataPos)*sizeof(U32));
+									memcpy(User_data, &LMBufferDone[0][DMADataPos], (DMA_LM_FRAMEBUFFER_LENGTH/4-DMADataPos)*sizeof(U32));
 									DMADataPos =numDWordsLeftover[0];		// restart from beginning plus the leftovers from last buffer
 									sprintf(ErrMSG, "*DEBUG* (Pixie_Acquire_Data 0x440x_06): reset DMADataPos = %d.",DMADataPos);
 									Pixie_Print_MSG(ErrMSG,PrintDebugMsg_daq);
@@ -1797,7 +1737,7 @@ S32 Pixie_Acquire_Data (
 								if (PollForNewData)
 								{
 									// return new data = from current to end of block	
-									memcpy(User_data, &LMBuffer[0][DMADataPos], (DMA_LM_FRAMEBUFFER_LENGTH/4-DMADataPos)*sizeof(U32));
+									memcpy(User_data, &LMBufferDone[0][DMADataPos], (DMA_LM_FRAMEBUFFER_LENGTH/4-DMADataPos)*sizeof(U32));
 									DMADataPos =numDWordsLeftover[0];		// restart from beginning plus the leftovers from last buffer
 									sprintf(ErrMSG, "*DEBUG* (Pixie_Acquire_Data 0x440x_06): reset DMADataPos = %d.",DMADataPos);
 									Pixie_Print_MSG(ErrMSG,PrintDebugMsg_daq);
@@ -1812,6 +1752,7 @@ S32 Pixie_Acquire_Data (
 
 					// polling or not, increment the buffer counters
 					retval += LMBufferCounter[CurrentModNum];
+					Live_Stats_Sample((U8)CurrentModNum, 0);		// DSP run statistics, at most every LIVE_STATS_DSP_MS
  
 				} // for modules
 #endif
@@ -1844,6 +1785,36 @@ S32 Pixie_Acquire_Data (
 				break;
 */
 				
+#ifdef WINDRIVER_API
+				case 0x0E0:  /* list mode writer pipeline counters, all modules */
+					for(CurrentModNum = MNstart; CurrentModNum < MNend ; CurrentModNum ++)
+						LM_Writer_Stats((U8)CurrentModNum, &User_data[CurrentModNum*LM_WRITER_STATS_LENGTH]);
+					retval = 0;
+					break;
+
+				case 0x0E1:  /* end of run flush report, all modules */
+					for(CurrentModNum = MNstart; CurrentModNum < MNend ; CurrentModNum ++)
+						End_Run_Report((U8)CurrentModNum, &User_data[CurrentModNum*END_RUN_REPORT_LENGTH]);
+					retval = 0;
+					break;
+#endif
+
+				case 0x0E2:  /* control task completion times, all tasks */
+					Run_Wait_Stats(User_data);
+					retval = 0;
+					break;
+
+				case 0x0E3:  /* boot report, all modules */
+					for(CurrentModNum = MNstart; CurrentModNum < MNend ; CurrentModNum ++)
+						Boot_Report((U8)CurrentModNum, &User_data[CurrentModNum*BOOT_REPORT_LENGTH]);
+					retval = 0;
+					break;
+
+				case 0x0E4:  /* message log counters */
+					Pixie_Log_Stats(User_data);
+					retval = 0;
+					break;
+
 				case 0x0F0:  /* read Config Status Register */
 					Pixie_Register_IO(ModNum, PCI_CFSTATUS, MOD_READ, &CSR);
 					retval=CSR & 0xFFFF;
@@ -2069,7 +2040,7 @@ S32 Pixie_Acquire_Data (
 				case 0x101:
 				case 0x102:
 				case 0x103:
-					retval=Write_List_Mode_File(file_name);
+					retval=Write_List_Mode_File(file_name, 0);
 					break;
 
 				case 0x400:
@@ -2291,6 +2262,28 @@ S32 Pixie_Acquire_Data (
 
 					break;
 
+				case 0x40:  /* columnar binary file */
+					if (ListFileVariant == P500E_LIST_FILE) retval=LM_Columns_Write(file_name, User_data);
+					if(retval < 0)
+					{
+						sprintf(ErrMSG, "*ERROR* (Pixie_Acquire_Data): failure to read list mode data, retval=%d", retval);
+						Pixie_Print_MSG(ErrMSG,1);
+						return(-0x79);
+					}
+
+					break;
+
+				case 0x50:  /* time ordered merge of all modules' files to one columnar file */
+					if (ListFileVariant == P500E_LIST_FILE) retval=LM_Merge_Write(file_name, User_data);
+					if(retval < 0)
+					{
+						sprintf(ErrMSG, "*ERROR* (Pixie_Acquire_Data): failure to read list mode data, retval=%d", retval);
+						Pixie_Print_MSG(ErrMSG,1);
+						return(-0x79);
+					}
+
+					break;
+
 
 				default:
 					sprintf(ErrMSG, "*ERROR* (Pixie_Acquire_Data): invalid list mode parse analysis request, Run Type=%d", Run_Type);
@@ -2347,6 +2340,7 @@ S32 Pixie_Acquire_Data (
 						Pixie_Print_MSG(ErrMSG,1);
 						return(-0x92);
 					}
+					MCA_View_Reset(ModNum);		// 0x900B changes count from zero again, as after Start_Run
 
 					break;
 
@@ -2444,6 +2438,35 @@ S32 Pixie_Acquire_Data (
 					}
 					
 					break;
+
+				case 0x8:
+					/* Read online histograms of module ModNum, NUMBER_OF_CHANNELS x LM_HIST_BINS */
+					LM_Hist_Read(ModNum, User_data);
+					retval = 0;
+					break;
+
+				case 0x9:
+					/* Read gated online histograms, all modules, LM_HIST_GATES x LM_HIST_BINS */
+					LM_Hist_Read_Gated(User_data);
+					retval = 0;
+					break;
+
+				case 0xA:
+					/* Define gated online histogram User_data[0] from the LM_HIST_GATE_WORDS words that follow */
+					if(LM_Hist_Set_Gate(User_data[0], &User_data[1]) < 0)
+						return(-0x99);
+					retval = 0;
+					break;
+
+				case 0xB:
+					/* Read bins User_data[1] to User_data[1]+User_data[2]-1 of channel User_data[0] (MCA_VIEW_ALL: all) */
+					/* of module ModNum; User_data[3] is the mode, MCA_VIEW_xxx. User_data receives the result, */
+					/* in mode MCA_VIEW_CHANGED up to 1+2*channels*bins words */
+					retval = MCA_View_Read(ModNum, (U16)User_data[0], User_data[1], User_data[2], (U16)User_data[3], User_data);
+					if(retval < 0)
+						return(-0x9A);
+					retval = 0;
+					break;
 					
 				default:
 					sprintf(ErrMSG, "*ERROR* (Pixie_Acquire_Data): invalid external memory I/O request, Run Type=%d", Run_Type);
@@ -2801,7 +2824,7 @@ S32 Pixie_Buffer_IO (
 			if(settingsFile != NULL)
 			{
 				/* Read out the DSP I/O parameters for all the Pixie modules in the system */
-				if (Offline == 0) {
+				if (Offline != 1) {
 					for(i=0; i<Number_Modules; i++)
 					{
 						Pixie_IODM((U8)i, DATA_MEMORY_ADDRESS, MOD_READ, N_DSP_PAR, buffer);
@@ -0,0 +1,1014 @@
+/*----------------------------------------------------------------------
+* Copyright (c) 2004, 2009, 2015 XIA LLC
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, 
+* with or without modification, are permitted provided 
+* that the following conditions are met:
+*
+*   * Redistributions of source code must retain the above 
+*     copyright notice, this list of conditions and the 
+*     following disclaimer.
+*   * Redistributions in binary form must reproduce the 
+*     above copyright notice, this list of conditions and the 
+*     following disclaimer in the documentation and/or other 
+*     materials provided with the distribution.
+*   * Neither the name of XIA LLC
+*     nor the names of its contributors may be used to endorse 
+*     or promote products derived from this software without 
+*     specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND 
+* CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+* INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF 
+* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+* IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE 
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON 
+* ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR 
+* TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF 
+* THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF 
+* SUCH DAMAGE.
+*----------------------------------------------------------------------*/
+
+/******************************************************************************
+*
+* File name:
+*
+*      pixie_emu.c
+*
+* Description:
+*
+*      Pixie-4e modules emulated in software, selected with 
+*      OFFLINE_ANALYSIS = OFFLINE_EMULATOR. The emulator is a device backend 
+*      (see PIXIE500E_BACKEND in pixie500e_lib.h): the library talks to it 
+*      through the same register, memory, DMA and interrupt calls as to the 
+*      WinDriver backend, so boot, parameter I/O, runs and the list mode 
+*      readout execute their normal code paths without hardware.
+*
+*      Emulated per module:
+*        - registers: run and control task enables and run active status,
+*          parameter I/O mailbox, VDMA sequencer CSR
+*        - DSP parameter memory (FPGA_PARAM_RAM) and descriptor RAM
+*        - external memory with the MCA (and the 2D MCA range)
+*        - the VDMA transfer into the framebuffer armed with the SG list:
+*          synthetic 0x400-0x403 events of the good channels, at EmuRate kcps
+*          (0 = as fast as the host takes them), followed by the end of run 
+*          record when the run stops
+*        - run statistics (RUNTIME, NUMEVENTS, COUNTTIME, FASTPEAKS)
+*        - ADC traces for control task GET_TRACES
+*
+*      EmuErrors injects watermark, checksum, short trace and split event
+*      errors into the list mode data, to exercise the buffer QC.
+*
+*      A fill thread per module plays the part of DSP and DMA engine. When
+*      the framebuffer is full it clears the sequencer CSR and, in interrupt 
+*      mode, calls Write_DMA_List_Mode_File() like the interrupt handler.
+*      FPGA and DSP downloads are accepted and ignored; other control tasks 
+*      only report run active for EMU_CTRL_US.
+*
+* Member functions:
+*					Pixie_Emu_Open()			- create (or find) the emulated module
+*					Pixie_Emu_Backend			- device backend of the emulated modules
+*
+******************************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "PlxTypes.h"
+#include "PciTypes.h"
+#include "Plx.h"
+
+#include "globals.h"
+#include "sharedfiles.h"
+#include "utilities.h"
+
+#ifdef WINDRIVER_API
+
+#define EMU_REGS			(EMDATA + 1)		// registers in the order of pixie500e_lib.h
+#define EMU_DESC_WORDS		0x800				// descriptor RAM, m_RAMSize/4
+#define EMU_LOCKED_MAX		(DMA_LM_RING_MAX + 4)	// DMA buffers locked at the same time
+#define EMU_BASELINE		400					// ADC baseline of the synthetic traces
+#define EMU_TAU				50					// decay time of the synthetic pulses, samples
+
+struct Emu_Module {
+	U8  ModNum;
+	U32 Stop;								// set to end the fill thread
+	pthread_t Thread;
+	pthread_mutex_t Lock;					// protects everything below against host calls
+	pthread_cond_t Wake;					// host wrote a register the fill thread waits for
+	pthread_cond_t Idle;					// fill thread let go of a framebuffer
+
+	U32 Reg[EMU_REGS];
+	U32 Param[N_DSP_PAR];					// DSP parameter memory
+	U32 Desc[EMU_DESC_WORDS];				// VDMA descriptor RAM
+	U32 *MCA;								// external memory: NUMBER_OF_CHANNELS x MAX_HISTOGRAM_LENGTH
+	U32 *MCA2D;								// external memory, upper range (BIT_MCAUPPERA)
+	U32 EMAddr;								// external memory address of the last read (reads are pipelined)
+
+	U32 Csr;								// VDMA sequencer running
+	U32 GoSeen;								// report running once after Go, even if the buffer is filled at once
+	WD_DMA *Locked[EMU_LOCKED_MAX];
+	WD_DMA *Target;							// framebuffer of the SG list at the last Go
+	WD_DMA *Busy;							// framebuffer the fill thread writes outside the lock
+	U32 Pos;								// next word in Target
+	U32 LastWord;							// last framebuffer word, written with Csr = 0
+	U32 LastPending;
+
+	U16 RunType;
+	U32 RunActive;
+	U32 EorPending;							// run stopped, end of run record not yet written
+	U32 TracePending;						// GET_TRACES done, traces go out with the next Go
+	U64 CtrlEnd;							// end of the control task, us
+	U64 RunStart;							// us
+	U64 RunTimeAcc;							// run time of previous (resumed) runs, us
+	U64 Generated;							// events generated since RunStart (rate limit)
+	U64 NumEvents;
+	U32 ChanEvents[NUMBER_OF_CHANNELS];
+	U32 Buffers;							// framebuffers filled in this run
+	double TimeStamp;						// ADC ticks
+	double TickMHz;
+	double DSPMHz;
+	double FilterMHz;
+	double CTScale;
+	U32 Good;								// good channels (CHANCSRA bit 2)
+	U32 Blocks[NUMBER_OF_CHANNELS];			// trace blocks per channel
+	U32 PrevBlocks;							// trace blocks of the previous event
+	U32 *Evt;								// event being written, may span two framebuffers
+	U32 EvtLen;
+	U32 EvtPos;
+	U32 EvtMax;
+	U16 *Pulse;								// pulse shape, 4096 = full amplitude
+	U32 PulseLen;
+	U32 Rng;
+
+	U32 IntEnabled;
+	U8  IntModNum;
+	U16 IntRunType;
+};
+
+static struct Emu_Module *Emu[PRESET_MAX_MODULES];
+
+
+static U64 Emu_us (void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return((U64)ts.tv_sec*1000000 + ts.tv_nsec/1000);
+}
+
+static U32 Emu_Random (struct Emu_Module *m)
+{
+	U32 x = m->Rng;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	m->Rng = x;
+	return(x);
+}
+
+/* uniform in (0,1] */
+static double Emu_Uniform (struct Emu_Module *m)
+{
+	return(((Emu_Random(m) >> 8) + 1) / 16777216.0);
+}
+
+static U32 Emu_Par (struct Emu_Module *m, S8 *name)
+{
+	U16 idx = Find_Xact_Match(name, DSP_Parameter_Names, N_DSP_PAR);
+
+	return((idx < N_DSP_PAR) ? m->Param[idx] : 0);
+}
+
+/* 48 bit run statistics counter, high word first */
+static void Emu_Put48 (struct Emu_Module *m, U16 idx, U64 value)
+{
+	if(idx + 2 >= N_DSP_PAR)
+		return;
+	m->Param[idx]     = (U32)((value >> 32) & 0xFFFF);
+	m->Param[idx + 1] = (U32)((value >> 16) & 0xFFFF);
+	m->Param[idx + 2] = (U32)(value & 0xFFFF);
+}
+
+static void Emu_Put32 (struct Emu_Module *m, U16 idx, U32 value)
+{
+	if(idx + 1 >= N_DSP_PAR)
+		return;
+	m->Param[idx]     = value >> 16;
+	m->Param[idx + 1] = value & 0xFFFF;
+}
+
+
+/****************************************************************
+*	Emu_Update_Stats function:
+*		Write the run statistics to the DSP parameter memory,
+*		with lock held. There is no dead time: live time = run time.
+****************************************************************/
+static void Emu_Update_Stats (struct Emu_Module *m, U64 now)
+{
+	double t = (m->RunTimeAcc + (m->RunActive ? now - m->RunStart : 0)) * 1e-6;
+	U32 ch;
+
+	Emu_Put48(m, RUNTIME_Index, (U64)(t * m->DSPMHz * 1e6));
+	Emu_Put32(m, NUMEVENTS_Index, (U32)m->NumEvents);
+	for(ch = 0; ch < NUMBER_OF_CHANNELS; ch++) {
+		Emu_Put48(m, COUNTTIME_Index[ch], (U64)(t * m->FilterMHz * 1e6 / m->CTScale));
+		Emu_Put32(m, FASTPEAKS_Index[ch], m->ChanEvents[ch]);
+	}
+}
+
+
+/****************************************************************
+*	Emu_Run_Start function:
+*		RUNENA set: read the run settings from the DSP parameters,
+*		with lock held. Waits until the fill thread is done with
+*		the events of the previous run, which may still be copied
+*		out of the lock (end of run record).
+****************************************************************/
+static void Emu_Run_Start (struct Emu_Module *m, U64 now)
+{
+	U16 sys, filter, adc, ctscale, dsp;
+	U32 ch, len, i, total;
+	S8 str[256];
+
+	while(m->Busy)
+		pthread_cond_wait(&m->Idle, &m->Lock);
+
+	m->RunType = (U16)(m->Param[Run_Task_Index] & 0x0FFF);
+	if(m->Param[Resume_Index] == NEW_RUN) {
+		m->RunTimeAcc = 0;
+		m->NumEvents  = 0;
+		memset(m->ChanEvents, 0, sizeof(m->ChanEvents));
+		m->TimeStamp  = 0.0;
+	}
+	Pixie_Define_Clocks(m->ModNum, 0, &sys, &filter, &adc, &ctscale, &dsp);
+	m->TickMHz   = adc;
+	m->DSPMHz    = dsp;
+	m->FilterMHz = filter;
+	m->CTScale   = (ctscale > 0) ? ctscale : 1;
+
+	m->Good = 0;
+	total = 0;
+	len = 0;
+	for(ch = 0; ch < NUMBER_OF_CHANNELS; ch++) {
+		sprintf(str, "CHANCSRA%d", ch);
+		if(TstBit(2, (U16)Emu_Par(m, str)))		// good channel
+			m->Good |= 1 << ch;
+		sprintf(str, "TRACELENGTH%d", ch);
+		m->Blocks[ch] = (m->RunType == 0x401) ? 0 : Emu_Par(m, str) / BLOCKSIZE;
+		total += m->Blocks[ch];
+		if(m->Blocks[ch] * BLOCKSIZE > len)
+			len = m->Blocks[ch] * BLOCKSIZE;
+	}
+	total = MAX_CHAN_HEAD_LENGTH/2 + total * BLOCKSIZE/2;
+	if(total > m->EvtMax) {
+		free(m->Evt);
+		m->Evt = malloc(total * sizeof(U32));
+		m->EvtMax = m->Evt ? total : 0;
+	}
+	if(len > m->PulseLen) {
+		free(m->Pulse);
+		m->Pulse = malloc(len * sizeof(U16));
+		m->PulseLen = m->Pulse ? len : 0;
+		for(i = 0; i < m->PulseLen; i++)
+			m->Pulse[i] = (U16)(4096.0 * (1.0 - exp(-(double)i/3.0)) * exp(-(double)i/EMU_TAU) * 1.3);
+	}
+	if(m->Evt == NULL || (len && m->Pulse == NULL)) {
+		sprintf(ErrMSG, "*ERROR* (Pixie_Emu): module %d, memory allocation failure, no events", m->ModNum);
+		Pixie_Print_MSG(ErrMSG,1);
+		m->Good = 0;
+	}
+
+	m->PrevBlocks   = 0;
+	m->EvtLen       = 0;
+	m->EvtPos       = 0;
+	m->Buffers      = 0;
+	m->Generated    = 0;
+	m->RunStart     = now;
+	m->RunActive    = 1;
+	m->EorPending   = 0;
+	m->TracePending = 0;
+}
+
+
+/****************************************************************
+*	Emu_Trace function:
+*		Pulse of the given energy on a noisy baseline, two samples 
+*		per word. Samples are written to t[0..words-1].
+****************************************************************/
+static void Emu_Trace (struct Emu_Module *m, U32 *t, U32 words, U32 energy)
+{
+	U32 amp = energy >> 2;
+	U32 start = words / 2;			// pulse at 1/4 of the trace
+	U32 i, k, s[2];
+
+	for(i = 0; i < words; i++) {
+		U32 r = Emu_Random(m);
+		for(k = 0; k < 2; k++) {
+			U32 n = 2*i + k;
+			s[k] = EMU_BASELINE + ((r >> (8*k)) & 0x7);
+			if(energy && n >= start && n - start < m->PulseLen)
+				s[k] += (amp * m->Pulse[n - start]) >> 12;
+			if(s[k] > 0xFFFF)
+				s[k] = 0xFFFF;
+		}
+		t[i] = s[0] | (s[1] << 16);
+	}
+}
+
+/* energy: a peak per channel on an exponential background */
+static U32 Emu_Energy (struct Emu_Module *m, U32 ch)
+{
+	double e;
+
+	if((Emu_Random(m) & 0xF) < 11)
+		e = 8000.0 + 6000.0*ch + 60.0*(Emu_Uniform(m) + Emu_Uniform(m) + Emu_Uniform(m) + Emu_Uniform(m) - 2.0);
+	else
+		e = -6000.0 * log(Emu_Uniform(m));
+	return((e < 1.0) ? 1 : (e > 65535.0) ? 65535 : (U32)e);
+}
+
+static void Emu_Histogram (struct Emu_Module *m, U32 ch, U32 energy)
+{
+	U32 bin = energy >> EMU_MCA_SHIFT;
+
+	m->ChanEvents[ch]++;
+	if(bin < MAX_HISTOGRAM_LENGTH)
+		m->MCA[ch*MAX_HISTOGRAM_LENGTH + bin]++;
+}
+
+/* advance the time stamp to the next event, rate in kcps */
+static U64 Emu_Next_Time (struct Emu_Module *m, U32 rate)
+{
+	m->TimeStamp -= log(Emu_Uniform(m)) * m->TickMHz * 1000.0 / rate;
+	return((U64)m->TimeStamp);
+}
+
+
+/****************************************************************
+*	Emu_Make_Event function:
+*		Generate the next event into m->Evt, count and histogram it.
+*		Returns the event length in words.
+****************************************************************/
+static U32 Emu_Make_Event (struct Emu_Module *m)
+{
+	U32 rate = EmuRate ? EmuRate : EMU_MCA_RATE;
+	U32 *e = m->Evt;
+	U32 ch, k, len, blocks, energy, esum, hit;
+	U32 inject = (U32)(m->NumEvents % EMU_ERR_INTERVAL);
+	U64 ts = Emu_Next_Time(m, rate);
+
+	memset(e, 0, MAX_CHAN_HEAD_LENGTH/2 * sizeof(U32));
+	len = MAX_CHAN_HEAD_LENGTH/2;
+	if(m->RunType == 0x402) {
+		/* one record for all channels, each good channel hit with probability 1/2 */
+		do {
+			hit = Emu_Random(m) & m->Good;
+		} while(hit == 0);
+		blocks = 0;
+		esum = 0;
+		for(ch = 0; ch < NUMBER_OF_CHANNELS; ch++) {
+			U64 tch = ts + (Emu_Random(m) & 0x3);
+			energy = (hit & (1 << ch)) ? Emu_Energy(m, ch) : 0;
+			if(energy) {
+				Emu_Histogram(m, ch, energy);
+				esum += energy;
+			}
+			e[4 + 2*ch] = (U32)(tch & 0xFFFFFFFF);
+			e[5 + 2*ch] = energy | (m->Blocks[ch] << 16);
+			Emu_Trace(m, &e[len], m->Blocks[ch] * BLOCKSIZE/2, energy);
+			len += m->Blocks[ch] * BLOCKSIZE/2;
+			blocks += m->Blocks[ch];
+		}
+		e[0] = hit;
+		e[2] = (U32)(ts >> 32) & 0xFFFF;
+		e[3] = (esum > 0xFFFF) ? 0xFFFF : esum;
+		e[13] = (U32)(ts & 0xFFFFFFFF);
+	}
+	else {
+		/* a single channel, good channels take turns at random */
+		do {
+			ch = Emu_Random(m) & (NUMBER_OF_CHANNELS - 1);
+		} while(!(m->Good & (1 << ch)));
+		energy = Emu_Energy(m, ch);
+		Emu_Histogram(m, ch, energy);
+		blocks = m->Blocks[ch];
+		Emu_Trace(m, &e[len], blocks * BLOCKSIZE/2, energy);
+		len += blocks * BLOCKSIZE/2;
+		e[0] = 1 << ch;
+		e[2] = (U32)(ts & 0xFFFFFFFF);
+		e[3] = (U32)(ts >> 32) & 0xFFFF;
+		e[4] = energy | (ch << 16);
+	}
+	e[1] = blocks | (m->PrevBlocks << 16);
+	for(k = 0; k < 8; k++)
+		e[14] ^= e[k];
+	e[15] = WATERMARK;
+	m->PrevBlocks = blocks;
+	m->NumEvents++;
+
+	if((EmuErrors & EMU_ERR_WATERMARK) && inject == EMU_ERR_INTERVAL/4)
+		e[15] ^= 0x00000F00;
+	if((EmuErrors & EMU_ERR_CHECKSUM) && inject == EMU_ERR_INTERVAL/2)
+		e[14] ^= 1;
+	if((EmuErrors & EMU_ERR_SHORT) && inject == 3*EMU_ERR_INTERVAL/4 && blocks)
+		len -= 2;
+	return(len);
+}
+
+
+/* copy n words to the framebuffer, the last framebuffer word is kept for the caller */
+static U32 Emu_Copy (struct Emu_Module *m, U32 *buf, U32 nWords, U32 *pos, const U32 *src, U32 n)
+{
+	U32 done = 0, chunk;
+
+	while(done < n && *pos < nWords) {
+		if(*pos == nWords - 1) {
+			m->LastWord = src[done++];
+			m->LastPending = 1;
+			(*pos)++;
+			break;
+		}
+		chunk = nWords - 1 - *pos;
+		if(chunk > n - done)
+			chunk = n - done;
+		memcpy(&buf[*pos], &src[done], chunk * sizeof(U32));
+		*pos += chunk;
+		done += chunk;
+	}
+	return(done);
+}
+
+
+/****************************************************************
+*	Emu_Fill function:
+*		Write up to maxEvents events (and the end of run record if eor)
+*		into the framebuffer, starting at word pos. Runs without the
+*		lock; the framebuffer is marked busy. Returns the new position.
+****************************************************************/
+static U32 Emu_Fill (struct Emu_Module *m, U32 *buf, U32 nWords, U32 pos, U64 maxEvents, U32 eor, U64 *made)
+{
+	U32 eorRecord[MAX_CHAN_HEAD_LENGTH/2];
+	U64 ts;
+	U32 k;
+
+	*made = 0;
+	/* rest of an event split at the previous framebuffer boundary */
+	if(m->EvtPos < m->EvtLen)
+		m->EvtPos += Emu_Copy(m, buf, nWords, &pos, &m->Evt[m->EvtPos], m->EvtLen - m->EvtPos);
+	while(pos < nWords && *made < maxEvents && m->Good) {
+		m->EvtLen = Emu_Make_Event(m);
+		m->EvtPos = Emu_Copy(m, buf, nWords, &pos, m->Evt, m->EvtLen);
+		(*made)++;
+	}
+	if(m->EvtPos < m->EvtLen && (EmuErrors & EMU_ERR_SPLIT) && (m->Buffers % 8) == 7)
+		m->EvtPos = m->EvtLen;
+
+	if(eor && pos < nWords) {
+		ts = (U64)m->TimeStamp;
+		memset(eorRecord, 0, sizeof(eorRecord));
+		eorRecord[0] = EORMARK;
+		eorRecord[1] = m->PrevBlocks << 16;
+		eorRecord[2] = (U32)(ts & 0xFFFFFFFF);
+		eorRecord[3] = (U32)(ts >> 32) & 0xFFFF;
+		for(k = 0; k < 8; k++)
+			eorRecord[14] ^= eorRecord[k];
+		eorRecord[15] = WATERMARK;
+		Emu_Copy(m, buf, nWords, &pos, eorRecord, MAX_CHAN_HEAD_LENGTH/2);
+		if(pos < nWords) {
+			memset(&buf[pos], 0, (nWords - 1 - pos) * sizeof(U32));
+			m->LastWord = 0;
+			m->LastPending = 1;
+			pos = nWords;
+		}
+	}
+	return(pos);
+}
+
+
+/****************************************************************
+*	Emu_Fill_Traces function:
+*		GET_TRACES: ADC traces of all channels, one sample per word,
+*		channel k at word k*IO_BUFFER_LENGTH. With lock held.
+****************************************************************/
+static void Emu_Fill_Traces (struct Emu_Module *m, WD_DMA *pDma)
+{
+	U32 *buf = (U32 *)pDma->pUserAddr;
+	U32 nWords = pDma->dwBytes / sizeof(U32);
+	U32 i, ch, s, pulse = IO_BUFFER_LENGTH / 4;
+
+	for(i = 0; i < nWords; i++) {
+		ch = i / IO_BUFFER_LENGTH;
+		s = EMU_BASELINE + (Emu_Random(m) & 0x7);
+		if((i % IO_BUFFER_LENGTH) >= pulse && ch < NUMBER_OF_CHANNELS)
+			s += (U32)(1000.0*(ch + 1) * exp(-(double)((i % IO_BUFFER_LENGTH) - pulse)/EMU_TAU));
+		buf[i] = s;
+	}
+}
+
+
+/****************************************************************
+*	Emu_Service function:
+*		One pass of the fill thread, with lock held (released while 
+*		the framebuffer is written). Returns 1 if it did some work.
+****************************************************************/
+static S32 Emu_Service (struct Emu_Module *m)
+{
+	U64 now = Emu_us();
+	U64 due = 0, made;
+	U32 listMode = (m->RunType >= 0x400 && m->RunType <= 0x403);
+	U32 rate = EmuRate ? EmuRate : EMU_MCA_RATE;
+	U32 eor, callback, *buf, nWords, pos, ch;
+	WD_DMA *pDma;
+
+	if(m->RunActive) {
+		due = (now - m->RunStart) * rate / 1000;
+		due = (due > m->Generated) ? due - m->Generated : 0;
+		Emu_Update_Stats(m, now);
+	}
+
+	if(m->Csr == 1 && m->Target && m->TracePending) {
+		Emu_Fill_Traces(m, m->Target);
+		m->TracePending = 0;
+		m->Csr = 0;
+		return(1);
+	}
+
+	if(!listMode) {
+		/* MCA runs: histogram only */
+		if(m->RunActive && m->Good) {
+			for(; due > 0; due--, m->Generated++) {
+				do {
+					ch = Emu_Random(m) & (NUMBER_OF_CHANNELS - 1);
+				} while(!(m->Good & (1 << ch)));
+				Emu_Next_Time(m, rate);
+				Emu_Histogram(m, ch, Emu_Energy(m, ch));
+				m->NumEvents++;
+			}
+		}
+		return(0);
+	}
+
+	if(m->Csr != 1 || m->Target == NULL || !(m->RunActive || m->EorPending)) {
+		/* no framebuffer: events are lost, unless EmuRate is 0 (wait for the host) */
+		if(m->RunActive && EmuRate)
+			m->Generated += due;
+		return(0);
+	}
+	if(m->RunActive && EmuRate == 0)
+		due = ~(U64)0;
+	if(due == 0 && m->RunActive)
+		return(0);
+
+	eor = !m->RunActive && m->EorPending;
+	pDma = m->Target;
+	buf = (U32 *)pDma->pUserAddr;
+	nWords = pDma->dwBytes / sizeof(U32);
+	m->Busy = pDma;
+	m->LastPending = 0;
+	pthread_mutex_unlock(&m->Lock);
+
+	pos = Emu_Fill(m, buf, nWords, m->Pos, eor ? 0 : due, eor, &made);
+
+	pthread_mutex_lock(&m->Lock);
+	m->Busy = NULL;
+	pthread_cond_broadcast(&m->Idle);
+	m->Generated += made;
+	callback = 0;
+	if(m->Csr == 1 && m->Target == pDma) {
+		m->Pos = pos;
+		if(eor && pos == nWords)
+			m->EorPending = 0;
+		if(m->LastPending) {
+			/* the host polls the last word: write it together with the CSR */
+			__atomic_store_n(&buf[nWords - 1], m->LastWord, __ATOMIC_RELEASE);
+			m->Csr = 0;
+			m->Pos = 0;
+			m->Buffers++;
+			callback = m->IntEnabled;
+		}
+	}
+	Emu_Update_Stats(m, Emu_us());
+
+	if(callback) {
+		/* framebuffer done interrupt */
+		pthread_mutex_unlock(&m->Lock);
+		Write_DMA_List_Mode_File(m->IntModNum, "", m->IntRunType);
+		pthread_mutex_lock(&m->Lock);
+	}
+	return(1);
+}
+
+
+static void *Emu_Thread (void *arg)
+{
+	struct Emu_Module *m = (struct Emu_Module *)arg;
+	struct timespec ts;
+
+	pthread_mutex_lock(&m->Lock);
+	while(!m->Stop) {
+		if(Emu_Service(m))
+			continue;
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_nsec += 1000000;
+		if(ts.tv_nsec >= 1000000000) {
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000000000;
+		}
+		pthread_cond_timedwait(&m->Wake, &m->Lock, &ts);
+	}
+	pthread_mutex_unlock(&m->Lock);
+	return(NULL);
+}
+
+
+/****************************************************************
+*	Pixie_Emu_Open function:
+*		Create the emulated module ModNum and start its fill thread,
+*		or return the existing one. Returns the device handle for 
+*		the functions of Pixie_Emu_Backend, NULL on failure.
+****************************************************************/
+WDC_DEVICE_HANDLE Pixie_Emu_Open (U8 ModNum)
+{
+	struct Emu_Module *m;
+
+	if(ModNum >= PRESET_MAX_MODULES)
+		return(NULL);
+	if(Emu[ModNum] != NULL)
+		return((WDC_DEVICE_HANDLE)Emu[ModNum]);
+
+	m = calloc(1, sizeof(struct Emu_Module));
+	if(m == NULL)
+		return(NULL);
+	m->MCA   = calloc(NUMBER_OF_CHANNELS*MAX_HISTOGRAM_LENGTH, sizeof(U32));
+	m->MCA2D = calloc(MCA2D_MEMORY_LENGTH, sizeof(U32));
+	if(m->MCA == NULL || m->MCA2D == NULL) {
+		free(m->MCA);
+		free(m->MCA2D);
+		free(m);
+		return(NULL);
+	}
+	m->ModNum = ModNum;
+	m->Rng = 0x9E3779B9 ^ (ModNum * 0x85EBCA6B);
+	m->TickMHz = m->DSPMHz = m->FilterMHz = m->CTScale = 1.0;
+	pthread_mutex_init(&m->Lock, NULL);
+	pthread_cond_init(&m->Wake, NULL);
+	pthread_cond_init(&m->Idle, NULL);
+	if(pthread_create(&m->Thread, NULL, Emu_Thread, m) != 0) {
+		pthread_mutex_destroy(&m->Lock);
+		pthread_cond_destroy(&m->Wake);
+		pthread_cond_destroy(&m->Idle);
+		free(m->MCA);
+		free(m->MCA2D);
+		free(m);
+		return(NULL);
+	}
+	Emu[ModNum] = m;
+	return((WDC_DEVICE_HANDLE)m);
+}
+
+
+/* framebuffer of the SG list: the first SG entry points to its start */
+static WD_DMA *Emu_SG_Target (struct Emu_Module *m)
+{
+	U32 p = m->Desc[LDM_SG_LIST_PTR];
+	DMA_ADDR addr;
+	U32 k;
+
+	if(p + 1 >= EMU_DESC_WORDS || m->Desc[LDM_SG_CNT] == 0)
+		return(NULL);
+	addr = (DMA_ADDR)m->Desc[p] | ((DMA_ADDR)m->Desc[p + 1] << 32);
+	for(k = 0; k < EMU_LOCKED_MAX; k++) {
+		if(m->Locked[k] && m->Locked[k]->Page[0].pPhysicalAddr == addr)
+			return(m->Locked[k]);
+	}
+	return(NULL);
+}
+
+
+static DWORD Emu_ReadWriteReg (WDC_DEVICE_HANDLE hDev, DWORD dwReg, WDC_DIRECTION direction, void *value, BOOL fPciCfg)
+{
+	struct Emu_Module *m = (struct Emu_Module *)hDev;
+	U32 *v = (U32 *)value;
+	U32 old, idx;
+	U64 now;
+
+	if(m == NULL || dwReg >= EMU_REGS)
+		return(WD_INVALID_PARAMETER);
+	pthread_mutex_lock(&m->Lock);
+	now = Emu_us();
+	if(direction == WDC_READ) {
+		switch(dwReg) {
+			case APP_STATUS:
+				*v = m->Reg[APP_STATUS] & ~(1 << BIT_RUN_ACTIVE);
+				if(m->RunActive || now < m->CtrlEnd)
+					*v |= 1 << BIT_RUN_ACTIVE;
+				break;
+			case APP_SDRAM_STATUS:
+				*v = m->Reg[APP_SDRAM_STATUS] | 0x4;
+				break;
+			case VDMA_CSRx:
+				*v = m->GoSeen ? 1 : m->Csr;
+				m->GoSeen = 0;
+				break;
+			default:
+				*v = m->Reg[dwReg];
+				break;
+		}
+	}
+	else {
+		old = m->Reg[dwReg];
+		m->Reg[dwReg] = *v;
+		switch(dwReg) {
+			case APP_HOST_CTL:
+				if(*v & (1 << BIT_PARIO)) {
+					/* parameter I/O: a read request puts the value into the mailbox */
+					idx = m->Reg[APP_HOST_CTL_DATA];
+					if(idx != 0xFFFFFFFF)
+						m->Reg[APP_STATUS_DATA] = (idx < N_DSP_PAR) ? m->Param[idx] : 0;
+					m->Reg[APP_HOST_CTL] &= ~(1 << BIT_PARIO);
+				}
+				if((*v & (1 << BIT_CTRLENA)) && !(old & (1 << BIT_CTRLENA))) {
+					/* control tasks end by themselves */
+					m->CtrlEnd = now + EMU_CTRL_US;
+					m->TracePending = (m->Param[Control_Task_Index] == GET_TRACES);
+					m->Reg[APP_HOST_CTL] &= ~(1 << BIT_CTRLENA);
+				}
+				if((*v & (1 << BIT_RUNENA)) && !(old & (1 << BIT_RUNENA)))
+					Emu_Run_Start(m, now);
+				if(!(*v & (1 << BIT_RUNENA)) && (old & (1 << BIT_RUNENA)) && m->RunActive) {
+					m->RunActive = 0;
+					m->RunTimeAcc += now - m->RunStart;
+					m->EorPending = (m->RunType >= 0x400 && m->RunType <= 0x403);
+					Emu_Update_Stats(m, now);
+				}
+				pthread_cond_signal(&m->Wake);
+				break;
+			case VDMA_CSRx:
+				if(*v & 1) {
+					m->Csr = 1;
+					m->GoSeen = 1;
+					m->Pos = 0;
+					m->Target = Emu_SG_Target(m);
+					if(m->Target == NULL) {
+						sprintf(ErrMSG, "*ERROR* (Pixie_Emu): module %d, SG list does not point to a locked DMA buffer", m->ModNum);
+						Pixie_Print_MSG(ErrMSG,1);
+					}
+					pthread_cond_signal(&m->Wake);
+				}
+				else if(*v & 2) {
+					m->Csr = 0;
+					m->GoSeen = 0;
+					while(m->Busy)
+						pthread_cond_wait(&m->Idle, &m->Lock);
+				}
+				m->Reg[VDMA_CSRx] = m->Csr;
+				break;
+			default:
+				break;
+		}
+	}
+	pthread_mutex_unlock(&m->Lock);
+	return(WD_STATUS_SUCCESS);
+}
+
+static DWORD Emu_WriteFIFO (WDC_DEVICE_HANDLE hDev, DWORD dwReg, const UINT32 *data, UINT32 nWords)
+{
+	/* FPGA configuration data: nothing to configure */
+	return((hDev == NULL) ? WD_INVALID_PARAMETER : WD_STATUS_SUCCESS);
+}
+
+/* word in BAR0 (parameter memory, descriptor RAM) or BAR2 (external memory), NULL if none */
+static U32 *Emu_Word (struct Emu_Module *m, DWORD dwAddrSpace, KPTR dwOffset, U32 emAddr)
+{
+	if(dwAddrSpace == AD_PCI_BAR0) {
+		if(dwOffset >= FPGA_PARAM_RAM && dwOffset < FPGA_PARAM_RAM + N_DSP_PAR*sizeof(U32))
+			return(&m->Param[(dwOffset - FPGA_PARAM_RAM) / sizeof(U32)]);
+		if(dwOffset >= m_RAMBase && dwOffset < m_RAMBase + EMU_DESC_WORDS*sizeof(U32))
+			return(&m->Desc[(dwOffset - m_RAMBase) / sizeof(U32)]);
+	}
+	else if(dwAddrSpace == AD_PCI_BAR2) {
+		if(m->Reg[APP_HOST_CTL] & (1 << BIT_MCAUPPERA))
+			return((emAddr < MCA2D_MEMORY_LENGTH) ? &m->MCA2D[emAddr] : NULL);
+		return((emAddr < NUMBER_OF_CHANNELS*MAX_HISTOGRAM_LENGTH) ? &m->MCA[emAddr] : NULL);
+	}
+	return(NULL);
+}
+
+/* a BAR2 read returns the word at the address of the previous read and latches the new address */
+static U32 Emu_Read (struct Emu_Module *m, DWORD dwAddrSpace, KPTR dwOffset)
+{
+	U32 *w;
+
+	if(dwAddrSpace == AD_PCI_BAR2) {
+		w = Emu_Word(m, dwAddrSpace, dwOffset, m->EMAddr);
+		m->EMAddr = (U32)((dwOffset - PCIE_EMDATA) / sizeof(U32));
+	}
+	else
+		w = Emu_Word(m, dwAddrSpace, dwOffset, 0);
+	return(w ? *w : 0);
+}
+
+static void Emu_Write (struct Emu_Module *m, DWORD dwAddrSpace, KPTR dwOffset, U32 val)
+{
+	U32 *w = Emu_Word(m, dwAddrSpace, dwOffset, (U32)((dwOffset - PCIE_EMDATA) / sizeof(U32)));
+
+	if(w)
+		*w = val;
+}
+
+static DWORD DLLCALLCONV Emu_ReadAddr32 (WDC_DEVICE_HANDLE hDev, DWORD dwAddrSpace, KPTR dwOffset, UINT32 *val)
+{
+	struct Emu_Module *m = (struct Emu_Module *)hDev;
+
+	if(m == NULL)
+		return(WD_INVALID_PARAMETER);
+	pthread_mutex_lock(&m->Lock);
+	*val = Emu_Read(m, dwAddrSpace, dwOffset);
+	pthread_mutex_unlock(&m->Lock);
+	return(WD_STATUS_SUCCESS);
+}
+
+static DWORD DLLCALLCONV Emu_WriteAddr32 (WDC_DEVICE_HANDLE hDev, DWORD dwAddrSpace, KPTR dwOffset, UINT32 val)
+{
+	struct Emu_Module *m = (struct Emu_Module *)hDev;
+
+	if(m == NULL)
+		return(WD_INVALID_PARAMETER);
+	pthread_mutex_lock(&m->Lock);
+	Emu_Write(m, dwAddrSpace, dwOffset, val);
+	pthread_mutex_unlock(&m->Lock);
+	return(WD_STATUS_SUCCESS);
+}
+
+static DWORD DLLCALLCONV Emu_ReadAddrBlock (WDC_DEVICE_HANDLE hDev, DWORD dwAddrSpace, KPTR dwOffset, DWORD dwBytes, PVOID pData, WDC_ADDR_MODE mode, WDC_ADDR_RW_OPTIONS options)
+{
+	struct Emu_Module *m = (struct Emu_Module *)hDev;
+	U32 *data = (U32 *)pData;
+	DWORD i;
+
+	if(m == NULL)
+		return(WD_INVALID_PARAMETER);
+	pthread_mutex_lock(&m->Lock);
+	for(i = 0; i < dwBytes / sizeof(U32); i++)
+		data[i] = Emu_Read(m, dwAddrSpace, dwOffset + i*sizeof(U32));
+	pthread_mutex_unlock(&m->Lock);
+	return(WD_STATUS_SUCCESS);
+}
+
+static DWORD DLLCALLCONV Emu_WriteAddrBlock (WDC_DEVICE_HANDLE hDev, DWORD dwAddrSpace, KPTR dwOffset, DWORD dwBytes, PVOID pData, WDC_ADDR_MODE mode, WDC_ADDR_RW_OPTIONS options)
+{
+	struct Emu_Module *m = (struct Emu_Module *)hDev;
+	U32 *data = (U32 *)pData;
+	DWORD i;
+
+	if(m == NULL)
+		return(WD_INVALID_PARAMETER);
+	pthread_mutex_lock(&m->Lock);
+	for(i = 0; i < dwBytes / sizeof(U32); i++)
+		Emu_Write(m, dwAddrSpace, dwOffset + i*sizeof(U32), data[i]);
+	pthread_mutex_unlock(&m->Lock);
+	return(WD_STATUS_SUCCESS);
+}
+
+/* host memory is the DMA memory: one page, the "physical" address is the user address */
+static DWORD DLLCALLCONV Emu_DMASGBufLock (WDC_DEVICE_HANDLE hDev, PVOID pBuf, DWORD dwOptions, DWORD dwDMABufSize, WD_DMA **ppDma)
+{
+	struct Emu_Module *m = (struct Emu_Module *)hDev;
+	WD_DMA *pDma;
+	U32 k;
+
+	if(m == NULL || pBuf == NULL)
+		return(WD_INVALID_PARAMETER);
+	pDma = calloc(1, sizeof(WD_DMA));
+	if(pDma == NULL)
+		return(WD_INSUFFICIENT_RESOURCES);
+	pDma->pUserAddr = pBuf;
+	pDma->dwBytes = dwDMABufSize;
+	pDma->dwOptions = dwOptions;
+	pDma->dwPages = 1;
+	pDma->hCard = m->ModNum;
+	pDma->Page[0].pPhysicalAddr = (DMA_ADDR)(uintptr_t)pBuf;
+	pDma->Page[0].dwBytes = dwDMABufSize;
+
+	pthread_mutex_lock(&m->Lock);
+	for(k = 0; k < EMU_LOCKED_MAX && m->Locked[k]; k++)
+		;
+	if(k < EMU_LOCKED_MAX)
+		m->Locked[k] = pDma;
+	pthread_mutex_unlock(&m->Lock);
+	if(k == EMU_LOCKED_MAX) {
+		free(pDma);
+		return(WD_INSUFFICIENT_RESOURCES);
+	}
+	*ppDma = pDma;
+	return(WD_STATUS_SUCCESS);
+}
+
+static DWORD DLLCALLCONV Emu_DMABufUnlock (WD_DMA *pDma)
+{
+	struct Emu_Module *m;
+	U32 k;
+
+	if(pDma == NULL || pDma->hCard >= PRESET_MAX_MODULES || (m = Emu[pDma->hCard]) == NULL)
+		return(WD_INVALID_PARAMETER);
+	pthread_mutex_lock(&m->Lock);
+	while(m->Busy == pDma)
+		pthread_cond_wait(&m->Idle, &m->Lock);
+	if(m->Target == pDma) {
+		m->Target = NULL;
+		m->Csr = 0;
+	}
+	for(k = 0; k < EMU_LOCKED_MAX; k++) {
+		if(m->Locked[k] == pDma)
+			m->Locked[k] = NULL;
+	}
+	pthread_mutex_unlock(&m->Lock);
+	free(pDma);
+	return(WD_STATUS_SUCCESS);
+}
+
+static DWORD DLLCALLCONV Emu_DMASync (WD_DMA *pDma)
+{
+	/* no caches between the emulated device and the host */
+	return(WD_STATUS_SUCCESS);
+}
+
+static void Emu_IntSetup (WDC_DEVICE_HANDLE hDev, U8 ModNum, U16 RunType)
+{
+	struct Emu_Module *m = (struct Emu_Module *)hDev;
+
+	pthread_mutex_lock(&m->Lock);
+	m->IntEnabled = 1;
+	m->IntModNum  = ModNum;
+	m->IntRunType = RunType;
+	pthread_mutex_unlock(&m->Lock);
+}
+
+static DWORD Emu_IntDisable (WDC_DEVICE_HANDLE hDev)
+{
+	struct Emu_Module *m = (struct Emu_Module *)hDev;
+
+	if(m == NULL)
+		return(WD_INVALID_PARAMETER);
+	pthread_mutex_lock(&m->Lock);
+	m->IntEnabled = 0;
+	pthread_mutex_unlock(&m->Lock);
+	return(WD_STATUS_SUCCESS);
+}
+
+static BOOL Emu_DeviceClose (WDC_DEVICE_HANDLE hDev)
+{
+	struct Emu_Module *m = (struct Emu_Module *)hDev;
+	U32 k;
+
+	if(m == NULL || Emu[m->ModNum] != m)
+		return(FALSE);
+	pthread_mutex_lock(&m->Lock);
+	m->Stop = 1;
+	pthread_cond_signal(&m->Wake);
+	pthread_mutex_unlock(&m->Lock);
+	pthread_join(m->Thread, NULL);
+	Emu[m->ModNum] = NULL;
+
+	for(k = 0; k < EMU_LOCKED_MAX; k++)
+		free(m->Locked[k]);
+	pthread_mutex_destroy(&m->Lock);
+	pthread_cond_destroy(&m->Wake);
+	pthread_cond_destroy(&m->Idle);
+	free(m->MCA);
+	free(m->MCA2D);
+	free(m->Evt);
+	free(m->Pulse);
+	free(m);
+	return(TRUE);
+}
+
+const PIXIE500E_BACKEND Pixie_Emu_Backend = {
+	"Emulator",
+	Emu_ReadWriteReg,
+	Emu_WriteFIFO,
+	Emu_ReadAddr32,
+	Emu_WriteAddr32,
+	Emu_ReadAddrBlock,
+	Emu_WriteAddrBlock,
+	Emu_DMASGBufLock,
+	Emu_DMABufUnlock,
+	Emu_DMASync,
+	Emu_DMASync,
+	Emu_IntSetup,
+	Emu_IntDisable,
+	Emu_DeviceClose
+};
+
+#endif // WINDRIVER_API
@@ -0,0 +1,352 @@
+/*----------------------------------------------------------------------
+* Copyright (c) 2004, 2009, 2015 XIA LLC
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms,
+* with or without modification, are permitted provided
+* that the following conditions are met:
+*
+*   * Redistributions of source code must retain the above
+*     copyright notice, this list of conditions and the
+*     following disclaimer.
+*   * Redistributions in binary form must reproduce the
+*     above copyright notice, this list of conditions and the
+*     following disclaimer in the documentation and/or other
+*     materials provided with the distribution.
+*   * Neither the name of XIA LLC
+*     nor the names of its contributors may be used to endorse
+*     or promote products derived from this software without
+*     specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+* CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+* INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+* ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+* TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+* THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+* SUCH DAMAGE.
+*----------------------------------------------------------------------*/
+
+/******************************************************************************
+*
+* File name:
+*
+*      pixie_log.c
+*
+* Description:
+*
+*      Message log of the Linux library. Pixie_Print_MSG used to open 
+*      PIXIEmsg.txt, append the message and close it again for every message,
+*      also in the list mode QC and readout threads. Now each thread puts its
+*      messages into its own ring of records, without locks, and a flusher 
+*      thread writes them to stdout and PIXIEmsg.txt, in the order they were 
+*      logged, every LOG_FLUSH_MS. 
+*      Frequent messages are logged with Pixie_Log_Rec as a format string and
+*      integer arguments, so they are checked against their enable flag before
+*      anything is done and formatted only by the flusher.
+*      If a ring is full, the thread flushes the log itself, so no message is 
+*      lost. Messages are only dropped (and counted) if a ring can not be 
+*      allocated.
+*
+* Member functions:
+*					Pixie_Log_Put()		- log a formatted message
+*					Pixie_Log_Rec()		- log a format and integer arguments, formatted later
+*					Pixie_Log_Flush()	- write all logged messages now
+*					Pixie_Log_Stats()	- message counts (0x40E4)
+*
+******************************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "PlxTypes.h"
+#include "PciTypes.h"
+#include "Plx.h"
+
+#include "globals.h"
+#include "sharedfiles.h"
+#include "utilities.h"
+
+struct Log_Record {
+	U64 Seq;						// order of logging, over all threads
+	const char *Format;				// format of Arg, NULL if Text is the message
+	U32 Arg[LOG_MAX_ARGS];
+	S8  Text[LOG_TEXT_LENGTH];
+};
+
+/* written by one thread, read by the flusher */
+struct Log_Ring {
+	U32 Head;						// next record to write, only changed by the writing thread
+	U32 Tail;						// next record to flush, only changed by the flusher
+	U32 Free;						// 1 if the writing thread has exited, the ring can be taken over
+	U32 MaxFill;					// most records waiting at a time
+	struct Log_Ring *Next;
+	struct Log_Record Rec[LOG_RING_LENGTH];
+};
+
+static struct Log_Ring *LogRings = NULL;		// all rings, only ever added to
+static __thread struct Log_Ring *LogRing = NULL;	// ring of this thread
+static U64 LogSeq = 0;
+static U64 LogNext = 0;							// Seq of the next record to write, under LogFlushLock
+static U32 LogWritten = 0, LogFull = 0, LogDropped = 0, LogDroppedReported = 0, LogRingCount = 0;
+static U32 LogFlusher = 0;						// 1 if the flusher thread runs
+static FILE *LogFile = NULL;
+static pthread_mutex_t LogFlushLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t LogOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t LogKey;
+
+
+static void Log_Ring_Release (void *ring)
+{
+	__atomic_store_n(&((struct Log_Ring *)ring)->Free, 1, __ATOMIC_RELEASE);
+}
+
+static void *Log_Flush_Thread (void *arg)
+{
+	struct timespec ts;
+
+	ts.tv_sec = 0;
+	ts.tv_nsec = LOG_FLUSH_MS*1000000L;
+	for(;;) {
+		nanosleep(&ts, NULL);
+		Pixie_Log_Flush();
+	}
+	return(NULL);
+}
+
+static void Log_Start (void)
+{
+	pthread_t thread;
+
+	pthread_key_create(&LogKey, Log_Ring_Release);
+	if(pthread_create(&thread, NULL, Log_Flush_Thread, NULL) == 0) {
+		pthread_detach(thread);
+		LogFlusher = 1;
+	}
+	atexit(Pixie_Log_Flush);
+}
+
+
+/* The ring of this thread: a released one, or a new one */
+static struct Log_Ring *Log_Get_Ring (void)
+{
+	struct Log_Ring *r;
+	U32 one = 1;
+
+	pthread_once(&LogOnce, Log_Start);
+	for(r = __atomic_load_n(&LogRings, __ATOMIC_ACQUIRE); r != NULL; r = r->Next) {
+		if(__atomic_compare_exchange_n(&r->Free, &one, 0, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+			break;
+		one = 1;
+	}
+	if(r == NULL) {
+		r = (struct Log_Ring *)calloc(1, sizeof(struct Log_Ring));
+		if(r == NULL)
+			return(NULL);
+		r->Next = __atomic_load_n(&LogRings, __ATOMIC_RELAXED);
+		while(!__atomic_compare_exchange_n(&LogRings, &r->Next, r, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+			;
+		__atomic_add_fetch(&LogRingCount, 1, __ATOMIC_RELAXED);
+	}
+	pthread_setspecific(LogKey, r);
+	LogRing = r;
+	return(r);
+}
+
+
+/* Next free record of this thread's ring, NULL if there is no ring */
+static struct Log_Record *Log_Reserve (void)
+{
+	struct Log_Ring *r = LogRing;
+	U32 fill;
+
+	if(r == NULL && (r = Log_Get_Ring()) == NULL) {
+		__atomic_add_fetch(&LogDropped, 1, __ATOMIC_RELAXED);
+		return(NULL);
+	}
+	fill = r->Head - __atomic_load_n(&r->Tail, __ATOMIC_ACQUIRE);
+	if(fill >= LOG_RING_LENGTH) {
+		/* do not wait for the flusher */
+		__atomic_add_fetch(&LogFull, 1, __ATOMIC_RELAXED);
+		for(;;) {
+			Pixie_Log_Flush();
+			fill = r->Head - __atomic_load_n(&r->Tail, __ATOMIC_ACQUIRE);
+			if(fill < LOG_RING_LENGTH)
+				break;
+			sched_yield();	// the flush stopped at a record another thread is just committing
+		}
+	}
+	if(fill >= r->MaxFill)
+		r->MaxFill = fill + 1;
+	return(&r->Rec[r->Head & (LOG_RING_LENGTH-1)]);
+}
+
+static void Log_Commit (struct Log_Record *rec)
+{
+	rec->Seq = __atomic_fetch_add(&LogSeq, 1, __ATOMIC_RELAXED);
+	__atomic_store_n(&LogRing->Head, LogRing->Head + 1, __ATOMIC_RELEASE);
+	if(!LogFlusher)
+		Pixie_Log_Flush();	// no flusher thread: write it now
+}
+
+
+/****************************************************************
+*	Pixie_Log_Put function:
+*		Log the message, as Pixie_Print_MSG did. It is written 
+*		with the next flush; messages longer than LOG_TEXT_LENGTH-1
+*		are cut.
+*
+****************************************************************/
+
+void Pixie_Log_Put (
+				   const S8 *message )	// message to be logged
+{
+	struct Log_Record *rec;
+
+	if((rec = Log_Reserve()) == NULL)
+		return;
+	rec->Format = NULL;
+	strncpy((char *)rec->Text, (const char *)message, LOG_TEXT_LENGTH-1);
+	rec->Text[LOG_TEXT_LENGTH-1] = 0;
+	Log_Commit(rec);
+}
+
+
+/****************************************************************
+*	Pixie_Log_Rec function:
+*		Log a message given by format and nArgs (at most 
+*		LOG_MAX_ARGS) integer arguments of 32 bits, each passed as
+*		U32 or S32. Nothing is done if enable is 0. The message is 
+*		only formatted when it is written, so format has to stay
+*		valid: a string literal.
+*
+****************************************************************/
+
+void Pixie_Log_Rec (
+				   U32 enable,			// log it or not, e.g. PrintDebugMsg_QCerror
+				   const char *format,	// printf format with up to LOG_MAX_ARGS integer conversions
+				   U32 nArgs,			// number of arguments
+				   ... )				// U32 or S32 arguments
+{
+	struct Log_Record *rec;
+	va_list ap;
+	U32 k;
+
+	if(!enable)
+		return;
+	if((rec = Log_Reserve()) == NULL)
+		return;
+	rec->Format = format;
+	va_start(ap, nArgs);
+	for(k = 0; k < LOG_MAX_ARGS; k++)
+		rec->Arg[k] = (k < nArgs) ? va_arg(ap, U32) : 0;
+	va_end(ap);
+	Log_Commit(rec);
+}
+
+
+/****************************************************************
+*	Pixie_Log_Flush function:
+*		Write all messages logged so far to stdout and PIXIEmsg.txt,
+*		in the order they were logged. Called by the flusher 
+*		thread, at exit, and by anyone who needs the messages 
+*		written now. A thread takes its Seq just before it 
+*		publishes the record, so the oldest record waiting may 
+*		not be the next one yet; then the flush stops at the gap
+*		and the following flush continues from there.
+*
+****************************************************************/
+
+void Pixie_Log_Flush (void)
+{
+	struct Log_Ring *r, *first;
+	struct Log_Record *rec;
+	S8 line[LOG_TEXT_LENGTH];
+	U32 dropped, n = 0;
+
+	pthread_mutex_lock(&LogFlushLock);
+	for(;;) {
+		/* the oldest record waiting in any ring */
+		first = NULL;
+		rec = NULL;
+		for(r = __atomic_load_n(&LogRings, __ATOMIC_ACQUIRE); r != NULL; r = r->Next) {
+			if(r->Tail == __atomic_load_n(&r->Head, __ATOMIC_ACQUIRE))
+				continue;
+			if(first == NULL || r->Rec[r->Tail & (LOG_RING_LENGTH-1)].Seq < rec->Seq) {
+				first = r;
+				rec = &r->Rec[r->Tail & (LOG_RING_LENGTH-1)];
+			}
+		}
+		if(first == NULL || rec->Seq != LogNext)
+			break;		// nothing waiting, or the next record is not published yet
+		LogNext++;
+
+		if(rec->Format)
+			snprintf((char *)line, LOG_TEXT_LENGTH, rec->Format, rec->Arg[0], rec->Arg[1], rec->Arg[2], 
+				rec->Arg[3], rec->Arg[4], rec->Arg[5], rec->Arg[6], rec->Arg[7]);
+		else
+			memcpy(line, rec->Text, LOG_TEXT_LENGTH);
+		__atomic_store_n(&first->Tail, first->Tail + 1, __ATOMIC_RELEASE);
+
+		if(LogFile == NULL)
+			LogFile = fopen("PIXIEmsg.txt", "a");
+		printf("%s\n", line);
+		if(LogFile != NULL)
+			fprintf(LogFile, "%s\n", line);
+		n++;
+	}
+
+	dropped = __atomic_load_n(&LogDropped, __ATOMIC_RELAXED);
+	if(dropped != LogDroppedReported) {
+		sprintf((char *)line, "*WARNING* (Pixie_Log_Flush): %u messages dropped, out of memory for the log", dropped - LogDroppedReported);
+		LogDroppedReported = dropped;
+		printf("%s\n", line);
+		if(LogFile != NULL)
+			fprintf(LogFile, "%s\n", line);
+		n++;
+	}
+	if(n) {
+		LogWritten += n;
+		fflush(stdout);
+		if(LogFile != NULL)
+			fflush(LogFile);
+	}
+	pthread_mutex_unlock(&LogFlushLock);
+}
+
+
+/****************************************************************
+*	Pixie_Log_Stats function:
+*		Return LOG_STATS_LENGTH words: messages written, times a
+*		thread found its ring full and flushed the log itself, 
+*		messages dropped, thread rings, and the most messages that
+*		were waiting in one ring.
+*
+****************************************************************/
+
+void Pixie_Log_Stats (
+					 U32 *stats )		// LOG_STATS_LENGTH words
+{
+	struct Log_Ring *r;
+
+	pthread_mutex_lock(&LogFlushLock);
+	stats[0] = LogWritten;
+	stats[1] = __atomic_load_n(&LogFull, __ATOMIC_RELAXED);
+	stats[2] = __atomic_load_n(&LogDropped, __ATOMIC_RELAXED);
+	stats[3] = __atomic_load_n(&LogRingCount, __ATOMIC_RELAXED);
+	stats[4] = 0;
+	for(r = __atomic_load_n(&LogRings, __ATOMIC_ACQUIRE); r != NULL; r = r->Next)
+		if(r->MaxFill > stats[4]) stats[4] = r->MaxFill;
+	pthread_mutex_unlock(&LogFlushLock);
+}
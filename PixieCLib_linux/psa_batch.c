@@ -0,0 +1,590 @@
+/*----------------------------------------------------------------------
+* Copyright (c) 2004, 2009, 2015 XIA LLC
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms,
+* with or without modification, are permitted provided
+* that the following conditions are met:
+*
+*   * Redistributions of source code must retain the above
+*     copyright notice, this list of conditions and the
+*     following disclaimer.
+*   * Redistributions in binary form must reproduce the
+*     above copyright notice, this list of conditions and the
+*     following disclaimer in the documentation and/or other
+*     materials provided with the distribution.
+*   * Neither the name of XIA LLC
+*     nor the names of its contributors may be used to endorse
+*     or promote products derived from this software without
+*     specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+* CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+* INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+* ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+* TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+* THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+* SUCH DAMAGE.
+*----------------------------------------------------------------------*/
+
+/******************************************************************************
+*
+* File name:
+*
+*      psa_batch.c
+*
+* Description:
+*
+*      Batch pulse shape analysis: baseline, amplitude, rise time, Q0 and Q1
+*      sums and PSA ratio of many traces at a time, with the same definitions
+*      and control words as ComputePSA (task 0x7030).
+*      Traces are kept back to back in one sample array, with start, length
+*      and each result in arrays of their own. The work per trace (maximum,
+*      threshold crossings, sums) is done by integer kernels, SSE2 and AVX2
+*      versions selected at run time as for the buffer QC (bufferqc.c).
+*      The floating point steps use the same expressions as ComputePSA, so
+*      results are identical to ComputePSA on the same trace, to the bit.
+*      Samples outside a trace count as 0, where ComputePSA reads whatever
+*      follows the trace in memory.
+*
+* Member functions:
+*					PSA_Kernel_Select()			- select kernel (auto, scalar, SSE2, AVX2)
+*					PSA_Batch_Create()			- allocate a batch
+*					PSA_Batch_Add()				- add a trace
+*					PSA_Batch_Compute()			- PSA values of all traces in the batch
+*					PSA_Batch_Clear()			- remove all traces
+*					PSA_Batch_Free()			- release a batch
+*
+******************************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "PlxTypes.h"
+#include "PciTypes.h"
+#include "Plx.h"
+
+#include "globals.h"
+#include "sharedfiles.h"
+#include "utilities.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PSA_X86
+#include <immintrin.h>
+#endif
+
+#define PSA_PAD		16		// samples after the last trace, so vector loads never leave the array
+#define PSA_NONE	0xFFFFFFFF
+
+static U16 (*PSA_Max_Kernel)(const U16 *x, U32 n) = NULL;
+static U32 (*PSA_Above_Kernel)(const U16 *x, U32 start, U32 n, U16 t) = NULL;
+static U64 (*PSA_Sum_Kernel)(const U16 *x, U32 start, U32 end) = NULL;
+static S32 PSA_Kernel = -1;
+
+
+/****************************************************************
+*	Scalar kernels
+*		Max:   largest of x[0..n-1]
+*		Above: first i in start..n-1 with x[i] > t, n if none
+*		Sum:   sum of x[start..end-1]
+****************************************************************/
+
+static U16 PSA_Max_Scalar (const U16 *x, U32 n)
+{
+	U16 m = 0;
+	U32 i;
+
+	for(i = 0; i < n; i++)
+		if(x[i] > m)
+			m = x[i];
+	return(m);
+}
+
+static U32 PSA_Above_Scalar (const U16 *x, U32 start, U32 n, U16 t)
+{
+	U32 i;
+
+	for(i = start; i < n; i++)
+		if(x[i] > t)
+			return(i);
+	return(n);
+}
+
+static U64 PSA_Sum_Scalar (const U16 *x, U32 start, U32 end)
+{
+	U64 s = 0;
+	U32 i;
+
+	for(i = start; i < end; i++)
+		s += x[i];
+	return(s);
+}
+
+
+#ifdef PSA_X86
+/****************************************************************
+*	SSE2 kernels, 8 samples at a time. Unsigned 16-bit
+*	compares are done as signed ones on x ^ 0x8000.
+****************************************************************/
+
+__attribute__((target("sse2")))
+static U16 PSA_Max_SSE2 (const U16 *x, U32 n)
+{
+	__m128i sign = _mm_set1_epi16((short)0x8000);
+	__m128i m = _mm_set1_epi16((short)0x8000);		// 0, biased
+	U16 v[8], r;
+	U32 i = 0, k;
+
+	for( ; i + 8 <= n; i += 8)
+		m = _mm_max_epi16(m, _mm_xor_si128(_mm_loadu_si128((__m128i *)&x[i]), sign));
+	_mm_storeu_si128((__m128i *)v, _mm_xor_si128(m, sign));
+	r = PSA_Max_Scalar(&x[i], n - i);
+	for(k = 0; k < 8; k++)
+		if(v[k] > r)
+			r = v[k];
+	return(r);
+}
+
+__attribute__((target("sse2")))
+static U32 PSA_Above_SSE2 (const U16 *x, U32 start, U32 n, U16 t)
+{
+	__m128i sign = _mm_set1_epi16((short)0x8000);
+	__m128i tt = _mm_set1_epi16((short)(t ^ 0x8000));
+	U32 i = start;
+	int mask;
+
+	for( ; i + 8 <= n; i += 8) {
+		mask = _mm_movemask_epi8(_mm_cmpgt_epi16(_mm_xor_si128(_mm_loadu_si128((__m128i *)&x[i]), sign), tt));
+		if(mask)
+			return(i + __builtin_ctz(mask)/2);
+	}
+	return(PSA_Above_Scalar(x, i, n, t));
+}
+
+__attribute__((target("sse2")))
+static U64 PSA_Sum_SSE2 (const U16 *x, U32 start, U32 end)
+{
+	__m128i zero = _mm_setzero_si128();
+	__m128i acc, v;
+	U32 lanes[4];
+	U64 s = 0;
+	U32 i = start, stop;
+
+	while(i + 8 <= end) {
+		acc = _mm_setzero_si128();
+		stop = (end - i > 8*16384) ? i + 8*16384 : end;		// 32-bit lanes can not overflow
+		for( ; i + 8 <= stop; i += 8) {
+			v = _mm_loadu_si128((__m128i *)&x[i]);
+			acc = _mm_add_epi32(acc, _mm_unpacklo_epi16(v, zero));
+			acc = _mm_add_epi32(acc, _mm_unpackhi_epi16(v, zero));
+		}
+		_mm_storeu_si128((__m128i *)lanes, acc);
+		s += (U64)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+	}
+	return(s + PSA_Sum_Scalar(x, i, end));
+}
+
+
+/****************************************************************
+*	AVX2 kernels, 16 samples at a time
+****************************************************************/
+
+__attribute__((target("avx2")))
+static U16 PSA_Max_AVX2 (const U16 *x, U32 n)
+{
+	__m256i m = _mm256_setzero_si256();
+	U16 v[16], r;
+	U32 i = 0, k;
+
+	for( ; i + 16 <= n; i += 16)
+		m = _mm256_max_epu16(m, _mm256_loadu_si256((__m256i *)&x[i]));
+	_mm256_storeu_si256((__m256i *)v, m);
+	r = PSA_Max_Scalar(&x[i], n - i);
+	for(k = 0; k < 16; k++)
+		if(v[k] > r)
+			r = v[k];
+	return(r);
+}
+
+__attribute__((target("avx2")))
+static U32 PSA_Above_AVX2 (const U16 *x, U32 start, U32 n, U16 t)
+{
+	__m256i sign = _mm256_set1_epi16((short)0x8000);
+	__m256i tt = _mm256_set1_epi16((short)(t ^ 0x8000));
+	U32 i = start;
+	U32 mask;
+
+	for( ; i + 16 <= n; i += 16) {
+		mask = (U32)_mm256_movemask_epi8(_mm256_cmpgt_epi16(_mm256_xor_si256(_mm256_loadu_si256((__m256i *)&x[i]), sign), tt));
+		if(mask)
+			return(i + __builtin_ctz(mask)/2);
+	}
+	return(PSA_Above_Scalar(x, i, n, t));
+}
+
+__attribute__((target("avx2")))
+static U64 PSA_Sum_AVX2 (const U16 *x, U32 start, U32 end)
+{
+	__m256i zero = _mm256_setzero_si256();
+	__m256i acc, v;
+	U32 lanes[8];
+	U64 s = 0;
+	U32 i = start, stop, k;
+
+	while(i + 16 <= end) {
+		acc = _mm256_setzero_si256();
+		stop = (end - i > 16*16384) ? i + 16*16384 : end;		// 32-bit lanes can not overflow
+		for( ; i + 16 <= stop; i += 16) {
+			v = _mm256_loadu_si256((__m256i *)&x[i]);
+			acc = _mm256_add_epi32(acc, _mm256_unpacklo_epi16(v, zero));
+			acc = _mm256_add_epi32(acc, _mm256_unpackhi_epi16(v, zero));
+		}
+		_mm256_storeu_si256((__m256i *)lanes, acc);
+		for(k = 0; k < 8; k++)
+			s += lanes[k];
+	}
+	return(s + PSA_Sum_Scalar(x, i, end));
+}
+#endif // PSA_X86
+
+
+/****************************************************************
+*	PSA_Kernel_Select function:
+*		Select the batch PSA kernels.
+*			QC_KERNEL_AUTO:   best supported by this CPU
+*			QC_KERNEL_SCALAR, QC_KERNEL_SSE2, QC_KERNEL_AVX2
+*		An unsupported choice falls back to the next lower one.
+*		Returns the kernel in use.
+*
+****************************************************************/
+
+S32 PSA_Kernel_Select (
+					   S32 Kernel)		// QC_KERNEL_AUTO, _SCALAR, _SSE2 or _AVX2
+{
+	S32 best = QC_KERNEL_SCALAR;
+
+#ifdef PSA_X86
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("sse2"))
+		best = QC_KERNEL_SSE2;
+	if(__builtin_cpu_supports("avx2"))
+		best = QC_KERNEL_AVX2;
+#endif
+
+	if(Kernel == QC_KERNEL_AUTO || Kernel > best)
+		Kernel = best;
+
+	switch(Kernel) {
+#ifdef PSA_X86
+		case QC_KERNEL_AVX2:
+			PSA_Max_Kernel = PSA_Max_AVX2;
+			PSA_Above_Kernel = PSA_Above_AVX2;
+			PSA_Sum_Kernel = PSA_Sum_AVX2;
+			break;
+		case QC_KERNEL_SSE2:
+			PSA_Max_Kernel = PSA_Max_SSE2;
+			PSA_Above_Kernel = PSA_Above_SSE2;
+			PSA_Sum_Kernel = PSA_Sum_SSE2;
+			break;
+#endif
+		default:
+			Kernel = QC_KERNEL_SCALAR;
+			PSA_Max_Kernel = PSA_Max_Scalar;
+			PSA_Above_Kernel = PSA_Above_Scalar;
+			PSA_Sum_Kernel = PSA_Sum_Scalar;
+			break;
+	}
+	__atomic_store_n(&PSA_Kernel, Kernel, __ATOMIC_RELEASE);	// kernels set before they are used by other threads
+
+	return(Kernel);
+}
+
+
+/****************************************************************
+*	PSA_Above function:
+*		First sample at or after start (as computed by ComputePSA,
+*		possibly wrapped around) that is larger than threshold.
+*		For integer samples, x > threshold is x > floor(threshold).
+*
+*		Return Value:
+*			sample index, PSA_NONE if there is none
+*
+****************************************************************/
+
+static U32 PSA_Above (const U16 *trace, U32 start, U32 traceLen, double threshold)
+{
+	U32 i;
+
+	if(start >= traceLen || threshold >= 65535.0)
+		return(PSA_NONE);
+	if(threshold < 0.0)
+		return(start);
+	i = PSA_Above_Kernel(trace, start, traceLen, (U16)threshold);
+	return((i < traceLen) ? i : PSA_NONE);
+}
+
+
+/****************************************************************
+*	PSA_Sum function:
+*		Sum of the samples start..end-1 (U32 loop as in ComputePSA,
+*		no samples if end <= start) that lie inside the trace.
+*
+****************************************************************/
+
+static U64 PSA_Sum (const U16 *trace, U32 traceLen, U32 start, U32 end)
+{
+	if(end > traceLen)
+		end = traceLen;
+	if(start >= end)
+		return(0);
+	return(PSA_Sum_Kernel(trace, start, end));
+}
+
+
+/****************************************************************
+*	PSA_Trace function:
+*		ComputePSA for one trace, with the searches and sums done by
+*		the kernels. The floating point steps are those of ComputePSA.
+*		Results go to out[0..5]: rise time, amplitude, baseline,
+*		Q0 sum, Q1 sum, PSA value (PSAval[11..16] of ComputePSA).
+*
+*		Return Value:
+*			 0 - success
+*			-1 - no proper rising edge or Q sums (as ComputePSA)
+*
+****************************************************************/
+
+static S32 PSA_Trace (const U16 *trace, U32 traceLen, U32 *PSAval, U32 *out)
+{
+	double base;
+	double ampl;
+	U32 V_maxloc;
+	U16 V_max;
+	U32 lev10, lev90;
+	U32 i, start, end, n;
+	double RTlow, RThigh;
+	double RT;
+	double Q0sum, Q1sum;
+	U32 Q0start, SoQ0, LoQ0;
+	U32 Q1start, SoQ1, LoQ1;
+	U32 normQ0, normQ1;
+	U32 PSAoption, PSAdiv8, PSAletrig, PSAth;
+	double LEthreshold;
+	U32 BLlen = 8;
+	S32 retval = 0;
+
+	LoQ0 = PSAval[1];
+	LoQ1 = PSAval[2];
+	SoQ0 = PSAval[3];
+	SoQ1 = PSAval[4];
+	RTlow = PSAval[5]/100.0;
+	RThigh = PSAval[6]/100.0;
+	PSAoption = PSAval[7];
+	PSAdiv8 = PSAval[8];
+	PSAletrig = PSAval[9];
+	PSAth = PSAval[10];
+	LEthreshold = PSAth*1.27*4;
+	normQ0 = normQ1 = PSAdiv8 ? 32 : 4;
+
+	// Baseline: sum of integers, exact in double as in ComputePSA
+	base = (double)PSA_Sum(trace, traceLen, 4, 4+BLlen);
+	base /= BLlen;
+
+	// Amplitude: first occurrence of the maximum
+	V_max = (traceLen > 0) ? PSA_Max_Kernel(trace, traceLen) : 0;
+	V_maxloc = (V_max > 0) ? PSA_Above_Kernel(trace, 0, traceLen, (U16)(V_max - 1)) : 0;
+	ampl = (double)V_max - base;
+
+	// 10% and 90% levels, searched from the same (unsigned) start as ComputePSA
+	start = (V_maxloc-LoQ0 > 0) ? V_maxloc-LoQ0 : 0;
+	i = PSA_Above(trace, start, traceLen, base + ampl*RTlow);
+	lev10 = (i != PSA_NONE) ? i : 0;
+	i = PSA_Above(trace, start, traceLen, base + ampl*RThigh);
+	lev90 = (i != PSA_NONE) ? i : 0;
+
+	RT  = (lev90-lev10)*16;	// in 1/16 clock cycles
+
+	Q0start = Q1start = lev10;
+	if (PSAletrig) {
+		i = PSA_Above(trace, start, traceLen, base + LEthreshold);
+		if(i != PSA_NONE)
+			Q0start = Q1start = i;
+	}
+
+	// Q sums: the sum over (sample - base) of ComputePSA is exact in double,
+	// so it equals sum(samples) - n*base, also exact
+	start = Q1start + SoQ1;
+	end = Q1start + SoQ1 + LoQ1;
+	n = (end > start) ? end - start : 0;
+	Q1sum = (double)PSA_Sum(trace, traceLen, start, end) - (double)n * base;
+	Q1sum /= normQ1;
+
+	start = Q0start + SoQ0;
+	end = Q0start + SoQ0 + LoQ0;
+	n = (end > start) ? end - start : 0;
+	Q0sum = (double)PSA_Sum(trace, traceLen, start, end) - (double)n * base;
+	Q0sum /= normQ0;
+
+	out[0] = (int)RT;
+	out[1] = (int)ampl;
+	out[2] = (int)base;
+	out[3] = (int)Q0sum;
+	out[4] = (int)Q1sum;
+	if (Q0sum > 0) 
+		out[5] = (PSAoption>0) ? (int)(1000.*((Q1sum-Q0sum)/Q0sum)) : (int)(1000.*(Q1sum/Q0sum));
+	else 
+		out[5] = 0;
+
+	if (lev10 >= lev90 || lev10 >=V_maxloc || lev90 > V_maxloc)
+		retval = -1;
+	if (Q0sum<=0 || Q1sum<=0 )
+		retval = -1;
+	return(retval);
+}
+
+
+/****************************************************************
+*	PSA_Batch_Create function:
+*		Allocate a batch for up to maxTraces traces with up to
+*		maxSamples samples in total.
+*
+*		Return Value:
+*			batch, NULL on memory allocation error
+*
+****************************************************************/
+
+PSABatch *PSA_Batch_Create (
+							U32 maxTraces,		// traces per batch
+							U32 maxSamples)		// samples of all traces together
+{
+	PSABatch *B;
+
+	if(!(B = calloc(1, sizeof(*B))))
+		return(NULL);
+	B->MaxTraces  = maxTraces;
+	B->MaxSamples = maxSamples;
+	B->Samples    = calloc((size_t)maxSamples + PSA_PAD, sizeof(U16));
+	B->Start      = calloc(maxTraces, sizeof(U32));
+	B->Length     = calloc(maxTraces, sizeof(U32));
+	B->RiseTime   = calloc(maxTraces, sizeof(U32));
+	B->Amplitude  = calloc(maxTraces, sizeof(U32));
+	B->Baseline   = calloc(maxTraces, sizeof(U32));
+	B->Q0Sum      = calloc(maxTraces, sizeof(U32));
+	B->Q1Sum      = calloc(maxTraces, sizeof(U32));
+	B->PSAValue   = calloc(maxTraces, sizeof(U32));
+	B->Status     = calloc(maxTraces, sizeof(S32));
+	if(!B->Samples || !B->Start || !B->Length || !B->RiseTime || !B->Amplitude || !B->Baseline ||
+	   !B->Q0Sum || !B->Q1Sum || !B->PSAValue || !B->Status) {
+		sprintf(ErrMSG, "*ERROR* (PSA_Batch_Create): not enough memory for %u traces, %u samples", maxTraces, maxSamples);
+		Pixie_Print_MSG(ErrMSG,1);
+		PSA_Batch_Free(B);
+		return(NULL);
+	}
+	return(B);
+}
+
+
+/****************************************************************
+*	PSA_Batch_Add function:
+*		Copy a trace into the batch.
+*
+*		Return Value:
+*			number of the trace in the batch, -1 if the batch is full
+*
+****************************************************************/
+
+S32 PSA_Batch_Add (
+				   PSABatch *B,			// batch
+				   U16 *trace,			// trace
+				   U32 traceLen)		// samples
+{
+	if(B->NumTraces == B->MaxTraces || traceLen > B->MaxSamples - B->NumSamples)
+		return(-1);
+	memcpy(&B->Samples[B->NumSamples], trace, traceLen * sizeof(U16));
+	B->Start[B->NumTraces]  = B->NumSamples;
+	B->Length[B->NumTraces] = traceLen;
+	B->NumSamples += traceLen;
+	return((S32)B->NumTraces++);
+}
+
+
+/****************************************************************
+*	PSA_Batch_Compute function:
+*		PSA values of all traces in the batch. PSAval holds the
+*		control words 1-10 as for ComputePSA; results go to the
+*		result arrays of the batch, not to PSAval.
+*
+*		Return Value:
+*			number of traces with Status -1
+*
+****************************************************************/
+
+S32 PSA_Batch_Compute (
+					   PSABatch *B,			// batch
+					   U32 *PSAval)			// control words, as for ComputePSA
+{
+	U32 k, out[6];
+	S32 bad = 0;
+
+	if(__atomic_load_n(&PSA_Kernel, __ATOMIC_ACQUIRE) < 0)
+		PSA_Kernel_Select(QC_KERNEL_AUTO);
+
+	for(k = 0; k < B->NumTraces; k++) {
+		B->Status[k]    = PSA_Trace(&B->Samples[B->Start[k]], B->Length[k], PSAval, out);
+		B->RiseTime[k]  = out[0];
+		B->Amplitude[k] = out[1];
+		B->Baseline[k]  = out[2];
+		B->Q0Sum[k]     = out[3];
+		B->Q1Sum[k]     = out[4];
+		B->PSAValue[k]  = out[5];
+		if(B->Status[k] != 0)
+			bad++;
+	}
+	return(bad);
+}
+
+
+/****************************************************************
+*	PSA_Batch_Clear function:
+*		Remove all traces from the batch.
+*
+****************************************************************/
+
+void PSA_Batch_Clear (
+					  PSABatch *B)		// batch
+{
+	B->NumTraces  = 0;
+	B->NumSamples = 0;
+}
+
+
+/****************************************************************
+*	PSA_Batch_Free function:
+*		Release a batch.
+*
+****************************************************************/
+
+void PSA_Batch_Free (
+					 PSABatch *B)		// batch
+{
+	if(!B)
+		return;
+	free(B->Samples);
+	free(B->Start);
+	free(B->Length);
+	free(B->RiseTime);
+	free(B->Amplitude);
+	free(B->Baseline);
+	free(B->Q0Sum);
+	free(B->Q1Sum);
+	free(B->PSAValue);
+	free(B->Status);
+	free(B);
+}
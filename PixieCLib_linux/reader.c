@@ -42,6 +42,8 @@
 * Description:
 *
 *      This file contains format reader functions for Pixie.
+*      P4e/500e files are read through the event index of lm_index.c.
+*      Single events of P4/500 files are read through the block reader of lm_block.c.
 *
 * Revision:
 *
@@ -249,27 +251,34 @@ void CheckSums (U32 *Computed, U32 *Recorded, U16 *ChannelHeader) {
 *		- check for prev. trace length, correct if necessary
 *		- check for current trace length, correct if necessary
 *		- final file pointer at beginning of currwent trace 
+*		The file is read through a block reader (lm_block.c): FilePos
+*		is the position just after the channel header on entry and
+*		receives the beginning of the current trace.
 *
 *		Return Values: 0 if ok
 *					   1 if unrecoverable error
 *
 ****************************************************************/
 
-U32 ErrorChecking (U16 *ChannelHeader, U16 direction, U16 RunType,  FILE *ListModeFile, P500E_t P500E) {
+U32 ErrorChecking (U16 *ChannelHeader, U16 direction, U16 RunType, LMB_t Block, S64 *FilePos, P500E_t P500E) {
 
 	S64  i = 0;
 	S64  CurrentFilePos = 0;
+	S64  Pos = 0;			/* file position of the next read, bytes */
 	U32  Computed = 0; /* Check sum */
 	U32  Recorded = 0; /* Check sum */
 	U32  WaterMark = 0;
 	U32  Skipped16=0;
 	U16  Words[2] = {0};
+	U16  *w;
+	U32  got;
 	S64	 skipbytes;
 	U16  hit;
 	U16 CHL = *P500E->ChanHeadLen;
 	int errorf =0;
  
-	CurrentFilePos = Pixie_ftell(ListModeFile);	// positioned just after current header
+	CurrentFilePos = *FilePos;	// positioned just after current header
+	Pos = CurrentFilePos;
 	if(direction==1)						// 1 means search to right, towards next event
 		skipbytes = CHL*(-2)+4;				// in searching WM, move pointer in file a channel header back and then 2 16 bit words forward
 	else
@@ -277,36 +286,35 @@ U32 ErrorChecking (U16 *ChannelHeader, U16 direction, U16 RunType,  FILE *ListMo
 
 	WaterMark = (U32)ChannelHeader[WATERMARKINDEX16] + (U32)ChannelHeader[WATERMARKINDEX16+1]*65536;
 	while (WaterMark != WATERMARK) { 
-		sprintf(ErrMSG, "*ERROR* (ErrorChecking): Bad watermark in current event: 0x%X",WaterMark);
-		Pixie_Print_MSG(ErrMSG,(PrintDebugMsg_QCerror && Skipped16==0) );	// if bad watermark and we did not skip in the previous cycle, it's a new error: print
+		Pixie_Log_Rec(PrintDebugMsg_QCerror && Skipped16==0, "*ERROR* (ErrorChecking): Bad watermark in current event: 0x%X", 1, WaterMark);	// if bad watermark and we did not skip in the previous cycle, it's a new error: print
 
 		// scan for next WM
-		Pixie_fseek (ListModeFile , skipbytes, SEEK_CUR);	// skip from previous read and try again. 
+		if(Pos+skipbytes >= 0)
+			Pos += skipbytes;								// skip from previous read and try again. 
 		Skipped16++;										// count how many words skipped
 		Skipped16++;										// count how many words skipped
-		fread(ChannelHeader, sizeof(U16), CHL, ListModeFile);
+		Pos += 2*LM_Block_Read(Block, Pos, ChannelHeader, CHL);
 		WaterMark = (U32)ChannelHeader[WATERMARKINDEX16] + (U32)ChannelHeader[WATERMARKINDEX16+1]*65536;
 
 		// give up if too many skips (4* the max waveform length). Note: not in while condition so we can print this message
 		if(Skipped16 > MAXFIFOBLOCKS * BLOCKSIZE * 4) {		
 			sprintf(ErrMSG, "*ERROR* (ErrorChecking): list file badly damaged");
 			Pixie_Print_MSG(ErrMSG,1);
+			*FilePos = Pos;
 			return (1);				    
 		}
 	}
 	// once we found a watermark: print how many words skipped (if any) and set skip counter to zero
 	if (Skipped16 > 0) {
-		sprintf(ErrMSG, "*DEBUG* (ErrorChecking): Skipped %d words before finding event",Skipped16);
-		Pixie_Print_MSG(ErrMSG,PrintDebugMsg_QCdetail);
+		Pixie_Log_Rec(PrintDebugMsg_QCdetail, "*DEBUG* (ErrorChecking): Skipped %d words before finding event", 1, Skipped16);
 		Skipped16=0;
-		CurrentFilePos = Pixie_ftell(ListModeFile); // positioned just after current header
+		CurrentFilePos = Pos; // positioned just after current header
 	}
 	
 	/* Check checksum */
 	CheckSums (&Computed, &Recorded, ChannelHeader);
 	if (Computed != Recorded) {
-		sprintf(ErrMSG, "*ERROR* (ErrorChecking): Checksum mismatch.");
-		Pixie_Print_MSG(ErrMSG,PrintDebugMsg_QCerror);
+		Pixie_Log_Rec(PrintDebugMsg_QCerror, "*ERROR* (ErrorChecking): Checksum mismatch.", 0);
 		ChannelHeader[1] |= 0x8000; /* Mark as bad event.*/
 	} // end checking checksum
 
@@ -315,8 +323,7 @@ U32 ErrorChecking (U16 *ChannelHeader, U16 direction, U16 RunType,  FILE *ListMo
 	// no matter if checksum is good or bad, 
 	if((RunType & 0xFF0F) != 0x402) {		// no channel number in 0x402 record
 		if (ChannelHeader[9] > (NUMBER_OF_CHANNELS - 1)) { 
-			sprintf(ErrMSG, "*ERROR* (ErrorChecking): wrong channel number: %hu",ChannelHeader[9]);
-			Pixie_Print_MSG(ErrMSG,PrintDebugMsg_QCerror);
+			Pixie_Log_Rec(PrintDebugMsg_QCerror, "*ERROR* (ErrorChecking): wrong channel number: %hu", 1, ChannelHeader[9]);
 			ChannelHeader[1] |= 0x8000; /* Mark as bad event.*/
 
 			// try to recover from hit pattern
@@ -347,6 +354,7 @@ U32 ErrorChecking (U16 *ChannelHeader, U16 direction, U16 RunType,  FILE *ListMo
 	// - check previous trace length by looking for prev. watermark
 	// - check  following trace length by looking for next watermark 
 	//    except if we have an end-of-run record
+	// the searches below step 2 words at a time through the block reader's window, refilled only when they leave it
 
 	/* check previous trace length. no known value from prev. event, so have to look for it */
 	// note: corrected value may be shorter than actual length due to block size coarseness. Must use "direction" parameter to find correctly
@@ -355,20 +363,24 @@ U32 ErrorChecking (U16 *ChannelHeader, U16 direction, U16 RunType,  FILE *ListMo
 		errorf = 1;														// indicate "errorf" which means prev. event outside file
 	}
 	else {
-		Pixie_fseek (ListModeFile ,skipbytes , SEEK_CUR);						//  go back to (nominal) WM of prev event (previously check this is in range)
-		fread (Words, sizeof(U16), 2, ListModeFile);
+		Pos = CurrentFilePos + skipbytes;								//  go back to (nominal) WM of prev event (previously check this is in range)
+		Pos += 2*LM_Block_Read(Block, Pos, Words, 2);
 		WaterMark = (U32)Words[0] + (U32)Words[1]*65536; 
 		if (WaterMark != WATERMARK) { 
-			sprintf(ErrMSG, "*ERROR* (ErrorChecking): wrong previous trace size ");
-			Pixie_Print_MSG(ErrMSG,PrintDebugMsg_QCerror);				// if bad watermark, the prev. trace size is bad
+			Pixie_Log_Rec(PrintDebugMsg_QCerror, "*ERROR* (ErrorChecking): wrong previous trace size ", 0);				// if bad watermark, the prev. trace size is bad
 			ChannelHeader[1] |= 0x8000;									// Mark as bad event
 
-			errorf = Pixie_fseek (ListModeFile , CurrentFilePos-CHL*2-4, SEEK_SET); // set to known position of beginning of current header, then 2 16bit words back.  errorf is zero if ok
+			Pos = CurrentFilePos-CHL*2-4;								// set to known position of beginning of current header, then 2 16bit words back
+			errorf = (Pos < 0);											// errorf is zero if ok
 			
 			while ( (WaterMark != WATERMARK) && (!errorf) ) { 
-				fread (Words, sizeof(U16), 2, ListModeFile);			// read and move 2 words forward
+				w = LM_Block_Get(Block, Pos, 2, &got);					// read 2 words, then go back 2 16bit words from where they start
+				if(got > 0) Words[0] = w[0];
+				if(got > 1) Words[1] = w[1];
 				WaterMark = (U32)Words[0] + (U32)Words[1]*65536;
-				errorf = Pixie_fseek (ListModeFile , -8, SEEK_CUR);			//  go back 4 16bit words
+				Pos += 2*got;
+				errorf = (Pos-8 < 0);
+				if(!errorf) Pos -= 8;
 				Skipped16++;
 				Skipped16++;
 
@@ -376,46 +388,47 @@ U32 ErrorChecking (U16 *ChannelHeader, U16 direction, U16 RunType,  FILE *ListMo
 				if(Skipped16 > MAXFIFOBLOCKS * BLOCKSIZE * 4) {		
 					sprintf(ErrMSG, "*ERROR* (ErrorChecking): list file badly damaged");
 					Pixie_Print_MSG(ErrMSG,1);
+					*FilePos = Pos;
 					return (1);				    
 				}
-			} // end while loop. file pointer just after WM position of previous event
+			} // end while loop. Pos just after WM position of previous event
 
-			i = Pixie_ftell(ListModeFile);									// get current position at just after WM position of previous event
+			i = Pos;													// current position at just after WM position of previous event
 			i = i+2*(CHL-WATERMARKINDEX16);								// adjust to beginning of prev. trace
 			i = (S64)fabs(CurrentFilePos - i);							// difference to beginning of current trace
 			ChannelHeader[3] = (U16)floor(2 * i / BLOCKSIZE) - 1;		// update prev. trace length in blocks
-			sprintf(ErrMSG, "*DEBUG* (ErrorChecking) Trace length: %d i: %d", ChannelHeader[3], i);
-			Pixie_Print_MSG(ErrMSG,PrintDebugMsg_QCdetail);
+			Pixie_Log_Rec(PrintDebugMsg_QCdetail, "*DEBUG* (ErrorChecking) Trace length: %d i: %d", 2, ChannelHeader[3], i);
 		}
 	}		
-	if(errorf) {	//fseek outside file or other error
+	if(errorf) {	//position outside file or other error
 		ChannelHeader[3] = 0;		// set prev. TL to zero
-		sprintf(ErrMSG, "*DEBUG* (ErrorChecking): previous event would be outside file, assuming current is the first with previous trace size = 0");
-		Pixie_Print_MSG(ErrMSG,PrintDebugMsg_QCdetail);
+		Pixie_Log_Rec(PrintDebugMsg_QCdetail, "*DEBUG* (ErrorChecking): previous event would be outside file, assuming current is the first with previous trace size = 0", 0);
 	}
 	/* end check previous trace length */
 
 
 	/* check current trace length; have to look for it. If this is the EOR record, it must be zero */
 	// note: corrected value may be shorter than actual length due to block size coarseness. Must use "direction" parameter to find correctly
-	Pixie_fseek (ListModeFile , CurrentFilePos, SEEK_SET);	// go back to known position at beginnin of current trace
 	skipbytes = (ChannelHeader[2]*BLOCKSIZE)*(2)+WATERMARKINDEX16*2;
-	errorf = Pixie_fseek (ListModeFile ,skipbytes , SEEK_CUR); //  go forward trace (nominal), then forward to WM. 
-	if( ((U32)ChannelHeader[0] + (U32)ChannelHeader[1]*65536) == EORMARK)	//If there are trailing zeros in the file, the above errorf checking does not catch the last event, so check for EOR
+	Pos = CurrentFilePos + skipbytes;							// from beginning of current trace go forward trace (nominal), then forward to WM. 
+	errorf = 0;
+	if( ((U32)ChannelHeader[0] + (U32)ChannelHeader[1]*65536) == EORMARK)	//If there are trailing zeros in the file, the checking below does not catch the last event, so check for EOR
 		errorf=1;												// indicate "errorf" which means next event outside file
 	if(!errorf) {
-		fread (Words, sizeof(U16), 2, ListModeFile);
+		Pos += 2*LM_Block_Read(Block, Pos, Words, 2);
 		WaterMark = (U32)Words[0] + (U32)Words[1]*65536; 
 		if (WaterMark != WATERMARK) { 
-			sprintf(ErrMSG, "*ERROR* (ErrorChecking): wrong current trace size ");
-			Pixie_Print_MSG(ErrMSG,PrintDebugMsg_QCerror);		// if bad watermark, the prev. trace size is bad
+			Pixie_Log_Rec(PrintDebugMsg_QCerror, "*ERROR* (ErrorChecking): wrong current trace size ", 0);		// if bad watermark, the prev. trace size is bad
 			ChannelHeader[1] |= 0x8000;							// Mark as bad event.
 
-			Pixie_fseek (ListModeFile , CurrentFilePos, SEEK_SET);	// set to known position of beginning of current trace
+			Pos = CurrentFilePos;								// set to known position of beginning of current trace
 			
 			while ( (WaterMark != WATERMARK) && !(errorf) ) { 
-				errorf = fread (Words, sizeof(U16), 2, ListModeFile);		// read and move 2 words forward
-				errorf = 2-errorf;								// zero if successfully read the 2 words
+				w = LM_Block_Get(Block, Pos, 2, &got);			// read and move 2 words forward
+				if(got > 0) Words[0] = w[0];
+				if(got > 1) Words[1] = w[1];
+				Pos += 2*got;
+				errorf = 2-got;									// zero if successfully read the 2 words
 				WaterMark = (U32)Words[0] + (U32)Words[1]*65536;
 				Skipped16++;
 				Skipped16++;
@@ -424,27 +437,26 @@ U32 ErrorChecking (U16 *ChannelHeader, U16 direction, U16 RunType,  FILE *ListMo
 				if(Skipped16 > MAXFIFOBLOCKS * BLOCKSIZE * 4) {		
 					sprintf(ErrMSG, "*ERROR* (ErrorChecking): list file badly damaged");
 					Pixie_Print_MSG(ErrMSG,1);
+					*FilePos = Pos;
 					return (1);				    
 				}
-			} // end while loop. file pointer just after WM position of previous event
+			} // end while loop. Pos just after WM position of next event
 
-			i = Pixie_ftell(ListModeFile);							// get current position at just after WM position of next event
+			i = Pos;											// current position at just after WM position of next event
 			i = i-2*(WATERMARKINDEX16);							// adjust to beginning of next header
 			i = (S64)fabs(CurrentFilePos - i);					// difference to beginning of current trace
 			ChannelHeader[3] = (U16)floor(2 * i / BLOCKSIZE);	// update current trace length in blocks
-			sprintf(ErrMSG, "*DEBUG* (ErrorChecking) Trace length: %d i: %d", ChannelHeader[3], i);
-			Pixie_Print_MSG(ErrMSG,PrintDebugMsg_QCdetail);
+			Pixie_Log_Rec(PrintDebugMsg_QCdetail, "*DEBUG* (ErrorChecking) Trace length: %d i: %d", 2, ChannelHeader[3], i);
 
 		}
 	}
-	if(errorf) {	//fseek outside file or other error. 
+	if(errorf) {	//position outside file or other error. 
 		ChannelHeader[2] = 0;		// set current TL to zero
-		sprintf(ErrMSG, "*DEBUG* (ErrorChecking): next event would be outside file, assuming this is the last event (EOR) with trace size = 0");
-		Pixie_Print_MSG(ErrMSG,PrintDebugMsg_QCdetail);
+		Pixie_Log_Rec(PrintDebugMsg_QCdetail, "*DEBUG* (ErrorChecking): next event would be outside file, assuming this is the last event (EOR) with trace size = 0", 0);
 	}
 	/* end check current trace length */
 
-	Pixie_fseek (ListModeFile , CurrentFilePos, SEEK_SET); // set file position to beginning of trace
+	*FilePos = CurrentFilePos; // set file position to beginning of trace
 
 	return (0);
 	/* End error checking */
@@ -453,6 +465,9 @@ U32 ErrorChecking (U16 *ChannelHeader, U16 direction, U16 RunType,  FILE *ListMo
 /****************************************************************
 *	Pixie_List_Mode_Parser function (P4e/500e):
 *		Parse the list mode files to get various information.
+*		Events are taken from the index of the memory-mapped file
+*		(see lm_index.c), which is built with the error checking
+*		on first use and saved next to the file as <filename>.idx.
 *       Task 0x7001 Mode 0: report the total number of events.
 *       Task 0x7001 Mode 1: report the total number of events
 *                           and create an ASCII file with some 
@@ -524,38 +539,84 @@ U32 ErrorChecking (U16 *ChannelHeader, U16 direction, U16 RunType,  FILE *ListMo
 
 ****************************************************************/
 
+#define PSA_BATCH_TRACES		1024					// 0x7030: traces per PSA batch
+#define PSA_BATCH_SAMPLES		(4*MAX_TRACE_LENGTH)	// 0x7030: samples per PSA batch
+
+// 0x7030: event data printed with the PSA values
+typedef struct {
+	U32 Event;
+	U16 ChanNo;
+	U16 Energy;
+	U64 TimeStamp;
+} PSAEventInfo;
+
+/****************************************************************
+*	PSA_Batch_Output function:
+*		Task 0x7030: compute the PSA values of the traces in the
+*		batch and print them with their events, in order. 
+*		UserData[11..16] are left with the values of the last event.
+*
+****************************************************************/
+
+static void PSA_Batch_Output (FILE *OutputFile, PSABatch *PSA, PSAEventInfo *Info, U32 *UserData)
+{
+	U32 k;
+
+	PSA_Batch_Compute(PSA, UserData);
+	for (k = 0; k < PSA->NumTraces; k++) {
+		if (PSA->Status[k] != 0) {
+			// Not quitting processing, just reporting bad PSA calculation.
+			Pixie_Log_Rec(PrintDebugMsg_QCdetail, "*WARNING* (Pixie_List_Mode_Parser): Failed calculating PSA for event %u.", 1, Info[k].Event);
+			UserData[11] = 0;
+			UserData[12] = 0;
+			UserData[13] = 0;
+			UserData[14] = 0;
+			UserData[15] = 0;
+			UserData[16] = 0;
+		}
+		else {
+			UserData[11] = PSA->RiseTime[k];
+			UserData[12] = PSA->Amplitude[k];
+			UserData[13] = PSA->Baseline[k];
+			UserData[14] = PSA->Q0Sum[k];
+			UserData[15] = PSA->Q1Sum[k];
+			UserData[16] = PSA->PSAValue[k];
+		}
+		fprintf(OutputFile, "%u   %hu   %llu   %hu   %hu   %hu   %hu   %hu  %hu  %hu\n",
+				Info[k].Event, 
+				Info[k].ChanNo,
+				(unsigned long long)Info[k].TimeStamp,
+				Info[k].Energy,
+				UserData[11], UserData[12], UserData[13], UserData[14], UserData[15], UserData[16]);
+	}
+	PSA_Batch_Clear(PSA);
+}
+
 
 S32 Pixie_List_Mode_Parser(S8 *filename, U32 *UserData, U16 TaskNum )
 {
 	U8   mode[3] = {"w"};
 	U16  i = 0;
-	U16  Words[2] = {0};
-	U16  hit;
-	U16  MyNumTraceBlksPrev=0;
 	U16  P4hsize16 = BUFFER_HEAD_LENGTH + EVENT_HEAD_LENGTH + P4_MAX_CHAN_HEAD_LENGTH;
 	U16  RunType;
 	U16  ChannelNo = 0;
 	U32  TraceNum = 0;
-	U16  EventLengthRH;
-	U16  ReadMoreFileData = 1;
+	U32  EventNum;
 	S32	 ReturnValue = 0;
-	U32  CheckSumComputed = 0;
-	U32  CheckSumRecorded = 0;
-	U32  WaterMark = 0;
 	U32  *ShiftFromStart = NULL;
 	U32  EHR;
 	U16  *P4headers = NULL;
 	U32  TotalShift      =  0;
 	S64  EventPos = RUN_HEAD_LENGTH;
 	S64  GoodHeaderPos = 0;
-	S64  offset16 = 0;
-	S64  Skipped32 = 0;
 	double	RunStartTime = 0;
-	BOOL nextWMfound = FALSE;
 	/* Pointers to data structures for the list mode reader */
 	LMR_t		LMP5 = NULL;
 	P500E_t		P500E = NULL;
-	size_t		bytesRead = 0;
+	LMI_t		Idx = NULL;
+	/* 0x7030: traces waiting for PSA, and their events */
+	PSABatch	*PSA = NULL;
+	PSAEventInfo *PSAInfo = NULL;
 
 	sprintf(ErrMSG, "*INFO* (Pixie_List_Mode_Parser): Start processing LM file");
 	Pixie_Print_MSG(ErrMSG,PrintDebugMsg_other);
@@ -596,42 +657,23 @@ S32 Pixie_List_Mode_Parser(S8 *filename, U32 *UserData, U16 TaskNum )
 			return(-2);
 	}
 
-	/* Open the list mode file if exists */
+	/* Map the list mode file and get its event index. The index is built by the QC below on first use */
+	/* and kept in <filename>.idx, so later tasks on the same file do not have to check every event again */
 	LMP5->ListModeFileName = filename;
-	if(LMP5->ListModeFile) fclose(LMP5->ListModeFile);
-	if(!(LMP5->ListModeFile = fopen(LMP5->ListModeFileName, "rb"))) { 
-		sprintf(ErrMSG, "*ERROR* (Pixie_List_Mode_Parser): can't open list mode data file %s", LMP5->ListModeFileName);
-		Pixie_Print_MSG(ErrMSG,1);
+	ReturnValue = LM_Index_Open(filename, &Idx);
+	if(!Idx) {
 		free(LMP5);
 		free(P500E); 
 		free(ShiftFromStart);
 		free(P4headers);
-		return(-1);
-	}
-
-	/* Read the first buffer/run/channel header to glean initial information about the type of the list mode file */
-	fread (LMP5->FirstHeader, sizeof(U16), FIRST_HEAD_LENGTH, LMP5->ListModeFile);
-	RunType = LMP5->FirstHeader[2];
-
-		// Check for valid RunType
-	if (RunType < 0x400 || RunType > 0x4F3) { /* If run type is bogus then finish processing */
-		sprintf(ErrMSG, "*ERROR* (Pixie_List_Mode_Parser): wrong run type 0x%x", RunType);
-		Pixie_Print_MSG(ErrMSG,1);
-		fclose(LMP5->ListModeFile);
-		free(LMP5);
-		free(P500E); 
-		free(ShiftFromStart);
-		free(P4headers);
-		return (-5);
-	} 
-	else {
-		sprintf(ErrMSG, "*INFO* (Pixie_List_Mode_Parser): RunType = 0x%x", RunType);
-		Pixie_Print_MSG(ErrMSG,PrintDebugMsg_other);
+		return(ReturnValue);
 	}
+	RunType = Idx->RunType;
+	sprintf(ErrMSG, "*INFO* (Pixie_List_Mode_Parser): RunType = 0x%x", RunType);
+	Pixie_Print_MSG(ErrMSG,PrintDebugMsg_other);
 
-	/* Copy first header to the corresponding run header and first channel header */
-	memcpy (LMP5->RunHeader,        &LMP5->FirstHeader[0],		RUN_HEAD_LENGTH * sizeof(U16) );
-	rewind(LMP5->ListModeFile);
+	/* Copy run header */
+	memcpy (LMP5->RunHeader, Idx->RunHeader, RUN_HEAD_LENGTH * sizeof(U16) );
 
 	/* Pixie-500 Express List Mode Format Mapping */
 	if((RunType & 0xFF0F) == 0x402)
@@ -639,279 +681,18 @@ S32 Pixie_List_Mode_Parser(S8 *filename, U32 *UserData, U16 TaskNum )
 	else
 		P500E_Format_Map_400 (LMP5, P500E);
 	
-	/* Read run header */
-	fread (LMP5->RunHeader, sizeof(U16), RUN_HEAD_LENGTH, LMP5->ListModeFile);
-	/* Remember the end position of the last header */
-	GoodHeaderPos = (S64)Pixie_ftell (LMP5->ListModeFile);		// This eliminated unneccesary parsing of the first 32 words?
-
-	/* Read the list mode file and do the processing */
-	/* Loop over channel headers */
-	while ( ReadMoreFileData) {
-		
-			bytesRead = fread (LMP5->ChannelHeader, sizeof(U16), *P500E->ChanHeadLen, LMP5->ListModeFile);
-			if(bytesRead != *P500E->ChanHeadLen) {
-				sprintf(ErrMSG, "*ERROR* (Pixie_List_Mode_Parser): Less than a channel header remaining in file, exiting file");
-				Pixie_Print_MSG(ErrMSG,1);
-				ReadMoreFileData=0;
-				continue;
-			}
-			
-			  // if the event pattern is all zero, exit the loop over events
-			  // (except in the first event, where we might have leading zeros which are handled by error checking)
-			  if( (*P500E->EvtPattern==0) && (LMP5->TotalEvents>=0) )	 {
-				sprintf(ErrMSG, "*ERROR* (Pixie_List_Mode_Parser): Found all zero event pattern, exiting file");
-				Pixie_Print_MSG(ErrMSG,PrintDebugMsg_QCdetail);
-				ReadMoreFileData=0;
-				continue;
-			  }
-
-				// fill run type dependent event parameters
-				if((RunType & 0xFF0F) == 0x402) {	
-					ChannelNo = 0;// default to zero
-					EventLengthRH = *P500E->SumChanLen - 3; // EventLengthTotal = 4x (header + TL), in blocks; so subtract 3 for actual length in runtype 0x402
-				}
-				else {
-					// for other run types, this default may be overwritten in channel error check
-					ChannelNo = *P500E->ChanNo;
-					EventLengthRH = LMP5->RunHeader[8+ ChannelNo];
-				}
-
-			/* ERROR CHECKING */
-			/* Begin check watermark */
-			WaterMark = *P500E->WaterMark0 + *P500E->WaterMark1 * 65536;
-
-			if (WaterMark != WATERMARK) { 
-				sprintf(ErrMSG, "*ERROR* (Pixie_List_Mode_Parser): Bad watermark: 0x%X, event %d",WaterMark, LMP5->TotalEvents);
-				Pixie_Print_MSG(ErrMSG,(PrintDebugMsg_QCerror && Skipped32==0) );	// if bad watermark and we did not skip in the previous cycle, it's a new error: print
-
-				Pixie_fseek (LMP5->ListModeFile , (S64)(*P500E->ChanHeadLen)*(-2)+4, SEEK_CUR); // move pointer in file 2 16 bit words ahead from previous read and try again. 
-				Skipped32++; // count how many words skipped
-				
-				if(Skipped32 > (MAXFIFOBLOCKS * BLOCKSIZE)/2 * 4) {		// give up if too many skips (4* the max waveform length
-						sprintf(ErrMSG, "*ERROR* (Pixie_List_Mode_Parser): list file badly damaged. Event: %d", LMP5->TotalEvents);
-						Pixie_Print_MSG(ErrMSG,1);
-						fclose(LMP5->ListModeFile);
-						free(LMP5);
-						free(P500E); 
-						free(ShiftFromStart);
-						free(P4headers);
-						return (-3);				    
-					}
-				continue;		//next cycle
-			}
-			
-			// once we found a watermark: print how many words skipped (if any) and set skip counter to zero
-			if (Skipped32 > 0) {
-				sprintf(ErrMSG, "*DEBUG* (Pixie_List_Mode_Parser): Skipped %d words before finding event %d",Skipped32, LMP5->TotalEvents);
-				Pixie_Print_MSG(ErrMSG,PrintDebugMsg_QCdetail);
-				Skipped32=0;
-			}
-			
-			// Remember the end position of the last header 
-			GoodHeaderPos = (S64)Pixie_ftell (LMP5->ListModeFile);		// WH_TODO: check. This eliminated unneccesary parsing of the first 32 words?
-
-			/* End check watermark */
-		
-			/* Begin check checksums */
-			// The idea is that all values make sense if the checksum is correct.
-			// For example, a channel number can only be wrong if the checksum is wrong (DSP would not write a bad value on purpose)
-			// The exception is the trace length, which may be correct but different from actual recorded langth, e.g. if some words are just missing
-			CheckSums (&CheckSumComputed, &CheckSumRecorded, LMP5->ChannelHeader);
-			if (CheckSumComputed != CheckSumRecorded) { 
-				// If checksums do not match 
-				sprintf(ErrMSG, "*ERROR* (Pixie_List_Mode_Parser): Checksums do not match. Computed: 0x%X, Recorded: 0x%X Event: %d",CheckSumComputed, CheckSumRecorded, LMP5->TotalEvents);
-				Pixie_Print_MSG(ErrMSG,PrintDebugMsg_QCerror);
-				if (LMP5->TotalEvents == 0) {
-					sprintf(ErrMSG, "TaskNum: 0x%X", TaskNum);
-					Pixie_Print_MSG(ErrMSG,1);
-				}
-				*P500E->EvtInfo |= 0x8000; // Mark as bad event. 
-				LMP5->BadEvent++;
-			} /* end check checksums */
-			else {	// progress report for specific event
-				// sprintf(ErrMSG, "*DEBUG* (Pixie_List_Mode_Parser): checksum ok");
-				// Pixie_Print_MSG(ErrMSG,(LMP5->TotalEvents==0));
-			}
-
-			/* checking channel number, even if checksums are ok */
-			if((RunType & 0xFF0F) != 0x402) {	
-				if (ChannelNo > (NUMBER_OF_CHANNELS - 1)) { 
-					sprintf(ErrMSG, "*ERROR* (Pixie_List_Mode_Parser): wrong channel number: %hu, event %d",*P500E->ChanNo, LMP5->TotalEvents);
-					Pixie_Print_MSG(ErrMSG,PrintDebugMsg_QCerror);
-					*P500E->EvtInfo |= 0x8000; // Mark as bad event. 
-
-					// try to recover from hit pattern
-					hit = (*P500E->EvtPattern & 0x000F);
-					switch(hit)
-					{  
-						case 0x1:
-							ChannelNo = 0;
-							break;
-						case 0x2:
-							ChannelNo = 1;
-							break;
-						case 0x4:
-							ChannelNo = 2;
-							break;
-						case 0x8:
-							ChannelNo = 3;
-							break;
-						default: 
-							ChannelNo = 0;		// default to zero if both header and hit are bad 
-							break;
-					}
-				}
-				EventLengthRH = LMP5->RunHeader[8+ ChannelNo];
-			} /* end checking channel number */
-
-			/* trace length check */
-			// no matter if checksum is good or bad, 
-			// - check previous trace length by comparing to what was actually written. this is actually not important, not used below
-			// - check  following trace length by looking for next watermark 
-			//    except if we have an end-of-run record
-
-			/* check previous trace length against known value from processing */
-			if (*P500E->NumTraceBlksPrev !=MyNumTraceBlksPrev) {
-				sprintf(ErrMSG, "*ERROR* (Pixie_List_Mode_Parser): wrong previous trace size in blocks: %hu, event %d",*P500E->NumTraceBlksPrev, LMP5->TotalEvents);
-				Pixie_Print_MSG(ErrMSG,PrintDebugMsg_QCerror);
-				*P500E->EvtInfo |= 0x8000;								// Mark as bad event. 
-				*P500E->NumTraceBlksPrev  = MyNumTraceBlksPrev;			// try to recover from previous processing
-			} /* end check previous trace length */
-		
-			/* check following trace length by looking for next watermark */
-			WaterMark = *P500E->EvtPattern + *P500E->EvtInfo * 65536;	// borrow this variable temporarily for end of run mark check
-			if (WaterMark==EORMARK) {
-				// no need to check for tracelength
-				sprintf(ErrMSG, "*DEBUG* (Pixie_List_Mode_Parser): reached end of run");
-				Pixie_Print_MSG(ErrMSG,PrintDebugMsg_QCdetail);
-				*P500E->NumTraceBlks = 0;
-				ReadMoreFileData=0;
-			}	
-			else {
-				nextWMfound = FALSE;
-				// 1. try place of next watermark per channel header
-				// move file pointer 
-				offset16 = *P500E->NumTraceBlks * *P500E->BlockSize + WATERMARKINDEX16;	// offset from current position (end of channel header) to place of next watermark (in 16bit words)
-				Pixie_fseek (LMP5->ListModeFile , GoodHeaderPos+offset16*2, SEEK_SET); // move pointer in file 2 16 bit words ahead from previous read and try again. 
-				// read 
-				bytesRead = fread (Words, sizeof(U16), 2, LMP5->ListModeFile);
-				if ( bytesRead == 0 ) {
-					sprintf(ErrMSG, "*DEBUG* (Pixie_List_Mode_Parser): unexpected end of file");
-					Pixie_Print_MSG(ErrMSG,PrintDebugMsg_QCerror);
-					ReadMoreFileData=0;
-				} else {
-					// compare
-					WaterMark = (U32)Words[0] + (U32)Words[1]*65536;
-					//sprintf(ErrMSG, "*DEBUG* (Pixie_List_Mode_Parser): watermark try 1, %X at offset %d",WaterMark, offset16);
-					//Pixie_Print_MSG(ErrMSG,(LMP5->TotalEvents==0));
-					if (WaterMark == WATERMARK)
-						nextWMfound = TRUE;
-				}
-
-				// 2. try zero (some special code may suppress traces)
-				// move file pointer 
-				if (!nextWMfound) {
-					offset16 = WATERMARKINDEX16;	// offset from current position (end of channel header) to place of next watermark (in 16bit words)
-					Pixie_fseek (LMP5->ListModeFile , GoodHeaderPos+offset16*2, SEEK_SET); // move pointer in file 2 16 bit words ahead from previous read and try again. 			
-					// read 
-					bytesRead = fread (Words, sizeof(U16), 2, LMP5->ListModeFile);
-					if ( bytesRead == 0 ) {
-						sprintf(ErrMSG, "*DEBUG* (Pixie_List_Mode_Parser): unexpected end of file");
-						Pixie_Print_MSG(ErrMSG,PrintDebugMsg_QCerror);
-						ReadMoreFileData=0;
-					}	else {
-						// compare
-						WaterMark = (U32)Words[0] + (U32)Words[1]*65536;
-						if (WaterMark == WATERMARK)
-							nextWMfound = TRUE;
-					}
-				}
+	/* Loop over events. Error checking was done when building the index: */
+	/* - watermark: headers without watermark are not in the index */
+	/* - checksum, channel number, previous and following trace length: corrected values and bad event mark come from the index */
+	for (EventNum = 0; EventNum < Idx->NumEvents; EventNum++) {
 
-				// 3. try using file header value (assumes ChannelNo is correct. Make sure it's at least in range)
-				// move file pointer 
-				if (!nextWMfound) {
-					if( (ChannelNo < NUMBER_OF_CHANNELS) && (EventLengthRH>0) && (EventLengthRH<MAXFIFOBLOCKS+1) ) {
-						offset16 = (EventLengthRH -1) * *P500E->BlockSize + WATERMARKINDEX16;	 // offset from current position (end of channel header) to place of next watermark (in 16bit words)
-						//RunHeader 8-11 have event size in blocks (header+trace)
-						Pixie_fseek (LMP5->ListModeFile , GoodHeaderPos+offset16*2, SEEK_SET); // move pointer in file 2 16 bit words ahead from previous read and try again. 				
-						// read 
-						bytesRead = fread (Words, sizeof(U16), 2, LMP5->ListModeFile);
-						if ( bytesRead == 0 ) {
-							sprintf(ErrMSG, "*DEBUG* (Pixie_List_Mode_Parser): unexpected end of file");
-							Pixie_Print_MSG(ErrMSG,PrintDebugMsg_QCerror);
-							ReadMoreFileData=0;
-						} 	else {
-							// compare
-							WaterMark = (U32)Words[0] + (U32)Words[1]*65536;
-							if (WaterMark == WATERMARK)
-								nextWMfound = TRUE;
-						}
-					}
-				} // end try 3
-
-
-				// no point finding true value now. Just use file header value for processing below. 
-				// But later advance file pointer only by channel header (not trace), so next cycle starts looking for watermark
-				// update header info
-				if(!nextWMfound) {
-					*P500E->EvtInfo |= 0x8000; // Mark as bad event. 
-					LMP5->BadEvent++;
-					sprintf(ErrMSG, "*ERROR* (Pixie_List_Mode_Parser): wrong following trace size in blocks: %hu, event %d",*P500E->NumTraceBlks, LMP5->TotalEvents);
-					Pixie_Print_MSG(ErrMSG,PrintDebugMsg_QCerror);
-				}
-				*P500E->NumTraceBlks = (U16)(offset16  - (S64)WATERMARKINDEX16) / *P500E->BlockSize;	// update trace blocks to follow
-				*P500E->NumTraceBlks = MAX(*P500E->NumTraceBlks, 0);	// ensure it's in legal limits if some really crazy values have been read
-				*P500E->NumTraceBlks = MIN(*P500E->NumTraceBlks, *P500E->SumChanLen);
-				MyNumTraceBlksPrev = *P500E->NumTraceBlks;									// update "known" value of last event for next event
-
-				// move back file pointer
-				Pixie_fseek (LMP5->ListModeFile , GoodHeaderPos, SEEK_SET);
-			}
-			/* end check following trace length */
-
-	/*		// Some more checks. Can't harm, but maybe not necessary
-			if (!(*P500E->EvtInfo & 0x8000)) { // if not a bad event 
-				if (*P500E->NumTraceBlks > *P500E->SumChanLen) { // If trace length is bogus then finish processing 
-					sprintf(ErrMSG, "*ERROR* (Pixie_List_Mode_Parser): wrong trace size in blocks: %hu, event %d,   %d",*P500E->NumTraceBlks, LMP5->TotalEvents, LMP5->ChannelHeader[2]);
-					Pixie_Print_MSG(ErrMSG,PrintDebugMsg_QCerror);
-					fclose(LMP5->ListModeFile);
-					free(LMP5);
-					free(P500E); 
-					free(ShiftFromStart);
-					free(P4headers);
-					return (-3);
-				}
-				if (*P500E->NumTraceBlksPrev > *P500E->SumChanLen) { // If previous trace length is bogus then finish processing 
-					sprintf(ErrMSG, "*ERROR* (Pixie_List_Mode_Parser): wrong previous trace size in blocks: %hu, event %d",	*P500E->NumTraceBlksPrev, LMP5->TotalEvents);
-					Pixie_Print_MSG(ErrMSG,PrintDebugMsg_QCerror);
-					fclose(LMP5->ListModeFile);
-					free(LMP5);
-					free(P500E); 
-					free(ShiftFromStart);
-					free(P4headers);
-					return (-3);
-				}
-				if (ChannelNo > (NUMBER_OF_CHANNELS - 1)) { // If channel number is bogus then finish processing 
-					sprintf(ErrMSG, "*ERROR* (Pixie_List_Mode_Parser): wrong channel number: %hu, event %d",ChannelNo, LMP5->TotalEvents);
-					Pixie_Print_MSG(ErrMSG,PrintDebugMsg_QCerror);
-					fclose(LMP5->ListModeFile);
-					free(LMP5);
-					free(P500E); 
-					free(ShiftFromStart);
-					free(P4headers);
-					return (-3);
-				}   
-				// END OF OTHER ERROR CHECKING 
-			}		*/
+			LM_Index_Header(Idx, EventNum, LMP5->ChannelHeader);
+			ChannelNo = Idx->Entry[EventNum].ChanNo;
+			GoodHeaderPos = Idx->Entry[EventNum].Pos + 2*(S64)*P500E->ChanHeadLen;		// end position of the header
 
 			/* Read trace if it is run 0x400, 0x402, or 0x403*/
-			if ((RunType & 0xFF0F) == 0x400 || (RunType & 0xFF0F) == 0x402 || (RunType & 0xFF0F) == 0x403) {
-				if(*P500E->NumTraceBlks>0)
-					fread (LMP5->Trace, sizeof(U16), (U32)*P500E->BlockSize * (U32)*P500E->NumTraceBlks, LMP5->ListModeFile);
-				// if the watermark was not found (bad TL), move back file pointer to end of header so next cycles starts a search
-
-				if(!nextWMfound) Pixie_fseek (LMP5->ListModeFile , GoodHeaderPos, SEEK_SET);
-			}
+			if ((RunType & 0xFF0F) == 0x400 || (RunType & 0xFF0F) == 0x402 || (RunType & 0xFF0F) == 0x403)
+				LM_Index_Trace(Idx, EventNum, LMP5->Trace, MAX_TRACE_LENGTH);
 
 			/* Analysis logic here */
 			/*************************************************************************************************************/
@@ -944,7 +725,7 @@ S32 Pixie_List_Mode_Parser(S8 *filename, U32 *UserData, U16 TaskNum )
 							}
 
 							if(!(LMP5->OutputFile = fopen(LMP5->OutputFileName, mode))) {
-								fclose(LMP5->ListModeFile);
+								LM_Index_Close(Idx);
 								sprintf(ErrMSG, "*ERROR* (Pixie_List_Mode_Parser): can't open output file", LMP5->OutputFileName);
 								Pixie_Print_MSG(ErrMSG,1);
 								free(LMP5);
@@ -1143,7 +924,7 @@ S32 Pixie_List_Mode_Parser(S8 *filename, U32 *UserData, U16 TaskNum )
 			if (TaskNum == 0x7002) {
 				if ((RunType & 0xFF0F) != 0x402) {	// not supported in runtask 0x402
 					U32  TraceLen       = (U32)*P500E->NumTraceBlks * (U32)*P500E->BlockSize;
-					U32  TracePos       = (U32)(Pixie_ftell(LMP5->ListModeFile) + 1) / 2 - TraceLen;
+					U32  TracePos       = (U32)(LM_Index_Next(Idx, EventNum) + 1) / 2 - TraceLen;
 				//	U32		i; 
 
 				TraceNum = LMP5->Traces[*P500E->ModNum];
@@ -1257,7 +1038,7 @@ S32 Pixie_List_Mode_Parser(S8 *filename, U32 *UserData, U16 TaskNum )
 							sprintf(LMP5->OutputFileName,"%s_QC.b%02d", LMP5->OutputFileName, *P500E->ModNum); 
 							
 							if(!(LMP5->OutputFile = fopen(LMP5->OutputFileName, "wb"))) {
-								fclose(LMP5->ListModeFile);
+								LM_Index_Close(Idx);
 								sprintf(ErrMSG, "*ERROR* (Pixie_List_Mode_Parser): can't open output file", LMP5->OutputFileName);
 								Pixie_Print_MSG(ErrMSG,1);
 								free(LMP5);
@@ -1293,7 +1074,7 @@ S32 Pixie_List_Mode_Parser(S8 *filename, U32 *UserData, U16 TaskNum )
 							sprintf(LMP5->OutputFileName, "%s_m%hu.bin", LMP5->OutputFileName, *P500E->ModNum); 
 							
 							if(!(LMP5->OutputFile = fopen(LMP5->OutputFileName, "wb"))) {
-								fclose(LMP5->ListModeFile);
+								LM_Index_Close(Idx);
 								sprintf(ErrMSG, "*ERROR* (Pixie_List_Mode_Parser): can't open output file", LMP5->OutputFileName);
 								Pixie_Print_MSG(ErrMSG,1);
 								free(LMP5);
@@ -1386,7 +1167,7 @@ S32 Pixie_List_Mode_Parser(S8 *filename, U32 *UserData, U16 TaskNum )
 						*strstr(LMP5->OutputFileName, ".") = '\0';
 						sprintf(LMP5->OutputFileName,"%s_m%d.out", LMP5->OutputFileName, *P500E->ModNum); 
 						if(!(LMP5->OutputFile = fopen(LMP5->OutputFileName, "w"))) {
-							fclose(LMP5->ListModeFile);
+							LM_Index_Close(Idx);
 							sprintf(ErrMSG, "*ERROR* (Pixie_List_Mode_Parser): can't open output file", LMP5->OutputFileName);
 							Pixie_Print_MSG(ErrMSG,1);
 							free(LMP5);
@@ -1470,7 +1251,7 @@ S32 Pixie_List_Mode_Parser(S8 *filename, U32 *UserData, U16 TaskNum )
 					default:
 						sprintf(ErrMSG, "*ERROR* (Pixie_List_Mode_Parser): run type %d not supported for task 0x7011", RunType);
 						Pixie_Print_MSG(ErrMSG,1);
-						fclose(LMP5->ListModeFile);
+						LM_Index_Close(Idx);
 						free(LMP5);
 						free(P500E); 
 						free(ShiftFromStart);
@@ -1495,7 +1276,7 @@ S32 Pixie_List_Mode_Parser(S8 *filename, U32 *UserData, U16 TaskNum )
                             *strstr(LMP5->OutputFileName, ".") = '\0';
                             sprintf(LMP5->OutputFileName,"%s_PSA_m%d.dt3", LMP5->OutputFileName, *P500E->ModNum); 
                             if(!(LMP5->OutputFile = fopen(LMP5->OutputFileName, "w"))) {
-                                fclose(LMP5->ListModeFile);
+                                LM_Index_Close(Idx);
                                 sprintf(ErrMSG, "*ERROR* (Pixie_List_Mode_Parser): can't open output file", LMP5->OutputFileName);
                                 Pixie_Print_MSG(ErrMSG,1);
                                 free(LMP5);
@@ -1514,47 +1295,46 @@ S32 Pixie_List_Mode_Parser(S8 *filename, U32 *UserData, U16 TaskNum )
                         fprintf(LMP5->OutputFile, "Run Type:\t%hu\n",         *P500E->RunType);
                         fprintf(LMP5->OutputFile, "Run Start Time (s) :\t%f\n\n", RunStartTime);                    
                         fprintf(LMP5->OutputFile, "Event\tChannel\tTimeStamp\tEnergy\tRT\tApeak\tBsum\tQ0\tQ1\tPSAval\n");
+
+                        /* PSA values are computed for batches of traces (see psa_batch.c), then printed in event order */
+                        PSA = PSA_Batch_Create(PSA_BATCH_TRACES, PSA_BATCH_SAMPLES);
+                        PSAInfo = calloc(PSA_BATCH_TRACES, sizeof(PSAEventInfo));
+                        if (!PSA || !PSAInfo) {
+                            sprintf(ErrMSG, "*ERROR* (Pixie_List_Mode_Parser): not enough memory for PSA");
+                            Pixie_Print_MSG(ErrMSG,1);
+                            PSA_Batch_Free(PSA);
+                            free(PSAInfo);
+                            LM_Index_Close(Idx);
+                            fclose(LMP5->OutputFile);
+                            free(LMP5);
+                            free(P500E); 
+                            free(ShiftFromStart);
+                            free(P4headers);
+                            return(-2);
+                        }
                     } // if header
                     switch ((RunType & 0xFF0F)) {
-                        case 0x400:
-                            if (ComputePSA(LMP5->Trace, (U32)*P500E->NumTraceBlks * (U32)*P500E->BlockSize, UserData) != 0) {
-                                // Not quitting processing, just reporting bad PSA calculation.
-                                /*
-                                fclose(LMP5->ListModeFile);
-                                sprintf(ErrMSG, "*ERROR* (Pixie_List_Mode_Parser): Failed calculating PSA.");
-                                Pixie_Print_MSG(ErrMSG,1);
-                                free(LMP5);
-                                free(P500E); 
-                                free(ShiftFromStart);
-                                free(P4headers);
-                                return(-3);
-                                */
-                                sprintf(ErrMSG, "*WARNING* (Pixie_List_Mode_Parser): Failed calculating PSA for event %ld.", LMP5->Events[*P500E->ModNum]);
-                                Pixie_Print_MSG(ErrMSG, PrintDebugMsg_QCdetail);
-								UserData[11] = 0;
-								UserData[12] = 0;
-								UserData[13] = 0;
-								UserData[14] = 0;
-								UserData[15] = 0;
-								UserData[16] = 0;
+                        case 0x400: {
+                            U32 TraceLen = MIN((U32)*P500E->NumTraceBlks * (U32)*P500E->BlockSize, MAX_TRACE_LENGTH);
+                            if (PSA_Batch_Add(PSA, LMP5->Trace, TraceLen) < 0) {		// batch full
+                                PSA_Batch_Output(LMP5->OutputFile, PSA, PSAInfo, UserData);
+                                PSA_Batch_Add(PSA, LMP5->Trace, TraceLen);
                             }
-							
-                            fprintf(LMP5->OutputFile, "%u   %hu   %llu   %hu   %hu   %hu   %hu   %hu  %hu  %hu\n",
-                                    LMP5->Events[*P500E->ModNum], 
-                                    ChannelNo,
-                                    (unsigned long long)(65536.0 * 65536.0 * (double)*P500E->TrigTimeHI + 
-                                                                   65536.0 * (double)*P500E->TrigTimeMI + 
-                                                                             (double)*P500E->TrigTimeLO),
-                                    *P500E->Energy,
-                                    UserData[11], UserData[12], UserData[13], UserData[14], UserData[15], UserData[16]);
+                            PSAInfo[PSA->NumTraces-1].Event     = LMP5->Events[*P500E->ModNum];
+                            PSAInfo[PSA->NumTraces-1].ChanNo    = ChannelNo;
+                            PSAInfo[PSA->NumTraces-1].Energy    = *P500E->Energy;
+                            PSAInfo[PSA->NumTraces-1].TimeStamp = Idx->Entry[EventNum].TimeStamp;
                             break;
+                        }
 
                         case 0x402:
                             // fall through to default.
                         default:
                             sprintf(ErrMSG, "*ERROR* (Pixie_List_Mode_Parser): run type %d not supported for task 0x7030", RunType);
                             Pixie_Print_MSG(ErrMSG,1);
-                            fclose(LMP5->ListModeFile);
+                            PSA_Batch_Free(PSA);
+                            free(PSAInfo);
+                            LM_Index_Close(Idx);
                             free(LMP5);
                             free(P500E); 
                             free(ShiftFromStart);
@@ -1577,21 +1357,27 @@ S32 Pixie_List_Mode_Parser(S8 *filename, U32 *UserData, U16 TaskNum )
 		LMP5->TotalTraces++;				/* Count all traces */
 		LMP5->Events[*P500E->ModNum]++;		/* Count events in each module. Same as traces for Pixie-500 Express */
 		LMP5->TotalEvents++;				/* Count all events.  Same as traces for Pixie-500 Express */
-	}	// end of while loop over events
+	}	// end of loop over events
 
+	if (PSA) {		/* 0x7030: PSA of the remaining traces */
+		PSA_Batch_Output(LMP5->OutputFile, PSA, PSAInfo, UserData);
+		PSA_Batch_Free(PSA);
+		free(PSAInfo);
+	}
 
+	LMP5->BadEvent = Idx->BadEvents;
 	sprintf(ErrMSG, "*INFO* (Pixie_List_Mode_Parser): Processed %d events, %d are marked as bad.", LMP5->TotalEvents, LMP5->BadEvent);
 	Pixie_Print_MSG(ErrMSG,1);
 	/* Close files */
-	fclose(LMP5->ListModeFile);
+	LM_Index_Close(Idx);
 	if (LMP5->OutputFile) fclose(LMP5->OutputFile);
 	/* Free memory */
 	free(LMP5);
 	free(P500E); 
 	free(ShiftFromStart);
 	free(P4headers);
-	/* Done */
-	return (0);
+	/* Done. -3 if the file is badly damaged, after processing the events before the damage */
+	return (ReturnValue);
 }
 
 
@@ -1606,8 +1392,9 @@ S32 Pixie_List_Mode_Parser(S8 *filename, U32 *UserData, U16 TaskNum )
 *			 0 - success
 *			-1 - can't open list mode data file
 *			-2 - memory allocation error
-*			-3 - error checking failed
+*			-3 - no event found at or after the location
 *			-4 - invalid pointer to UserData
+*			-5 - invalid run type in file
 *
 *
 ****************************************************************/
@@ -1635,16 +1422,14 @@ S32 Pixie_Event_Browser(S8 *filename, U32 *UserData)
 	U32 j,k;
 	U32 EventFound[NUMBER_OF_CHANNELS] ={0};
 	S64 EvtPos = 0;
-	U32 PrevEvtSize = 0;
+	S64 TracePos = 0;
+	S32 n0, n;				// event numbers in the index: selected event, current event of the search
 	U32	CheckSumComputed = 0;
 	U32	CheckSumRecorded = 0;
-	U32 TraceSize  = 0;		// trace size per channel header, corrected by error checking
 	U32 TraceSizeR = 0;		// trace size to be read from file (safe value)
 	U32 TraceSizeB = 0;		// trace size in blocks (temp)
 	U32 CurrentPosition = 0;
 	U32 EvtsFromStart = 0;
-	S32 status = 0;
-	S64 PrevEvtPos = 0;
 	double TimeStamp = 0;
 	double Time = 0;
 	double TimeWindow;
@@ -1656,6 +1441,7 @@ S32 Pixie_Event_Browser(S8 *filename, U32 *UserData)
 	/* Pointers to data structures for the list mode reader */
 	LMR_t		LMP5 = NULL;
 	P500E_t		P500E = NULL;
+	LMI_t		Idx = NULL;
 
 	/* Make sure UserData is not NULL */
 	if(!UserData) {
@@ -1676,23 +1462,20 @@ S32 Pixie_Event_Browser(S8 *filename, U32 *UserData)
 		return(-2);
 	}
 
-	/* Open the list mode file if exists */
+	/* Map the list mode file and get its event index, built on first use like in Pixie_List_Mode_Parser. */
+	/* A damaged file (-3) is still browsed up to the damage */
 	LMP5->ListModeFileName = filename;
-	if(!(LMP5->ListModeFile = fopen(LMP5->ListModeFileName, "rb"))) {
+	ReturnValue = LM_Index_Open(filename, &Idx);
+	if(!Idx) {
 		free(LMP5);
 		free(P500E);
-		sprintf(ErrMSG, "*ERROR* (Pixie_Event_Browser): can't open list mode data file %s", filename);
-		Pixie_Print_MSG(ErrMSG,1);
-		return(-1);
+		return(ReturnValue);
 	}
-	/* Read the first buffer/run/channel header to glean initial information about the type of the list mode file */
-	fread (LMP5->FirstHeader, sizeof(U16), FIRST_HEAD_LENGTH, LMP5->ListModeFile);
-	/* Copy first header to the corresponding run header and first channel header */
-	memcpy (LMP5->RunHeader, &LMP5->FirstHeader[0], RUN_HEAD_LENGTH * sizeof(U16) );
-	memcpy (LMP5->ChannelHeader, &LMP5->FirstHeader[MAX_CHAN_HEAD_LENGTH], MAX_CHAN_HEAD_LENGTH * sizeof(U16));
-	rewind(LMP5->ListModeFile);
-
-	RunType = LMP5->FirstHeader[2];
+	/* Run header and first channel header give initial information about the type of the list mode file */
+	memcpy (LMP5->RunHeader, Idx->RunHeader, RUN_HEAD_LENGTH * sizeof(U16) );
+	LM_Index_Read(Idx, 2*RUN_HEAD_LENGTH, LMP5->ChannelHeader, MAX_CHAN_HEAD_LENGTH);
+
+	RunType = Idx->RunType;
 	/* Pixie-500 Express List Mode Format Mapping */
 	if((RunType & 0xFF0F)==0x402)
 		P500E_Format_Map_402 (LMP5, P500E);
@@ -1716,7 +1499,7 @@ S32 Pixie_Event_Browser(S8 *filename, U32 *UserData)
 	if(!(ChanHeader = calloc(*P500E->ChanHeadLen, sizeof(U16)))) {
 		sprintf(ErrMSG, "*ERROR* (Pixie_Event_Browser): not enough memory for ChanHeader");
 		Pixie_Print_MSG(ErrMSG,1);
-		fclose(LMP5->ListModeFile);
+		LM_Index_Close(Idx);
 		free(LMP5);
 		free(P500E);
 		return(-2);
@@ -1727,7 +1510,7 @@ S32 Pixie_Event_Browser(S8 *filename, U32 *UserData)
 	if(!(TimeHighWord = calloc(NUMBER_OF_CHANNELS, sizeof(U16)))) {
 		sprintf(ErrMSG, "*ERROR* (Pixie_Event_Browser): not enough memory for TimeHighWord");
 		Pixie_Print_MSG(ErrMSG,1);
-		fclose(LMP5->ListModeFile);
+		LM_Index_Close(Idx);
 		free(LMP5);
 		free(P500E);
 		free(ChanHeader);
@@ -1742,7 +1525,7 @@ S32 Pixie_Event_Browser(S8 *filename, U32 *UserData)
 		if(!Traces[k]) {
 			sprintf(ErrMSG, "*ERROR* (Pixie_Event_Browser): not enough memory for Traces: %u", *P500E->SumChanLen);
 			Pixie_Print_MSG(ErrMSG,1);
-			fclose(LMP5->ListModeFile);
+			LM_Index_Close(Idx);
 			free(LMP5);
 			free(P500E);
 			free(ChanHeader);
@@ -1751,15 +1534,16 @@ S32 Pixie_Event_Browser(S8 *filename, U32 *UserData)
 		}
 	}
 
-	/* now read event header */ 
-	Pixie_fseek(LMP5->ListModeFile, EvtPos, SEEK_SET);								// Position ListModeFile to the beginning of this event 
-	fread(ChanHeader, sizeof(U16), *P500E->ChanHeadLen, LMP5->ListModeFile);	// Read event information 
-
-	/*	Even though location handed down from UI is the location found after error checking in runtask 0x7007
-		error checking is still necessary to catch bad tracelengths etc 
-		Values of ChanHeader may change, so use these, not *P500E->XXX for the return values */
-	if(ErrorChecking (ChanHeader, 1, RunType, LMP5->ListModeFile, P500E)) {				// Error checking. search forward (right) if event not found (unlikely)
-		fclose(LMP5->ListModeFile);
+	/* now find the event in the index and read its header */ 
+	/*	The location handed down from UI is the location found after error checking in runtask 0x7007.
+		If there is no event there, take the next one to the right (unlikely).
+		The index has the header values as corrected by error checking (bad tracelengths etc), 
+		so use ChanHeader, not *P500E->XXX for the return values */
+	n0 = LM_Index_Find(Idx, EvtPos);
+	if(n0 < 0) {
+		sprintf(ErrMSG, "*ERROR* (Pixie_Event_Browser): no event at or after position %u", UserData[0]);
+		Pixie_Print_MSG(ErrMSG,1);
+		LM_Index_Close(Idx);
 		free(LMP5);
 		free(P500E);
 		free(ChanHeader);
@@ -1767,6 +1551,10 @@ S32 Pixie_Event_Browser(S8 *filename, U32 *UserData)
 		for (k = 0; k < NUMBER_OF_CHANNELS; k++) free(Traces[k]);
 		return(-3);
 	}
+	LM_Index_Header(Idx, n0, ChanHeader);
+	if((RunType & 0xFF0F) != 0x402)
+		ChanHeader[9] = Idx->Entry[n0].ChanNo;					// channel number, recovered from hit pattern if wrong
+	TracePos = Idx->Entry[n0].Pos + 2*(S64)*P500E->ChanHeadLen;	// beginning of the trace
 
 	/* Populate event information array from current event */
 	pattern = *P500E->BoardVersion & 0x0FF0;
@@ -1823,7 +1611,8 @@ S32 Pixie_Event_Browser(S8 *filename, U32 *UserData)
 			TraceSizeR = *P500E->BlockSize * TraceSizeB;							// trace size in words16 for reading and returning to User, 
 			TraceSizeR = MIN(TraceSizeR, EvtLength );								// never longer than event length
 			UserData[3+k] = TraceSizeR;	
-			fread(Traces[k], 2, TraceSizeR, LMP5->ListModeFile);
+			LM_Index_Read(Idx, TracePos, Traces[k], TraceSizeR);
+			TracePos += 2*(S64)TraceSizeR;
 		}
 	}
 	else {		// other run types are single event records, search for 4 closest
@@ -1849,14 +1638,14 @@ S32 Pixie_Event_Browser(S8 *filename, U32 *UserData)
 		/* Search to the left in the time window to extract up to 4 channel records in coincidence with the selected event */
 		Time = TimeStamp;
 		CurrentChanNum = EvtChanNum;
-		PrevEvtPos = (S32)EvtPos;
+		n = n0;
 		TimeJitter = 20.0;
 		if (TimeStamp >= TimeWindow / 2.0) 
 			LeftTimeBoundary = TimeStamp - TimeWindow / 2.0;
 		else                                                       
 			LeftTimeBoundary = 0.0;
 		AdvanceBeyondCounter = NUMBER_OF_CHANNELS;
-		while (AdvanceBeyondCounter && (PrevEvtPos > 0)) {
+		while (AdvanceBeyondCounter && (n >= 0)) {
 			/* Record the closest event in time to the left of the current event */
 			if (!EventFound[CurrentChanNum] && (fabs(Time - TimeStamp) <= TimeWindow / 2.0)) { /* Only one record per channel. No overwriting  */
 				EventFound[CurrentChanNum] = 1;										// can not use UserData[3+CurrentChanNum] because the TL may be zero
@@ -1870,7 +1659,7 @@ S32 Pixie_Event_Browser(S8 *filename, U32 *UserData)
 				UserData[7+BHL+EHL+CHL*CurrentChanNum+7] = ChanHeader[14]; /* Extended Uretval */
 				UserData[7+BHL+EHL+CHL*CurrentChanNum+8] = ChanHeader[15]; /* Extended Uretval */
 				TimeHighWord[CurrentChanNum] = ChanHeader[6]; /* Time High */
-				fread(Traces[CurrentChanNum], 2, TraceSizeR, LMP5->ListModeFile);
+				LM_Index_Read(Idx, Idx->Entry[n].Pos + 2*(S64)*P500E->ChanHeadLen, Traces[CurrentChanNum], TraceSizeR);
 			}
 			if (TimeWindow > 65535.0) {/* Larger than 64k coincidence window disables searching for the neighboring events */
 				/* Copy found traces into external data array UserData and release dynamic memory */
@@ -1883,7 +1672,7 @@ S32 Pixie_Event_Browser(S8 *filename, U32 *UserData)
 						CurrentPosition += UserData[3+k];
 					}
 				}
-				fclose(LMP5->ListModeFile);
+				LM_Index_Close(Idx);
 				free(LMP5);
 				free(P500E);
 				free(ChanHeader);
@@ -1893,21 +1682,10 @@ S32 Pixie_Event_Browser(S8 *filename, U32 *UserData)
 			}
 			
 			/* read another channel header to the left */
-			PrevEvtSize =(U32)(ChanHeader[3] + 1) * *P500E->BlockSize;
-			PrevEvtPos -= (S64)(2 * PrevEvtSize);
-			if (PrevEvtPos > 0) {
-				Pixie_fseek(LMP5->ListModeFile, PrevEvtPos, SEEK_SET);
-				fread(ChanHeader, sizeof(U16), *P500E->ChanHeadLen, LMP5->ListModeFile);
-				if(ErrorChecking (ChanHeader, 0, RunType, LMP5->ListModeFile, P500E)) {			// check prev. event, if not found (prev length rounded down), look to left
-					fclose(LMP5->ListModeFile);
-					free(LMP5);
-					free(P500E);
-					free(ChanHeader);
-					free(TimeHighWord);
-					for (k = 0; k < NUMBER_OF_CHANNELS; k++) free(Traces[k]);
-					return(-3);
-				}
-				CurrentChanNum = ChanHeader[9];
+			n--;
+			if (n >= 0) {
+				LM_Index_Header(Idx, n, ChanHeader);
+				CurrentChanNum = Idx->Entry[n].ChanNo;
 				TraceSizeB = ChanHeader[2];												// trace size in blocks from header
 				if(   (CurrentChanNum < NUMBER_OF_CHANNELS)									// if within legal limits, check against run header
 				   && (LMP5->RunHeader[8+ CurrentChanNum]>0) 
@@ -1925,30 +1703,10 @@ S32 Pixie_Event_Browser(S8 *filename, U32 *UserData)
 		}
 
 		/* Now search to the right in the time window to extract up to 4 channel records in coincidence with the selected event */
-		/* Position LMP5->ListModeFile to the beginning of the current event */
-		if(Pixie_fseek(LMP5->ListModeFile, EvtPos, SEEK_SET)) {
-			for (j = 0; j < NUMBER_OF_CHANNELS; j++) if (Traces[j]) free(Traces[j]);
-			fclose(LMP5->ListModeFile);
-			free(LMP5);
-			free(P500E);
-			free(ChanHeader);
-			free(TimeHighWord);
-			return (0); /* Return peacefully if it does not exist. unlikely */
-		}
-
-		/* Read the header of the current event. WH_TODO: why again?*/
-		fread(ChanHeader, 2, (size_t)*P500E->ChanHeadLen, LMP5->ListModeFile);
-		if(ErrorChecking (ChanHeader, 1, RunType, LMP5->ListModeFile, P500E)) {
-			fclose(LMP5->ListModeFile);
-			free(LMP5);
-			free(P500E);
-			free(ChanHeader);
-			free(TimeHighWord);
-			for (k = 0; k < NUMBER_OF_CHANNELS; k++) free(Traces[k]);
-			return(-3);
-		}
-		TraceSize  = (U32)ChanHeader[2] * *P500E->BlockSize;					// length in file
-		EvtChanNum = ChanHeader[9];
+		/* Read the header of the current event again, the search to the left has overwritten it */
+		n = n0;
+		LM_Index_Header(Idx, n, ChanHeader);
+		EvtChanNum = Idx->Entry[n].ChanNo;
 		TraceSizeB = ChanHeader[2];												// trace size in blocks from header, corrected by error checking
 		if(   (EvtChanNum < NUMBER_OF_CHANNELS)									// if within legal limits, check against run header
 		   && (LMP5->RunHeader[8+ EvtChanNum]>0) 
@@ -1963,8 +1721,7 @@ S32 Pixie_Event_Browser(S8 *filename, U32 *UserData)
 		RightTimeBoundary = TimeStamp + TimeWindow / 2.0;
 		CurrentChanNum = EvtChanNum;
 		AdvanceBeyondCounter = NUMBER_OF_CHANNELS;
-		status = (S32)*P500E->ChanHeadLen; 
-		while (AdvanceBeyondCounter && (status == (S32)*P500E->ChanHeadLen)) {
+		while (AdvanceBeyondCounter) {
 			/* Record the closest event in time to the right of the current event */
 			if (CurrentChanNum > (NUMBER_OF_CHANNELS-1)) break; /* If an error occurs, stop scanning to the right */
 			if (CurrentChanNum != EvtChanNum) {
@@ -1981,29 +1738,16 @@ S32 Pixie_Event_Browser(S8 *filename, U32 *UserData)
 						UserData[7+BHL+EHL+CHL*CurrentChanNum+7] = ChanHeader[15]; /* Extended Uretval */
 						UserData[7+BHL+EHL+CHL*CurrentChanNum+8] = ChanHeader[14]; /* Extended Uretval */
 						TimeHighWord[CurrentChanNum] = ChanHeader[6]; /* Time High */
-						fread(Traces[CurrentChanNum], 2, TraceSizeR, LMP5->ListModeFile);
-						if(TraceSizeR<TraceSize)
-							Pixie_fseek(LMP5->ListModeFile, 2*(S64)(TraceSize-TraceSizeR), SEEK_CUR);		// skip over "trace" that exceeds DSP setting
+						LM_Index_Read(Idx, Idx->Entry[n].Pos + 2*(S64)*P500E->ChanHeadLen, Traces[CurrentChanNum], TraceSizeR);
 				}
-				else Pixie_fseek(LMP5->ListModeFile, 2*(S64)TraceSize, SEEK_CUR);		// skip trace of channel we don't want
 			}
-			else Pixie_fseek(LMP5->ListModeFile, 2*(S64)TraceSize, SEEK_CUR);			// skip trace of this event's channel, which we already have
 
 			// get next event
-			status = fread(ChanHeader, 2, (size_t)*P500E->ChanHeadLen, LMP5->ListModeFile);
-			if(ErrorChecking (ChanHeader, 1, RunType, LMP5->ListModeFile, P500E)) {
-				fclose(LMP5->ListModeFile);
-				free(LMP5);
-				free(P500E);
-				free(ChanHeader);
-				free(TimeHighWord);
-				for (k = 0; k < NUMBER_OF_CHANNELS; k++) free(Traces[k]);
-				return(-3);
-			}
+			if (++n >= (S32)Idx->NumEvents) break;		// end of file
+			LM_Index_Header(Idx, n, ChanHeader);
 			Time =  (double)ChanHeader[4] + 65536.0 * (double)ChanHeader[5] + 4294967296.0 * (double)ChanHeader[6]; /* Time in ticks */
-			CurrentChanNum = ChanHeader[9];
+			CurrentChanNum = Idx->Entry[n].ChanNo;
 			PreviousTime = (double)UserData[7+BHL+EHL+CHL*CurrentChanNum+1] + 4294967296.0 * (double)TimeHighWord[CurrentChanNum]; /* Time High. Time in ticks */
-			TraceSize = (U32)ChanHeader[2] * *P500E->BlockSize;
 			TraceSizeB = ChanHeader[2];												// trace size in blocks from header
 			if(   (EvtChanNum < NUMBER_OF_CHANNELS)									// if within legal limits, check against run header
 			   && (LMP5->RunHeader[8+ CurrentChanNum]>0) 
@@ -2046,8 +1790,8 @@ S32 Pixie_Event_Browser(S8 *filename, U32 *UserData)
 		free(Traces[k]);
 		CurrentPosition += UserData[3+k];
 	}
-	/* Close data file */
-	fclose(LMP5->ListModeFile);
+	/* Release the mapped data file */
+	LM_Index_Close(Idx);
 	/* Free memory */
 	free(ChanHeader);
 	free(TimeHighWord);
@@ -3279,6 +3023,8 @@ S32 Pixie_User_List_Mode_Reader (S8  *filename,		// the list mode data file name
 /****************************************************************
  *	Pixie_Read_List_Mode_Events function:
  *		Read specfic event header, channel headers and trace from the list mode file.
+ *		The buffer header and the whole event (event length from task 0x7007)
+ *		are read in one block and parsed from memory.
  *
  *		Return Value:
  *			 0 - success
@@ -3286,32 +3032,50 @@ S32 Pixie_User_List_Mode_Reader (S8  *filename,		// the list mode data file name
  *
  ****************************************************************/
 
+static void Pixie_Read_List_Mode_Words (
+			LMB_t Block,		// list mode file
+			S64 *pos,			// position in bytes, advanced by numWords
+			U32 *dst,			// receives data
+			U32 numWords )		// number of words to read
+{
+	U16 *w;
+	U32 k, got;
+
+	w = LM_Block_Get(Block, *pos, numWords, &got);
+	for(k=0; k<got; k++)		// like fread, words beyond the end of the file are left unchanged
+		dst[k] = w[k];
+	*pos += 2*(S64)numWords;
+}
+
 S32 Pixie_Read_List_Mode_Events (
 			S8  *filename,		// the list mode data file name (with complete path)
 			U32 *ListModeTraces )	// receives list mode trace data
 {						// first three words contain location of event, location of buffer, and length of event
 	U16 idx, RunTask, traceindex;
 	U16 EvtPattern, ChanNData, chl;
-	U32 j,k;
-	FILE  *ListModeFile = NULL;
+	U32 j, got;
+	S64 pos, span;
+	LMB_t Block = NULL;
 	
 	/* Open the list mode file */
-	ListModeFile = fopen(filename, "rb");
+	LM_Block_Open(filename, 0, &Block);
 
 	ListModeTraces[3] = 0;	// initialize tracelengths -- word 3 is now also an input parameter
 	ListModeTraces[4] = 0;	// initialize tracelengths 
 	ListModeTraces[5] = 0;	// initialize tracelengths 
 	ListModeTraces[6] = 0;	// initialize tracelengths 
 	
-	if(ListModeFile != NULL) {
+	if(Block != NULL) {
 	    /* Read list mode traces from the file */
 	    if((ListModeTraces[0] != 0 ) && (ListModeTraces[2] != 0)) {
         	idx = 7;	// buffer header is written starting from loc. 7
-			/* Position ListModeFile to the beginning of this buffer */
-			Pixie_fseek(ListModeFile, ListModeTraces[1]*2, SEEK_SET);
-			/* Read buffer header */
-			for(j=0; j<BUFFER_HEAD_LENGTH; j++) 
-				fread(&ListModeTraces[idx++], 2, 1, ListModeFile);
+			/* Read buffer header and, if it follows in the same buffer, the whole event in one block */
+			pos  = (S64)ListModeTraces[1]*2;
+			span = (S64)ListModeTraces[0] - (S64)ListModeTraces[1] + (S64)ListModeTraces[2];
+			if(ListModeTraces[0] >= ListModeTraces[1] + BUFFER_HEAD_LENGTH && span <= LM_BLOCK_READ_AHEAD)
+				LM_Block_Get(Block, pos, (U32)span, &got);
+			Pixie_Read_List_Mode_Words(Block, &pos, &ListModeTraces[idx], BUFFER_HEAD_LENGTH);
+			idx += BUFFER_HEAD_LENGTH;
 			
 			/* Determine Run Task */				
 			RunTask = (U16)(ListModeTraces[9] & 0x0FFF);			
@@ -3336,11 +3100,12 @@ S32 Pixie_Read_List_Mode_Events (
 					break;
 			}
         	
-			/* Position ListModeFile to the requested event location */
-			Pixie_fseek(ListModeFile, ListModeTraces[0]*2, SEEK_SET);	
+			/* Position to the requested event location, the event is in the block already */
+			pos = (S64)ListModeTraces[0]*2;
+			LM_Block_Get(Block, pos, MIN(ListModeTraces[2], LM_BLOCK_READ_AHEAD), &got);
 			/* Read event header */
-			for(j=0; j<EVENT_HEAD_LENGTH; j++) 
-				fread(&ListModeTraces[idx++], 2, 1, ListModeFile);
+			Pixie_Read_List_Mode_Words(Block, &pos, &ListModeTraces[idx], EVENT_HEAD_LENGTH);
+			idx += EVENT_HEAD_LENGTH;
 
        		EvtPattern = (U16)ListModeTraces[13];
 
@@ -3352,15 +3117,15 @@ S32 Pixie_Read_List_Mode_Events (
 					/* idx = 7+BUFFER_HEAD_LENGTH+EVENT_HEAD_LENGTH+9*j; */
 					if( chl == 9 ) {
 						/* Read channel header */
-						for(k=0; k<chl; k++) 
-							fread(&ListModeTraces[idx++], 2, 1, ListModeFile);
+						Pixie_Read_List_Mode_Words(Block, &pos, &ListModeTraces[idx], chl);
+						idx += chl;
 
 						// if traces, read and store
         				ChanNData = (U16)ListModeTraces[idx-chl];
         				if ( ChanNData > chl) {
             				/* store traces */
-            				for(k=0; k<(U16)(ChanNData - chl); k++) 
-								fread(&ListModeTraces[traceindex++], 2, 1, ListModeFile);
+							Pixie_Read_List_Mode_Words(Block, &pos, &ListModeTraces[traceindex], MIN((U32)(ChanNData - chl), 0x10000 - (U32)traceindex));
+							traceindex += (U16)(ChanNData - chl);
             				/* store tracelength */
             				ListModeTraces[3+j] = ChanNData-chl;
 						}
@@ -3370,8 +3135,8 @@ S32 Pixie_Read_List_Mode_Events (
                 		ListModeTraces[idx++] = chl;  
     					
 						/* Read channel header */
-						for(k=0; k<chl; k++) 
-							fread(&ListModeTraces[idx++], 2, 1, ListModeFile);
+						Pixie_Read_List_Mode_Words(Block, &pos, &ListModeTraces[idx], chl);
+						idx += chl;
                 		/* store tracelength */
                 		ListModeTraces[3+j] = 0;	// report zero tracelength for channels without trace		
                 		idx += (9-1-chl);    
@@ -3381,12 +3146,12 @@ S32 Pixie_Read_List_Mode_Events (
 					idx += 9;	// skip the channel header if channel not present
 				}
 			}	// endfor (traces)
-			fclose(ListModeFile);
+			LM_Block_Close(Block);
 	    }
 		else {
 			sprintf(ErrMSG, "*ERROR* (Pixie_Read_List_Mode_Events): UserData contains no valid locastion information");
 			Pixie_Print_MSG(ErrMSG,1);
-			fclose(ListModeFile);
+			LM_Block_Close(Block);
 			return(-1);
 		}	    
 	}
@@ -227,6 +227,225 @@ typedef struct LMReaderDataStruct * LMR_t;
 
 typedef struct P500E_ListModeFormatStruct * P500E_t;
 
+/* Event index of a Pixie-4e/500e list mode file (lm_index.c).
+ * One entry per event, in file order, with the values corrected by QC.
+ * Entries are saved as is to the sidecar file <list mode file>.idx */
+#define LM_INDEX_BAD		0x0001		/* QC marked the event as bad (EvtInfo bit 15) */
+#define LM_INDEX_NEXTWM		0x0002		/* next event's watermark found after the trace */
+#define LM_INDEX_BADCS		0x0004		/* checksum mismatch */
+#define LM_INDEX_BADTL		0x0008		/* following trace length not confirmed by the next watermark */
+
+typedef struct {
+	S64    Pos;					/* byte position of the channel header in the list mode file */
+	U64    TimeStamp;			/* 48-bit trigger time */
+	U16    ChanNo;				/* channel number, recovered from hit pattern if bad */
+	U16    NumTraceBlks;		/* blocks of trace to follow, corrected by QC */
+	U16    NumTraceBlksPrev;	/* blocks of trace of the previous event, corrected by QC */
+	U16    Flags;				/* LM_INDEX_xxx */
+} LMIndexEntry;
+
+ struct LMIndexStruct {
+	U16    *Data;				/* list mode file, mapped */
+	S64    FileSize;			/* in bytes */
+	S64    FileTime;			/* modification time */
+	U16    RunHeader[RUN_HEAD_LENGTH];
+	U16    BlockSize;			/* RunHeader[0] */
+	U16    RunType;				/* RunHeader[2] */
+	U16    ChanHeadLen;			/* RunHeader[3] */
+	LMIndexEntry *Entry;		/* NumEvents entries */
+	U32    NumEvents;
+	U32    BadEvents;
+	S32    Status;				/* 0, or -3 if the file is damaged after the last entry */
+	void   *Sidecar;			/* mapped index file the entries come from, if any */
+	S64    SidecarSize;
+	void   *Stream;				/* walk state of a streamed file (LM_Index_Stream_Open), else NULL */
+	U32    First;				/* streamed: event number in the file of Entry[0] */
+};
+
+typedef struct LMIndexStruct * LMI_t;
+
+/* Columnar export of a Pixie-4e/500e list mode file (lm_columns.c, task 0x7040).
+ * LMColumnsHeader and NumColumns LMColumnDesc, then each column as an array
+ * of NumRows fixed width values in native byte order */
+#define LM_COLUMNS_MAGIC		"PXLMCOL1"
+#define LM_COLUMNS_BYTEORDER	0x01020304	/* as written by this host */
+#define LM_COLUMNS_ALIGN		4096		/* columns start at multiples of this offset */
+
+typedef struct {
+	U8     Magic[8];			/* LM_COLUMNS_MAGIC */
+	U32    ByteOrder;			/* LM_COLUMNS_BYTEORDER */
+	U32    HeaderSize;			/* bytes, header and column table */
+	U32    NumColumns;
+	U32    NumEvents;			/* events in the list mode file */
+	U64    NumRows;				/* values per column: NumEvents, 4*NumEvents for run type 0x402 */
+	U16    ModNum;
+	U16    RunType;
+	U16    BlockSize;
+	U16    ClockMHz;			/* time stamp clock */
+	U32    BadEvents;
+	U32    Reserved;
+} LMColumnsHeader;
+
+typedef struct {
+	S8     Name[16];			/* "timestamp", "energy", ... zero terminated */
+	S8     Type[8];				/* "u8", "u16", "u32" or "u64" */
+	U32    Width;				/* bytes per value */
+	U32    Reserved;
+	U64    Offset;				/* byte position of the column in the file */
+} LMColumnDesc;
+
+typedef struct LMColumnsOutStruct * LMC_t;
+
+/* Time ordered merge of the list mode files of several modules (lm_merge.c, task 0x7050) */
+typedef struct {
+	U64    TimeStamp;			/* 48-bit event time */
+	S64    Pos;					/* byte position of the channel header in its file */
+	U32    EventNum;			/* event number in its file */
+	U16    File;				/* file the event comes from, 0..NumFiles-1 */
+	U16    ModNum;				/* module number from the run header of the file */
+	U16    RunType;
+	U16    ChanNo;
+	U16    Flags;				/* LM_INDEX_xxx */
+	U16    Header[MAX_CHAN_HEAD_LENGTH];	/* channel header, corrected as by LM_Index_Header */
+} LMMergeEvent;
+
+typedef struct LMMergeStruct * LMM_t;
+
+/* Buffered block reader of a list mode file (lm_block.c).
+ * Holds a window of the file in memory, refilled by one read when a
+ * request falls outside it */
+#define LM_BLOCK_READ_AHEAD		65536		/* words read at least per refill, default */
+
+ struct LMBlockStruct {
+	FILE   *File;
+	S64    FileSize;			/* in bytes, when opened */
+	U16    *Buf;				/* window buffer */
+	U32    Size;				/* words allocated in Buf */
+	S64    Pos;					/* byte position of Buf[0] in the file */
+	U32    Valid;				/* words of the file in Buf */
+	U32    ReadAhead;			/* words read at least per refill */
+	U32    Reads;				/* number of refills */
+};
+
+typedef struct LMBlockStruct * LMB_t;
+
+S32 LM_Index_Open (
+	S8 *filename,				// list mode file name
+	LMI_t *pIdx);				// receives index
+
+void LM_Index_Close (
+	LMI_t Idx);					// list mode file index
+
+S32 LM_Index_Stream_Open (
+	S8 *filename,				// list mode file name
+	LMI_t *pIdx);				// receives index
+
+S32 LM_Index_Stream_Next (
+	LMI_t Idx,					// list mode file index, from LM_Index_Stream_Open
+	S64 readAhead);				// size of the window in bytes
+
+S32 LM_Index_Find (
+	LMI_t Idx,					// list mode file index
+	S64 pos);					// position in bytes
+
+U16 *LM_Index_Header (
+	LMI_t Idx,					// list mode file index
+	U32 n,						// event number
+	U16 *ChannelHeader);		// receives ChanHeadLen words
+
+U32 LM_Index_Read (
+	LMI_t Idx,					// list mode file index
+	S64 pos,					// position in bytes
+	U16 *dst,					// receives data
+	U32 numWords);				// number of words to read
+
+U32 LM_Index_Trace (
+	LMI_t Idx,					// list mode file index
+	U32 n,						// event number
+	U16 *Trace,					// receives trace
+	U32 maxWords);				// size of Trace
+
+S64 LM_Index_Next (
+	LMI_t Idx,					// list mode file index
+	U32 n);						// event number
+
+S32 LM_Columns_Create (
+	S8 *outname,				// output file name
+	LMColumnsHeader *Info,		// ModNum, RunType, BlockSize of the events
+	U64 NumRows,				// number of rows, 0 if not known in advance
+	LMC_t *pOut);				// receives output file
+
+S32 LM_Columns_Event (
+	LMC_t Out,					// output file
+	U32 EventNum,				// event number in its list mode file
+	U16 ModNum,					// module number
+	U16 ChanNo,					// channel number (single channel records)
+	U64 TimeStamp,				// event time (single channel records)
+	U16 *ChannelHeader);		// channel header, corrected
+
+S32 LM_Columns_Close (
+	LMC_t Out,					// output file
+	U32 NumEvents,				// events written, for the file header
+	U32 BadEvents,				// of which bad
+	U64 *NumRows);				// receives number of rows written
+
+S32 LM_Merge_Open (
+	S8 **filenames,				// list mode files, one per module
+	U16 NumFiles,				// number of files
+	S64 readAhead,				// bytes indexed ahead in each file
+	LMM_t *pMerge);				// receives merge state
+
+S32 LM_Merge_Next (
+	LMM_t Merge,				// merge state
+	LMMergeEvent *Event);		// receives the next event in time
+
+U32 LM_Merge_Trace (
+	LMM_t Merge,				// merge state
+	LMMergeEvent *Event,		// event from LM_Merge_Next
+	U16 *Trace,					// receives trace
+	U32 maxWords);				// size of Trace
+
+S32 LM_Merge_Status (
+	LMM_t Merge,				// merge state
+	U32 *NumEvents,				// receives events of all files so far
+	U32 *BadEvents);			// receives bad events of all files so far
+
+void LM_Merge_Close (
+	LMM_t Merge);				// merge state
+
+S32 LM_Block_Open (
+	S8 *filename,				// list mode file name
+	U32 readAhead,				// words read at least per refill, 0 for LM_BLOCK_READ_AHEAD
+	LMB_t *pBlock);				// receives reader
+
+void LM_Block_Close (
+	LMB_t B);					// reader
+
+U16 *LM_Block_Get (
+	LMB_t B,					// reader
+	S64 pos,					// position in bytes
+	U32 numWords,				// number of words wanted
+	U32 *got);					// receives number of words available
+
+U32 LM_Block_Read (
+	LMB_t B,					// reader
+	S64 pos,					// position in bytes
+	U16 *dst,					// receives data
+	U32 numWords);				// number of words to read
+
+U32 ErrorChecking (
+	U16 *ChannelHeader,			// channel header, corrected
+	U16 direction,				// 1 to search for a watermark towards the next event
+	U16 RunType,				// run type
+	LMB_t Block,				// list mode file
+	S64 *FilePos,				// position just after the channel header, receives beginning of trace
+	P500E_t P500E);				// list mode format
+
+void CheckSums (
+	U32 *Computed,				// checksum computed from the channel header
+	U32 *Recorded,				// checksum recorded in the channel header
+	U16 *ChannelHeader);
+
 
 #ifdef __cplusplus
 }
@@ -145,6 +145,10 @@ S32 Pixie_Close_PCI_Devices (
 S32 Pixie_Boot (
 			U16 Boot_Pattern );		// boot pattern is a bit mask
 
+void Boot_Report (
+			U8  ModNum,				// Pixie module number
+			U32 *report );			// receives BOOT_REPORT_LENGTH words
+
 
 S32 Pixie_Init_VarNames(void);
 
@@ -167,6 +171,10 @@ S32 Adjust_Offsets_DSP ( // Adjusting offsets with DSP code
 
 U16 TstBit(U16 bit, U16 value);
 
+S32 Pixie_Index_Names (
+		     S8 Names[][MAX_PAR_NAME_LENGTH],	// the array which contains the names
+		     U16 Names_Array_Len );				// the length of the array
+
 U16 Find_Xact_Match (S8 *str,							// the string to be searched
 		     S8 Names[][MAX_PAR_NAME_LENGTH],	// the array which contains the string
 		     U16 Names_Array_Len );				// the length of the array
@@ -241,6 +249,16 @@ PIXIE_EXPORT S32 Pixie_User_Par_IO (
 			U8  ChanNum );				// channel number of the Pixie module
 
 
+//_declspec(dllexport) S32 Pixie_User_Par_Begin (
+PIXIE_EXPORT S32 Pixie_User_Par_Begin (
+			U8  ModNum );				// number of the module to work on
+
+
+//_declspec(dllexport) S32 Pixie_User_Par_Commit (
+PIXIE_EXPORT S32 Pixie_User_Par_Commit (
+			U8  ModNum );				// number of the module to work on
+
+
 //_declspec(dllexport) S32 Pixie_Buffer_IO (
 PIXIE_EXPORT S32 Pixie_Buffer_IO (
 			U16 *Values,		// an array hold the data for I/O
@@ -308,7 +326,8 @@ S32 Read_Spectrum_File (
 
 
 S32 Write_List_Mode_File (
-			S8  *FileName );		// List mode data file name
+			S8  *FileName,			// List mode data file name
+			U8  Resume );			// if 1, resume the run in each module as soon as its data are read
 
 
 S32 Write_Spectrum_File (
@@ -377,6 +396,205 @@ S32 Create_List_Mode_File (
 S32 FindNewDMAData (
 		)	;
 
+S32 Setup_DMA_Ring (
+	U8  ModNum);				// Pixie module number
+
+S32 Release_DMA_Ring (
+	U8  ModNum);				// Pixie module number
+
+U32 *Advance_DMA_Ring (
+	U8  ModNum);				// Pixie module number
+
+S32 Free_DMA_Ring_Slot (
+	U8  ModNum,					// Pixie module number
+	U32 *pBuf);					// framebuffer returned by Advance_DMA_Ring
+
+S32 Setup_LM_Spans (
+	U8  ModNum);				// Pixie module number
+
+S32 Release_LM_Spans (
+	U8  ModNum);				// Pixie module number
+
+S32 Process_DMA_Buffer (
+	U8  ModNum,					// Pixie module number
+	U32 *pBuf,					// filled framebuffer
+	U16 RunType,				// run type switch for ASCII/binary fwrite
+	BOOL rearmed);				// TRUE if the sequencer already runs on the next ring slot
+
+S32 LM_Writer_Start (
+	U8  ModNum,					// Pixie module number
+	U16 RunType);				// run type, lower 12 bits
+
+S32 LM_Writer_Stop (
+	U8  ModNum);				// Pixie module number
+
+S32 LM_Writer_Active (
+	U8  ModNum);				// Pixie module number
+
+S32 LM_Writer_Push (
+	U8  ModNum,					// Pixie module number
+	U32 *pBuf);					// filled framebuffer, from Advance_DMA_Ring
+
+U32 *LM_Writer_Wait_Slot (
+	U8  ModNum);				// Pixie module number
+
+S32 LM_Writer_Drain (
+	U8  ModNum);				// Pixie module number
+
+void LM_Writer_Request_New_File (void);
+
+void LM_Writer_Stats (
+	U8  ModNum,					// Pixie module number
+	U32 *stats);				// receives LM_WRITER_STATS_LENGTH words
+
+S32 End_Run_Flush (
+	U8  MNstart,				// first module
+	U8  MNend,					// last module + 1
+	U16 RunType);				// run type, lower 12 bits
+
+void End_Run_Report (
+	U8  ModNum,					// Pixie module number
+	U32 *report);				// receives END_RUN_REPORT_LENGTH words
+
+S32 QC_Kernel_Select (
+	S32 Kernel);				// QC_KERNEL_AUTO, _SCALAR, _SSE2 or _AVX2
+
+U32 QC_Watermark_Score (
+	U32 Word);					// candidate watermark
+
+U32 QC_Find_Watermark (
+	U32 *pBuf,					// list mode buffer
+	U32 start,					// first position of a channel header to try
+	U32 end);					// last position + 1
+
+S32 QC_Header_Checksum (
+	U32 *pHeader);				// channel header
+
+void QC_Pack16 (
+	U32 *src,					// 32-bit words
+	U16 *dst,					// receives nWords 16-bit words
+	U32 nWords);				// number of words
+
+S32 Wait_Run_Done (
+	U8  ModNum,					// Pixie module number
+	U16 Task,					// control task started by Start_Run, for the statistics
+	U32 Max_ms);				// timeout in ms
+
+void Run_Wait_Stats (
+	U32 *stats);				// receives RUN_WAIT_TASKS*RUN_WAIT_STATS_LENGTH words
+
+void Par_Trans_Begin (
+	U8  MNstart,				// first module
+	U8  MNend);					// last module + 1
+
+S32 Par_Trans_Defer (
+	U8  ModNum,					// Pixie module number
+	U8  What);					// PAR_TRANS_PARAM_RAM or PAR_TRANS_FIPPI
+
+S32 Par_Trans_Flush (
+	U8  ModNum);				// Pixie module number
+
+S32 Par_Trans_Start_Run (
+	U8  ModNum,					// Pixie module number
+	U8  Type,					// run type (NEW_RUN or RESUME_RUN)
+	U16 Run_Task,				// run task
+	U16 Control_Task);			// control task
+
+S32 Par_Trans_Open (
+	U8  ModNum);				// Pixie module number
+
+S32 Par_Trans_Commit (
+	U8  MNstart,				// first module
+	U8  MNend);					// last module + 1
+
+S32 FPGA_Image_Current (
+	S8 *filnam,					// configuration file
+	U8 ConfigName);				// configuration type, as for Load_U16
+
+S32 FPGA_Image_Build (
+	S8 *filnam,					// configuration file
+	U8 ConfigName);				// configuration type, as for Load_U16
+
+const U32 *FPGA_Image_Words (
+	const U8 *raw,				// configuration buffer
+	U32 len);					// bytes to write
+
+void FPGA_Image_Reverse (
+	const U8 *src,				// configuration bytes
+	U32 *dst,					// receives (nBytes+3)/4 FIFO words
+	U32 nBytes);				// number of bytes
+
+S32 Tune_Modules (
+	U8  ModNum,					// Pixie module number, Number_Modules for all
+	U16 Task);					// ADJUST_OFFSETS_DSP, ADJUST_BLCUT or ADJUST_TAU
+
+void Pixie_Log_Put (
+	const S8 *message);			// message to be logged
+
+void Pixie_Log_Rec (
+	U32 enable,					// log it or not
+	const char *format,			// printf format with up to LOG_MAX_ARGS integer conversions
+	U32 nArgs,					// number of arguments
+	... );						// U32 or S32 arguments
+
+void Pixie_Log_Flush (void);
+
+void Pixie_Log_Stats (
+	U32 *stats);				// LOG_STATS_LENGTH words
+
+void Live_Stats_Start (
+	U8  ModNum,					// Pixie module number
+	U16 RunType);				// 0x400 - 0x403
+
+void Live_Stats_Buffer (
+	U8  ModNum,					// Pixie module number
+	U32 *qc,					// LIVE_QC_COUNTERS counters of this buffer
+	U32 *chanEvents,			// NUMBER_OF_CHANNELS events, or NULL
+	U64 start);					// Live_Stats_Time() when the buffer was taken up
+
+void Live_Stats_Bytes (
+	U8  ModNum,					// Pixie module number
+	U64 bytes);					// bytes written
+
+U64 Live_Stats_Time (void);
+
+void Live_Stats_Sample (
+	U8  ModNum,					// Pixie module number
+	U8  force);					// 1: sample now
+
+void Live_Stats_Stop (
+	U8  ModNum);				// Pixie module number
+
+S32 LM_Hist_Set_Gate (
+	U32 gate,					// gated histogram number
+	U32 *def);					// LM_HIST_GATE_WORDS words
+
+S32 LM_Hist_Start (
+	U8  ModNum);				// Pixie module number
+
+void LM_Hist_Event (
+	U8  ModNum,					// Pixie module number
+	U32 *event,					// channel header, 32-bit words
+	U16 RunType);				// 0x400 - 0x403
+
+void LM_Hist_Read (
+	U8  ModNum,					// Pixie module number
+	U32 *User_data);			// NUMBER_OF_CHANNELS*LM_HIST_BINS words
+
+void LM_Hist_Read_Gated (
+	U32 *User_data);			// LM_HIST_GATES*LM_HIST_BINS words
+
+void MCA_View_Reset (
+	U8  ModNum);				// Pixie module number
+
+S32 MCA_View_Read (
+	U8  ModNum,					// Pixie module number
+	U16 Chan,					// channel number, or MCA_VIEW_ALL
+	U32 FirstBin,				// first bin
+	U32 NumBins,				// number of bins per channel
+	U16 Mode,					// MCA_VIEW_COUNTS, _DELTA or _CHANGED
+	U32 *Data);					// receives counts or changes
+
 //****************************************************
 //				%%% Tools functions %%%
 //****************************************************
@@ -0,0 +1,312 @@
+/*----------------------------------------------------------------------
+* Copyright (c) 2004, 2009, 2015 XIA LLC
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms,
+* with or without modification, are permitted provided
+* that the following conditions are met:
+*
+*   * Redistributions of source code must retain the above
+*     copyright notice, this list of conditions and the
+*     following disclaimer.
+*   * Redistributions in binary form must reproduce the
+*     above copyright notice, this list of conditions and the
+*     following disclaimer in the documentation and/or other
+*     materials provided with the distribution.
+*   * Neither the name of XIA LLC
+*     nor the names of its contributors may be used to endorse
+*     or promote products derived from this software without
+*     specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+* CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+* INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+* ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+* TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+* THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+* SUCH DAMAGE.
+*----------------------------------------------------------------------*/
+
+/******************************************************************************
+*
+* File name:
+*
+*      tune_sched.c
+*
+* Description:
+*
+*      Crate-wide scheduling of the offset, BLcut and tau adjustments. Most
+*      of the time of these adjustments is spent waiting for control tasks
+*      of one module (find offsets, get traces, collect baselines). With
+*      TuneParallel set, Pixie-4e/500e modules are adjusted at the same time,
+*      one thread per module, so the waits of different modules overlap and
+*      the trace analysis of one module runs while others are acquiring.
+*      The random sample pairs used by Tau_Finder are drawn beforehand in
+*      module and channel order, so every channel gets the same result as
+*      if the modules were adjusted one after the other.
+*
+* Member functions:
+*					Tune_Modules()		- adjust offsets, BLcut or tau of one or all modules
+*
+******************************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "PlxTypes.h"
+#include "PciTypes.h"
+#include "Plx.h"
+
+#include "globals.h"
+#include "sharedfiles.h"
+#include "utilities.h"
+
+struct Tune_Worker {
+	U8  ModNum;
+	U16 Task;				// ADJUST_OFFSETS_DSP, ADJUST_BLCUT or ADJUST_TAU
+	U16 *RandomSet;			// NUMBER_OF_CHANNELS random sets for ADJUST_TAU, else NULL
+	pthread_t Thread;		// 0 if run without a thread
+	S32 Status;				// 0 or the first error
+	U32 Time;				// ms
+};
+
+static struct Tune_Worker TuneWorker[PRESET_MAX_MODULES];
+
+static U32 Tune_ms (void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return((U32)(ts.tv_sec*1000 + ts.tv_nsec/1000000));
+}
+
+
+/****************************************************************
+*	Tune_BLcut function:
+*		Find the BLcut of all channels of a module, then program
+*		the FiPPI. Channels are adjusted even if one fails.
+*
+*		Return Value:
+*			 0 - success
+*			<0 - first error of BLcut_Finder
+*
+****************************************************************/
+
+static S32 Tune_BLcut (
+					 U8 ModNum )		// Pixie module number
+{
+	double BLcut;
+	S32 retval, status = 0;
+	U8 k;
+
+	for(k = 0; k < NUMBER_OF_CHANNELS; k++) {
+		retval = BLcut_Finder(ModNum, k, &BLcut);
+		if((retval < 0) && (status == 0)) status = retval;
+	}
+	/* Program FiPPI */
+	Control_Task_Run(ModNum, PROGRAM_FIPPI, 1000);
+	sprintf(ErrMSG, "Module %d finished adjusting BLcut", ModNum);
+	Pixie_Print_MSG(ErrMSG,1);
+	return(status);
+}
+
+
+/****************************************************************
+*	Tune_Tau function:
+*		Find tau of all channels of a module, download it as 
+*		PREAMPTAUA/B, find the BLcut for the new tau, then program 
+*		the FiPPI. Channels are adjusted even if one fails.
+*
+*		Return Value:
+*			 0 - success
+*			<0 - first error of Tau_Finder_Set or BLcut_Finder
+*
+****************************************************************/
+
+static S32 Tune_Tau (
+				   U8 ModNum,			// Pixie module number
+				   U16 *RandomSet )		// NUMBER_OF_CHANNELS random sets of IO_BUFFER_LENGTH indices
+{
+	double tau, BLcut;
+	S32 retval, status = 0;
+	U32 value;
+	U16 idx;
+	U8 k;
+	S8 str[256];
+
+	for(k = 0; k < NUMBER_OF_CHANNELS; k++) {
+		/* The index offset for channel parameters */
+		idx=Find_Xact_Match("TAU", Channel_Parameter_Names, N_CHANNEL_PAR);
+		tau = Pixie_Devices[ModNum].Channel_Parameter_Values[k][idx]*1.0e-6; 
+		retval = Tau_Finder_Set(ModNum, k, &tau, &RandomSet[k*IO_BUFFER_LENGTH]);
+		if((retval < 0) && (status == 0)) status = retval;
+		tau /= 1.0e-6;
+		Pixie_Devices[ModNum].Channel_Parameter_Values[k][idx]=tau;
+		/* Update DSP parameters */
+		sprintf(str,"PREAMPTAUA%d",k);
+		idx=Find_Xact_Match(str, DSP_Parameter_Names, N_DSP_PAR);
+		Pixie_Devices[ModNum].DSP_Parameter_Values[idx]=(U16)floor(tau);
+		/* Download to the data memory */
+		value = (U32)Pixie_Devices[ModNum].DSP_Parameter_Values[idx];
+		Pixie_IODM(ModNum, (DATA_MEMORY_ADDRESS+idx), MOD_WRITE, 1, &value);
+		sprintf(str,"PREAMPTAUB%d",k);
+		idx=Find_Xact_Match(str, DSP_Parameter_Names, N_DSP_PAR);
+		Pixie_Devices[ModNum].DSP_Parameter_Values[idx]=(U16)((tau-floor(tau))*65536);
+		/* Download to the data memory */
+		value = (U32)Pixie_Devices[ModNum].DSP_Parameter_Values[idx];
+		Pixie_IODM(ModNum, (DATA_MEMORY_ADDRESS+idx), MOD_WRITE, 1, &value);			
+		retval = BLcut_Finder(ModNum, k, &BLcut);
+		if((retval < 0) && (status == 0)) status = retval;
+	}
+	/* Program FiPPI */
+	Control_Task_Run(ModNum, PROGRAM_FIPPI, 1000);
+	sprintf(ErrMSG, "Module %d finished adjusting tau", ModNum);
+	Pixie_Print_MSG(ErrMSG,1);
+	return(status);
+}
+
+
+static void *Tune_Module_Thread (void *arg)
+{
+	struct Tune_Worker *w = (struct Tune_Worker *)arg;
+	U32 t;
+
+	t = Tune_ms();
+	switch(w->Task)
+	{
+		case ADJUST_OFFSETS_DSP:
+			w->Status = Adjust_Offsets_DSP(w->ModNum);
+			break;
+		case ADJUST_BLCUT:
+			w->Status = Tune_BLcut(w->ModNum);
+			break;
+		case ADJUST_TAU:
+			w->Status = Tune_Tau(w->ModNum, w->RandomSet);
+			break;
+		default:
+			w->Status = -1;
+			break;
+	}
+	w->Time = Tune_ms() - t;
+	return(NULL);
+}
+
+
+/****************************************************************
+*	Tune_Modules function:
+*		Run the adjustment Task (ADJUST_OFFSETS_DSP, ADJUST_BLCUT
+*		or ADJUST_TAU) in module ModNum, or in all modules if
+*		ModNum equals Number_Modules.
+*		If TuneParallel is set, Pixie-4e/500e modules are adjusted 
+*		at the same time, one thread per module. Otherwise they are
+*		adjusted one after the other, and offset adjustment stops 
+*		at the first module that fails, as in Adjust_Offsets_DSP.
+*		BLcut and tau are adjusted in all modules and channels
+*		regardless of errors.
+*
+*		Return Value:
+*			 0 - success
+*			-1 - invalid task or out of memory
+*			<0 - error of the first module that failed
+*
+****************************************************************/
+
+S32 Tune_Modules (
+				  U8 ModNum,		// Pixie module number, Number_Modules for all
+				  U16 Task )		// ADJUST_OFFSETS_DSP, ADJUST_BLCUT or ADJUST_TAU
+{
+	U16 *RandomSets = NULL;
+	U8 MNstart, MNend, m, k;
+	U32 start;
+	S32 retval;
+
+	if((Task != ADJUST_OFFSETS_DSP) && (Task != ADJUST_BLCUT) && (Task != ADJUST_TAU)) {
+		sprintf(ErrMSG, "*ERROR* (Tune_Modules): invalid task %d", Task);
+		Pixie_Print_MSG(ErrMSG,1);
+		return(-1);
+	}
+
+	if(ModNum == Number_Modules)
+	{
+		MNstart = 0;
+		MNend = Number_Modules;
+	}
+	else
+	{
+		MNstart = ModNum;
+		MNend = ModNum+1;
+	}
+
+	if(Task == ADJUST_TAU) {
+		/* draw the random sets in the order the channels were adjusted one by one */
+		RandomSets = (U16 *)malloc((size_t)(MNend-MNstart)*NUMBER_OF_CHANNELS*IO_BUFFER_LENGTH*sizeof(U16));
+		if(RandomSets == NULL) {
+			sprintf(ErrMSG, "*ERROR* (Tune_Modules): out of memory for random sets of %d modules", MNend-MNstart);
+			Pixie_Print_MSG(ErrMSG,1);
+			return(-1);
+		}
+		for(m = MNstart; m < MNend; m++) {
+			for(k = 0; k < NUMBER_OF_CHANNELS; k++) {
+				RandomSwap();
+				memcpy(&RandomSets[((m-MNstart)*NUMBER_OF_CHANNELS+k)*IO_BUFFER_LENGTH], Random_Set, IO_BUFFER_LENGTH*sizeof(U16));
+			}
+		}
+	}
+
+	start = Tune_ms();
+	for(m = MNstart; m < MNend; m++) {
+		memset(&TuneWorker[m], 0, sizeof(struct Tune_Worker));
+		TuneWorker[m].ModNum = m;
+		TuneWorker[m].Task = Task;
+		if(RandomSets)
+			TuneWorker[m].RandomSet = &RandomSets[(m-MNstart)*NUMBER_OF_CHANNELS*IO_BUFFER_LENGTH];
+	}
+
+	if(TuneParallel && (PCIBusType == EXPRESS_PCI) && (MNend-MNstart > 1)) {
+		for(m = MNstart; m < MNend; m++) {
+			if(pthread_create(&TuneWorker[m].Thread, NULL, Tune_Module_Thread, &TuneWorker[m]) != 0) {
+				// no thread: adjust this one here, the others continue meanwhile
+				TuneWorker[m].Thread = 0;
+				Tune_Module_Thread(&TuneWorker[m]);
+			}
+		}
+		for(m = MNstart; m < MNend; m++) {
+			if(TuneWorker[m].Thread)
+				pthread_join(TuneWorker[m].Thread, NULL);
+		}
+	}
+	else {
+		for(m = MNstart; m < MNend; m++) {
+			Tune_Module_Thread(&TuneWorker[m]);
+			if((TuneWorker[m].Status < 0) && (Task == ADJUST_OFFSETS_DSP)) {
+				MNend = m+1;
+				break;
+			}
+		}
+	}
+
+	// per module timing, and the first error in module order
+	retval = 0;
+	for(m = MNstart; m < MNend; m++) {
+		sprintf(ErrMSG, "*INFO* (Tune_Modules): module %d: task 0x%X in %d ms, status %d", m, Task, TuneWorker[m].Time, TuneWorker[m].Status);
+		Pixie_Print_MSG(ErrMSG,PrintDebugMsg_other);
+		if((TuneWorker[m].Status < 0) && (retval == 0))
+			retval = TuneWorker[m].Status;
+	}
+	sprintf(ErrMSG, "*INFO* (Tune_Modules): task 0x%X done in %d modules in %d ms", Task, MNend-MNstart, Tune_ms() - start);
+	Pixie_Print_MSG(ErrMSG,PrintDebugMsg_other);
+
+	if(RandomSets)
+		free(RandomSets);
+	return(retval);
+}
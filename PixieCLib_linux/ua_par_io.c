@@ -319,6 +319,95 @@ S32 UA_SYSTEM_PAR_IO (	double *User_Par_Values,	// user parameters to be transfe
 	    if (WRITE) KeepCW  = (U8)    (System_Parameter_Values[idx] = (U16)User_Par_Values[idx]);
 	    if (READ) User_Par_Values[idx] = (double)(System_Parameter_Values[idx] = (U16)KeepCW);
 	}
+
+	if(strcmp(user_variable_name,"LM_RING_DEPTH") == 0 || ALLREAD)
+	{
+	    idx = Find_Xact_Match("LM_RING_DEPTH", System_Parameter_Names, N_SYSTEM_PAR);
+	    if (WRITE) {
+			LMRingDepth = (U16)User_Par_Values[idx];
+			if(LMRingDepth < 1) LMRingDepth = 1;
+			if(LMRingDepth > DMA_LM_RING_MAX) LMRingDepth = DMA_LM_RING_MAX;
+			System_Parameter_Values[idx] = LMRingDepth;		// takes effect at next run start
+		}
+	    if (READ) User_Par_Values[idx] = (double)(System_Parameter_Values[idx] = (U16)LMRingDepth);
+	}
+
+	if(strcmp(user_variable_name,"LM_WRITER_THREAD") == 0 || ALLREAD)
+	{
+	    idx = Find_Xact_Match("LM_WRITER_THREAD", System_Parameter_Names, N_SYSTEM_PAR);
+	    if (WRITE) LMWriterThread = (U16)(System_Parameter_Values[idx] = (U16)User_Par_Values[idx] ? 1 : 0);	// takes effect at next run start
+	    if (READ) User_Par_Values[idx] = (double)(System_Parameter_Values[idx] = (U16)LMWriterThread);
+	}
+
+	if(strcmp(user_variable_name,"LM_ZERO_COPY") == 0 || ALLREAD)
+	{
+	    idx = Find_Xact_Match("LM_ZERO_COPY", System_Parameter_Names, N_SYSTEM_PAR);
+	    if (WRITE) LMZeroCopy = (U16)(System_Parameter_Values[idx] = (U16)User_Par_Values[idx] ? 1 : 0);	// takes effect at next run start
+	    if (READ) User_Par_Values[idx] = (double)(System_Parameter_Values[idx] = (U16)LMZeroCopy);
+	}
+
+	if(strcmp(user_variable_name,"LM_PARSE_THREADS") == 0 || ALLREAD)
+	{
+	    idx = Find_Xact_Match("LM_PARSE_THREADS", System_Parameter_Names, N_SYSTEM_PAR);
+	    if (WRITE) LMParseThreads = (U16)(System_Parameter_Values[idx] = (U16)User_Par_Values[idx]);	// takes effect when a list mode file is indexed next
+	    if (READ) User_Par_Values[idx] = (double)(System_Parameter_Values[idx] = (U16)LMParseThreads);
+	}
+
+	if(strcmp(user_variable_name,"BOOT_PARALLEL") == 0 || ALLREAD)
+	{
+	    idx = Find_Xact_Match("BOOT_PARALLEL", System_Parameter_Names, N_SYSTEM_PAR);
+	    if (WRITE) BootParallel = (U16)(System_Parameter_Values[idx] = (U16)User_Par_Values[idx] ? 1 : 0);	// takes effect at next boot
+	    if (READ) User_Par_Values[idx] = (double)(System_Parameter_Values[idx] = (U16)BootParallel);
+	}
+
+	if(strcmp(user_variable_name,"TUNE_PARALLEL") == 0 || ALLREAD)
+	{
+	    idx = Find_Xact_Match("TUNE_PARALLEL", System_Parameter_Names, N_SYSTEM_PAR);
+	    if (WRITE) TuneParallel = (U16)(System_Parameter_Values[idx] = (U16)User_Par_Values[idx] ? 1 : 0);	// takes effect at next adjustment
+	    if (READ) User_Par_Values[idx] = (double)(System_Parameter_Values[idx] = (U16)TuneParallel);
+	}
+
+	if(strcmp(user_variable_name,"LIVE_STATS") == 0 || ALLREAD)
+	{
+	    idx = Find_Xact_Match("LIVE_STATS", System_Parameter_Names, N_SYSTEM_PAR);
+	    if (WRITE) LiveStats = (U16)(System_Parameter_Values[idx] = (U16)User_Par_Values[idx] ? 1 : 0);	// takes effect at next run start
+	    if (READ) User_Par_Values[idx] = (double)(System_Parameter_Values[idx] = (U16)LiveStats);
+	}
+
+	if(strcmp(user_variable_name,"LIVE_STATS_DSP_MS") == 0 || ALLREAD)
+	{
+	    idx = Find_Xact_Match("LIVE_STATS_DSP_MS", System_Parameter_Names, N_SYSTEM_PAR);
+	    if (WRITE) LiveStatsDSPms = (U16)(System_Parameter_Values[idx] = (U16)User_Par_Values[idx]);
+	    if (READ) User_Par_Values[idx] = (double)(System_Parameter_Values[idx] = (U16)LiveStatsDSPms);
+	}
+
+	if(strcmp(user_variable_name,"LM_HIST") == 0 || ALLREAD)
+	{
+	    idx = Find_Xact_Match("LM_HIST", System_Parameter_Names, N_SYSTEM_PAR);
+	    if (WRITE) LMHist = (U16)(System_Parameter_Values[idx] = (U16)User_Par_Values[idx] ? 1 : 0);	// takes effect at next run start
+	    if (READ) User_Par_Values[idx] = (double)(System_Parameter_Values[idx] = (U16)LMHist);
+	}
+
+	if(strcmp(user_variable_name,"EMU_RATE") == 0 || ALLREAD)
+	{
+	    idx = Find_Xact_Match("EMU_RATE", System_Parameter_Names, N_SYSTEM_PAR);
+	    if (WRITE) EmuRate = (U16)(System_Parameter_Values[idx] = (U16)User_Par_Values[idx]);
+	    if (READ) User_Par_Values[idx] = (double)(System_Parameter_Values[idx] = (U16)EmuRate);
+	}
+
+	if(strcmp(user_variable_name,"EMU_ERRORS") == 0 || ALLREAD)
+	{
+	    idx = Find_Xact_Match("EMU_ERRORS", System_Parameter_Names, N_SYSTEM_PAR);
+	    if (WRITE) EmuErrors = (U16)(System_Parameter_Values[idx] = (U16)User_Par_Values[idx]);
+	    if (READ) User_Par_Values[idx] = (double)(System_Parameter_Values[idx] = (U16)EmuErrors);
+	}
+
+	if(strcmp(user_variable_name,"SPILL_PARALLEL") == 0 || ALLREAD)
+	{
+	    idx = Find_Xact_Match("SPILL_PARALLEL", System_Parameter_Names, N_SYSTEM_PAR);
+	    if (WRITE) SpillParallel = (U16)(System_Parameter_Values[idx] = (U16)User_Par_Values[idx] ? 1 : 0);	// takes effect at next spill
+	    if (READ) User_Par_Values[idx] = (double)(System_Parameter_Values[idx] = (U16)SpillParallel);
+	}
 	
 	// Do not put new system variables beyond this line
 	
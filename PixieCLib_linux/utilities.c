@@ -50,7 +50,8 @@
 *
 * Member functions:
 *	1) Run control functions:
-*		Check_Run_Status, Control_Task_Run, End_Run, Get_Traces, Get_Slow_Traces
+*		Check_Run_Status, Control_Task_Run, Wait_Run_Done, Run_Wait_Stats, End_Run, 
+*		Get_Traces, Get_Slow_Traces
 *		Start_Run, Run_Enable_Set, Run_Enable_Clear, Read_Resume_Run
 *
 *	2) Pixie memory and file I/O functions:
@@ -62,11 +63,11 @@
 *	    BLcut_Finder, Make_SGA_Gain_Table, Pixie_CopyExtractSettings :		 	
 *
 *	4) Pixie automatic optimization functions:
-*		Phi_Value, Linear_Fit, RandomSwap, Tau_Finder,
+*		Phi_Value, Linear_Fit, RandomSwap, Tau_Finder, Tau_Finder_Set,
 *		Tau_Fit, Thresh_Finder, Adjust_Offsets, Adjust_Offsets_DSP 
 *
 *	5) Utility functions:
-*		ClrBit, Find_Xact_Match, RoundOff, FlushIgorMSG, Pixie_Print_MSG
+*		ClrBit, Pixie_Index_Names, Find_Xact_Match, RoundOff, FlushIgorMSG, Pixie_Print_MSG
 *		SetBit, TglBit, TstBit, Pixie_Sleep	
 *
 *   6) Functions that apply differences for different board types and variants
@@ -87,6 +88,10 @@
 #endif
 #ifdef XIA_LINUX
 #include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/uio.h>
 #endif
 
 #include <fcntl.h>
@@ -100,6 +105,7 @@
 #include "globals.h"
 #include "sharedfiles.h"
 #include "utilities.h"
+#include "live_stats.h"
 
 #include "Reg9054.h"
 #include "PexApi.h"
@@ -137,6 +143,9 @@ S32 Start_Run (
 	U8  k;
 	U32 dwStatus, CSR; 
 
+	/* Apply the changes of an open parameter transaction first */
+	if(Par_Trans_Open(ModNum)) return(Par_Trans_Start_Run(ModNum, Type, Run_Task, Control_Task));
+
 	buffer = malloc(MCA2D_MEMORY_LENGTH * sizeof(U32));		// temp array to clear MCA memory. choose the larger of 2D or Nch x MCA memory
 	if(!buffer){
 		sprintf(ErrMSG, "*ERROR* (Start_Run): Memory allocation failure");
@@ -169,6 +178,7 @@ S32 Start_Run (
 			{
 				// Standard MCA memory
 				Pixie_IOEM(k, HISTOGRAM_MEMORY_ADDRESS, MOD_WRITE, MAX_HISTOGRAM_LENGTH*NUMBER_OF_CHANNELS, buffer);
+				MCA_View_Reset(k);
 
 				// Extra 2D memory
 #ifdef WINDRIVER_API
@@ -238,6 +248,7 @@ S32 Start_Run (
 		if((Type == NEW_RUN) && (Run_Task != 0) && (Control_Task == 0))
 		{
 			Pixie_IOEM(ModNum, 0, MOD_WRITE, MAX_HISTOGRAM_LENGTH*NUMBER_OF_CHANNELS, buffer);
+			MCA_View_Reset(ModNum);
 
 			// Extra 2D memory
 #ifdef WINDRIVER_API
@@ -472,7 +483,7 @@ S32 Read_Resume_Run (
 	//if( (RunActive==0) | (DataReady ==1))
 	if(DataReady ==1)
 	{
-		retval=Write_List_Mode_File(FileName);
+		retval=Write_List_Mode_File(FileName, (U8)(RunActive==0));		// resumes each module stopped by the spill as soon as it is read
 		if(retval<0)
 		{
 			return(retval);
@@ -485,16 +496,8 @@ S32 Read_Resume_Run (
 
 	/* Resume run in all modules */
 	//if( ((Stop==2) | (Stop==0)) & (RunActive ==0))
-	if( (RunActive==0) & (DataReady!=0))		// resume if module was stopped and data was ready. (if no data ready, must be a host stop)
-	{
-		for(k = 0; k < Number_Modules; k++)
-		{
-			/* Read CSR */
-			Pixie_ReadCSR(k, &CSR);
-			CSR = (U32)SetBit(0, (U16)CSR);	/* Set bit 0 of CSR to enable run */
-			Pixie_WrtCSR(k, CSR);
-		}
-	}
+	// resume if module was stopped and data was ready. (if no data ready, must be a host stop)
+	// Done by Write_List_Mode_File above, module by module as soon as its data are read
 
 /***** Return info ************************************************************************/
 	if( (RunActive==0) & (DataReady==0))		// end MT polling if module was stopped and no data was ready. (must be a host stop)
@@ -557,7 +560,6 @@ S32 Control_Task_Run (
 					  U32 Max_Poll )		// Timeout control in unit of ms for control task run
 {
 	S32 retval;
-	U32 count;
 	
 	if (Offline == 1) {
 		sprintf(ErrMSG, "(Control_Task_Run): Offline mode. No I/O operations possible");
@@ -565,6 +567,9 @@ S32 Control_Task_Run (
 		return (0);
 	}
 
+	/* In a parameter transaction, the FiPPI is programmed once on commit */
+	if (ControlTask == PROGRAM_FIPPI && Par_Trans_Defer(ModNum, PAR_TRANS_FIPPI)) return (0);
+
 	/* Start control task run: NEW_RUN and RunTask = 0 */
 	retval = Start_Run(ModNum, NEW_RUN, 0, ControlTask);
 	if(retval < 0)
@@ -574,17 +579,8 @@ S32 Control_Task_Run (
 		return(-1);
 	}
 
-	/* A short wait before polling the run status */
-	Pixie_Sleep(1);
-
-	count=0;
-	while(Check_Run_Status(ModNum) && (count<Max_Poll))
-	{
-		count++; /* The maximal waiting time is set by Max_Poll */ 
-		Pixie_Sleep(1);
-	}
-
-	if(count>=Max_Poll)
+	/* The maximal waiting time is set by Max_Poll */ 
+	if(Wait_Run_Done(ModNum, ControlTask, Max_Poll) < 0)
 	{
 		sprintf(ErrMSG, "*ERROR* (Control_Task_Run): Control task %d in Module %d timed out", ControlTask, ModNum);
 		Pixie_Print_MSG(ErrMSG,1);
@@ -596,6 +592,139 @@ S32 Control_Task_Run (
 	}
 }
 
+
+/* Time to finish of each control task, see Wait_Run_Done */
+struct Run_Wait_Stat {
+	U32 Count;				// finished waits
+	U32 Timeouts;			// timed out waits
+	double Total;			// us, all finished waits
+	U32 Min, Max, Last;		// us
+	double Typical;			// us, running average to plan the next wait
+};
+
+static struct Run_Wait_Stat RunWaitStat[RUN_WAIT_TASKS];
+static pthread_mutex_t RunWaitLock = PTHREAD_MUTEX_INITIALIZER;
+
+static double Run_Wait_us (void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return(ts.tv_sec*1.0e6 + ts.tv_nsec/1.0e3);
+}
+
+
+/****************************************************************
+*	Wait_Run_Done function:
+*		Wait until the control task started in a module by 
+*		Start_Run has finished, i.e. the run active bit is cleared.
+*		Instead of sleeping at least 1 ms per poll, the status is 
+*		polled continuously around the time the task took before 
+*		(RUN_WAIT_SPIN_US on both sides), and once per ms otherwise. 
+*		Tasks that took long before are waited for by sleeping 
+*		until shortly before their expected end.
+*		The active bit is set by the DSP some time after the run
+*		is enabled, so inactive only means done if the task was
+*		seen active, or RUN_WAIT_ACK_US after the start (the fixed
+*		1 ms wait used before).
+*		The time to finish is kept for each task, see Run_Wait_Stats.
+*
+*		Return Value:
+*			 0 - task finished
+*			-2 - timed out
+*
+****************************************************************/
+
+S32 Wait_Run_Done (
+				   U8  ModNum,			// Pixie module number
+				   U16 Task,			// control task started by Start_Run, for the statistics
+				   U32 Max_ms )			// timeout in ms
+{
+	struct Run_Wait_Stat *s = &RunWaitStat[MIN(Task, RUN_WAIT_TASKS-1)];
+	double start, elapsed, typical, t;
+	S32 active, seen = 0;
+
+	start = Run_Wait_us();
+	pthread_mutex_lock(&RunWaitLock);
+	typical = s->Typical;
+	pthread_mutex_unlock(&RunWaitLock);
+
+	/* long task: sleep until shortly before its expected end */
+	if(typical > 2*RUN_WAIT_SPIN_US && typical - RUN_WAIT_SPIN_US < Max_ms*1000.0)
+		Pixie_Sleep((typical - RUN_WAIT_SPIN_US) / 1000.0);
+
+	for(;;)
+	{
+		active = Check_Run_Status(ModNum);
+		elapsed = Run_Wait_us() - start;
+		if(active == 1)
+			seen = 1;
+		else if(active == 0 && (seen || elapsed >= RUN_WAIT_ACK_US))
+			break;
+
+		if(elapsed >= Max_ms*1000.0)
+		{
+			pthread_mutex_lock(&RunWaitLock);
+			s->Timeouts++;
+			pthread_mutex_unlock(&RunWaitLock);
+			return(-2);
+		}
+
+		if(elapsed < typical + RUN_WAIT_SPIN_US)
+			for(t = Run_Wait_us(); Run_Wait_us() - t < RUN_WAIT_POLL_US; ) ;
+		else
+			Pixie_Sleep(1);
+	}
+
+	pthread_mutex_lock(&RunWaitLock);
+	s->Typical = s->Count ? 0.75*s->Typical + 0.25*elapsed : elapsed;
+	s->Min = s->Count ? MIN(s->Min, (U32)elapsed) : (U32)elapsed;
+	s->Max = MAX(s->Max, (U32)elapsed);
+	s->Last = (U32)elapsed;
+	s->Total += elapsed;
+	s->Count++;
+	pthread_mutex_unlock(&RunWaitLock);
+	return(0);
+}
+
+
+/****************************************************************
+*	Run_Wait_Stats function:
+*		Fill RUN_WAIT_STATS_LENGTH words per control task with 
+*		the times Wait_Run_Done waited for it since the library 
+*		was loaded:
+*			0: finished waits
+*			1: timed out waits
+*			2: average time to finish, us
+*			3: shortest time, us
+*			4: longest time, us
+*			5: last time, us
+*			6: expected time used to plan the next wait, us
+*		Control tasks from RUN_WAIT_TASKS-1 up share the last entry.
+*
+****************************************************************/
+
+void Run_Wait_Stats (
+					 U32 *stats )			// receives RUN_WAIT_TASKS*RUN_WAIT_STATS_LENGTH words
+{
+	struct Run_Wait_Stat *s;
+	U32 k;
+
+	pthread_mutex_lock(&RunWaitLock);
+	for(k = 0; k < RUN_WAIT_TASKS; k++)
+	{
+		s = &RunWaitStat[k];
+		stats[k*RUN_WAIT_STATS_LENGTH+0] = s->Count;
+		stats[k*RUN_WAIT_STATS_LENGTH+1] = s->Timeouts;
+		stats[k*RUN_WAIT_STATS_LENGTH+2] = s->Count ? (U32)(s->Total / s->Count) : 0;
+		stats[k*RUN_WAIT_STATS_LENGTH+3] = s->Min;
+		stats[k*RUN_WAIT_STATS_LENGTH+4] = s->Max;
+		stats[k*RUN_WAIT_STATS_LENGTH+5] = s->Last;
+		stats[k*RUN_WAIT_STATS_LENGTH+6] = (U32)s->Typical;
+	}
+	pthread_mutex_unlock(&RunWaitLock);
+}
+
 /******************************************************************
 * Set Bit 0 of  Pixie-4 CSR, or Set bit 0 of P4e/500e APP_HOST_CTL
 *******************************************************************/
@@ -679,6 +808,12 @@ S32 Pixie_Register_IO (
 	/* Returns immediately for offline analysis */
 	if(Offline == 1) return(0);
 
+	/* Emulated modules have no registers mapped at VAddr */
+	if(Offline == OFFLINE_EMULATOR) {
+		if(direction == MOD_READ) *value = 0;
+		return(0);
+	}
+
 	if (VAddr[ModNum] == 0) {            
 		sprintf(ErrMSG, "*ERROR* (Pixie_Register_IO) - module address not mapped. Module=%d", ModNum);
 		Pixie_Print_MSG(ErrMSG,1);
@@ -845,6 +980,9 @@ S32 Pixie_IODM (
 		return(-6);
 	}
 
+	/* Apply parameter writes staged by an open transaction before reading */
+	if (direction == MOD_READ) Par_Trans_Flush(ModNum);
+
 	switch (PCIBusType) {
 		case REGULAR_PCI:
 			/* Set initial address to talk to */
@@ -868,15 +1006,18 @@ S32 Pixie_IODM (
 				//  Write only to the DSP input parameters
 				if (address >= DATA_MEMORY_ADDRESS && address < DATA_MEMORY_ADDRESS+DSP_IO_BORDER) {
 				
-					// put the "bad value" index of the parameter to be read out into APP_HOST_CTL_DATA as a write request
-					dwData = 0xFFFFFFFF; 
-					dwStatus =  PIXIE500E_ReadWriteReg(hDev[ModNum], APP_HOST_CTL_DATA, WDC_WRITE, &dwData, FALSE);
-
 					// TODO: IODM should not change values in Pixie_Devices, but if it does not here, GetTraces DMA times out
 								
 					// Put the values to be changed into  DSP_Parameter_Values
 					for (k = 0; k < nWords; k++) 
 						Pixie_Devices[ModNum].DSP_Parameter_Values[address-DATA_MEMORY_ADDRESS+k] = (U16)buffer[k];
+
+					// In a parameter transaction, the parameter RAM is written once on commit
+					if (Par_Trans_Defer(ModNum, PAR_TRANS_PARAM_RAM)) return(0);
+
+					// put the "bad value" index of the parameter to be read out into APP_HOST_CTL_DATA as a write request
+					dwData = 0xFFFFFFFF; 
+					dwStatus =  PIXIE500E_ReadWriteReg(hDev[ModNum], APP_HOST_CTL_DATA, WDC_WRITE, &dwData, FALSE);
 					
 					// Fill the DSP parameter block RAM with the updated DSP_Parameter_Values
 
@@ -888,7 +1029,7 @@ S32 Pixie_IODM (
 #ifdef XIA_LINUX
 					// KS DEBUG
 					// NOTE: looks like VAddr mapping is not working right under Linux. Using just regular memory I/O
-					WDC_WriteAddr32(hDev[ModNum], AD_PCI_BAR0, FPGA_PARAM_RAM + 4*k, Pixie_Devices[ModNum].DSP_Parameter_Values[k]);
+					PIXIE500E_WriteAddr32(hDev[ModNum], AD_PCI_BAR0, FPGA_PARAM_RAM + 4*k, Pixie_Devices[ModNum].DSP_Parameter_Values[k]);
 #endif
 
 					// Set bit 5 of APP_HOST_CTL to enable Parameter IO 
@@ -966,7 +1107,7 @@ S32 Pixie_IODM (
 #ifdef XIA_LINUX
 						// KS DEBUG
 						// NOTE: looks like VAddr mapping is not working right under Linux. Using just regular memory I/O
-						WDC_ReadAddr32(hDev[ModNum], AD_PCI_BAR0, FPGA_PARAM_RAM + 4 * index, &dwData);
+						PIXIE500E_ReadAddr32(hDev[ModNum], AD_PCI_BAR0, FPGA_PARAM_RAM + 4 * index, &dwData);
 #endif
 						buffer[k] = dwData;
 					}
@@ -1222,7 +1363,7 @@ S32 Pixie_IOEM (
 				// thus using here loop with WDC_WriteAddr() and reading data back (returning -7 if descrepancy is found).
 				//error = WDC_WriteAddrBlock32(hDev[ModNum], AD_PCI_BAR2, PCIE_EMDATA+4*address, nWords*sizeof(U32), buffer, WDC_ADDR_RW_DEFAULT);
 				for (k=0; k<nWords; k++) {
-					error = WDC_WriteAddr32(hDev[ModNum], AD_PCI_BAR2, PCIE_EMDATA+4*(address+k), buffer[k]);
+					error = PIXIE500E_WriteAddr32(hDev[ModNum], AD_PCI_BAR2, PCIE_EMDATA+4*(address+k), buffer[k]);
 					wait_for_a_short_time(500);
 					//WDC_ReadAddr32(hDev[ModNum],AD_PCI_BAR2, PCIE_EMDATA+4*(address+k), &u32Data);
 					//WDC_ReadAddr32(hDev[ModNum],AD_PCI_BAR2, PCIE_EMDATA+4*(address+k), &u32Data);
@@ -1237,11 +1378,11 @@ S32 Pixie_IOEM (
 				// then read addresses 1 through N-1 via ReadAddrBlock() (into buffer[0] through buffer[N-2]),
 				// then read address N-1 to read buffer[N-1].
 
-				error = WDC_ReadAddr32(hDev[ModNum],AD_PCI_BAR2, PCIE_EMDATA+4*address, &u32Data);
+				error = PIXIE500E_ReadAddr32(hDev[ModNum],AD_PCI_BAR2, PCIE_EMDATA+4*address, &u32Data);
 
-				error = WDC_ReadAddrBlock32(hDev[ModNum], AD_PCI_BAR2, PCIE_EMDATA+4*(address+1), (nWords-1)*sizeof(U32), buffer, WDC_ADDR_RW_DEFAULT);
+				error = PIXIE500E_ReadAddrBlock(hDev[ModNum], AD_PCI_BAR2, PCIE_EMDATA+4*(address+1), (nWords-1)*sizeof(U32), buffer, WDC_MODE_32, WDC_ADDR_RW_DEFAULT);
 
-				error = WDC_ReadAddr32(hDev[ModNum],AD_PCI_BAR2, PCIE_EMDATA+4*(address+nWords-1), (buffer+nWords-1));
+				error = PIXIE500E_ReadAddr32(hDev[ModNum],AD_PCI_BAR2, PCIE_EMDATA+4*(address+nWords-1), (buffer+nWords-1));
 
 
 			} // if READ
@@ -1276,12 +1417,79 @@ S32 Pixie_IOEM (
 }
 
 
+/* Hash index of a parameter name table, see Pixie_Index_Names */
+#define NAME_INDEX_TABLES	4			// DSP, channel, module and system parameter names
+#define NAME_INDEX_SLOTS	1024		// power of 2, at least twice N_DSP_PAR
+
+typedef struct {
+	S8  (*Names)[MAX_PAR_NAME_LENGTH];	// indexed table, NULL if slot unused
+	U16 Len;							// number of names in the table
+	U16 Slot[NAME_INDEX_SLOTS];			// name index + 1, 0 if empty
+} NameIndexStruct;
+
+static NameIndexStruct Name_Index[NAME_INDEX_TABLES];
+
+static U32 Name_Hash (S8 *str)
+{
+	U32 h = 2166136261u;	// FNV-1a
+
+	while (*str) {
+		h ^= (U8)*str++;
+		h *= 16777619u;
+	}
+	return(h);
+}
+
+
+/****************************************************************
+*	Pixie_Index_Names function:
+*		Builds the hash index Find_Xact_Match uses to look up names
+*		in the array Names, instead of comparing str with every
+*		name. Must be called again whenever the names change.
+*		If several entries have the same name, the first one is
+*		indexed, as found by a linear search.
+*
+*		Return Value:
+*			 0 - success
+*			-1 - no free index, Find_Xact_Match searches Names linearly
+*
+****************************************************************/
+
+S32 Pixie_Index_Names (
+					 S8 Names[][MAX_PAR_NAME_LENGTH],	// the array which contains the names
+					 U16 Names_Array_Len )			// the length of the array
+{
+	NameIndexStruct *NI = NULL;
+	U32 h;
+	U16 k, t;
+
+	for (t = 0; t < NAME_INDEX_TABLES; t++) {
+		if (Name_Index[t].Names == Names) { NI = &Name_Index[t]; break; }
+		if (!NI && !Name_Index[t].Names) NI = &Name_Index[t];
+	}
+	if (!NI || Names_Array_Len > NAME_INDEX_SLOTS/2) return(-1);
+
+	/* not used by Find_Xact_Match while it is rebuilt */
+	NI->Names = NULL;
+	memset(NI->Slot, 0, sizeof(NI->Slot));
+	for (k = 0; k < Names_Array_Len; k++) {
+		for (h = Name_Hash(Names[k]) & (NAME_INDEX_SLOTS-1); NI->Slot[h]; h = (h+1) & (NAME_INDEX_SLOTS-1))
+			if (strcmp(Names[NI->Slot[h]-1], Names[k]) == 0) break;	// keep first of duplicate names
+		if (!NI->Slot[h]) NI->Slot[h] = k + 1;
+	}
+	NI->Len = Names_Array_Len;
+	NI->Names = Names;
+	return(0);
+}
+
+
 /****************************************************************
 *	Find_Xact_Match function:
 *		Looks for an exact match between str and a name in the
 *		array Names. It uses Names_Array_Len to know how many names
 *		there are. Note that all elements in Names have all-uppercase
-*		names.
+*		names. Names indexed by Pixie_Index_Names are found by hash, 
+*		others by comparing str with each name.
 *
 *		Return Value:
 *			index of str in Names if found
@@ -1293,9 +1501,21 @@ U16 Find_Xact_Match (S8 *str,				// the string to be searched
 					 S8 Names[][MAX_PAR_NAME_LENGTH],	// the array which contains the string
 					 U16 Names_Array_Len )			// the length of the array
 {
-	U16	k = 0;
-
-	while (strcmp(str, Names[k]) != 0 && k < Names_Array_Len) { k++; }
+	NameIndexStruct *NI;
+	U32	h;
+	U16	k = 0, t;
+
+	for (t = 0; t < NAME_INDEX_TABLES; t++) {
+		NI = &Name_Index[t];
+		if (NI->Names == Names && NI->Len == Names_Array_Len) {
+			for (h = Name_Hash(str) & (NAME_INDEX_SLOTS-1); NI->Slot[h]; h = (h+1) & (NAME_INDEX_SLOTS-1))
+				if (strcmp(str, Names[NI->Slot[h]-1]) == 0) return(NI->Slot[h]-1);
+			k = Names_Array_Len;
+			break;
+		}
+	}
+	if (t == NAME_INDEX_TABLES)
+		while (k < Names_Array_Len && strcmp(str, Names[k]) != 0) { k++; }
 
 	if (k == Names_Array_Len) 
 	{
@@ -1367,6 +1587,144 @@ S32 Write_Spectrum_File (
 }
 
 
+// readout of one module's spill in Write_List_Mode_File
+#define SPILL_DM		0		// single buffer mode, list mode data in DM
+#define SPILL_EM32		1		// 32x buffer mode, list mode data in EM
+#define SPILL_EMDBL		2		// double buffer mode, list mode data in EM
+
+struct Spill_Worker {
+	U8   ModNum;
+	U16  Mode;					// SPILL_xxx
+	U8   Resume;				// 1: enable the run again once the data are read
+	U16  EMwords_index;			// DSP variables EMWORDS, EMWORDS2
+	U16  EMwords2_index;
+	U32  *Buffer;				// LIST_MEMORY_LENGTH words
+	U16  *Packed;				// IO_BUFFER_LENGTH words, data of SPILL_DM packed to 16 bit
+	U32  WordCount;				// 16-bit words to write to the file
+	S32  Status;				// 0, or -2 invalid word count
+	pthread_t Thread;
+};
+
+static struct Spill_Worker SpillWorker[PRESET_MAX_MODULES];
+static U8  *SpillBuffer = NULL;			// Buffer and Packed of all modules
+static U16 SpillBufferModules = 0;		// number of modules SpillBuffer has room for
+
+
+/****************************************************************
+*	Spill_Read_Module function:
+*		Read the list mode data of one module for Write_List_Mode_File
+*		into its own buffer, then re-arm the module: clear the
+*		DBUF_1FULL bit in double buffer mode and, if requested, set
+*		the run enable bit in the CSR again. Run on a thread of its
+*		own for each module if SpillParallel is set.
+*
+****************************************************************/
+
+static void *Spill_Read_Module (void *arg)
+{
+	struct Spill_Worker *w = (struct Spill_Worker *)arg;
+	U8  ModNum = w->ModNum;
+	U16 j;
+	U32 WordCount, NumWordsToRead, CSR;
+	U32 WordCountPP[2];
+	U32 dsp_word[2];
+
+	w->WordCount = 0;
+	w->Status = 0;
+
+	switch(w->Mode) {
+
+		// ----------- single buffer mode, List mode data in DM ------------------------------
+		case SPILL_DM:
+			// Read Pixie's word count register => the number of 16-bit words to read 
+			Pixie_RdWrdCnt(ModNum, &WordCount);
+			if(WordCount > IO_BUFFER_LENGTH) {
+				Pixie_Log_Rec(1, "*ERROR* (Write_List_Mode_File):invalid word count %d", 1, WordCount);
+				w->Status = -2;
+				return(NULL);
+			}
+			// Read out the list mode data, keep the low 16 bits of each word
+			Pixie_IODM(ModNum, IO_BUFFER_ADDRESS, MOD_READ, (U16)WordCount, w->Buffer);
+			QC_Pack16(w->Buffer, w->Packed, WordCount);
+			w->WordCount = WordCount;
+			break;
+
+		// ----------- 32x buffer mode, List mode data in EM ------------------------------
+		case SPILL_EM32:
+			// A dummy read of Pixie's word count register 
+			Pixie_RdWrdCnt(ModNum, &WordCount);
+
+			// The number of 16-bit words to read is in EMwords 
+			Pixie_IODM(ModNum, (U16)DATA_MEMORY_ADDRESS + w->EMwords_index, MOD_READ, 2, dsp_word);
+			WordCount = dsp_word[0] * 65536 + dsp_word[1];
+			NumWordsToRead = (WordCount + 1) / 2;	// odd number: round up
+			if( (NumWordsToRead > LIST_MEMORY_LENGTH) || (NumWordsToRead ==0) ) {
+				Pixie_Log_Rec(1, "*ERROR* (Write_List_Mode_File):invalid word count %d", 1, NumWordsToRead);
+				w->Status = -2;
+				return(NULL);
+			}
+			// Read out the list mode data 
+			Pixie_IOEM(ModNum, LIST_MEMORY_ADDRESS, MOD_READ, NumWordsToRead, w->Buffer);
+			w->WordCount = WordCount;
+			break;
+
+		// ----------- double buffer mode, List mode data in EM ------------------------------
+		default:
+			// read the CSR
+			Pixie_ReadCSR(ModNum, &CSR);
+
+			// A read of Pixie's word count register 
+			// This also indicates to the DSP that a readout has begun 
+			Pixie_RdWrdCnt(ModNum, &WordCount);
+
+			// The number of 16-bit words to read is in EMwords or EMwords2
+			Pixie_IODM(ModNum, (U16)DATA_MEMORY_ADDRESS + w->EMwords_index, MOD_READ, 2, dsp_word);
+			WordCountPP[0] = dsp_word[0] * 65536 + dsp_word[1];
+			Pixie_IODM(ModNum, (U16)DATA_MEMORY_ADDRESS + w->EMwords2_index, MOD_READ, 2, dsp_word);
+			WordCountPP[1] = dsp_word[0] * 65536 + dsp_word[1];
+
+			if(TstBit(CSR_128K_FIRST, (U16)CSR) == 1) 
+				j=0;			
+			else		// block at 128K+64K was first
+				j=1;
+	
+			if  (TstBit(CSR_DATAREADY, (U16)CSR) == 0 )		
+			// function called after a readout that cleared WCR => run stopped => read other block
+			{
+				j=1-j;			
+				Pixie_Log_Rec(1, "*INFO* (Write_List_Mode_File): Module %d: Both memory blocks full (block %d older). Run paused (or finished).", 2, ModNum, 1-j);
+			}
+
+			if (WordCountPP[j] >0)
+			{
+				NumWordsToRead = (WordCountPP[j] + 1) / 2;	// odd number: round up
+				if(NumWordsToRead > LIST_MEMORY_LENGTH)
+				{
+					Pixie_Log_Rec(1, "*ERROR* (Write_List_Mode_File):invalid word count %d", 1, NumWordsToRead);
+					w->Status = -2;
+					return(NULL);
+				}
+				// Read out the list mode data 
+				Pixie_IOEM(ModNum, LIST_MEMORY_ADDRESS+(j ? LM_DBLBUF_BLOCK_LENGTH : 0), MOD_READ, NumWordsToRead, w->Buffer);
+				w->WordCount = WordCountPP[j];
+			}
+
+			// A second read of Pixie's word count register to clear the DBUF_1FULL bit
+			// indicating to the DSP that the read is complete
+			Pixie_RdWrdCnt(ModNum, &WordCount);
+			break;
+	}
+
+	// data captured: resume the run in this module without waiting for the others
+	if(w->Resume) {
+		Pixie_ReadCSR(ModNum, &CSR);
+		CSR = (U32)SetBit(0, (U16)CSR);	/* Set bit 0 of CSR to enable run */
+		Pixie_WrtCSR(ModNum, CSR);
+	}
+	return(NULL);
+}
+
+
 /****************************************************************
 *	Write_List_Mode_File function:
 *		Read list mode data from each Pixie module then append the data to
@@ -1376,6 +1734,11 @@ S32 Write_Spectrum_File (
 *		The assumption is that all modules are in the same mode, i.e. 32x buffer, ping
 *      pong or single buffer mode, and that they take data synchronously, i.e they
 *      have the same number of buffers.
+*		With SpillParallel set, all modules are read at the same time, one
+*		thread per module, and each module is re-armed as soon as its own data
+*		are read; the file is written in module order once all are done.
+*		A module with an invalid word count is skipped, the data of all
+*		other modules read are still written, and the error is returned.
 *
 *		Return Value:
 *			 0 - success
@@ -1385,32 +1748,28 @@ S32 Write_Spectrum_File (
 ****************************************************************/
 
 S32 Write_List_Mode_File (
-						  S8  *FileName )		// List mode data file name
+						  S8  *FileName,		// List mode data file name
+						  U8  Resume )			// if 1, resume the run in each module as soon as its data are read
 {
-	U16 i, j, MCSRA, MCSRA_index, EMwords_index;
-	U16 EMwords2_index, DblBufCSR_index, DblBufCSR;
-	U32 Aoffset[2], WordCountPP[2];
-	U32 WordCount, NumWordsToRead, CSR;
+	U16 i, MCSRA, MCSRA_index, EMwords_index;
+	U16 EMwords2_index, DblBufCSR_index, DblBufCSR, Mode;
 	U32 dsp_word[2];
-	U32 WCRs[PRESET_MAX_MODULES], CSRs[PRESET_MAX_MODULES];
 	FILE *ListModeFile = NULL;
-	U32 *buffer=NULL;
-	U16 *shortbuffer=NULL;
+	S32 retval = 0;
+	U16 dropped = 0;
 
 	//sprintf(ErrMSG, "*INFO* (Write_List_Mode_File): file %s",FileName);
 	//Pixie_Print_MSG(ErrMSG,PrintDebugMsg_other);
 
-	buffer = malloc(LIST_MEMORY_LENGTH * sizeof(U32));
-	if(!buffer){
-		sprintf(ErrMSG, "*ERROR* (Write_List_Mode_File): Memory allocation failure");
-		Pixie_Print_MSG(ErrMSG,1);
-		return(-1);
+	/* One buffer per module, kept from spill to spill */
+	if(SpillBufferModules < Number_Modules) {
+		free(SpillBuffer);
+		SpillBuffer = (U8 *)malloc((size_t)Number_Modules * (LIST_MEMORY_LENGTH * sizeof(U32) + IO_BUFFER_LENGTH * sizeof(U16)));
+		SpillBufferModules = SpillBuffer ? Number_Modules : 0;
 	}
-	shortbuffer = malloc(IO_BUFFER_LENGTH * sizeof(U16));
-	if(!shortbuffer){
+	if(!SpillBuffer){
 		sprintf(ErrMSG, "*ERROR* (Write_List_Mode_File): Memory allocation failure");
 		Pixie_Print_MSG(ErrMSG,1);
-		free(buffer);
 		return(-1);
 	}
 
@@ -1419,11 +1778,11 @@ S32 Write_List_Mode_File (
 		if(ListModeFile == NULL) {
 			sprintf(ErrMSG, "*ERROR* (Write_List_Mode_File): can't open list mode file %s", FileName);
 			Pixie_Print_MSG(ErrMSG,1);
-			free(buffer);
-			free(shortbuffer);
 			return(-1);
 		}
 	}
+	else
+		ListModeFile = listFile[0];
 
 	// Locate DSP variables MODCSRA and EMWORDS 
 	MCSRA_index = Find_Xact_Match("MODCSRA", DSP_Parameter_Names, N_DSP_PAR);
@@ -1436,240 +1795,110 @@ S32 Write_List_Mode_File (
 	Pixie_IODM(0, (U16)DATA_MEMORY_ADDRESS + DblBufCSR_index, MOD_READ, 1, dsp_word);
 	DblBufCSR = (U16)dsp_word[0];
 
-	// ----------- single buffer mode, List mode data in DM ------------------------------
-
 	if( (TstBit(MODCSRA_EMWORDS, MCSRA) == 0) & (TstBit(DBLBUFCSR_ENABLE, DblBufCSR) == 0) )	
-	{
-		// Read out list mode data module by module 
-		for(i=0; i<Number_Modules; i++)
-		{
-
-			// Read Pixie's word count register => the number of 16-bit words to read 
-			Pixie_RdWrdCnt((U8)i, &WordCount);
-
-			if(WordCount > IO_BUFFER_LENGTH)
-			{
-				sprintf(ErrMSG, "*ERROR* (Write_List_Mode_File):invalid word count %d", WordCount);
-				Pixie_Print_MSG(ErrMSG,1);
-				if(!MultiThreadDAQ) fclose(ListModeFile);
-				if( MultiThreadDAQ) fclose(listFile[0]);
-				free(buffer);
-				free(shortbuffer);
-				return(-2);
-			}
-
-			// Read out the list mode data 
-			Pixie_IODM((U8)i, IO_BUFFER_ADDRESS, MOD_READ, (U16)WordCount, buffer);
+		Mode = SPILL_DM;
+	else if( (TstBit(MODCSRA_EMWORDS, MCSRA) == 1) & (TstBit(DBLBUFCSR_ENABLE, DblBufCSR) == 0) )	
+		Mode = SPILL_EM32;
+	else
+		Mode = SPILL_EMDBL;
+
+	for(i=0; i<Number_Modules; i++) {
+		memset(&SpillWorker[i], 0, sizeof(struct Spill_Worker));
+		SpillWorker[i].ModNum = (U8)i;
+		SpillWorker[i].Mode = Mode;
+		SpillWorker[i].Resume = Resume;
+		SpillWorker[i].EMwords_index = EMwords_index;
+		SpillWorker[i].EMwords2_index = EMwords2_index;
+		SpillWorker[i].Buffer = (U32 *)((U8 *)SpillBuffer + (size_t)i * (LIST_MEMORY_LENGTH * sizeof(U32) + IO_BUFFER_LENGTH * sizeof(U16)));
+		SpillWorker[i].Packed = (U16 *)(SpillWorker[i].Buffer + LIST_MEMORY_LENGTH);
+	}
 
-			for(j=0; j<WordCount; j++)
-			{
-				shortbuffer[j] = (U16)buffer[j];
+	// Read out list mode data, all modules at once or module by module
+	if(SpillParallel && (Number_Modules > 1)) {
+		for(i=0; i<Number_Modules; i++) {
+			if(pthread_create(&SpillWorker[i].Thread, NULL, Spill_Read_Module, &SpillWorker[i]) != 0) {
+				// no thread: read this one here, the others continue meanwhile
+				SpillWorker[i].Thread = 0;
+				Spill_Read_Module(&SpillWorker[i]);
 			}
-
-			// Append to the file 
-			
-			if(!MultiThreadDAQ) fwrite(shortbuffer, 2, WordCount, ListModeFile);
-			if( MultiThreadDAQ) fwrite(shortbuffer, 2, WordCount, listFile[0]);
 		}
-
-		if(!MultiThreadDAQ) fclose(ListModeFile);		// only normal mode closes file every time
-		free(buffer);
-		free(shortbuffer);
-		return(0);
-
+		for(i=0; i<Number_Modules; i++) {
+			if(SpillWorker[i].Thread)
+				pthread_join(SpillWorker[i].Thread, NULL);
+		}
+	}
+	else {
+		for(i=0; i<Number_Modules; i++) {
+			Spill_Read_Module(&SpillWorker[i]);
+			if(SpillWorker[i].Status < 0)
+				break;		// later modules are not read or re-armed, they keep their data
+		}
 	}
 
-	// ----------- 32x buffer mode, List mode data in EM ------------------------------
+	// Append to the file in module order, skip modules that failed; the others
+	// have been re-armed already, their data would be lost otherwise
+	for(i=0; i<Number_Modules; i++) {
+		if(SpillWorker[i].Status < 0) {
+			retval = SpillWorker[i].Status;
+			dropped++;
+			continue;
+		}
+		if(Mode == SPILL_DM)
+			fwrite(SpillWorker[i].Packed, 2, SpillWorker[i].WordCount, ListModeFile);
+		else
+			fwrite(SpillWorker[i].Buffer, 2, SpillWorker[i].WordCount, ListModeFile);
+	}
+	if(dropped) {
+		sprintf(ErrMSG, "*ERROR* (Write_List_Mode_File): %d of %d module spills not written, invalid word count", dropped, Number_Modules);
+		Pixie_Print_MSG(ErrMSG,1);
+	}
 
-	if( (TstBit(MODCSRA_EMWORDS, MCSRA) == 1) & (TstBit(DBLBUFCSR_ENABLE, DblBufCSR) == 0) )	
-	{
-		// Read out list mode data module by module 
-		for(i=0; i<Number_Modules; i++)
-		{
+	if(!MultiThreadDAQ) fclose(ListModeFile);		// only normal mode closes file every time
+	else if(retval < 0) {
+		fclose(listFile[0]);
+		listFile[0] = NULL;
+	}
+	return(retval);
+}
 
-			// A dummy read of Pixie's word count register 
-			Pixie_RdWrdCnt((U8)i, &WordCount);
 
-			// The number of 16-bit words to read is in EMwords 
-			Pixie_IODM((U8)i, (U16)DATA_MEMORY_ADDRESS + EMwords_index, MOD_READ, 2, dsp_word);
-			WordCount = dsp_word[0] * 65536 + dsp_word[1];
+/****************************************************************
+*	Read_Spectrum_File function:
+*		Read MCA spectrum data from a previously-saved binary file.
+*
+*		Return Value:
+*			 0 - success
+*			-1 - can't open the MCA spectrum file
+*			-2 - the spectrum file doesn't contain data for this module
+*
+****************************************************************/
 
-			// Check if it is an odd or even number 
-			if(fmod(WordCount, 2.0) == 0.0) 
-			{
-				NumWordsToRead = WordCount / 2;
-			}
-			else
-			{
-				NumWordsToRead = WordCount / 2 + 1;
-			}
+S32 Read_Spectrum_File (
+						U8  ModNum,			// Pixie module number
+						U32 *Data,			// Receives histogram data
+						S8  *FileName )		// previously-saved histogram file
+{
+	U32 offset, TotalBytes;
 
-			if( (NumWordsToRead > LIST_MEMORY_LENGTH) || (NumWordsToRead ==0) ) {
-				sprintf(ErrMSG, "*ERROR* (Write_List_Mode_File):invalid word count %d", NumWordsToRead);
-				Pixie_Print_MSG(ErrMSG,1);
-				if(!MultiThreadDAQ) fclose(ListModeFile);
-				if( MultiThreadDAQ) fclose(listFile[0]);
-				free(buffer);
-				free(shortbuffer);
-				return(-2);
-			}
+	FILE *specFile = NULL;
 
-			// Read out the list mode data 
-			Pixie_IOEM((U8)i, LIST_MEMORY_ADDRESS, MOD_READ, NumWordsToRead, buffer);
+	specFile = fopen(FileName, "rb"); /* Read a binary file */
+	if(specFile != NULL)
+	{
+		/* Get the file length */
+		Pixie_fseek(specFile, 0, SEEK_END);
+		TotalBytes = Pixie_ftell(specFile) + 1;
 
-			if(!MultiThreadDAQ) fwrite(buffer, 2, WordCount, ListModeFile);
-			if( MultiThreadDAQ) fwrite(buffer, 2, WordCount, listFile[0]);
+		/* Calculate the offset to point the file pointer to the module histogram data */
+		offset = ModNum*HISTOGRAM_MEMORY_LENGTH*NUMBER_OF_CHANNELS;
 
-		}
-
-		if(!MultiThreadDAQ) fclose(ListModeFile);		// only normal mode closes file every time
-		free(buffer);
-		free(shortbuffer);
-		return(0);
-
-	}
-
-	// ----------- double buffer mode, List mode data in EM ------------------------------
-
-	else
-	{
-	
-		Aoffset[0] = 0;
-		Aoffset[1] = LM_DBLBUF_BLOCK_LENGTH;
-		
-		for(i=0; i<Number_Modules; i++)
-		{
-			// read the CSR
-			Pixie_ReadCSR((U8)i, &CSR);
-			CSRs[i] = CSR;
-
-			// A read of Pixie's word count register 
-			// This also indicates to the DSP that a readout has begun 
-			Pixie_RdWrdCnt((U8)i, &WordCount);
-			WCRs[i] = WordCount;
-		}	// CSR for loop
-
-		// Read out list mode data module by module 
-		for(i=0; i<Number_Modules; i++)
-		{
-
-			// The number of 16-bit words to read is in EMwords or EMwords2
-			Pixie_IODM((U8)i, (U16)DATA_MEMORY_ADDRESS + EMwords_index, MOD_READ, 2, dsp_word);
-			WordCountPP[0] = dsp_word[0] * 65536 + dsp_word[1];
-			Pixie_IODM((U8)i, (U16)DATA_MEMORY_ADDRESS + EMwords2_index, MOD_READ, 2, dsp_word);
-			WordCountPP[1] = dsp_word[0] * 65536 + dsp_word[1];
-
-					
-			if(TstBit(CSR_128K_FIRST, (U16)CSRs[i]) == 1) 
-			{
-				j=0;			
-			}
-			else		// block at 128K+64K was first
-			{
-				j=1;
-			}
-	
-			if  (TstBit(CSR_DATAREADY, (U16)CSRs[i]) == 0 )		
-			// function called after a readout that cleared WCR => run stopped => read other block
-			{
-				j=1-j;			
-				sprintf(ErrMSG, "*INFO* (Write_List_Mode_File): Module %d: Both memory blocks full (block %d older). Run paused (or finished).",i,1-j);
-				Pixie_Print_MSG(ErrMSG,1);
-			}
-
-//sprintf(ErrMSG, "*INFO* (Write_List_Mode_File): Module %d: CSR = %x, j=%d",i,CSRs[i],j );
-//Pixie_Print_MSG(ErrMSG,1);
-			
-			if (WordCountPP[j] >0)
-			{
-				// Check if it is an odd or even number 
-				if(fmod(WordCountPP[j], 2.0) == 0.0)
-				{
-					NumWordsToRead = WordCountPP[j] / 2;
-				}
-				else
-				{
-					NumWordsToRead = WordCountPP[j] / 2 + 1;
-				}
-	
-				if(NumWordsToRead > LIST_MEMORY_LENGTH)
-				{
-					sprintf(ErrMSG, "*ERROR* (Write_List_Mode_File):invalid word count %d", NumWordsToRead);
-					Pixie_Print_MSG(ErrMSG,1);
-					if(!MultiThreadDAQ) fclose(ListModeFile);
-					if( MultiThreadDAQ) fclose(listFile[0]);
-					free(buffer);
-					free(shortbuffer);
-					return(-2);
-				}
-	
-				// Read out the list mode data 
-				Pixie_IOEM((U8)i, LIST_MEMORY_ADDRESS+Aoffset[j], MOD_READ, NumWordsToRead, buffer);
-	
-				// save to file
-				if(!MultiThreadDAQ) fwrite(buffer, 2, WordCountPP[j], ListModeFile);
-				if( MultiThreadDAQ) fwrite(buffer, 2, WordCountPP[j], listFile[0]);
-
-			}
-						
-		}	// readout for loop
-	
-	
-		if(!MultiThreadDAQ) fclose(ListModeFile);		// only normal mode closes file every time
-
-		for(i=0; i<Number_Modules; i++)
-		{
-			// A second read of Pixie's word count register to clear the DBUF_1FULL bit
-			// indicating to the DSP that the read is complete
-			Pixie_RdWrdCnt((U8)i, &WordCount);
-		}	// third for loop
-
-		free(buffer);
-		free(shortbuffer);
-		return(0);
-	}
-
-	
-}
-
-
-/****************************************************************
-*	Read_Spectrum_File function:
-*		Read MCA spectrum data from a previously-saved binary file.
-*
-*		Return Value:
-*			 0 - success
-*			-1 - can't open the MCA spectrum file
-*			-2 - the spectrum file doesn't contain data for this module
-*
-****************************************************************/
-
-S32 Read_Spectrum_File (
-						U8  ModNum,			// Pixie module number
-						U32 *Data,			// Receives histogram data
-						S8  *FileName )		// previously-saved histogram file
-{
-	U32 offset, TotalBytes;
-
-	FILE *specFile = NULL;
-
-	specFile = fopen(FileName, "rb"); /* Read a binary file */
-	if(specFile != NULL)
-	{
-		/* Get the file length */
-		Pixie_fseek(specFile, 0, SEEK_END);
-		TotalBytes = Pixie_ftell(specFile) + 1;
-
-		/* Calculate the offset to point the file pointer to the module histogram data */
-		offset = ModNum*HISTOGRAM_MEMORY_LENGTH*NUMBER_OF_CHANNELS;
-
-		/* Check offset to make sure histogram data is available for this Pixie module */
-		if(offset < (TotalBytes - HISTOGRAM_MEMORY_LENGTH*NUMBER_OF_CHANNELS))
-		{
-			Pixie_fseek(specFile, offset, SEEK_SET);
-			fread(Data, 4, HISTOGRAM_MEMORY_LENGTH, specFile);
-			fclose(specFile);
-			return(0);
+		/* Check offset to make sure histogram data is available for this Pixie module */
+		if(offset < (TotalBytes - HISTOGRAM_MEMORY_LENGTH*NUMBER_OF_CHANNELS))
+		{
+			Pixie_fseek(specFile, offset, SEEK_SET);
+			fread(Data, 4, HISTOGRAM_MEMORY_LENGTH, specFile);
+			fclose(specFile);
+			return(0);
 		}
 		else
 		{
@@ -1707,7 +1936,7 @@ S32 Get_Traces (
 				U8  ChanNum )			// Pixie channel number
 {
 
-	U16 ch, idx, Wcount;
+	U16 ch, idx;
 	U32 value;
 	S32 retval;
 	U32 dwStatus;
@@ -1740,7 +1969,7 @@ S32 Get_Traces (
 				return(-5);
 			}
 			
-			retval = WDC_DMASyncCpu(pDmaTrace);	
+			retval = PIXIE500E_DMASyncCpu(pDmaTrace);	
 #endif
 			//	sprintf(ErrMSG, "*DEBUG* (Get_Traces): start run", ModNum);
 			//	Pixie_Print_MSG(ErrMSG,1);
@@ -1754,20 +1983,7 @@ S32 Get_Traces (
 			}
 
 			/* Check Run Status */
-			Wcount=0;
-			do{
-				Pixie_Sleep(10);
-				if(Check_Run_Status(ModNum)==0)
-				{
-				//	sprintf(ErrMSG, "*INFO* (Get_Traces): Check_Run_Status=0: Module %d", ModNum);
-				//	Pixie_Print_MSG(ErrMSG,1);
-					break;
-				}
-
-				Wcount++;
-			} while(Wcount<100); /* The maximum allowed waiting time is 1 s */
-
-			if(Wcount>=100)	{
+			if(Wait_Run_Done(ModNum, GET_TRACES, 1000) < 0)	{ /* The maximum allowed waiting time is 1 s */
 				sprintf(ErrMSG, "*ERROR* (Get_Traces): Acquiring ADC traces in Module %d timed out", ModNum);
 				Pixie_Print_MSG(ErrMSG,1);
 				return(-2); /* Time Out */
@@ -1792,8 +2008,8 @@ S32 Get_Traces (
 
 				// sprintf(ErrMSG, "*DEBUG* (Get_Traces): finishing up DMA");
 				// Pixie_Print_MSG(ErrMSG,PrintDebugMsg_other);	
-				retval = WDC_DMASyncIo(pDmaTrace);
-				retval = WDC_DMABufUnlock(pDmaTrace);
+				retval = PIXIE500E_DMASyncIo(pDmaTrace);
+				retval = PIXIE500E_DMABufUnlock(pDmaTrace);
 #endif
 		} // endif PCI bus type == PCIe
 
@@ -1817,17 +2033,7 @@ S32 Get_Traces (
 				}
 
 				/* Check Run Status */
-				Wcount=0;
-				do{
-					Pixie_Sleep(1);
-					if(Check_Run_Status(ModNum)==0) {
-						break;
-					}
-
-					Wcount++;
-				} while(Wcount<10000); /* The maximum allowed waiting time is 10 s */
-
-				if(Wcount>=10000) 	{
+				if(Wait_Run_Done(ModNum, GET_TRACES, 10000) < 0) 	{ /* The maximum allowed waiting time is 10 s */
 					sprintf(ErrMSG, "*ERROR* (Get_Traces): Acquiring ADC traces in Module %d Channel %d timed out", ModNum, ch);
 					Pixie_Print_MSG(ErrMSG,1);
 					return(-2); /* Time Out */
@@ -1875,17 +2081,7 @@ S32 Get_Traces (
 		}
 
 		/* Check Run Status */
-		Wcount=0;
-		do
-		{
-			Pixie_Sleep(10);
-			if(Check_Run_Status(ModNum)==0)
-				break;
-
-			Wcount++;
-		} while(Wcount<100); /* The maximum allowed waiting time is 2 s */
-
-		if(Wcount>=100)
+		if(Wait_Run_Done(ModNum, (U16)((PCIBusType == EXPRESS_PCI) ? 39 : GET_TRACES), 1000) < 0) /* The maximum allowed waiting time is 1 s */
 		{
 			sprintf(ErrMSG, "*ERROR* (Get_Traces): Acquiring ADC traces in Module %d Channel %d timed out", ModNum, ChanNum);
 			Pixie_Print_MSG(ErrMSG,1);
@@ -1931,7 +2127,7 @@ S32 Adjust_Offsets (
 					U8 ModNum )		// module number
 {
 
-	U32    Wcount, j, CurrentModNum, Twait, MNstart, MNend;
+	U32    j, CurrentModNum, Twait, MNstart, MNend;
 	S32    retval;
 	U32    sTDACwave[IO_BUFFER_LENGTH], IOBuffer[DSP_IO_BORDER];
 	double TDACwave[IO_BUFFER_LENGTH], DACcenter, DACfifty;
@@ -1978,19 +2174,7 @@ S32 Adjust_Offsets (
 		for(CurrentModNum = MNstart; CurrentModNum < MNend ; CurrentModNum ++)
 		{
 			/* Check run status */
-			Wcount=0;
-			do
-			{
-				Pixie_Sleep(1);
-				if(Check_Run_Status((U8)CurrentModNum)==0)		
-				{
-					break;
-				}
-
-				Wcount++;
-			}while(Wcount<10000); /* The maximum allowed waiting time is 10 s */
-
-			if(Wcount>=10000)
+			if(Wait_Run_Done((U8)CurrentModNum, RAMP_TRACKDAC, 10000) < 0) /* The maximum allowed waiting time is 10 s */
 			{
 				sprintf(ErrMSG, "*ERROR* (Adjust_Offsets): RampTrackDACs timed out in Module %d", CurrentModNum);
 				Pixie_Print_MSG(ErrMSG,1);
@@ -2493,6 +2677,32 @@ S32 Tau_Finder (
 				U8 ChanNum,			// Pixie channel number
 				double *Tau )		// Tau value
 {
+	/* Generate random indices */
+	RandomSwap();
+
+	return(Tau_Finder_Set(ModNum, ChanNum, Tau, Random_Set));
+}
+
+
+/****************************************************************
+*	Tau_Finder_Set function:
+*		Tau_Finder with the random pairs of trace samples for the
+*		noise estimate given by RandomSet, as made by RandomSwap.
+*		Modules can then be tuned at the same time with the same 
+*		pairs as one after the other (see Tune_Modules).
+*
+*		Return Value:
+*			 0 - success
+*			-1 - failure to acquire ADC traces
+*
+****************************************************************/
+
+S32 Tau_Finder_Set (
+				U8 ModNum,			// Pixie module number
+				U8 ChanNum,			// Pixie channel number
+				double *Tau,		// Tau value
+				U16 *RandomSet )	// random order of IO_BUFFER_LENGTH indices
+{
 
 	U32 Trace[IO_BUFFER_LENGTH];
 	U16 idx, FL, FG, Xwait, TFcount; /* fast filter times are set here */
@@ -2521,9 +2731,6 @@ S32 Tau_Finder (
 	/* Save input Tau value */
 	input_tau=*Tau;
 
-	/* Generate random indices */
-	RandomSwap();
-
 	/* Get DSP parameters FL, FG and XWAIT */
 	sprintf(str,"FASTLENGTH%d",ChanNum);
 	idx=Find_Xact_Match(str, DSP_Parameter_Names, N_DSP_PAR);
@@ -2557,7 +2764,7 @@ S32 Tau_Finder (
 					return(-1);
 				}
 				/* Find threshold */
-				threshold=Thresh_Finder(Trace, Tau, FF, FF2, FL, FG, ModNum, ChanNum);
+				threshold=Thresh_Finder(Trace, Tau, FF, FF2, FL, FG, ModNum, ChanNum, RandomSet);
 
 				kmin=2*FL+FG;
 
@@ -2811,6 +3018,8 @@ double Phi_Value (
 /****************************************************************
 *	Thresh_Finder function:
 *		Threshold finder used for Tau Finder function.
+*		The fast filter sums are updated from one sample to the
+*		next instead of summed again (exact, as integer sums).
 *
 *		Return Value:
 *			Threshold
@@ -2825,7 +3034,8 @@ double Thresh_Finder (
 					  U32 FL,			// fast length
 					  U32 FG,			// fast gap
 					  U8  ModNum,		// Pixie module number
-					  U8  ChanNum )		// Pixie channel number
+					  U8  ChanNum,		// Pixie channel number
+					  U16 *RandomSet )	// random order of IO_BUFFER_LENGTH indices
 {
 
 	U32 ndat,kmin,k,idx,ndev,n,m;
@@ -2860,38 +3070,33 @@ double Thresh_Finder (
 		FF[k]=0;
 	}
 
-	for(k=kmin;k<ndat;k+=1)
-	{
-		sum0=0;	sum1=0;
-		for(n=0;n<FL;n++)
-		{
-			sum0+=Trace[k-kmin+n];
-			sum1+=Trace[k-kmin+FL+FG+n];
-		}
-		FF[k]=sum1-sum0*c0;
-	}
-
-	/* zero out the initial part,where the true filter values are unknown */
 	for(k=0;k<kmin;k+=1)
 	{
 		FF2[k]=0;
 	}
 
+	sum0=0;	sum1=0;
+	for(n=0;n<FL;n++)
+	{
+		sum0+=Trace[n];
+		sum1+=Trace[FL+FG+n];
+	}
 	for(k=kmin;k<ndat;k+=1)
 	{
-		sum0=0;	sum1=0;
-		for(n=0;n<FL;n++)
+		FF[k]=sum1-sum0*c0;
+		FF2[k]=(sum0-sum1)/FL;
+		if(k+1 < ndat)
 		{
-			sum0+=Trace[k-kmin+n];
-			sum1+=Trace[k-kmin+FL+FG+n];
+			/* move both sums one sample on */
+			sum0+=(double)Trace[k+1-kmin+FL-1]-(double)Trace[k-kmin];
+			sum1+=(double)Trace[k+1-kmin+2*FL+FG-1]-(double)Trace[k-kmin+FL+FG];
 		}
-		FF2[k]=(sum0-sum1)/FL;
 	}
 
 	deviation=0;
 	for(k=0;k<ndat;k+=2)
 	{
-		deviation+=fabs(FF[Random_Set[k]]-FF[Random_Set[k+1]]);
+		deviation+=fabs(FF[RandomSet[k]]-FF[RandomSet[k+1]]);
 	}
 
 	deviation/=(ndat/2);
@@ -2900,10 +3105,10 @@ double Thresh_Finder (
 	m=0; deviation=0;
 	for(k=0;k<ndat;k+=2)
 	{
-		if(fabs(FF[Random_Set[k]]-FF[Random_Set[k+1]])<threshold)
+		if(fabs(FF[RandomSet[k]]-FF[RandomSet[k+1]])<threshold)
 		{
 			m+=1;
-			deviation+=fabs(FF[Random_Set[k]]-FF[Random_Set[k+1]]);
+			deviation+=fabs(FF[RandomSet[k]]-FF[RandomSet[k+1]]);
 		}
 	}
 	deviation/=m;
@@ -2913,10 +3118,10 @@ double Thresh_Finder (
 	m=0; deviation=0;
 	for(k=0;k<ndat;k+=2)
 	{
-		if(fabs(FF[Random_Set[k]]-FF[Random_Set[k+1]])<threshold)
+		if(fabs(FF[RandomSet[k]]-FF[RandomSet[k+1]])<threshold)
 		{
 			m+=1;
-			deviation+=fabs(FF[Random_Set[k]]-FF[Random_Set[k+1]]);
+			deviation+=fabs(FF[RandomSet[k]]-FF[RandomSet[k+1]]);
 		}
 	}
 
@@ -2927,10 +3132,10 @@ double Thresh_Finder (
 	m=0; deviation=0;
 	for(k=0;k<ndat;k+=2)
 	{
-		if(fabs(FF[Random_Set[k]]-FF[Random_Set[k+1]])<threshold)
+		if(fabs(FF[RandomSet[k]]-FF[RandomSet[k+1]])<threshold)
 		{
 			m+=1;
-			deviation+=fabs(FF[Random_Set[k]]-FF[Random_Set[k+1]]);
+			deviation+=fabs(FF[RandomSet[k]]-FF[RandomSet[k+1]]);
 		}
 	}
 	deviation/=m;
@@ -2960,7 +3165,7 @@ S32 BLcut_Finder (
 {
 
 	U16 idx, KeepLog, FilterRange, SL, SG, KeepChanNum, k, l,localBlCut;
-	U32 BadBaselines, value, Wcount, buffer[IO_BUFFER_LENGTH];
+	U32 BadBaselines, value, buffer[IO_BUFFER_LENGTH];
 	S8  str[256];
 	double tim, tau, Bnorm, BLave, BLsigma, ExpFactor, b0, b1, b2, b3, baseline[IO_BUFFER_LENGTH/6];
 	U16 BLCmin, BLCmax;
@@ -3067,14 +3272,7 @@ S32 BLcut_Finder (
 			}
 
 			/* Check Run Status */
-			Wcount=0;
-			Pixie_Sleep(1); /* A short wait before polling */
-			while(Check_Run_Status(ModNum) && (Wcount<10000))
-			{
-				Pixie_Sleep(1);
-				Wcount++; /* The maximal waiting time is 10 s */ 
-			}
-			if(Wcount>=10000)
+			if(Wait_Run_Done(ModNum, COLLECT_BASES, 10000) < 0) /* The maximal waiting time is 10 s */ 
 			{
 				sprintf(ErrMSG, "BLcut_Finder: Module %d timed out", ModNum);
 				Pixie_Print_MSG(ErrMSG,1);
@@ -3703,6 +3901,9 @@ S32 Make_SGA_Gain_Table(void)
 *	Pixie_Print_MSG function:
 *		This routine prints error message or other message
 *		either to Igor history window or a text file.
+*		Outside Igor, the message is logged by Pixie_Log_Put
+*		and printed and written to PIXIEmsg.txt by the log 
+*		flusher thread.
 *
 ****************************************************************/
 
@@ -3710,7 +3911,9 @@ S32 Pixie_Print_MSG (
 					 S8 *message, 	// message to be printed 
 					 U32 enable )	// print it or not
 {
+#ifdef COMPILE_IGOR_XOP
 	FILE *PIXIEmsg = NULL;
+#endif
 		
 	if(!enable)	return(0);
 
@@ -3752,18 +3955,7 @@ S32 Pixie_Print_MSG (
 		
 #else
 		// for LV dll etc
-		//FILE *PIXIEmsg = NULL;
-
-		PIXIEmsg = fopen("PIXIEmsg.txt", "a");
-		if(PIXIEmsg != NULL)
-		{
-			/* Add new line character '\n' for printf */
-			strcat(message, "\n");
-			printf(message);
-
-			fprintf(PIXIEmsg, "%s", message);
-			fclose(PIXIEmsg);
-		}
+		Pixie_Log_Put(message);
 
 #endif
 
@@ -3922,9 +4114,333 @@ S32 Pixie_Check_Moduletypes (
 	return(ret);
 }
 
+/****************************************************************
+*	Setup_DMA_Ring function:
+*		Allocate and lock the ring of list mode DMA framebuffers 
+*		for one module, program the sequencer for the first slot.
+*		The number of slots is LMRingDepth at run start.
+*		return values
+*			<0: error
+*			 0: ok
+****************************************************************/
+
+S32 Setup_DMA_Ring (
+					U8  ModNum) 				// Pixie module number
+{
+#ifdef WINDRIVER_API
+	U32 slot, depth;
+	DWORD dwStatus;
+
+	depth = LMRingDepth;
+	if(depth < 1) depth = 1;
+	if(depth > DMA_LM_RING_MAX) depth = DMA_LM_RING_MAX;
+
+	for(slot = 0; slot < DMA_LM_RING_MAX; slot++) {
+		LMRing[ModNum][slot] = NULL;
+		LMRingCode[ModNum][slot] = NULL;
+		pDmaRing[ModNum][slot] = NULL;
+		LMRingState[ModNum][slot] = LM_SLOT_FREE;
+	}
+	LMRingSlots[ModNum] = 0;
+	LMRingFill[ModNum] = 0;
+	LMRingStalls[ModNum] = 0;
+	LMBufferDone[ModNum] = NULL;
+
+	for(slot = 0; slot < depth; slot++) {
+		LMRing[ModNum][slot] = malloc(DMA_LM_FRAMEBUFFER_LENGTH);
+		LMRingCode[ModNum][slot] = malloc(m_RAMSize);
+		if (!LMRing[ModNum][slot] || !LMRingCode[ModNum][slot]) {
+			sprintf(ErrMSG, "*ERROR* (Setup_DMA_Ring): Memory allocation for list mode buffer %d failure", slot);
+			Pixie_Print_MSG(ErrMSG,1);
+			Release_DMA_Ring(ModNum);
+			return(-1);
+		}
+		memset(LMRing[ModNum][slot], 0x69, DMA_LM_FRAMEBUFFER_LENGTH); 
+
+		// lock the buffer and generate its sequencer image (code + SG list)
+		dwStatus = PIXIE500E_DMA_Ring_Setup(hDev[ModNum], DMA_LM_FRAMEBUFFER_LENGTH, (DWORD *)LMRing[ModNum][slot], &pDmaRing[ModNum][slot], LMRingCode[ModNum][slot]);
+		if (dwStatus != WD_STATUS_SUCCESS) {
+			sprintf(ErrMSG, "*ERROR* (Setup_DMA_Ring): DMA setup failed for buffer %d, module %d", slot, ModNum);
+			Pixie_Print_MSG(ErrMSG,1);
+			Release_DMA_Ring(ModNum);
+			return(-2);
+		}
+		LMRingSlots[ModNum]++;
+	}
+
+	// Program the sequencer with the first slot
+	dwStatus = PIXIE500E_DMA_ProgramSequencer(hDev[ModNum], LMRingCode[ModNum][0]);
+	if (dwStatus != WD_STATUS_SUCCESS) {
+		sprintf(ErrMSG, "*ERROR* (Setup_DMA_Ring): Failure to program DMA controller, module %d", ModNum);
+		Pixie_Print_MSG(ErrMSG,1);
+		Release_DMA_Ring(ModNum);
+		return(-2);
+	}
+
+	LMRingState[ModNum][0] = LM_SLOT_FILLING;
+	LMBuffer[ModNum] = LMRing[ModNum][0];
+	LMBufferDone[ModNum] = LMRing[ModNum][0];
+	pDmaList[ModNum] = pDmaRing[ModNum][0];
+
+	sprintf(ErrMSG, "*DEBUG* (Setup_DMA_Ring): module %d, %d DMA framebuffers", ModNum, LMRingSlots[ModNum]);
+	Pixie_Print_MSG(ErrMSG,PrintDebugMsg_daq);
+#endif
+	return(0);
+}
+
+/****************************************************************
+*	Release_DMA_Ring function:
+*		Unlock and free all list mode DMA framebuffers of one module
+*
+****************************************************************/
+
+S32 Release_DMA_Ring (
+					  U8  ModNum) 				// Pixie module number
+{
+#ifdef WINDRIVER_API
+	U32 slot;
+
+	for(slot = 0; slot < DMA_LM_RING_MAX; slot++) {
+		if (pDmaRing[ModNum][slot] != NULL) {
+			PIXIE500E_DMASyncIo(pDmaRing[ModNum][slot]);
+			PIXIE500E_DMABufUnlock(pDmaRing[ModNum][slot]);
+			pDmaRing[ModNum][slot] = NULL;
+		}
+		if (LMRing[ModNum][slot] != NULL) {
+			free(LMRing[ModNum][slot]);
+			LMRing[ModNum][slot] = NULL;
+		}
+		if (LMRingCode[ModNum][slot] != NULL) {
+			free(LMRingCode[ModNum][slot]);
+			LMRingCode[ModNum][slot] = NULL;
+		}
+		LMRingState[ModNum][slot] = LM_SLOT_FREE;
+	}
+	LMRingSlots[ModNum] = 0;
+	LMBuffer[ModNum] = NULL;
+	LMBufferDone[ModNum] = NULL;
+	pDmaList[ModNum] = NULL;
+#endif
+	return(0);
+}
+
+/****************************************************************
+*	Advance_DMA_Ring function:
+*		Called when the sequencer has filled the current framebuffer.
+*		Marks it full, re-arms and restarts the sequencer on the next 
+*		free slot and returns the filled buffer to the caller.
+*		If the sequencer is still busy (partial buffer at end of run), 
+*		the ring has one slot, or no slot is free, nothing is re-armed 
+*		and the caller has to process the buffer in place and rewind 
+*		the sequencer itself; this is the case if the returned pointer
+*		is still equal to LMBuffer[ModNum].
+*
+****************************************************************/
+
+U32 *Advance_DMA_Ring (
+					   U8  ModNum) 				// Pixie module number
+{
+#ifdef WINDRIVER_API
+	U16 filled, next;
+	U32 *pBuf;
+
+	filled = LMRingFill[ModNum];
+	pBuf = LMBuffer[ModNum];
+	if(LMRingSlots[ModNum] < 2 || pBuf != LMRing[ModNum][filled])
+		return(pBuf);
+
+	if(!VDMADriver_isIdle(hDev[ModNum]))
+		return(pBuf);
+
+	next = (filled + 1) % LMRingSlots[ModNum];
+	if(__atomic_load_n(&LMRingState[ModNum][next], __ATOMIC_ACQUIRE) != LM_SLOT_FREE) {
+		LMRingStalls[ModNum]++;
+		sprintf(ErrMSG, "*DEBUG* (Advance_DMA_Ring): no free DMA framebuffer, module %d, stalls %d", ModNum, LMRingStalls[ModNum]);
+		Pixie_Print_MSG(ErrMSG,PrintDebugMsg_daq);
+		return(pBuf);
+	}
+
+	PIXIE500E_DMASyncIo(pDmaRing[ModNum][filled]);		// make DMA data visible to the CPU
+
+	// Set the last element to a known pattern, change of which will be used as DMA idle indicator.
+	LMRing[ModNum][next][DMA_LM_FRAMEBUFFER_LENGTH/(sizeof(U32))-1] = 0xA5A5A5A5;
+	if(PIXIE500E_DMA_Ring_Arm(hDev[ModNum], LMRingCode[ModNum][next], pDmaRing[ModNum][next]) != WD_STATUS_SUCCESS) {
+		// restore the SG list of the filled slot so the caller can rewind as usual
+		PIXIE500E_DMA_Ring_Arm(hDev[ModNum], LMRingCode[ModNum][filled], pDmaRing[ModNum][filled]);
+		return(pBuf);
+	}
+
+	LMRingState[ModNum][filled] = LM_SLOT_FULL;
+	LMRingState[ModNum][next] = LM_SLOT_FILLING;
+	LMRingFill[ModNum] = next;
+	LMBuffer[ModNum] = LMRing[ModNum][next];
+	pDmaList[ModNum] = pDmaRing[ModNum][next];
+
+	VDMADriver_Go(hDev[ModNum]);						// resume DMA into the next framebuffer
+	sprintf(ErrMSG, "*DEBUG* (Advance_DMA_Ring): Sequencer restarted on buffer %d", next);
+	Pixie_Print_MSG(ErrMSG,PrintDebugMsg_daq);
+
+	return(pBuf);
+#else
+	return(NULL);
+#endif
+}
+
+/****************************************************************
+*	Free_DMA_Ring_Slot function:
+*		Return a framebuffer obtained from Advance_DMA_Ring
+*		to the ring once its data has been written.
+*		return values
+*			<0: buffer is not a full ring slot
+*			 0: ok
+****************************************************************/
+
+S32 Free_DMA_Ring_Slot (
+						U8  ModNum,					// Pixie module number
+						U32 *pBuf)					// framebuffer returned by Advance_DMA_Ring
+{
+#ifdef WINDRIVER_API
+	U32 slot;
+
+	for(slot = 0; slot < LMRingSlots[ModNum]; slot++) {
+		if(LMRing[ModNum][slot] == pBuf && LMRingState[ModNum][slot] == LM_SLOT_FULL) {
+			pBuf[DMA_LM_FRAMEBUFFER_LENGTH/(sizeof(U32))-1] = 0xA5A5A5A5;
+			__atomic_store_n(&LMRingState[ModNum][slot], LM_SLOT_FREE, __ATOMIC_RELEASE);	// may be called from a writer thread
+			return(0);
+		}
+	}
+#endif
+	return(-1);
+}
+
+/****************************************************************
+*	List mode output spans
+*		In binary list mode runs the events accepted by the buffer
+*		QC are written straight from the DMA framebuffer: QC fixes
+*		headers in place, records each event as a span (address, 
+*		length) and all spans are written with one writev() per
+*		buffer. Adjacent events are merged into one span, so usually 
+*		a buffer is only a few spans. Replaces LMBufferCopy.
+****************************************************************/
+
+#ifdef XIA_LINUX
+#define LM_SPAN_MAX		(DMA_LM_FRAMEBUFFER_LENGTH/(MAX_CHAN_HEAD_LENGTH*sizeof(U16)) + 2)	// one per event, plus leftover
+#define LM_SPAN_IOV_MAX	1024		// IOV_MAX on Linux
+
+static struct iovec *LMSpan[PRESET_MAX_MODULES];
+static U32 LMSpanCount[PRESET_MAX_MODULES];
+
+static S32 LM_Spans_Write (U8 ModNum)
+{
+	struct iovec *iov = LMSpan[ModNum];
+	U32 n = LMSpanCount[ModNum];
+	U32 k;
+	ssize_t written;
+	S32 fd;
+	U64 bytes = 0;
+
+	LMSpanCount[ModNum] = 0;
+	if(n == 0)
+		return(0);
+	for(k = 0; k < n; k++)
+		bytes += iov[k].iov_len;
+	Live_Stats_Bytes(ModNum, bytes);
+
+	fflush(listFile[ModNum]);	// file header or leftover may still be in the FILE buffer
+	fd = fileno(listFile[ModNum]);
+	while(n > 0) {
+		written = writev(fd, iov, (n < LM_SPAN_IOV_MAX) ? n : LM_SPAN_IOV_MAX);
+		if(written < 0) {
+			if(errno == EINTR)
+				continue;
+			sprintf(ErrMSG, "*ERROR* (LM_Spans_Write): write to list mode file failed, module %d, errno %d", ModNum, errno);
+			Pixie_Print_MSG(ErrMSG,1);
+			return(-1);
+		}
+		// skip fully written spans, adjust a partly written one
+		for(k = 0; n > 0 && (size_t)written >= iov[k].iov_len; k++, n--)
+			written -= iov[k].iov_len;
+		iov += k;
+		if(n > 0) {
+			iov[0].iov_base = (U8 *)iov[0].iov_base + written;
+			iov[0].iov_len -= written;
+		}
+	}
+	return(0);
+}
+
+static void LM_Span_Add (U8 ModNum, U32 *pData, U32 numDWords)
+{
+	struct iovec *last;
+
+	if(numDWords == 0)
+		return;
+	if(LMSpanCount[ModNum] > 0) {
+		last = &LMSpan[ModNum][LMSpanCount[ModNum]-1];
+		if((U8 *)last->iov_base + last->iov_len == (U8 *)pData) {
+			last->iov_len += numDWords*sizeof(U32);		// continues previous event
+			return;
+		}
+		if(LMSpanCount[ModNum] == LM_SPAN_MAX)
+			LM_Spans_Write(ModNum);
+	}
+	LMSpan[ModNum][LMSpanCount[ModNum]].iov_base = pData;
+	LMSpan[ModNum][LMSpanCount[ModNum]].iov_len  = numDWords*sizeof(U32);
+	LMSpanCount[ModNum]++;
+}
+#endif
+
+/****************************************************************
+*	Setup_LM_Spans function:
+*		Allocate the span list of a module at run start, for
+*		writing binary list mode files without LMBufferCopy.
+*		return values
+*			<0: not supported or allocation failure, use LMBufferCopy
+*			 0: ok
+****************************************************************/
+
+S32 Setup_LM_Spans (
+					U8  ModNum)				// Pixie module number
+{
+#ifdef XIA_LINUX
+	Release_LM_Spans(ModNum);
+	LMSpan[ModNum] = malloc(LM_SPAN_MAX*sizeof(struct iovec));
+	if(!LMSpan[ModNum])
+		return(-1);
+	LMSpanCount[ModNum] = 0;
+	return(0);
+#else
+	return(-1);
+#endif
+}
+
+/****************************************************************
+*	Release_LM_Spans function:
+*		Free the span list of a module after the run
+****************************************************************/
+
+S32 Release_LM_Spans (
+					  U8  ModNum)			// Pixie module number
+{
+#ifdef XIA_LINUX
+	if(LMSpan[ModNum] != NULL) {
+		free(LMSpan[ModNum]);
+		LMSpan[ModNum] = NULL;
+	}
+	LMSpanCount[ModNum] = 0;
+#endif
+	return(0);
+}
+
 /****************************************************************
 *	Write_DMA_List_Mode_File function:
 *		Read out data from DMA buffer to file, one module
+*		The filled framebuffer is handed over from the sequencer first
+*		and DMA is restarted on the next ring slot before any QC or disk I/O.
+*		If a writer thread runs for the module, the buffer is queued for it,
+*		otherwise it is processed here. If no ring slot can be used 
+*		(single buffer, partial buffer at end of run) the buffer is 
+*		processed in place and the sequencer rewound afterwards.
 *		return values
 *			<0: error
 *			 0: ok
@@ -3936,7 +4452,132 @@ S32 Write_DMA_List_Mode_File (
 							  U8  ModNum, 				// Pixie module number
 							  S8  *FileName ,		// List mode data file name
 							  U16 RunType)          // Run type (binary vs ASCII file dump), lower 12 bits
+{
+	U32 j;
+	S32 retval = 0;
+	size_t eventsWritten;
+	U32 *pBuf;			// framebuffer to process: current LMBuffer, or the ring slot just filled
+	BOOL rearmed;		// TRUE if the sequencer is already running on the next ring slot
+
+	if(listFile[ModNum] == NULL)
+	{
+		sprintf(ErrMSG, "*ERROR* (Write_DMA_List_Mode_File): file not found error");
+		Pixie_Print_MSG(ErrMSG,1);
+		return(-1);
+	} // if binary file opened
 
+#ifdef WINDRIVER_API
+	if (!LMBuffer[ModNum]) {
+		sprintf(ErrMSG, "*ERROR* (Write_DMA_List_Mode_File): LMBuffer = 0");
+		Pixie_Print_MSG(ErrMSG,1);
+		return (-1);
+	}
+
+	pBuf = Advance_DMA_Ring(ModNum);
+	rearmed = (pBuf != LMBuffer[ModNum]);
+
+	if(LM_Writer_Active(ModNum)) {
+		if(!rearmed && LMRingSlots[ModNum] > 1 && VDMADriver_isIdle(hDev[ModNum])) {
+			// all slots are queued: wait for the writer to return one
+			pBuf = LM_Writer_Wait_Slot(ModNum);
+			rearmed = (pBuf != LMBuffer[ModNum]);
+		}
+		if(rearmed) {
+			LMBufferDone[ModNum] = pBuf;
+			if(MakeNewFile)	{	// switch files in the writer threads, each between two of its buffers
+				LM_Writer_Request_New_File();
+				MakeNewFile = 0;
+			}
+			if(LM_Writer_Push(ModNum, pBuf) == 0)
+				return(__atomic_load_n(&EndRunFound[ModNum], __ATOMIC_ACQUIRE));
+			// queue full, should not happen as there are no more slots than queue entries
+			LM_Writer_Drain(ModNum);
+		}
+		else {
+			// partial buffer, sequencer still running: keep file order, let the writer finish first
+			LM_Writer_Drain(ModNum);
+		}
+	}
+
+	LMBufferDone[ModNum] = pBuf;
+	retval = Process_DMA_Buffer(ModNum, pBuf, RunType, rearmed);
+	if(retval < 0)
+		return(retval);
+#endif
+
+	if(MakeNewFile)	{	// if a top level call asked for new file in multi-file runs, make/switch files now for all modules
+		// first write any left overs. (cleared in Create_List_Mode_File) 
+		if(numDWordsLeftover[ModNum]>0) {
+			eventsWritten = fwrite(LMBuffer[ModNum], (numDWordsLeftover[ModNum])*sizeof(U32), 1, listFile[ModNum]);
+		}
+		// TODO: insert EOR block at the end of the old files
+		// then make new files
+		for(j=0; j < Number_Modules; j++) {
+			Create_List_Mode_File(j, next_base_name, RunType);
+		}
+	}
+
+	return(__atomic_load_n(&EndRunFound[ModNum], __ATOMIC_ACQUIRE));
+}
+
+/****************************************************************
+*	LM_Carry_Save function:
+*		Keep the incomplete event at the end of a framebuffer in 
+*		LMCarry, to be joined with the start of the next one.
+*		LMCarry grows to hold the tail plus a full event and the 
+*		next channel header.
+*		return values
+*			<0: memory allocation failure, tail is dropped
+*			 0: ok
+****************************************************************/
+
+static S32 LM_Carry_Save (
+						  U8  ModNum,				// Pixie module number
+						  U32 *pTail,				// incomplete event at the end of the framebuffer
+						  U32 numDWords,			// its length
+						  U32 numDWordsMaxEvent)	// longest event expected
+{
+	U32 size;
+	U32 *pCarry;
+
+	LMCarryCount[ModNum] = 0;
+	if(numDWords == 0)
+		return(0);
+
+	size = numDWords + numDWordsMaxEvent + MAX_CHAN_HEAD_LENGTH;	// 2 channel headers
+	if(size > LMCarrySize[ModNum]) {
+		pCarry = realloc(LMCarry[ModNum], size*sizeof(U32));
+		if(!pCarry) {
+			sprintf(ErrMSG, "*ERROR* (LM_Carry_Save): Memory allocation failure, module %d, event at end of buffer dropped", ModNum);
+			Pixie_Print_MSG(ErrMSG,1);
+			return(-1);
+		}
+		LMCarry[ModNum] = pCarry;
+		LMCarrySize[ModNum] = size;
+	}
+	memcpy(LMCarry[ModNum], pTail, numDWords*sizeof(U32));
+	LMCarryCount[ModNum] = numDWords;
+	return(0);
+}
+
+/****************************************************************
+*	Process_DMA_Buffer function:
+*		Quality check a filled DMA framebuffer of one module and 
+*		write it to the module's list mode file.
+*		If the buffer is a ring slot handed over by Advance_DMA_Ring
+*		(rearmed = TRUE), it is returned to the ring when done; 
+*		otherwise the sequencer is rewound and restarted on it.
+*		return values
+*			<0: error
+*			 0: ok
+****************************************************************/
+
+
+S32 Process_DMA_Buffer (						 
+						U8  ModNum, 			// Pixie module number
+						U32 *pBuf,				// filled DMA framebuffer
+						U16 RunType,			// Run type (binary vs ASCII file dump), lower 12 bits
+						BOOL rearmed)			// TRUE if the sequencer already runs on the next ring slot
 
 
 {
@@ -3944,7 +4585,7 @@ S32 Write_DMA_List_Mode_File (
 //#define MAKE_CHAN_HEAD_ERRORS
 
 	size_t elementsWritten = 0;
-	U32 value, i, j;
+	U32 value, j;
 	U32 bufPtr, currentDWord, EvStart;
 	U32 traceBlocksFollow, traceBlocksPrev, traceBlocksMismatchCount; // traceBlocksMismatchCount: TRACELENGTH != trace blocks to follow in channnel header
 	U32 goodEventCount;			// actually TOTAL events written
@@ -3986,11 +4627,28 @@ S32 Write_DMA_List_Mode_File (
 	U32 *dumpBuffer = NULL; // copy of the DMA framebuffer, used for writing to the file with "FileName"
 
 	U32 *pLMBufferCopy; // local pointer to current module LMBufferCopy
-	
+	BOOL zeroCopy = FALSE;	// write events directly from pBuf (LMSpan) instead of LMBufferCopy
+
+	U32 *pQC;					// buffer under QC: LMCarry (tail of previous buffer joined with head of this one) or pBuf
+	U32 numDWordsQC;			// words in pQC
+	U32 qcEnd;					// QC events starting before this word of pQC
+	U32 pass;					// 0: joined events in LMCarry, 1: pBuf
+	U32 numDWordsJoined = 0;	// words of the previous buffer at the start of LMCarry
+	U32 numDWordsMaxEvent;		// longest event according to DSP settings, in 32-bit words
+	U32 carryFrom = 0, numDWordsCarry = 0;	// incomplete event at the end of pBuf, carried over to the next buffer
+	U32 splitCarryCount;		// events carried over to the next buffer
+	BOOL stopQC = FALSE;		// EOR found
+	BOOL saved;					// header and counters saved before QC of an event near the end of pBuf
+	U32 saveHeader[MAX_CHAN_HEAD_LENGTH/2];
+	U32 saveCount[4];
+	U16 savePrevQC = 0;
+	U32 liveQC[LIVE_QC_COUNTERS];				// counters for Live_Stats_Buffer, in LIVE_QC_* order
+	U32 chanEvents[NUMBER_OF_CHANNELS] = {0};	// events written per channel
+	U64 liveStart = Live_Stats_Time();
 
 	if(listFile[ModNum] == NULL)
 	{
-		sprintf(ErrMSG, "*ERROR* (Write_DMA_List_Mode_File): file not found error");
+		sprintf(ErrMSG, "*ERROR* (Process_DMA_Buffer): file not found error");
 		Pixie_Print_MSG(ErrMSG,1);
 		return(-1);
 	} // if binary file opened
@@ -4009,7 +4667,8 @@ S32 Write_DMA_List_Mode_File (
 		// 3a. If cool, write the event to disk.
 		// 3b. If not, write as if header's trace length is correct (likely junk at end of trace), mark event as bad
 	    // 4. go back to 1. 
-		// Events that start/end not on buffer boundary are discarded and counted as split. WH_TODO: improve that
+		// Events that do not end before the buffer boundary are carried over in LMCarry, joined with the 
+		// head of the next buffer and QC'd as a whole then. Only events that can not be joined are counted as split.
 
 
 		bufPtr = 0;
@@ -4023,6 +4682,7 @@ S32 Write_DMA_List_Mode_File (
 		badEventCount = 0;
 		splitHeaderCount = 0;
 		splitTraceCount = 0;
+		splitCarryCount = 0;
 		offsetWordCount = 0;
 		traceBlocksMismatchCount = 0;
 		badWatermarkCount = 0;
@@ -4031,13 +4691,16 @@ S32 Write_DMA_List_Mode_File (
 
 //		EndRunFound[ModNum] = 0;		// global: initialize to zero every time we process a new buffer
 
-		if (!LMBuffer[ModNum]) {
-			sprintf(ErrMSG, "*ERROR* (Write_DMA_List_Mode_File): LMBuffer = 0");
+		if (!pBuf) {
+			sprintf(ErrMSG, "*ERROR* (Process_DMA_Buffer): LMBuffer = 0");
 			Pixie_Print_MSG(ErrMSG,1);
 			return (-1);
 		}
-		if (!LMBufferCopy[ModNum]) {
-			sprintf(ErrMSG, "*ERROR* (Write_DMA_List_Mode_File): LMBufferCopy = 0");
+#ifdef XIA_LINUX
+		zeroCopy = (LMSpan[ModNum] != NULL);
+#endif
+		if (!LMBufferCopy[ModNum] && !zeroCopy) {
+			sprintf(ErrMSG, "*ERROR* (Process_DMA_Buffer): LMBufferCopy = 0");
 			Pixie_Print_MSG(ErrMSG,1);
 			return (-1);
 		}
@@ -4047,350 +4710,430 @@ S32 Write_DMA_List_Mode_File (
 		if(!BufferQC)
 		{
 #ifdef DUMP
-			eventsWritten = fwrite(LMBuffer[ModNum], DMA_LM_FRAMEBUFFER_LENGTH, 1, listFile[ModNum]);
+			if(LMCarryCount[ModNum] > 0)		// QC was turned off with an event carried over: write as is
+				eventsWritten = fwrite(LMCarry[ModNum], LMCarryCount[ModNum]*sizeof(U32), 1, listFile[ModNum]);
+			Live_Stats_Bytes(ModNum, (U64)LMCarryCount[ModNum]*sizeof(U32) + DMA_LM_FRAMEBUFFER_LENGTH);
+			LMCarryCount[ModNum] = 0;
+			eventsWritten = fwrite(pBuf, DMA_LM_FRAMEBUFFER_LENGTH, 1, listFile[ModNum]);
 #endif		
-			// Set the last element to a known pattern, change of which will be used as DMA idle indicator.
-			LMBuffer[ModNum][DMA_LM_FRAMEBUFFER_LENGTH/(sizeof(U32))-1] = 0xA5A5A5A5;
+			if(rearmed) {
+				Free_DMA_Ring_Slot(ModNum, pBuf);
+			}
+			else {
+				// Set the last element to a known pattern, change of which will be used as DMA idle indicator.
+				LMBuffer[ModNum][DMA_LM_FRAMEBUFFER_LENGTH/(sizeof(U32))-1] = 0xA5A5A5A5;
 
-			VDMADriver_SetDPTR(hDev[ModNum], MAIN_START);		// rewind DMA sequencer
-			VDMADriver_Go(hDev[ModNum]);						// resume DMA (that was halted by finishing the SG list)
-			sprintf(ErrMSG, "*DEBUG* (Write_DMA_List_Mode_File): Sequencer restarted, no QC");
-			Pixie_Print_MSG(ErrMSG,PrintDebugMsg_QCdetail);
+				VDMADriver_SetDPTR(hDev[ModNum], MAIN_START);		// rewind DMA sequencer
+				VDMADriver_Go(hDev[ModNum]);						// resume DMA (that was halted by finishing the SG list)
+				Pixie_Log_Rec(PrintDebugMsg_QCdetail, "*DEBUG* (Process_DMA_Buffer): Sequencer restarted, no QC", 0);
+			}
 
 			LMBufferCounter[ModNum]++;
-			sprintf(ErrMSG, "*DEBUG* (Write_DMA_List_Mode_File): Done Write_DMA_List_Mode_File with buffer %d, no QC",LMBufferCounter[ModNum]);
-			Pixie_Print_MSG(ErrMSG,PrintDebugMsg_QCdetail);
-
-			if(MakeNewFile)	{	// if a top level call asked for new file in multi-file runs, make/switch files now for all modules
-				// TODO: insert an EOR block at the end of the file
-				for(j=0; j < Number_Modules; j++) {
-					Create_List_Mode_File(j, next_base_name, RunType);
-				}
-			}
+			Pixie_Log_Rec(PrintDebugMsg_QCdetail, "*DEBUG* (Process_DMA_Buffer): Done Process_DMA_Buffer with buffer %d, no QC", 1, LMBufferCounter[ModNum]);
+			memset(liveQC, 0, sizeof(liveQC));		// events are not counted without QC
+			Live_Stats_Buffer(ModNum, liveQC, NULL, liveStart);
 
 			return(0);
 		}
 
 		// if BufferQC
-		sprintf(ErrMSG, "*INFO*  (Write_DMA_List_Mode_File): Starting BUFFER QUALITY CHECK, module %d",ModNum);
-		Pixie_Print_MSG(ErrMSG,PrintDebugMsg_QCdetail);
+		Pixie_Log_Rec(PrintDebugMsg_QCdetail, "*INFO*  (Process_DMA_Buffer): Starting BUFFER QUALITY CHECK, module %d", 1, ModNum);
 
 		// first, write leftover from previous buffer to file
 		// but then start looking for watermark of next event from beginning of file, in case the leftover is a short trace
 		if(numDWordsLeftover[ModNum]>0) {
-			eventsWritten = fwrite(LMBuffer[ModNum], (numDWordsLeftover[ModNum])*sizeof(U32), 1, listFile[ModNum]);
+#ifdef XIA_LINUX
+			if(zeroCopy)
+				LM_Span_Add(ModNum, pBuf, numDWordsLeftover[ModNum]);
+			else
+#endif
+			{
+				eventsWritten = fwrite(pBuf, (numDWordsLeftover[ModNum])*sizeof(U32), 1, listFile[ModNum]);
+				Live_Stats_Bytes(ModNum, (U64)numDWordsLeftover[ModNum]*sizeof(U32));
+			}
 		}
 
-		while (bufPtr < numDWordsBuf) {
-
-			// check if we can read complete channel header
-			numDWordsRemaining = numDWordsBuf - bufPtr;
-			if ( numDWordsChanHead > numDWordsRemaining ) 
-			{ 
-				splitHeaderCount++;
-				sprintf(ErrMSG, "*ERROR* (Write_DMA_List_Mode_File): @ 0x%08X B discarding multi-buffer event (split channel header), split count %d", bufPtr*sizeof(U32), splitHeaderCount);
-				Pixie_Print_MSG(ErrMSG,PrintDebugMsg_QCerror);
-				//bufPtr += numDWordsChanHead; // to jump out of while loop
-				break;
-			} // end if cannot read complete channel header
+		// longest event expected: carried over tails are at most this long
+		numDWordsMaxEvent = EventLengthTotal[ModNum];
+		for (j = 0; j < NUMBER_OF_CHANNELS; j++)
+			numDWordsMaxEvent = MAX(numDWordsMaxEvent, EventLength[ModNum][j]);
+		numDWordsMaxEvent = numDWordsMaxEvent*BLOCKSIZE/2;
 
-			if  (RunType==0x402) 	{	// run type 0x402 does not have the channel number in the usual place
-					ChanNum = 0;		// default to zero 
-					EventLengthDSP = EventLengthTotal[ModNum]; // EventLengthTotal = 1x header + 4x TL (in blocks) in runtype 0x402
-			} else {
-					ChanNum = (U16)((LMBuffer[ModNum][bufPtr+chanHeadEnChanIdx] & 0xFFFF0000) >> 16); 
-					ChanNum = ChanNum & 0x00FF;		// upper bits of channel number reserved for special records
-					EventLengthDSP = EventLength[ModNum][ChanNum];
+		for (pass = 0; pass < 2 && !stopQC; pass++) {
+			if (pass == 0) {
+				// join the incomplete event at the end of the previous buffer with the start of this buffer
+				if (LMCarryCount[ModNum] == 0)
+					continue;
+				numDWordsJoined = LMCarryCount[ModNum];
+				numDWordsQC = numDWordsJoined + MIN(numDWordsBuf, LMCarrySize[ModNum] - numDWordsJoined);
+				memcpy(LMCarry[ModNum] + numDWordsJoined, pBuf, (numDWordsQC - numDWordsJoined)*sizeof(U32));
+				LMCarryCount[ModNum] = 0;
+				pQC = LMCarry[ModNum];
+				qcEnd = numDWordsJoined;		// only events starting in the carried over part
+			}
+			else {
+				bufPtr = (bufPtr > numDWordsJoined) ? bufPtr - numDWordsJoined : 0;	// words of pBuf QC'd in pass 0
+				if (numDWordsLeftover[ModNum] > 0) {	// joined event longer than expected: its rest follows in pBuf
+					numDWordsLeftover[ModNum] = MIN(numDWordsLeftover[ModNum], numDWordsBuf - bufPtr);
+#ifdef DUMP
+#ifdef XIA_LINUX
+					if(zeroCopy)
+						LM_Span_Add(ModNum, &pBuf[bufPtr], numDWordsLeftover[ModNum]);
+					else
+#endif
+					memcpy(pLMBufferCopy+goodEventBytes/sizeof(U32), &pBuf[bufPtr], (numDWordsLeftover[ModNum])*sizeof(U32));
+					goodEventBytes += (numDWordsLeftover[ModNum])*sizeof(U32);
+#endif
+				}
+				numDWordsLeftover[ModNum] = 0;
+				pQC = pBuf;
+				numDWordsQC = numDWordsBuf;
+				qcEnd = numDWordsBuf;
 			}
 
-			// WATERMARK CHECK BEGIN
-			// if watermark in place, event starts here
-			currentDWord = LMBuffer[ModNum][bufPtr+chanHeadWatermarkIdx]; // watermark word
+			while (bufPtr < qcEnd) {
+
+				// check if we can read complete channel header
+				numDWordsRemaining = numDWordsQC - bufPtr;
+				if ( numDWordsChanHead > numDWordsRemaining ) 
+				{ 
+					if (pass == 1) {	// carry over, header is completed with the start of the next buffer
+						carryFrom = bufPtr;
+						numDWordsCarry = numDWordsRemaining;
+						splitCarryCount++;
+						Pixie_Log_Rec(PrintDebugMsg_QCdetail, "*DEBUG* (Process_DMA_Buffer): @ 0x%08X B split channel header, carried over to next buffer, carry count %d", 2, (U32)(bufPtr*sizeof(U32)), splitCarryCount);
+					}
+					else {
+						splitHeaderCount++;
+						Pixie_Log_Rec(PrintDebugMsg_QCerror, "*ERROR* (Process_DMA_Buffer): @ 0x%08X B discarding multi-buffer event (split channel header), split count %d", 2, (U32)(bufPtr*sizeof(U32)), splitHeaderCount);
+					}
+					break;
+				} // end if cannot read complete channel header
+
+				// skip words that can not be a watermark (more than one digit wrong), several at a time
+				j = QC_Find_Watermark(pQC, bufPtr, numDWordsQC - numDWordsChanHead + 1);
+				if (j != bufPtr) {
+					offsetWordCount += j - bufPtr;
+					bufPtr = j;
+					continue;	// no watermark before the end: split header check above ends the loop
+				}
 
-			if(	currentDWord == WATERMARK)	// first try, watermark might just be in place and correct
-			{
-				value=8;
-			}
-			else	// if not, maybe just a few digits are wrong: check
-			{					
-				// give a point for a number at correct position: 0 (no match) to 8 points (full match)
-				value = 0;
-				for (i = 0; i < 8; i++) {
-					if ( ((currentDWord >> (i*4)) & 0xF) == ((WATERMARK >> (i*4)) & 0xF)) 
-						value++;
+				// an event near the end of pBuf may not be complete: keep what QC changes, to undo if it is carried over
+				saved = (pass == 1) && (numDWordsRemaining < numDWordsMaxEvent + numDWordsChanHead);
+				if (saved) {
+					memcpy(saveHeader, &pQC[bufPtr], numDWordsChanHead*sizeof(U32));
+					saveCount[0] = badWatermarkCount;
+					saveCount[1] = checkSumMismatchCount;
+					saveCount[2] = badChanNumCount;
+					saveCount[3] = traceBlocksMismatchCount;
+					savePrevQC = traceBlocksPrev_QC[ModNum];
 				}
-				
-				// if watermark word is almost correct, but not full match: still count as OK, fix and continue.
-				if (value > 6 &&  value < 8) {  // for more robust watermark word, change acceptance level.
-					sprintf(ErrMSG, "*ERROR* (Write_DMA_List_Mode_File): @ 0x%08X B bad watermark 0x%08X, fixed. (module %d, event %d)", bufPtr*4, currentDWord, ModNum, goodEventCount);
-					Pixie_Print_MSG(ErrMSG,PrintDebugMsg_QCerror);
-					badWatermarkCount++;
-					LMBuffer[ModNum][bufPtr+chanHeadWatermarkIdx] = WATERMARK; // corrected
-					LMBuffer[ModNum][bufPtr+chanHeadEventStatusIdx] |= 0x80000000; // mark event as bad
+
+				if  (RunType==0x402) 	{	// run type 0x402 does not have the channel number in the usual place
+						ChanNum = 0;		// default to zero 
+						EventLengthDSP = EventLengthTotal[ModNum]; // EventLengthTotal = 1x header + 4x TL (in blocks) in runtype 0x402
+				} else {
+						ChanNum = (U16)((pQC[bufPtr+chanHeadEnChanIdx] & 0xFFFF0000) >> 16); 
+						ChanNum = ChanNum & 0x00FF;		// upper bits of channel number reserved for special records
+						EventLengthDSP = EventLength[ModNum][ChanNum];
 				}
-			}
 
-			if (value<=6)  // if more than two digits are wrong: assume that this is not the watermark, go to next word
-			{
-				bufPtr++;
-				offsetWordCount++;
-				continue; // next word
-			} 
-			// WATERMARK CHECK END
-
-#ifdef MAKE_CHAN_HEAD_ERRORS
-			// DEBUG Breaking some channel header words
-			if (goodEventCount %2 == 1) {
-				LMBuffer[ModNum][bufPtr+1] = LMBuffer[ModNum][bufPtr+1]+ 0x10000;
-			}
-#endif
+				// WATERMARK CHECK BEGIN
+				// if watermark in place, event starts here
+				currentDWord = pQC[bufPtr+chanHeadWatermarkIdx]; // watermark word
 
-			traceBlocksFollow = (LMBuffer[ModNum][bufPtr+chanHeadNumBlocksIdx] & 0x0000FFFF);
-			traceBlocksPrev   = (LMBuffer[ModNum][bufPtr+chanHeadNumBlocksIdx] & 0xFFFF0000) >> 16;
-			numDWordsTrace    = traceBlocksFollow*BLOCKSIZE/2;
-
-			// CHECK SUM CHECK BEGIN
-			checkSum = LMBuffer[ModNum][bufPtr+chanHeadCheckSumIdx];
-			checkSumComputed = 0;
-			for (i = 0; i < numDWordsChanHead; i++) { // checksum computation from channel header
-				// Checksum only contains words written in main.sam(LMprocessing())
-				if (i == chanHeadEventStatusIdx ||
-					i == chanHeadNumBlocksIdx ||
-					i == chanHeadLoMidTrigTimeIdx ||
-					i == chanHeadHiTrigTimeIdx ||
-					i == chanHeadEnChanIdx ||
-					i == chanHeadPSAIdx ||
-					i == chanHeadPSA0Idx ||
-					i == chanHeadPSA1Idx) {
-						checkSumComputed = (checkSumComputed^LMBuffer[ModNum][bufPtr+i]);
+				if(	currentDWord == WATERMARK)	// first try, watermark might just be in place and correct
+				{
+					value=8;
 				}
-			} // end for channel header words used for checksum
-
-			// If channel header corrupted, mark it as bad event
-			// then, check and correct a few key values
-			// channel number: 
-			//		- can be compared to hit pattern, use that if header value is unreasonable
-			// previous trace length: 
-			//		- known from before
-			// current trace length: 
-			//		- can be expected to be DSP parameter value (or less in special code)
-			//		  this channel's DSP parameter value is stored in file header (TL#_DSP)
-			//		- try reasonable values then ([maybe] search for next watermark to verify header value (up to TL#_DSP)
-			//		- if true length less than TL#_DSP, correct header with that value and store that much trace
-			//		- if true length more than TL#_DSP (ie, watermark not found), correct header with TL#_DSP and store that much trace
-			//		  (excess will be discarded in watermark search next time around)
-			//		- if end of buffer earlier than TL#_DSP, treat as split event (ie currently: discard)
-			// Note: if checksum is ok and tracelength written is incorrect (more or less data), 
-			// event should be marked bad and saved with trace length as in header. Missing data will be 
-			// filled with junk (actually next channel header), excess data will be truncated in watermark search next time around
-			// This is applied below
-
-			if (checkSumComputed != checkSum) {
-				sprintf(ErrMSG, "*ERROR* (Write_DMA_List_Mode_File): @ 0x%08X B bad checksum, expected 0x%08X, calculated 0x%08X (module %d event %d)", bufPtr*4, checkSum, checkSumComputed, ModNum, goodEventCount);
-				Pixie_Print_MSG(ErrMSG,PrintDebugMsg_QCerror);
-				checkSumMismatchCount++;
-				LMBuffer[ModNum][bufPtr+chanHeadEventStatusIdx] |= 0x80000000; // mark event as bad
-			} // CHECK SUM CHECK END
-
-			// CHANNEL NUMBER CHECK BEGIN
-			if  (RunType!=0x402) 	{	// run type 0x402 does not have the channel number in the usual place, can't check
-				ChanNum = (U16)((LMBuffer[ModNum][bufPtr+chanHeadEnChanIdx] & 0xFFFF0000) >> 16); 
-				ChanNum = ChanNum & 0x00FF;		// upper bits of channel number reserved for special records
-				if (ChanNum >= NUMBER_OF_CHANNELS) {
-					badChanNumCount++;								
-					sprintf(ErrMSG, "*ERROR* (Write_DMA_List_Mode_File): @ 0x%08X B wrong channel number %d", bufPtr*4, ChanNum);
-					Pixie_Print_MSG(ErrMSG,PrintDebugMsg_QCerror);
-					// uncomment 2 lines below to reject such events
-					//bufPtr+=numDWordsChanHead; // skip forward
-					//continue; // no further processing of this event
-					LMBuffer[ModNum][bufPtr+chanHeadEventStatusIdx] |= 0x80000000; // mark event as bad
-
-					// try to recover
-					hit = (U16)(LMBuffer[ModNum][bufPtr+chanHeadEventStatusIdx] & 0x000F);
-					switch(hit)
-					{  
-						case 0x1:
-							ChanNum = 0;
-							break;
-						case 0x2:
-							ChanNum = 1;
-							break;
-						case 0x4:
-							ChanNum = 2;
-							break;
-						case 0x8:
-							ChanNum = 3;
-							break;
-						default: 
-							ChanNum = 0;		// default to zero if both header and hit are bad 
-							break;
+				else	// if not, maybe just a few digits are wrong: check
+				{					
+					// give a point for a number at correct position: 0 (no match) to 8 points (full match)
+					value = QC_Watermark_Score(currentDWord);
+				
+					// if watermark word is almost correct, but not full match: still count as OK, fix and continue.
+					if (value > 6 &&  value < 8) {  // for more robust watermark word, change acceptance level.
+						Pixie_Log_Rec(PrintDebugMsg_QCerror, "*ERROR* (Process_DMA_Buffer): @ 0x%08X B bad watermark 0x%08X, fixed. (module %d, event %d)", 4, bufPtr*4, currentDWord, ModNum, goodEventCount);
+						badWatermarkCount++;
+						pQC[bufPtr+chanHeadWatermarkIdx] = WATERMARK; // corrected
+						pQC[bufPtr+chanHeadEventStatusIdx] |= 0x80000000; // mark event as bad
 					}
-					// reconstruct energy (lo), channel (hi)
-					value = (LMBuffer[ModNum][bufPtr+chanHeadEnChanIdx] & 0xFFFF) + (ChanNum << 16);
-					LMBuffer[ModNum][bufPtr+chanHeadEnChanIdx] = value;
 				}
-				EventLengthDSP = EventLength[ModNum][ChanNum];
-			} // CHANNEL NUMBER CHECK END
+
+				if (value<=6)  // if more than two digits are wrong: assume that this is not the watermark, go to next word
+				{
+					bufPtr++;
+					offsetWordCount++;
+					continue; // next word
+				} 
+				// WATERMARK CHECK END
+
+	#ifdef MAKE_CHAN_HEAD_ERRORS
+				// DEBUG Breaking some channel header words
+				if (goodEventCount %2 == 1) {
+					pQC[bufPtr+1] = pQC[bufPtr+1]+ 0x10000;
+				}
+	#endif
+
+				traceBlocksFollow = (pQC[bufPtr+chanHeadNumBlocksIdx] & 0x0000FFFF);
+				traceBlocksPrev   = (pQC[bufPtr+chanHeadNumBlocksIdx] & 0xFFFF0000) >> 16;
+				numDWordsTrace    = traceBlocksFollow*BLOCKSIZE/2;
+
+				// CHECK SUM CHECK BEGIN
+				checkSum = pQC[bufPtr+chanHeadCheckSumIdx];
+				// Checksum only contains words written in main.sam(LMprocessing()), header words 0-7
+				checkSumComputed = QC_Header_Checksum(&pQC[bufPtr]);
+
+				// If channel header corrupted, mark it as bad event
+				// then, check and correct a few key values
+				// channel number: 
+				//		- can be compared to hit pattern, use that if header value is unreasonable
+				// previous trace length: 
+				//		- known from before
+				// current trace length: 
+				//		- can be expected to be DSP parameter value (or less in special code)
+				//		  this channel's DSP parameter value is stored in file header (TL#_DSP)
+				//		- try reasonable values then ([maybe] search for next watermark to verify header value (up to TL#_DSP)
+				//		- if true length less than TL#_DSP, correct header with that value and store that much trace
+				//		- if true length more than TL#_DSP (ie, watermark not found), correct header with TL#_DSP and store that much trace
+				//		  (excess will be discarded in watermark search next time around)
+				//		- if end of buffer earlier than TL#_DSP, treat as split event (ie currently: discard)
+				// Note: if checksum is ok and tracelength written is incorrect (more or less data), 
+				// event should be marked bad and saved with trace length as in header. Missing data will be 
+				// filled with junk (actually next channel header), excess data will be truncated in watermark search next time around
+				// This is applied below
+
+				if (checkSumComputed != checkSum) {
+					Pixie_Log_Rec(PrintDebugMsg_QCerror, "*ERROR* (Process_DMA_Buffer): @ 0x%08X B bad checksum, expected 0x%08X, calculated 0x%08X (module %d event %d)", 5, bufPtr*4, checkSum, checkSumComputed, ModNum, goodEventCount);
+					checkSumMismatchCount++;
+					pQC[bufPtr+chanHeadEventStatusIdx] |= 0x80000000; // mark event as bad
+				} // CHECK SUM CHECK END
+
+				// CHANNEL NUMBER CHECK BEGIN
+				if  (RunType!=0x402) 	{	// run type 0x402 does not have the channel number in the usual place, can't check
+					ChanNum = (U16)((pQC[bufPtr+chanHeadEnChanIdx] & 0xFFFF0000) >> 16); 
+					ChanNum = ChanNum & 0x00FF;		// upper bits of channel number reserved for special records
+					if (ChanNum >= NUMBER_OF_CHANNELS) {
+						badChanNumCount++;								
+						Pixie_Log_Rec(PrintDebugMsg_QCerror, "*ERROR* (Process_DMA_Buffer): @ 0x%08X B wrong channel number %d", 2, bufPtr*4, ChanNum);
+						// uncomment 2 lines below to reject such events
+						//bufPtr+=numDWordsChanHead; // skip forward
+						//continue; // no further processing of this event
+						pQC[bufPtr+chanHeadEventStatusIdx] |= 0x80000000; // mark event as bad
+
+						// try to recover
+						hit = (U16)(pQC[bufPtr+chanHeadEventStatusIdx] & 0x000F);
+						switch(hit)
+						{  
+							case 0x1:
+								ChanNum = 0;
+								break;
+							case 0x2:
+								ChanNum = 1;
+								break;
+							case 0x4:
+								ChanNum = 2;
+								break;
+							case 0x8:
+								ChanNum = 3;
+								break;
+							default: 
+								ChanNum = 0;		// default to zero if both header and hit are bad 
+								break;
+						}
+						// reconstruct energy (lo), channel (hi)
+						value = (pQC[bufPtr+chanHeadEnChanIdx] & 0xFFFF) + (ChanNum << 16);
+						pQC[bufPtr+chanHeadEnChanIdx] = value;
+					}
+					EventLengthDSP = EventLength[ModNum][ChanNum];
+				} // CHANNEL NUMBER CHECK END
 
 
 
 			
-			// EVENT LENGTH CHECK  A) trace length previously
-			if(traceBlocksPrev != traceBlocksPrev_QC[ModNum]) {
-				printf(ErrMSG, "*ERROR* (Write_DMA_List_Mode_File): @ 0x%08X B prev. tracelength mismatch (fixed). measured %d, header %d (module %d, event %d)", bufPtr*4, traceBlocksPrev_QC[ModNum], traceBlocksPrev, ModNum, goodEventCount);
-				Pixie_Print_MSG(ErrMSG,PrintDebugMsg_QCerror);
-				traceBlocksPrev = traceBlocksPrev_QC[ModNum]; // use the value remembered
-				traceBlocksMismatchCount++;
-				LMBuffer[ModNum][bufPtr+chanHeadEventStatusIdx] |= 0x80000000; // mark event as bad
-				LMBuffer[ModNum][bufPtr+chanHeadNumBlocksIdx] = traceBlocksFollow + (traceBlocksPrev << 16); // update with correct length
-			} // END EVENT LENGTH CHECK A)
-
-
-			// BEGIN CHECK FOR END OF RUN 
-			if ((LMBuffer[ModNum][bufPtr+chanHeadEventStatusIdx] &0x0F00000F )==EORMARK) {	// special record: end run
-				sprintf(ErrMSG, "*INFO*  (Write_DMA_List_Mode_File): END of data, last TimeStamp=%u", LMBuffer[ModNum][bufPtr+2]);
-				Pixie_Print_MSG(ErrMSG,PrintDebugMsg_QCdetail);
-#ifdef DUMP	
-				memcpy(pLMBufferCopy+goodEventBytes/sizeof(U32), &LMBuffer[ModNum][bufPtr], (numDWordsChanHead)*sizeof(U32));
-				goodEventBytes += (numDWordsChanHead)*sizeof(U32);
-#endif
-				EndRunFound[ModNum] = 1;
-				bufPtr += (numDWordsChanHead); // advance only to trace, then step to next event
-				break; // no further processing of buffer
-			} 
-			else {
-				// EVENT LENGTH CHECK  B) trace length to follow. j will return the true trace length to write
-				nextWMfound = FALSE;	
-				nextWMoutside = FALSE;	// if _any_ of the checks find WM would be outside buffer, we assume it is. not 100% correct considering header value may be way off
-				// first, try if recorded value is ok
-				j = traceBlocksFollow*BLOCKSIZE/2 + chanHeadWatermarkIdx;				// operating on 32bit variables, but blocks are measured for 16 bit numbers
-				if(numDWordsRemaining-numDWordsChanHead > j) {							// only if there are enough words left
-					if(LMBuffer[ModNum][bufPtr+numDWordsChanHead+j] == WATERMARK)		// check for watermark
-						nextWMfound = TRUE;
-				}
+				// EVENT LENGTH CHECK  A) trace length previously
+				if(traceBlocksPrev != traceBlocksPrev_QC[ModNum]) {
+					Pixie_Log_Rec(PrintDebugMsg_QCerror, "*ERROR* (Process_DMA_Buffer): @ 0x%08X B prev. tracelength mismatch (fixed). measured %d, header %d (module %d, event %d)", 5, bufPtr*4, traceBlocksPrev_QC[ModNum], traceBlocksPrev, ModNum, goodEventCount);
+					traceBlocksPrev = traceBlocksPrev_QC[ModNum]; // use the value remembered
+					traceBlocksMismatchCount++;
+					pQC[bufPtr+chanHeadEventStatusIdx] |= 0x80000000; // mark event as bad
+					pQC[bufPtr+chanHeadNumBlocksIdx] = traceBlocksFollow + (traceBlocksPrev << 16); // update with correct length
+				} // END EVENT LENGTH CHECK A)
+
+
+				// BEGIN CHECK FOR END OF RUN 
+				if ((pQC[bufPtr+chanHeadEventStatusIdx] &0x0F00000F )==EORMARK) {	// special record: end run
+					Pixie_Log_Rec(PrintDebugMsg_QCdetail, "*INFO*  (Process_DMA_Buffer): END of data, last TimeStamp=%u", 1, pQC[bufPtr+2]);
+	#ifdef DUMP	
+	#ifdef XIA_LINUX
+					if(zeroCopy)
+						LM_Span_Add(ModNum, &pQC[bufPtr], numDWordsChanHead);
+					else
+	#endif
+					memcpy(pLMBufferCopy+goodEventBytes/sizeof(U32), &pQC[bufPtr], (numDWordsChanHead)*sizeof(U32));
+					goodEventBytes += (numDWordsChanHead)*sizeof(U32);
+	#endif
+					__atomic_store_n(&EndRunFound[ModNum], 1, __ATOMIC_RELEASE);	// read by the run stop loop
+					stopQC = TRUE;
+					bufPtr += (numDWordsChanHead); // advance only to trace, then step to next event
+					break; // no further processing of buffer
+				} 
 				else {
-					nextWMoutside = TRUE;
-				}
-
-				// second, try if zero (special code removing trace or special record with no trace and wrong channel number)
-				if(!nextWMfound) {
-					j = 0 + chanHeadWatermarkIdx; // 
-					if(numDWordsRemaining-numDWordsChanHead > j) {						// only if there are enough words left
-						if(LMBuffer[ModNum][bufPtr+numDWordsChanHead+j] == WATERMARK)	// check for watermark
+					// EVENT LENGTH CHECK  B) trace length to follow. j will return the true trace length to write
+					nextWMfound = FALSE;	
+					nextWMoutside = FALSE;	// if _any_ of the checks find WM would be outside buffer, we assume it is. not 100% correct considering header value may be way off
+					// first, try if recorded value is ok
+					j = traceBlocksFollow*BLOCKSIZE/2 + chanHeadWatermarkIdx;				// operating on 32bit variables, but blocks are measured for 16 bit numbers
+					if(numDWordsRemaining-numDWordsChanHead > j) {							// only if there are enough words left
+						if(pQC[bufPtr+numDWordsChanHead+j] == WATERMARK)		// check for watermark
 							nextWMfound = TRUE;
 					}
 					else {
 						nextWMoutside = TRUE;
 					}
-				}
 
-				// third, try if nominal value of DSP parameter is ok (should be so, unless special code recording shorter waveform or channel number wrong)
-				if(!nextWMfound) {
-					j = EventLengthDSP*BLOCKSIZE/2 - numDWordsChanHead + chanHeadWatermarkIdx;	// event length is trace length plus header, in blocks, so subtract that for tracelength
-					if(numDWordsRemaining-numDWordsChanHead > j) {										// only if there are enough words left
-						if(LMBuffer[ModNum][bufPtr+numDWordsChanHead+j] == WATERMARK)					// check for watermark
-							nextWMfound = TRUE;
+					// second, try if zero (special code removing trace or special record with no trace and wrong channel number)
+					if(!nextWMfound) {
+						j = 0 + chanHeadWatermarkIdx; // 
+						if(numDWordsRemaining-numDWordsChanHead > j) {						// only if there are enough words left
+							if(pQC[bufPtr+numDWordsChanHead+j] == WATERMARK)	// check for watermark
+								nextWMfound = TRUE;
+						}
+						else {
+							nextWMoutside = TRUE;
+						}
 					}
-					else {
-						nextWMoutside = TRUE;
+
+					// third, try if nominal value of DSP parameter is ok (should be so, unless special code recording shorter waveform or channel number wrong)
+					if(!nextWMfound) {
+						j = EventLengthDSP*BLOCKSIZE/2 - numDWordsChanHead + chanHeadWatermarkIdx;	// event length is trace length plus header, in blocks, so subtract that for tracelength
+						if(numDWordsRemaining-numDWordsChanHead > j) {										// only if there are enough words left
+							if(pQC[bufPtr+numDWordsChanHead+j] == WATERMARK)					// check for watermark
+								nextWMfound = TRUE;
+						}
+						else {
+							nextWMoutside = TRUE;
+						}
 					}
-				}
 
-				// If nextWMfound, j is the offset to the next watermark (minus header, but including watermarkindex).
-				// if not found,   j is the last try, which is the DSP setting
-				//					this may be a short event, but we store a full TL anyway
+					// If nextWMfound, j is the offset to the next watermark (minus header, but including watermarkindex).
+					// if not found,   j is the last try, which is the DSP setting
+					//					this may be a short event, but we store a full TL anyway
 
 
-				// correct trace length if neccesary
-				numDWordsTrace = j - chanHeadWatermarkIdx;									// trace: number of Dwords
-				traceBlocksFollow_QC = (U32)ceil( (double)numDWordsTrace/BLOCKSIZE*2);		// trace: number of blocks (rounded up)
-				if ((traceBlocksFollow_QC != traceBlocksFollow) && !nextWMoutside ) {		// this only checks for mismatch between header value and value used to record. short events (!nextWMfound but channel header TL matches run header TL) are handled below
-					if (nextWMfound)  sprintf(ErrMSG, "*ERROR* (Write_DMA_List_Mode_File): @ 0x%08X B tracelength mismatch (fixed). Measured %d, header %d, (module %d event %d)", bufPtr*sizeof(U32), traceBlocksFollow_QC, traceBlocksFollow, ModNum, goodEventCount);
-					else			  sprintf(ErrMSG, "*ERROR* (Write_DMA_List_Mode_File): @ 0x%08X B tracelength mismatch (fixed). WM not found, using %d, header %d, (module %d, event %d)", bufPtr*sizeof(U32), traceBlocksFollow_QC, traceBlocksFollow, ModNum, goodEventCount);
-					Pixie_Print_MSG(ErrMSG,PrintDebugMsg_QCerror);
-					traceBlocksMismatchCount++;
-					LMBuffer[ModNum][bufPtr+chanHeadEventStatusIdx] |= 0x80000000; // mark event as bad
-					LMBuffer[ModNum][bufPtr+chanHeadNumBlocksIdx] = traceBlocksFollow_QC + (traceBlocksPrev << 16);	// update with correct length
-				}
-				else {
-					if (nextWMoutside) {
-						sprintf(ErrMSG, "*DEBUG* (Write_DMA_List_Mode_File): @ 0x%08X B tracelength could not be verified, next WM beyond buffer.  Using %d, header %d, (module %d, event %d)", bufPtr*sizeof(U32), traceBlocksFollow_QC, traceBlocksFollow, ModNum, goodEventCount);
-						Pixie_Print_MSG(ErrMSG,PrintDebugMsg_QCdetail);
+					// correct trace length if neccesary
+					numDWordsTrace = j - chanHeadWatermarkIdx;									// trace: number of Dwords
+					traceBlocksFollow_QC = (U32)ceil( (double)numDWordsTrace/BLOCKSIZE*2);		// trace: number of blocks (rounded up)
+					if ((traceBlocksFollow_QC != traceBlocksFollow) && !nextWMoutside ) {		// this only checks for mismatch between header value and value used to record. short events (!nextWMfound but channel header TL matches run header TL) are handled below
+						if (nextWMfound)  Pixie_Log_Rec(PrintDebugMsg_QCerror, "*ERROR* (Process_DMA_Buffer): @ 0x%08X B tracelength mismatch (fixed). Measured %d, header %d, (module %d event %d)", 5, (U32)(bufPtr*sizeof(U32)), traceBlocksFollow_QC, traceBlocksFollow, ModNum, goodEventCount);
+						else			  Pixie_Log_Rec(PrintDebugMsg_QCerror, "*ERROR* (Process_DMA_Buffer): @ 0x%08X B tracelength mismatch (fixed). WM not found, using %d, header %d, (module %d, event %d)", 5, (U32)(bufPtr*sizeof(U32)), traceBlocksFollow_QC, traceBlocksFollow, ModNum, goodEventCount);
+						traceBlocksMismatchCount++;
+						pQC[bufPtr+chanHeadEventStatusIdx] |= 0x80000000; // mark event as bad
+						pQC[bufPtr+chanHeadNumBlocksIdx] = traceBlocksFollow_QC + (traceBlocksPrev << 16);	// update with correct length
+					}
+					else {
+						if (nextWMoutside) {
+							Pixie_Log_Rec(PrintDebugMsg_QCdetail, "*DEBUG* (Process_DMA_Buffer): @ 0x%08X B tracelength could not be verified, next WM beyond buffer.  Using %d, header %d, (module %d, event %d)", 5, (U32)(bufPtr*sizeof(U32)), traceBlocksFollow_QC, traceBlocksFollow, ModNum, goodEventCount);
+						}
 					}
-				}
 				
-				traceBlocksPrev_QC[ModNum] = (U16)traceBlocksFollow_QC;		// current follow becomes next event's previous
-				// END EVENT LENGTH CHECK B)
-			}	// END CHECK FOR END OF RUN 
+					traceBlocksPrev_QC[ModNum] = (U16)traceBlocksFollow_QC;		// current follow becomes next event's previous
+					// END EVENT LENGTH CHECK B)
+				}	// END CHECK FOR END OF RUN 
 
 			
-			// Now prepare to write to file					
-			numDWordsToWrite   = numDWordsChanHead + numDWordsTrace;		// set up defaults for good event
-			numDWordsToAdvance = numDWordsToWrite;
-			numDWordsLeftover[ModNum]  = 0; 
-
-			if ( numDWordsToWrite > numDWordsRemaining) {		// split trace
-				splitTraceCount++;
-//LMBuffer[ModNum][bufPtr+chanHeadEventStatusIdx] |= 0x10000000; // debug: mark event as split
-				numDWordsLeftover[ModNum]  = numDWordsToWrite - numDWordsRemaining;		// numberwords to write = lesser of numDWordsChanHead+numDWordsTrace and numDWordsRemaining	
-				numDWordsToAdvance = numDWordsRemaining;
-				numDWordsToWrite   = numDWordsRemaining;
-				goodEventCount++;
-				sprintf(ErrMSG, "*DEBUG* (Write_DMA_List_Mode_File): @ 0x%08X B found multi-buffer event (split current trace), split count %d, remaining words %d (event %d)", bufPtr*sizeof(U32), splitTraceCount, numDWordsLeftover[ModNum],goodEventCount-1);
-				Pixie_Print_MSG(ErrMSG,PrintDebugMsg_QCdetail);
-			}
-			else {
-				if (numDWordsToWrite + numDWordsChanHead > numDWordsRemaining) {	// split (or no) next header. no need to worry here, current event is ok, next will be investigated next cycle
+				// Now prepare to write to file					
+				numDWordsToWrite   = numDWordsChanHead + numDWordsTrace;		// set up defaults for good event
+				numDWordsToAdvance = numDWordsToWrite;
+				numDWordsLeftover[ModNum]  = 0; 
+
+				if ( numDWordsToWrite > numDWordsRemaining && saved) {		// split trace: undo QC, carry over, QC again joined with the next buffer
+					memcpy(&pQC[bufPtr], saveHeader, numDWordsChanHead*sizeof(U32));
+					badWatermarkCount        = saveCount[0];
+					checkSumMismatchCount    = saveCount[1];
+					badChanNumCount          = saveCount[2];
+					traceBlocksMismatchCount = saveCount[3];
+					traceBlocksPrev_QC[ModNum] = savePrevQC;
+					carryFrom = bufPtr;
+					numDWordsCarry = numDWordsRemaining;
+					splitCarryCount++;
+					Pixie_Log_Rec(PrintDebugMsg_QCdetail, "*DEBUG* (Process_DMA_Buffer): @ 0x%08X B split trace, carried over to next buffer, carry count %d", 2, (U32)(bufPtr*sizeof(U32)), splitCarryCount);
+					break;
+				}
+				if ( numDWordsToWrite > numDWordsRemaining) {		// split trace, can not be joined
+					splitTraceCount++;
+	//pQC[bufPtr+chanHeadEventStatusIdx] |= 0x10000000; // debug: mark event as split
+					numDWordsLeftover[ModNum]  = numDWordsToWrite - numDWordsRemaining;		// numberwords to write = lesser of numDWordsChanHead+numDWordsTrace and numDWordsRemaining	
+					numDWordsToAdvance = numDWordsRemaining;
+					numDWordsToWrite   = numDWordsRemaining;
 					goodEventCount++;
-					sprintf(ErrMSG, "*DEBUG* (Write_DMA_List_Mode_File): @ 0x%08X B found split next header (or none if remainder 0), remaining words %d (event %d)", bufPtr*sizeof(U32), numDWordsLeftover[ModNum],goodEventCount-1);
-					Pixie_Print_MSG(ErrMSG,PrintDebugMsg_QCdetail);
+					Pixie_Log_Rec(PrintDebugMsg_QCdetail, "*DEBUG* (Process_DMA_Buffer): @ 0x%08X B found multi-buffer event (split current trace), split count %d, remaining words %d (event %d)", 4, (U32)(bufPtr*sizeof(U32)), splitTraceCount, numDWordsLeftover[ModNum], goodEventCount-1);
 				}
 				else {
-					if(nextWMfound)		// truly good
+					if (numDWordsToWrite + numDWordsChanHead > numDWordsRemaining) {	// split (or no) next header. no need to worry here, current event is ok, next will be investigated next cycle
 						goodEventCount++;
-					else				// short trace, "bad"
-					{
-						badEventCount++;
-						goodEventCount++;	// we are counting all written to file in the goodEventCount						
-						numDWordsToAdvance = numDWordsChanHead;		// to search for watermark of next event in next loop
-						sprintf(ErrMSG, "*ERROR* (Write_DMA_List_Mode_File): @ 0x%08X B found short event record or corrupt next header, (module %d, event %d) ", bufPtr*sizeof(U32), ModNum, goodEventCount-1);
-						Pixie_Print_MSG(ErrMSG,PrintDebugMsg_QCerror);
-						LMBuffer[ModNum][bufPtr+chanHeadEventStatusIdx] |= 0x80000000; // mark event as bad
+						Pixie_Log_Rec(PrintDebugMsg_QCdetail, "*DEBUG* (Process_DMA_Buffer): @ 0x%08X B found split next header (or none if remainder 0), remaining words %d (event %d)", 3, (U32)(bufPtr*sizeof(U32)), numDWordsLeftover[ModNum], goodEventCount-1);
+					}
+					else {
+						if(nextWMfound)		// truly good
+							goodEventCount++;
+						else				// short trace, "bad"
+						{
+							badEventCount++;
+							goodEventCount++;	// we are counting all written to file in the goodEventCount						
+							numDWordsToAdvance = numDWordsChanHead;		// to search for watermark of next event in next loop
+							Pixie_Log_Rec(PrintDebugMsg_QCerror, "*ERROR* (Process_DMA_Buffer): @ 0x%08X B found short event record or corrupt next header, (module %d, event %d) ", 3, (U32)(bufPtr*sizeof(U32)), ModNum, goodEventCount-1);
+							pQC[bufPtr+chanHeadEventStatusIdx] |= 0x80000000; // mark event as bad
+						}
 					}
 				}
-			}
+				if (RunType != 0x402)
+					chanEvents[ChanNum]++;		// ChanNum < NUMBER_OF_CHANNELS after the channel number check
+				if (LMHist)
+					LM_Hist_Event(ModNum, &pQC[bufPtr], RunType);
 		
-#ifdef DUMP
-			// Now finally write to file (actually, fill output buffer to write) 
-			memcpy(pLMBufferCopy+goodEventBytes/sizeof(U32), &LMBuffer[ModNum][bufPtr], (numDWordsToWrite)*sizeof(U32));
-			goodEventBytes += (numDWordsToWrite)*sizeof(U32);
-#endif		
-			bufPtr += (numDWordsToAdvance); // increment to next event (most cases)
-		//	continue;
-		} // END WHILE INSIDE BUFFER
+	#ifdef DUMP
+				// Now finally write to file (actually, fill output buffer or span list to write) 
+	#ifdef XIA_LINUX
+				if(zeroCopy)
+					LM_Span_Add(ModNum, &pQC[bufPtr], numDWordsToWrite);
+				else
+	#endif
+				memcpy(pLMBufferCopy+goodEventBytes/sizeof(U32), &pQC[bufPtr], (numDWordsToWrite)*sizeof(U32));
+				goodEventBytes += (numDWordsToWrite)*sizeof(U32);
+	#endif		
+				bufPtr += (numDWordsToAdvance); // increment to next event (most cases)
+			//	continue;
+			} // END WHILE INSIDE BUFFER
+		} // END FOR PASS
 
 
 		// Report things that should not have happened
 		// if detail print is on, print always. if not, only print when there have been errors
 		if (PrintDebugMsg_QCdetail || PrintDebugMsg_other) {
-			sprintf(ErrMSG, "*DEBUG* (Write_DMA_List_Mode_File): Spill %d: Mod %d total=%d, short=%d, splitH=%d, splitT=%d, offset=%d,  traceMismatch=%d, badWM=%d, badChanNum=%d, badCheckSum=%d", LMBufferCounter[ModNum], ModNum, goodEventCount, badEventCount, splitHeaderCount, splitTraceCount, offsetWordCount, traceBlocksMismatchCount, badWatermarkCount, badChanNumCount, checkSumMismatchCount);
+			sprintf(ErrMSG, "*DEBUG* (Process_DMA_Buffer): Spill %d: Mod %d total=%d, short=%d, splitH=%d, splitT=%d, carried=%d, offset=%d,  traceMismatch=%d, badWM=%d, badChanNum=%d, badCheckSum=%d", LMBufferCounter[ModNum], ModNum, goodEventCount, badEventCount, splitHeaderCount, splitTraceCount, splitCarryCount, offsetWordCount, traceBlocksMismatchCount, badWatermarkCount, badChanNumCount, checkSumMismatchCount);
 			Pixie_Print_MSG(ErrMSG,1);
 		}
 		else {
 			if (badEventCount>0 || traceBlocksMismatchCount>0 || badWatermarkCount>0 || badChanNumCount>0 || checkSumMismatchCount>0 || splitHeaderCount>0 ) {
-				sprintf(ErrMSG, "*WARNING* (Write_DMA_List_Mode_File): Spill %d, Mod %d: total=%d, short=%d, splitH=%d, splitT=%d, offset=%d,  traceMismatch=%d, badWM=%d, badChanNum=%d, badCheckSum=%d", LMBufferCounter[ModNum], ModNum, goodEventCount, badEventCount, splitHeaderCount, splitTraceCount, offsetWordCount, traceBlocksMismatchCount, badWatermarkCount, badChanNumCount, checkSumMismatchCount);
+				sprintf(ErrMSG, "*WARNING* (Process_DMA_Buffer): Spill %d, Mod %d: total=%d, short=%d, splitH=%d, splitT=%d, carried=%d, offset=%d,  traceMismatch=%d, badWM=%d, badChanNum=%d, badCheckSum=%d", LMBufferCounter[ModNum], ModNum, goodEventCount, badEventCount, splitHeaderCount, splitTraceCount, splitCarryCount, offsetWordCount, traceBlocksMismatchCount, badWatermarkCount, badChanNumCount, checkSumMismatchCount);
 				Pixie_Print_MSG(ErrMSG,1);
 			}
 		}
+		if(!zeroCopy)		// events are copied to LMBufferCopy: LMCarry is free for the tail of this buffer
+			LM_Carry_Save(ModNum, &pBuf[carryFrom], numDWordsCarry, numDWordsMaxEvent);
+
 	//	if(!EndRunFound[ModNum]) {			// only if the run is not over anyway 
+		if(!rearmed && !zeroCopy) {		// with zeroCopy, the data is still in the DMA buffer: restart after writing
 			// Set the last element to a known pattern, change of which will be used as DMA idle indicator.
 			
 			LMBuffer[ModNum][DMA_LM_FRAMEBUFFER_LENGTH/(sizeof(U32))-1] = 0xA5A5A5A5;
 
 			VDMADriver_SetDPTR(hDev[ModNum], MAIN_START);			// rewind DMA sequencer
 			VDMADriver_Go(hDev[ModNum]);							// resume DMA (that was halted by finishing the SG list)
-			sprintf(ErrMSG, "*DEBUG* (Write_DMA_List_Mode_File): Sequencer restarted");
+			sprintf(ErrMSG, "*DEBUG* (Process_DMA_Buffer): Sequencer restarted");
 			Pixie_Print_MSG(ErrMSG,PrintDebugMsg_daq);
+		}
 	//	}
 
 #ifdef DUMP
@@ -4398,7 +5141,15 @@ S32 Write_DMA_List_Mode_File (
 				case 0x400: // Binary file
 				case 0x402: // Binary file
 				case 0x403:
-					eventsWritten = fwrite(pLMBufferCopy, goodEventBytes, 1, listFile[ModNum]);
+#ifdef XIA_LINUX
+					if(zeroCopy)
+						LM_Spans_Write(ModNum);
+					else
+#endif
+					{
+						eventsWritten = fwrite(pLMBufferCopy, goodEventBytes, 1, listFile[ModNum]);
+						Live_Stats_Bytes(ModNum, goodEventBytes);
+					}
 					break;
 				case 0x401: // ASCII file, no trace (like AutoPRocessLMData=3)
 					EvStart = 0;
@@ -4407,9 +5158,9 @@ S32 Write_DMA_List_Mode_File (
 							"%u   %hu   %llu   %hu   %hu   %hu   %hu   %hu  %hu  %hu\n", 
 							dt3EventCounter[ModNum]++, 
 							((U16*)pLMBufferCopy)[9+EvStart],
-							(unsigned long long)(65536.0 * 65536.0 * (double)((U16*)pLMBufferCopy)[6+EvStart] + 
-							65536.0 * (double)((U16*)pLMBufferCopy)[5+EvStart] + 
-							(double)((U16*)pLMBufferCopy)[4+EvStart]),
+							((unsigned long long)((U16*)pLMBufferCopy)[6+EvStart] << 32) + 
+							((unsigned long long)((U16*)pLMBufferCopy)[5+EvStart] << 16) + 
+							(unsigned long long)((U16*)pLMBufferCopy)[4+EvStart],
 							((U16*)pLMBufferCopy)[8+EvStart],
 							((U16*)pLMBufferCopy)[11+EvStart],
 							((U16*)pLMBufferCopy)[10+EvStart],
@@ -4425,27 +5176,38 @@ S32 Write_DMA_List_Mode_File (
 			} // switch RunType
 
 #endif // if DUMP
+
+		if(zeroCopy)		// spans are written: LMCarry is free for the tail of this buffer
+			LM_Carry_Save(ModNum, &pBuf[carryFrom], numDWordsCarry, numDWordsMaxEvent);
+
+		if(!rearmed && zeroCopy) {
+			LMBuffer[ModNum][DMA_LM_FRAMEBUFFER_LENGTH/(sizeof(U32))-1] = 0xA5A5A5A5;
+			VDMADriver_SetDPTR(hDev[ModNum], MAIN_START);			// rewind DMA sequencer
+			VDMADriver_Go(hDev[ModNum]);							// resume DMA (that was halted by finishing the SG list)
+			sprintf(ErrMSG, "*DEBUG* (Process_DMA_Buffer): Sequencer restarted");
+			Pixie_Print_MSG(ErrMSG,PrintDebugMsg_daq);
+		}
 		
+		if(rearmed)
+			Free_DMA_Ring_Slot(ModNum, pBuf);
+
 		LMBufferCounter[ModNum]++;
-		sprintf(ErrMSG, "*DEBUG* (Write_DMA_List_Mode_File): Done Write_DMA_List_Mode_File with spill %d",LMBufferCounter[ModNum]);
-		Pixie_Print_MSG(ErrMSG,PrintDebugMsg_QCdetail);
+		Pixie_Log_Rec(PrintDebugMsg_QCdetail, "*DEBUG* (Process_DMA_Buffer): Done Process_DMA_Buffer with spill %d", 1, LMBufferCounter[ModNum]);
 
+		liveQC[LIVE_QC_EVENTS]         = goodEventCount;
+		liveQC[LIVE_QC_SHORT]          = badEventCount;
+		liveQC[LIVE_QC_SPLIT_HEADER]   = splitHeaderCount;
+		liveQC[LIVE_QC_SPLIT_TRACE]    = splitTraceCount;
+		liveQC[LIVE_QC_TRACE_MISMATCH] = traceBlocksMismatchCount;
+		liveQC[LIVE_QC_BAD_WATERMARK]  = badWatermarkCount;
+		liveQC[LIVE_QC_BAD_CHANNEL]    = badChanNumCount;
+		liveQC[LIVE_QC_BAD_CHECKSUM]   = checkSumMismatchCount;
+		Live_Stats_Buffer(ModNum, liveQC, chanEvents, liveStart);
 
-#endif // if WINDRIVER_API
 
-	if(MakeNewFile)	{	// if a top level call asked for new file in multi-file runs, make/switch files now for all modules
-		// first write any left overs. (cleared in Create_List_Mode_File) 
-		if(numDWordsLeftover[ModNum]>0) {
-			eventsWritten = fwrite(LMBuffer[ModNum], (numDWordsLeftover[ModNum])*sizeof(U32), 1, listFile[ModNum]);
-		}
-		// TODO: insert EOR block at the end of the old files
-		// then make new files
-		for(j=0; j < Number_Modules; j++) {
-			Create_List_Mode_File(j, next_base_name, RunType);
-		}
-	}
+#endif // if WINDRIVER_API
 
-	return(EndRunFound[ModNum]);
+	return(0);
 }
 
 /****************************************************************
@@ -4896,8 +5658,7 @@ S32 ComputePSA(U16 *trace, U32 traceLen, U32 *PSAval)
     retval = 0;
 
     if (lev10 >= lev90 || lev10 >=V_maxloc || lev90 > V_maxloc)  {
-        sprintf (ErrMSG, "*WARNING* (ComputePSA): problems with finding rising edge: lev10 x=%d, peak x=%d, lev90 x=%d", lev10, V_maxloc, lev90);
-        Pixie_Print_MSG(ErrMSG, PrintDebugMsg_QCdetail);
+        Pixie_Log_Rec(PrintDebugMsg_QCdetail, "*WARNING* (ComputePSA): problems with finding rising edge: lev10 x=%d, peak x=%d, lev90 x=%d", 3, lev10, V_maxloc, lev90);
         retval = -1;
     }
 
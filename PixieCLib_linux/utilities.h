@@ -70,6 +70,12 @@ S32 Tau_Finder (
 			U8 ChanNum,			// Pixie channel number
 			double *Tau );		// Tau value
 
+S32 Tau_Finder_Set (
+			U8 ModNum,			// Pixie module number
+			U8 ChanNum,			// Pixie channel number
+			double *Tau,		// Tau value
+			U16 *RandomSet );	// random order of IO_BUFFER_LENGTH indices, see RandomSwap
+
 
 
 
@@ -94,7 +100,8 @@ double Thresh_Finder (
 			U32 FL,				// fast length
 			U32 FG,				// fast gap
 			U8  ModNum,			// Pixie module number
-			U8  ChanNum );		// Pixie channel number
+			U8  ChanNum,		// Pixie channel number
+			U16 *RandomSet );	// random order of IO_BUFFER_LENGTH indices
 
 S32 Adjust_Offsets (
 			U8 ModNum );	// module number
@@ -163,10 +170,51 @@ S32 Pixie_List_Mode_Parser(
 S32 Pixie_Event_Browser(
 			S8 *filename, 
 			U32 *UserData);
+S32 LM_Columns_Write(
+			S8 *filename, 
+			U32 *UserData);
+S32 LM_Merge_Write(
+			S8 *filename, 
+			U32 *UserData);
 
 // Processing function for 0x7030
 S32 ComputePSA(U16* trace, U32 traceLength, U32 *PSAval);
 
+// Batch version of ComputePSA (psa_batch.c): traces back to back in Samples, one result array per value
+typedef struct {
+	U32  NumTraces;				// traces in the batch
+	U32  MaxTraces;
+	U32  NumSamples;			// samples of all traces
+	U32  MaxSamples;
+	U16  *Samples;				// traces, back to back
+	U32  *Start;				// first sample of each trace
+	U32  *Length;				// samples of each trace
+	U32  *RiseTime;				// results, as PSAval[11..16] of ComputePSA
+	U32  *Amplitude;
+	U32  *Baseline;
+	U32  *Q0Sum;
+	U32  *Q1Sum;
+	U32  *PSAValue;
+	S32  *Status;				// 0, or -1 where ComputePSA returns -1
+} PSABatch;
+
+S32 PSA_Kernel_Select (
+			S32 Kernel);			// QC_KERNEL_AUTO, _SCALAR, _SSE2 or _AVX2
+PSABatch *PSA_Batch_Create (
+			U32 maxTraces,			// traces per batch
+			U32 maxSamples);		// samples of all traces together
+S32 PSA_Batch_Add (
+			PSABatch *B,			// batch
+			U16 *trace,				// trace
+			U32 traceLen);			// samples
+S32 PSA_Batch_Compute (
+			PSABatch *B,			// batch
+			U32 *PSAval);			// control words, as for ComputePSA
+void PSA_Batch_Clear (
+			PSABatch *B);			// batch
+void PSA_Batch_Free (
+			PSABatch *B);			// batch
+
 #ifdef __cplusplus
 }
 #endif	/* End of notice for C++ compilers */